@@ -5,7 +5,18 @@ project "Walnut"
    targetdir "bin/%{cfg.buildcfg}"
    staticruntime "off"
 
-   files { "src/**.h", "src/**.cpp" }
+   files { "src/**.h", "src/**.cpp", "src/**.inl", "src/**.comp" }
+
+   -- The sources #include the committed SPIR-V words, --compile-shaders regenerates and validates them before the build
+   if _OPTIONS["compile-shaders"] then
+      prebuildmessage "Compiling shaders"
+      prebuildcommands
+      {
+         "%{Tool.glslc} --target-env=vulkan1.0 -O src/Walnut/Shaders/Tonemap.comp -o src/Walnut/Shaders/Tonemap.comp.spv",
+         "%{Tool.spirv_val} --target-env vulkan1.0 src/Walnut/Shaders/Tonemap.comp.spv",
+         "%{Tool.glslc} --target-env=vulkan1.0 -O -mfmt=num src/Walnut/Shaders/Tonemap.comp -o src/Walnut/Shaders/Tonemap.comp.inc",
+      }
+   end
 
    includedirs
    {
@@ -30,10 +41,35 @@ project "Walnut"
    targetdir ("bin/" .. outputdir .. "/%{prj.name}")
    objdir ("../bin-int/" .. outputdir .. "/%{prj.name}")
 
+   if _OPTIONS["unity"] then
+      -- The ImGui backends define their own static helpers (eg. check_vk_result) and stay separate
+      local unitySources = {}
+      for _, source in ipairs(os.matchfiles("src/**.cpp")) do
+         if not source:find("src/Walnut/ImGui/", 1, true) then
+            table.insert(unitySources, source)
+         end
+      end
+
+      local unityFile = path.join(_SCRIPT_DIR, "../bin-int/unity/WalnutUnity.cpp")
+      local lines = { "// Generated by premake --unity, do not edit" }
+      for _, source in ipairs(unitySources) do
+         table.insert(lines, '#include "' .. path.getabsolute(source) .. '"')
+      end
+      os.mkdir(path.getdirectory(unityFile))
+      io.writefile(unityFile, table.concat(lines, "\n") .. "\n")
+
+      files { unityFile }
+      removefiles(unitySources)
+   end
+
    filter "system:windows"
       systemversion "latest"
       defines { "WL_PLATFORM_WINDOWS" }
 
+   filter "system:linux"
+      defines { "WL_PLATFORM_LINUX" }
+      libdirs { "%{LibraryDir.VulkanSDK}" }
+
    filter "configurations:Debug"
       defines { "WL_DEBUG" }
       runtime "Debug"
@@ -49,4 +85,6 @@ project "Walnut"
       defines { "WL_DIST" }
       runtime "Release"
       optimize "On"
-      symbols "Off"
\ No newline at end of file
+      symbols "Off"
+
+   WalnutProfileConfiguration()
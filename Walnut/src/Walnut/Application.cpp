@@ -8,6 +8,7 @@
 #include "backends/imgui_impl_vulkan.h"
 #include <stdio.h>          // printf, fprintf
 #include <stdlib.h>         // abort
+#include <string.h>         // strcmp
 #define GLFW_INCLUDE_NONE
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
@@ -15,6 +16,19 @@
 #include <glm/glm.hpp>
 
 #include <iostream>
+#include <chrono>
+#include <future>
+#include <algorithm>
+
+#include "Clock.h"
+#include "FontAtlasCache.h"
+#include "GPUMemory.h"
+#include "PoolAllocator.h"
+#include "SamplerCache.h"
+#include "TonemapPass.h"
+#include "VulkanHostAllocator.h"
+#include "ImGui/ImGuiBackend.h"
+#include "Input/Input.h"
 
 // Emedded font
 #include "ImGui/Roboto-Regular.embed"
@@ -33,7 +47,7 @@ extern bool g_ApplicationRunning;
 #define IMGUI_VULKAN_DEBUG_REPORT
 #endif
 
-static VkAllocationCallbacks* g_Allocator = NULL;
+static const VkAllocationCallbacks* g_Allocator = NULL;
 static VkInstance               g_Instance = VK_NULL_HANDLE;
 static VkPhysicalDevice         g_PhysicalDevice = VK_NULL_HANDLE;
 static VkDevice                 g_Device = VK_NULL_HANDLE;
@@ -46,17 +60,61 @@ static VkDescriptorPool         g_DescriptorPool = VK_NULL_HANDLE;
 static ImGui_ImplVulkanH_Window g_MainWindowData;
 static int                      g_MinImageCount = 2;
 static bool                     g_SwapChainRebuild = false;
+static bool                     g_SwapChainOutOfDate = false; // Can't be presented to anymore, a suboptimal one still can
+static VkImageUsageFlags        g_SwapChainImageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT; // What ImGui creates them with
+
+// Rebuilds are debounced while the window is being resized, see ApplicationSpecification::SwapchainResizeDebounce
+static int     s_SwapchainPendingWidth = 0;
+static int     s_SwapchainPendingHeight = 0;
+static int64_t s_SwapchainPendingTicks = 0; // When the framebuffer size last changed
+static int64_t s_SwapchainRebuildTicks = 0;
+
+// Up to ApplicationSpecification::MaxFramesInFlight frames are recorded ahead of the GPU, each with its own
+// command pool, fence and deletion queue, whatever the swapchain image count. A frame's slot is only reused
+// once its fence has signaled. Render-complete semaphores stay per swapchain image, see FrameRender
+struct FrameInFlight
+{
+	VkCommandPool CommandPool = VK_NULL_HANDLE;
+	VkCommandBuffer CommandBuffer = VK_NULL_HANDLE;
+	VkFence Fence = VK_NULL_HANDLE;
+	VkSemaphore ImageAcquiredSemaphore = VK_NULL_HANDLE;
+	uint64_t Submission = 0; // Last one signaling Fence
+
+	// Allocated by Application::GetCommandBuffer
+	std::vector<VkCommandBuffer> AllocatedCommandBuffers;
+	std::vector<std::function<void()>> ResourceFreeQueue;
+};
 
-// Per-frame-in-flight
-static std::vector<std::vector<VkCommandBuffer>> s_AllocatedCommandBuffers;
-static std::vector<std::vector<std::function<void()>>> s_ResourceFreeQueue;
+static std::vector<FrameInFlight> s_FramesInFlight;
 
 // Unlike g_MainWindowData.FrameIndex, this is not the the swapchain image index
 // and is always guaranteed to increase (eg. 0, 1, 2, 0, 1, 2)
 static uint32_t s_CurrentFrameIndex = 0;
 
+// Every window of a frame goes out in one submission, signaling the frame's fence.
+// Platform windows wait on these to know when their command buffers are free again
+static Walnut::ImGuiBackend::FrameBatch s_FrameBatch;
+static uint64_t s_Submission = 0;
+static uint64_t s_CompletedSubmission = 0;
+static bool s_PlatformWindowsBatched = false;
+
 static Walnut::Application* s_Instance = nullptr;
 
+// The default font is baked at this size, multiplied by the window's content scale
+static const float s_DefaultFontSize = 20.0f;
+
+// Font atlas rebuilt on a worker thread after the window moves to a monitor with a different content scale
+struct FontAtlasBuild
+{
+	float ContentScale = 1.0f;
+	std::atomic<bool> Ready = false;
+	std::vector<uint8_t> Data;
+};
+
+static float s_FontContentScale = 1.0f;
+static float s_PendingFontContentScale = 1.0f;
+static std::shared_ptr<FontAtlasBuild> s_FontAtlasBuild;
+
 void check_vk_result(VkResult err)
 {
 	if (err == 0)
@@ -75,10 +133,37 @@ static VKAPI_ATTR VkBool32 VKAPI_CALL debug_report(VkDebugReportFlagsEXT flags,
 }
 #endif // IMGUI_VULKAN_DEBUG_REPORT
 
+static bool HasExtension(const std::vector<VkExtensionProperties>& properties, const char* name)
+{
+	for (const VkExtensionProperties& extension : properties)
+	{
+		if (strcmp(extension.extensionName, name) == 0)
+			return true;
+	}
+	return false;
+}
+
 static void SetupVulkan(const char** extensions, uint32_t extensions_count)
 {
 	VkResult err;
 
+	// VK_EXT_memory_budget is queried through vkGetPhysicalDeviceMemoryProperties2KHR
+	std::vector<const char*> instance_extensions(extensions, extensions + extensions_count);
+	bool memory_budget = false;
+	{
+		uint32_t count;
+		vkEnumerateInstanceExtensionProperties(NULL, &count, NULL);
+		std::vector<VkExtensionProperties> properties(count);
+		vkEnumerateInstanceExtensionProperties(NULL, &count, properties.data());
+		if (HasExtension(properties, VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME))
+		{
+			instance_extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+			memory_budget = true;
+		}
+		extensions = instance_extensions.data();
+		extensions_count = (uint32_t)instance_extensions.size();
+	}
+
 	// Create Vulkan Instance
 	{
 		VkInstanceCreateInfo create_info = {};
@@ -171,23 +256,43 @@ static void SetupVulkan(const char** extensions, uint32_t extensions_count)
 
 	// Create Logical Device (with 1 queue)
 	{
-		int device_extension_count = 1;
-		const char* device_extensions[] = { "VK_KHR_swapchain" };
+		std::vector<const char*> device_extensions = { "VK_KHR_swapchain" };
+		if (memory_budget)
+		{
+			uint32_t count;
+			vkEnumerateDeviceExtensionProperties(g_PhysicalDevice, NULL, &count, NULL);
+			std::vector<VkExtensionProperties> properties(count);
+			vkEnumerateDeviceExtensionProperties(g_PhysicalDevice, NULL, &count, properties.data());
+			memory_budget = HasExtension(properties, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+			if (memory_budget)
+				device_extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+		}
+
 		const float queue_priority[] = { 1.0f };
 		VkDeviceQueueCreateInfo queue_info[1] = {};
 		queue_info[0].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
 		queue_info[0].queueFamilyIndex = g_QueueFamily;
 		queue_info[0].queueCount = 1;
 		queue_info[0].pQueuePriorities = queue_priority;
+
+		// Only request what Walnut uses, anisotropic filtering is optional per sampler
+		VkPhysicalDeviceFeatures supported_features;
+		vkGetPhysicalDeviceFeatures(g_PhysicalDevice, &supported_features);
+		VkPhysicalDeviceFeatures enabled_features = {};
+		enabled_features.samplerAnisotropy = supported_features.samplerAnisotropy;
+
 		VkDeviceCreateInfo create_info = {};
 		create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 		create_info.queueCreateInfoCount = sizeof(queue_info) / sizeof(queue_info[0]);
 		create_info.pQueueCreateInfos = queue_info;
-		create_info.enabledExtensionCount = device_extension_count;
-		create_info.ppEnabledExtensionNames = device_extensions;
+		create_info.enabledExtensionCount = (uint32_t)device_extensions.size();
+		create_info.ppEnabledExtensionNames = device_extensions.data();
+		create_info.pEnabledFeatures = &enabled_features;
 		err = vkCreateDevice(g_PhysicalDevice, &create_info, g_Allocator, &g_Device);
 		check_vk_result(err);
 		vkGetDeviceQueue(g_Device, g_QueueFamily, 0, &g_Queue);
+
+		Walnut::GPUMemory::Init(g_Instance, g_PhysicalDevice, g_Device, g_Allocator, memory_budget);
 	}
 
 	// Create Descriptor Pool
@@ -219,7 +324,7 @@ static void SetupVulkan(const char** extensions, uint32_t extensions_count)
 
 // All the ImGui_ImplVulkanH_XXX structures/functions are optional helpers used by the demo.
 // Your real engine/app may not use them.
-static void SetupVulkanWindow(ImGui_ImplVulkanH_Window* wd, VkSurfaceKHR surface, int width, int height)
+static void SetupVulkanWindow(ImGui_ImplVulkanH_Window* wd, VkSurfaceKHR surface, int width, int height, bool vsync)
 {
 	wd->Surface = surface;
 
@@ -239,11 +344,18 @@ static void SetupVulkanWindow(ImGui_ImplVulkanH_Window* wd, VkSurfaceKHR surface
 
 	// Select Present Mode
 #ifdef IMGUI_UNLIMITED_FRAME_RATE
-	VkPresentModeKHR present_modes[] = { VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_FIFO_KHR };
-#else
-	VkPresentModeKHR present_modes[] = { VK_PRESENT_MODE_FIFO_KHR };
+	vsync = false;
 #endif
-	wd->PresentMode = ImGui_ImplVulkanH_SelectPresentMode(g_PhysicalDevice, wd->Surface, &present_modes[0], IM_ARRAYSIZE(present_modes));
+	if (vsync)
+	{
+		VkPresentModeKHR present_modes[] = { VK_PRESENT_MODE_FIFO_KHR };
+		wd->PresentMode = ImGui_ImplVulkanH_SelectPresentMode(g_PhysicalDevice, wd->Surface, &present_modes[0], IM_ARRAYSIZE(present_modes));
+	}
+	else
+	{
+		VkPresentModeKHR present_modes[] = { VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_FIFO_KHR };
+		wd->PresentMode = ImGui_ImplVulkanH_SelectPresentMode(g_PhysicalDevice, wd->Surface, &present_modes[0], IM_ARRAYSIZE(present_modes));
+	}
 	//printf("[vulkan] Selected PresentMode = %d\n", wd->PresentMode);
 
 	// Create SwapChain, RenderPass, Framebuffer, etc.
@@ -270,55 +382,154 @@ static void CleanupVulkanWindow()
 	ImGui_ImplVulkanH_DestroyWindow(g_Instance, g_Device, &g_MainWindowData, g_Allocator);
 }
 
-static void FrameRender(ImGui_ImplVulkanH_Window* wd, ImDrawData* draw_data)
+static void CreateFramesInFlight(uint32_t count)
 {
-	VkResult err;
+	s_FramesInFlight.resize(count);
+	for (FrameInFlight& frame : s_FramesInFlight)
+	{
+		VkResult err;
+		{
+			VkCommandPoolCreateInfo info = {};
+			info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+			info.queueFamilyIndex = g_QueueFamily;
+			err = vkCreateCommandPool(g_Device, &info, g_Allocator, &frame.CommandPool);
+			check_vk_result(err);
+		}
+		{
+			VkCommandBufferAllocateInfo info = {};
+			info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			info.commandPool = frame.CommandPool;
+			info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			info.commandBufferCount = 1;
+			err = vkAllocateCommandBuffers(g_Device, &info, &frame.CommandBuffer);
+			check_vk_result(err);
+		}
+		{
+			VkFenceCreateInfo info = {};
+			info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+			info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+			err = vkCreateFence(g_Device, &info, g_Allocator, &frame.Fence);
+			check_vk_result(err);
+		}
+		{
+			VkSemaphoreCreateInfo info = {};
+			info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+			err = vkCreateSemaphore(g_Device, &info, g_Allocator, &frame.ImageAcquiredSemaphore);
+			check_vk_result(err);
+		}
+	}
+}
 
-	VkSemaphore image_acquired_semaphore = wd->FrameSemaphores[wd->SemaphoreIndex].ImageAcquiredSemaphore;
-	VkSemaphore render_complete_semaphore = wd->FrameSemaphores[wd->SemaphoreIndex].RenderCompleteSemaphore;
-	err = vkAcquireNextImageKHR(g_Device, wd->Swapchain, UINT64_MAX, image_acquired_semaphore, VK_NULL_HANDLE, &wd->FrameIndex);
-	if (err == VK_ERROR_OUT_OF_DATE_KHR || err == VK_SUBOPTIMAL_KHR)
+// Runs the remaining deletion queues, the device must be idle
+static void DestroyFramesInFlight()
+{
+	for (FrameInFlight& frame : s_FramesInFlight)
 	{
-		g_SwapChainRebuild = true;
+		for (auto& func : frame.ResourceFreeQueue)
+			func();
+
+		vkDestroySemaphore(g_Device, frame.ImageAcquiredSemaphore, g_Allocator);
+		vkDestroyFence(g_Device, frame.Fence, g_Allocator);
+		vkDestroyCommandPool(g_Device, frame.CommandPool, g_Allocator);
+	}
+	s_FramesInFlight.clear();
+}
+
+static void WaitForSubmission(uint64_t submission)
+{
+	if (submission <= s_CompletedSubmission)
 		return;
+
+	// A fence also covers every earlier submission, so the oldest frame at or past it is enough
+	FrameInFlight* oldest = nullptr;
+	for (FrameInFlight& frame : s_FramesInFlight)
+	{
+		if (frame.Submission >= submission && (!oldest || frame.Submission < oldest->Submission))
+			oldest = &frame;
 	}
-	check_vk_result(err);
+	IM_ASSERT(oldest);
 
-	s_CurrentFrameIndex = (s_CurrentFrameIndex + 1) % g_MainWindowData.ImageCount;
+	VkResult err = vkWaitForFences(g_Device, 1, &oldest->Fence, VK_TRUE, UINT64_MAX);
+	check_vk_result(err);
+	s_CompletedSubmission = oldest->Submission;
+}
 
-	ImGui_ImplVulkanH_Frame* fd = &wd->Frames[wd->FrameIndex];
+// Moves on to the next frame slot before anything of the frame runs, so resources and command buffers handed to
+// it during OnUpdate and OnUIRender are only released once this frame's own submission has completed
+static void FrameBegin()
+{
+	// Waiting for the frame that last used this slot keeps the CPU at most MaxFramesInFlight frames ahead
+	s_CurrentFrameIndex = (s_CurrentFrameIndex + 1) % (uint32_t)s_FramesInFlight.size();
+	FrameInFlight& frame = s_FramesInFlight[s_CurrentFrameIndex];
 	{
-		err = vkWaitForFences(g_Device, 1, &fd->Fence, VK_TRUE, UINT64_MAX);    // wait indefinitely instead of periodically checking
+		VkResult err = vkWaitForFences(g_Device, 1, &frame.Fence, VK_TRUE, UINT64_MAX);    // wait indefinitely instead of periodically checking
 		check_vk_result(err);
 
-		err = vkResetFences(g_Device, 1, &fd->Fence);
-		check_vk_result(err);
+		s_CompletedSubmission = std::max(s_CompletedSubmission, frame.Submission);
 	}
-	
+
 	{
 		// Free resources in queue
-		for (auto& func : s_ResourceFreeQueue[s_CurrentFrameIndex])
+		for (auto& func : frame.ResourceFreeQueue)
 			func();
-		s_ResourceFreeQueue[s_CurrentFrameIndex].clear();
+		frame.ResourceFreeQueue.clear();
 	}
 	{
 		// Free command buffers allocated by Application::GetCommandBuffer
-		// These use g_MainWindowData.FrameIndex and not s_CurrentFrameIndex because they're tied to the swapchain image index
-		auto& allocatedCommandBuffers = s_AllocatedCommandBuffers[wd->FrameIndex];
-		if (allocatedCommandBuffers.size() > 0)
+		if (frame.AllocatedCommandBuffers.size() > 0)
 		{
-			vkFreeCommandBuffers(g_Device, fd->CommandPool, (uint32_t)allocatedCommandBuffers.size(), allocatedCommandBuffers.data());
-			allocatedCommandBuffers.clear();
+			vkFreeCommandBuffers(g_Device, frame.CommandPool, (uint32_t)frame.AllocatedCommandBuffers.size(), frame.AllocatedCommandBuffers.data());
+			frame.AllocatedCommandBuffers.clear();
 		}
 
-		err = vkResetCommandPool(g_Device, fd->CommandPool, 0);
+		VkResult err = vkResetCommandPool(g_Device, frame.CommandPool, 0);
 		check_vk_result(err);
+	}
+
+	// Retired before their window's last present, which was on its current swapchain. Queued in this frame, so they
+	// are only destroyed once a submission made after that present has completed
+	Walnut::ImGuiBackend::ReleasePresentedSwapchains();
+}
+
+// Records the main window into s_FrameBatch, false when the swapchain needs rebuilding
+static bool FrameRender(ImGui_ImplVulkanH_Window* wd, ImDrawData* draw_data, const std::vector<std::shared_ptr<Walnut::Layer>>& layers, Walnut::FrameRecorder* recorder)
+{
+	VkResult err;
+
+	FrameInFlight& frame = s_FramesInFlight[s_CurrentFrameIndex];
+
+	// Suboptimal still acquires (and signals the semaphore), the frame is rendered and the swapchain rebuilt after it.
+	// Out of date leaves the fence signaled, so the slot is ready again for the next frame
+	err = vkAcquireNextImageKHR(g_Device, wd->Swapchain, UINT64_MAX, frame.ImageAcquiredSemaphore, VK_NULL_HANDLE, &wd->FrameIndex);
+	if (err == VK_ERROR_OUT_OF_DATE_KHR)
+	{
+		g_SwapChainRebuild = true;
+		g_SwapChainOutOfDate = true;
+		return false;
+	}
+	if (err == VK_SUBOPTIMAL_KHR)
+		g_SwapChainRebuild = true;
+	else
+		check_vk_result(err);
+
+	err = vkResetFences(g_Device, 1, &frame.Fence);
+	check_vk_result(err);
+
+	// Per swapchain image: it is only signaled again once the image has been presented and reacquired
+	VkSemaphore render_complete_semaphore = wd->FrameSemaphores[wd->FrameIndex].RenderCompleteSemaphore;
+
+	ImGui_ImplVulkanH_Frame* fd = &wd->Frames[wd->FrameIndex];
+	{
 		VkCommandBufferBeginInfo info = {};
 		info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 		info.flags |= VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-		err = vkBeginCommandBuffer(fd->CommandBuffer, &info);
+		err = vkBeginCommandBuffer(frame.CommandBuffer, &info);
 		check_vk_result(err);
 	}
+
+	for (auto& layer : layers)
+		layer->OnRender(frame.CommandBuffer);
+
 	{
 		VkRenderPassBeginInfo info = {};
 		info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
@@ -328,53 +539,93 @@ static void FrameRender(ImGui_ImplVulkanH_Window* wd, ImDrawData* draw_data)
 		info.renderArea.extent.height = wd->Height;
 		info.clearValueCount = 1;
 		info.pClearValues = &wd->ClearValue;
-		vkCmdBeginRenderPass(fd->CommandBuffer, &info, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdBeginRenderPass(frame.CommandBuffer, &info, VK_SUBPASS_CONTENTS_INLINE);
 	}
 
+	// Under the UI. ImGui binds its own pipeline and sets its own dynamic state
+	for (auto& layer : layers)
+		layer->OnRenderInPass(frame.CommandBuffer);
+
 	// Record dear imgui primitives into command buffer
-	ImGui_ImplVulkan_RenderDrawData(draw_data, fd->CommandBuffer);
-
-	// Submit command buffer
-	vkCmdEndRenderPass(fd->CommandBuffer);
-	{
-		VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		VkSubmitInfo info = {};
-		info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-		info.waitSemaphoreCount = 1;
-		info.pWaitSemaphores = &image_acquired_semaphore;
-		info.pWaitDstStageMask = &wait_stage;
-		info.commandBufferCount = 1;
-		info.pCommandBuffers = &fd->CommandBuffer;
-		info.signalSemaphoreCount = 1;
-		info.pSignalSemaphores = &render_complete_semaphore;
-
-		err = vkEndCommandBuffer(fd->CommandBuffer);
-		check_vk_result(err);
-		err = vkQueueSubmit(g_Queue, 1, &info, fd->Fence);
-		check_vk_result(err);
+	ImGui_ImplVulkan_RenderDrawData(draw_data, frame.CommandBuffer);
+
+	vkCmdEndRenderPass(frame.CommandBuffer);
+
+	// Read back in the frame's own command buffer, the frame fence tells the recorder when the copy is done
+	if (recorder)
+	{
+		const std::shared_ptr<Walnut::Image>& source = recorder->GetSpecification().Source;
+		if (source)
+		{
+			if (VkImage image = source->GetDisplayImage())
+				recorder->Capture(frame.CommandBuffer, frame.Fence, image, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, source->GetWidth(), source->GetHeight(), false);
+		}
+		else if (g_SwapChainImageUsage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT)
+		{
+			recorder->Capture(frame.CommandBuffer, frame.Fence, fd->Backbuffer, wd->SurfaceFormat.format, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, wd->Width, wd->Height, true);
+		}
 	}
+
+	err = vkEndCommandBuffer(frame.CommandBuffer);
+	check_vk_result(err);
+
+	// The main window is always the first entry of the batch
+	s_FrameBatch.Clear();
+	s_FrameBatch.WaitSemaphores.push_back(frame.ImageAcquiredSemaphore);
+	s_FrameBatch.WaitStages.push_back(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+	s_FrameBatch.CommandBuffers.push_back(frame.CommandBuffer);
+	s_FrameBatch.SignalSemaphores.push_back(render_complete_semaphore);
+	s_FrameBatch.Swapchains.push_back(wd->Swapchain);
+	s_FrameBatch.ImageIndices.push_back(wd->FrameIndex);
+	return true;
+}
+
+static void FrameSubmit()
+{
+	FrameInFlight& frame = s_FramesInFlight[s_CurrentFrameIndex];
+
+	VkSubmitInfo info = {};
+	info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	info.waitSemaphoreCount = (uint32_t)s_FrameBatch.WaitSemaphores.size();
+	info.pWaitSemaphores = s_FrameBatch.WaitSemaphores.data();
+	info.pWaitDstStageMask = s_FrameBatch.WaitStages.data();
+	info.commandBufferCount = (uint32_t)s_FrameBatch.CommandBuffers.size();
+	info.pCommandBuffers = s_FrameBatch.CommandBuffers.data();
+	info.signalSemaphoreCount = (uint32_t)s_FrameBatch.SignalSemaphores.size();
+	info.pSignalSemaphores = s_FrameBatch.SignalSemaphores.data();
+
+	VkResult err = vkQueueSubmit(g_Queue, 1, &info, frame.Fence);
+	check_vk_result(err);
+	frame.Submission = ++s_Submission;
 }
 
 static void FramePresent(ImGui_ImplVulkanH_Window* wd)
 {
-	if (g_SwapChainRebuild)
-		return;
-	VkSemaphore render_complete_semaphore = wd->FrameSemaphores[wd->SemaphoreIndex].RenderCompleteSemaphore;
+	s_FrameBatch.PresentResults.resize(s_FrameBatch.Swapchains.size());
+
 	VkPresentInfoKHR info = {};
 	info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-	info.waitSemaphoreCount = 1;
-	info.pWaitSemaphores = &render_complete_semaphore;
-	info.swapchainCount = 1;
-	info.pSwapchains = &wd->Swapchain;
-	info.pImageIndices = &wd->FrameIndex;
+	info.waitSemaphoreCount = (uint32_t)s_FrameBatch.SignalSemaphores.size();
+	info.pWaitSemaphores = s_FrameBatch.SignalSemaphores.data();
+	info.swapchainCount = (uint32_t)s_FrameBatch.Swapchains.size();
+	info.pSwapchains = s_FrameBatch.Swapchains.data();
+	info.pImageIndices = s_FrameBatch.ImageIndices.data();
+	info.pResults = s_FrameBatch.PresentResults.data();
 	VkResult err = vkQueuePresentKHR(g_Queue, &info);
+	if (err != VK_ERROR_OUT_OF_DATE_KHR && err != VK_SUBOPTIMAL_KHR)
+		check_vk_result(err);
+	Walnut::ImGuiBackend::MarkSwapchainPresented(wd); // Out of date still waits on the semaphores
+
+	Walnut::ImGuiBackend::PresentPlatformWindows(s_FrameBatch, 1);
+
+	err = s_FrameBatch.PresentResults[0];
 	if (err == VK_ERROR_OUT_OF_DATE_KHR || err == VK_SUBOPTIMAL_KHR)
 	{
 		g_SwapChainRebuild = true;
+		g_SwapChainOutOfDate |= err == VK_ERROR_OUT_OF_DATE_KHR;
 		return;
 	}
 	check_vk_result(err);
-	wd->SemaphoreIndex = (wd->SemaphoreIndex + 1) % wd->ImageCount; // Now we can use the next set of semaphores
 }
 
 static void glfw_error_callback(int error, const char* description)
@@ -382,12 +633,91 @@ static void glfw_error_callback(int error, const char* description)
 	fprintf(stderr, "Glfw Error %d: %s\n", error, description);
 }
 
+static void glfw_content_scale_callback(GLFWwindow* window, float xscale, float yscale)
+{
+	s_PendingFontContentScale = yscale;
+}
+
+static std::vector<uint8_t> BakeDefaultFontAtlas(float contentScale, const std::string& cacheDirectory)
+{
+	return Walnut::FontAtlasCache::GetOrBake(g_RobotoRegular, sizeof(g_RobotoRegular), s_DefaultFontSize * contentScale, "Roboto-Regular", cacheDirectory);
+}
+
+// Font texture upload submitted during startup, only waited for right before the first frame
+static VkFence s_FontUploadFence = VK_NULL_HANDLE;
+
+static void SubmitFontsTexture()
+{
+	VkCommandBuffer command_buffer = Walnut::Application::GetCommandBuffer(true);
+	ImGui_ImplVulkan_CreateFontsTexture(command_buffer);
+	Walnut::ImGuiBackend::TrackFontsTexture();
+	VkResult err = vkEndCommandBuffer(command_buffer);
+	check_vk_result(err);
+
+	VkFenceCreateInfo fence_info = {};
+	fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	err = vkCreateFence(g_Device, &fence_info, g_Allocator, &s_FontUploadFence);
+	check_vk_result(err);
+
+	VkSubmitInfo submit_info = {};
+	submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submit_info.commandBufferCount = 1;
+	submit_info.pCommandBuffers = &command_buffer;
+	err = vkQueueSubmit(g_Queue, 1, &submit_info, s_FontUploadFence);
+	check_vk_result(err);
+}
+
+static void WaitForFontsTexture()
+{
+	if (s_FontUploadFence == VK_NULL_HANDLE)
+		return;
+
+	VkResult err = vkWaitForFences(g_Device, 1, &s_FontUploadFence, VK_TRUE, UINT64_MAX);
+	check_vk_result(err);
+	vkDestroyFence(g_Device, s_FontUploadFence, g_Allocator);
+	s_FontUploadFence = VK_NULL_HANDLE;
+
+	ImGui_ImplVulkan_DestroyFontUploadObjects();
+}
+
+static void UploadFontsTexture()
+{
+	SubmitFontsTexture();
+	WaitForFontsTexture();
+}
+
+// Runs func on the thread pool and returns a future for its result
+template<typename Func>
+static auto SubmitStartupJob(Walnut::ThreadPool& threadPool, Func&& func) -> std::future<decltype(func())>
+{
+	auto task = std::make_shared<std::packaged_task<decltype(func())()>>(std::forward<Func>(func));
+	auto future = task->get_future();
+	threadPool.Submit([task]() { (*task)(); });
+	return future;
+}
+
+static void* ImGuiPoolAllocate(size_t size, void* userData)
+{
+	return Walnut::PoolAllocator::Allocate(size);
+}
+
+static void ImGuiPoolFree(void* memory, void* userData)
+{
+	Walnut::PoolAllocator::Free(memory);
+}
+
+// ImGui's allocator before PoolImGuiAllocations replaced it, restored at shutdown
+static ImGuiMemAllocFunc s_PreviousImGuiAllocate = nullptr;
+static ImGuiMemFreeFunc s_PreviousImGuiFree = nullptr;
+static void* s_PreviousImGuiAllocatorUserData = nullptr;
+
 namespace Walnut {
 
 	Application::Application(const ApplicationSpecification& specification)
 		: m_Specification(specification)
 	{
 		s_Instance = this;
+		m_MainThreadId = std::this_thread::get_id();
 
 		Init();
 	}
@@ -406,141 +736,369 @@ namespace Walnut {
 
 	void Application::Init()
 	{
-		// Setup GLFW window
-		glfwSetErrorCallback(glfw_error_callback);
-		if (!glfwInit())
+		// Fixed before the instance exists, every object must be destroyed with the callbacks that created it
+		if (m_Specification.TrackVulkanHostAllocations)
+			VulkanHostAllocator::Enable();
+		g_Allocator = VulkanHostAllocator::GetCallbacks();
+
+		// Before the font atlas bake below, which already allocates through ImGui
+		if (m_Specification.PoolImGuiAllocations)
 		{
-			std::cerr << "Could not initalize GLFW!\n";
-			return;
+			ImGui::GetAllocatorFunctions(&s_PreviousImGuiAllocate, &s_PreviousImGuiFree, &s_PreviousImGuiAllocatorUserData);
+			ImGui::SetAllocatorFunctions(ImGuiPoolAllocate, ImGuiPoolFree);
 		}
 
-		glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-		m_WindowHandle = glfwCreateWindow(m_Specification.Width, m_Specification.Height, m_Specification.Name.c_str(), NULL, NULL);
+		// The timestamp counter is measured against steady_clock across the whole startup, see Run()
+		Clock::BeginCalibration();
+
+		m_ThreadPool = std::make_unique<ThreadPool>();
+
+		// Setup GLFW
+		{
+			auto phase = m_StartupReport.Trace("GLFW Init");
+			glfwSetErrorCallback(glfw_error_callback);
+			if (!glfwInit())
+			{
+				std::cerr << "Could not initalize GLFW!\n";
+				return;
+			}
+		}
 
-		// Setup Vulkan
 		if (!glfwVulkanSupported())
 		{
 			std::cerr << "GLFW: Vulkan not supported!\n";
 			return;
 		}
+
+		// Creating the Vulkan instance and device only needs the instance extensions,
+		// so it runs on a worker while the main thread creates the window
 		uint32_t extensions_count = 0;
 		const char** extensions = glfwGetRequiredInstanceExtensions(&extensions_count);
-		SetupVulkan(extensions, extensions_count);
+		m_VulkanSetup = SubmitStartupJob(*m_ThreadPool, [this, extensions, extensions_count]()
+		{
+			auto phase = m_StartupReport.Trace("Vulkan Instance/Device", true);
+			SetupVulkan(extensions, extensions_count);
+		});
+
+		// Bake the default font for the primary monitor's content scale (or load it from the font cache)
+		// in parallel too, the window's own content scale is only known once it exists
+		float xscale, yscale;
+		glfwGetMonitorContentScale(glfwGetPrimaryMonitor(), &xscale, &yscale);
+		s_FontContentScale = yscale;
+		m_FontAtlasData = SubmitStartupJob(*m_ThreadPool, [this, contentScale = yscale, cacheDirectory = m_Specification.FontCacheDirectory]()
+		{
+			auto phase = m_StartupReport.Trace("Font Atlas Bake", true);
+			return BakeDefaultFontAtlas(contentScale, cacheDirectory);
+		});
 
-		// Create Window Surface
-		VkSurfaceKHR surface;
-		VkResult err = glfwCreateWindowSurface(g_Instance, m_WindowHandle, g_Allocator, &surface);
-		check_vk_result(err);
+		// A replay runs in a window of the recorded size
+		if (!m_Specification.InputReplayPath.empty())
+		{
+			m_InputReplayer = std::make_unique<InputReplayer>(m_Specification.InputReplayPath);
+			if (m_InputReplayer->IsLoaded() && m_InputReplayer->GetWindowWidth() > 0 && m_InputReplayer->GetWindowHeight() > 0)
+			{
+				m_Specification.Width = m_InputReplayer->GetWindowWidth();
+				m_Specification.Height = m_InputReplayer->GetWindowHeight();
+			}
+			else
+			{
+				m_InputReplayer.reset();
+			}
+		}
+
+		// Setup GLFW window
+		{
+			auto phase = m_StartupReport.Trace("Window Creation");
+			glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+			if (m_Specification.Headless)
+				glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+			m_WindowHandle = glfwCreateWindow(m_Specification.Width, m_Specification.Height, m_Specification.Name.c_str(), NULL, NULL);
+
+			// A window opening on another monitor gets its font rebaked by UpdateFontAtlas
+			glfwGetWindowContentScale(m_WindowHandle, &xscale, &yscale);
+			s_PendingFontContentScale = yscale;
+			glfwSetWindowContentScaleCallback(m_WindowHandle, glfw_content_scale_callback);
+		}
+
+		// Setup Dear ImGui context and platform backend, neither needs Vulkan
+		{
+			auto phase = m_StartupReport.Trace("ImGui Context");
+			IMGUI_CHECKVERSION();
+			ImGui::CreateContext();
+			ImGuiIO& io = ImGui::GetIO(); (void)io;
+			io.ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard;       // Enable Keyboard Controls
+			//io.ConfigFlags |= ImGuiConfigFlags_NavEnableGamepad;      // Enable Gamepad Controls
+			io.ConfigFlags |= ImGuiConfigFlags_DockingEnable;           // Enable Docking
+
+			// Only the main window's input is recorded, and a hidden window shouldn't open visible ones
+			bool singleWindow = m_Specification.Headless || m_InputReplayer || !m_Specification.InputRecordPath.empty();
+			if (!singleWindow)
+				io.ConfigFlags |= ImGuiConfigFlags_ViewportsEnable;     // Enable Multi-Viewport / Platform Windows
+			//io.ConfigViewportsNoAutoMerge = true;
+			//io.ConfigViewportsNoTaskBarIcon = true;
+
+			// Setup Dear ImGui style
+			ImGui::StyleColorsDark();
+			//ImGui::StyleColorsClassic();
+
+			// When viewports are enabled we tweak WindowRounding/WindowBg so platform windows can look identical to regular ones.
+			ImGuiStyle& style = ImGui::GetStyle();
+			if (io.ConfigFlags & ImGuiConfigFlags_ViewportsEnable)
+			{
+				style.WindowRounding = 0.0f;
+				style.Colors[ImGuiCol_WindowBg].w = 1.0f;
+			}
+
+			Input::Init(m_WindowHandle);
+			ImGui_ImplGlfw_InitForVulkan(m_WindowHandle, true);
+
+			// On top of ImGui's callbacks, which chain to Input's
+			if (m_InputReplayer)
+			{
+				m_InputReplayer->Attach(m_WindowHandle);
+			}
+			else if (!m_Specification.InputRecordPath.empty())
+			{
+				m_InputRecorder = std::make_unique<InputRecorder>(m_WindowHandle, m_Specification.InputRecordPath);
+				if (!m_InputRecorder->IsOpen())
+					m_InputRecorder.reset();
+			}
+		}
+
+		// The rest needs the device and is left to CompleteInit, so that layers pushed before Run load their assets
+		// while Vulkan is still initializing
+	}
+
+	void Application::CompleteInit()
+	{
+		if (m_VulkanInitialized || m_CompletingInit || !m_VulkanSetup.valid())
+			return;
+
+		// The font upload below already goes through GetCommandBuffer
+		m_CompletingInit = true;
+
+		{
+			auto phase = m_StartupReport.Trace("Vulkan Device Wait");
+			m_VulkanSetup.get();
+		}
 
-		// Create Framebuffers
-		int w, h;
-		glfwGetFramebufferSize(m_WindowHandle, &w, &h);
 		ImGui_ImplVulkanH_Window* wd = &g_MainWindowData;
-		SetupVulkanWindow(wd, surface, w, h);
-
-		s_AllocatedCommandBuffers.resize(wd->ImageCount);
-		s_ResourceFreeQueue.resize(wd->ImageCount);
-
-		// Setup Dear ImGui context
-		IMGUI_CHECKVERSION();
-		ImGui::CreateContext();
-		ImGuiIO& io = ImGui::GetIO(); (void)io;
-		io.ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard;       // Enable Keyboard Controls
-		//io.ConfigFlags |= ImGuiConfigFlags_NavEnableGamepad;      // Enable Gamepad Controls
-		io.ConfigFlags |= ImGuiConfigFlags_DockingEnable;           // Enable Docking
-		io.ConfigFlags |= ImGuiConfigFlags_ViewportsEnable;         // Enable Multi-Viewport / Platform Windows
-		//io.ConfigViewportsNoAutoMerge = true;
-		//io.ConfigViewportsNoTaskBarIcon = true;
-
-		// Setup Dear ImGui style
-		ImGui::StyleColorsDark();
-		//ImGui::StyleColorsClassic();
-
-		// When viewports are enabled we tweak WindowRounding/WindowBg so platform windows can look identical to regular ones.
-		ImGuiStyle& style = ImGui::GetStyle();
-		if (io.ConfigFlags & ImGuiConfigFlags_ViewportsEnable)
-		{
-			style.WindowRounding = 0.0f;
-			style.Colors[ImGuiCol_WindowBg].w = 1.0f;
-		}
-
-		// Setup Platform/Renderer backends
-		ImGui_ImplGlfw_InitForVulkan(m_WindowHandle, true);
-		ImGui_ImplVulkan_InitInfo init_info = {};
-		init_info.Instance = g_Instance;
-		init_info.PhysicalDevice = g_PhysicalDevice;
-		init_info.Device = g_Device;
-		init_info.QueueFamily = g_QueueFamily;
-		init_info.Queue = g_Queue;
-		init_info.PipelineCache = g_PipelineCache;
-		init_info.DescriptorPool = g_DescriptorPool;
-		init_info.Subpass = 0;
-		init_info.MinImageCount = g_MinImageCount;
-		init_info.ImageCount = wd->ImageCount;
-		init_info.MSAASamples = VK_SAMPLE_COUNT_1_BIT;
-		init_info.Allocator = g_Allocator;
-		init_info.CheckVkResultFn = check_vk_result;
-		ImGui_ImplVulkan_Init(&init_info, wd->RenderPass);
-
-		// Load default font
-		ImFontConfig fontConfig;
-		fontConfig.FontDataOwnedByAtlas = false;
-		ImFont* robotoFont = io.Fonts->AddFontFromMemoryTTF((void*)g_RobotoRegular, sizeof(g_RobotoRegular), 20.0f, &fontConfig);
-		io.FontDefault = robotoFont;
-
-		// Upload Fonts
-		{
-			// Use any command queue
-			VkCommandPool command_pool = wd->Frames[wd->FrameIndex].CommandPool;
-			VkCommandBuffer command_buffer = wd->Frames[wd->FrameIndex].CommandBuffer;
-
-			err = vkResetCommandPool(g_Device, command_pool, 0);
-			check_vk_result(err);
-			VkCommandBufferBeginInfo begin_info = {};
-			begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-			begin_info.flags |= VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-			err = vkBeginCommandBuffer(command_buffer, &begin_info);
+		{
+			auto phase = m_StartupReport.Trace("Swapchain");
+
+			// Create Window Surface
+			VkSurfaceKHR surface;
+			VkResult err = glfwCreateWindowSurface(g_Instance, m_WindowHandle, g_Allocator, &surface);
 			check_vk_result(err);
 
-			ImGui_ImplVulkan_CreateFontsTexture(command_buffer);
+			// Create Framebuffers
+			int w, h;
+			glfwGetFramebufferSize(m_WindowHandle, &w, &h);
+			SetupVulkanWindow(wd, surface, w, h, m_Specification.VSync && !m_Specification.Headless);
 
-			VkSubmitInfo end_info = {};
-			end_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-			end_info.commandBufferCount = 1;
-			end_info.pCommandBuffers = &command_buffer;
-			err = vkEndCommandBuffer(command_buffer);
-			check_vk_result(err);
-			err = vkQueueSubmit(g_Queue, 1, &end_info, VK_NULL_HANDLE);
-			check_vk_result(err);
+			CreateFramesInFlight(std::max(m_Specification.MaxFramesInFlight, 1u));
+		}
 
-			err = vkDeviceWaitIdle(g_Device);
-			check_vk_result(err);
-			ImGui_ImplVulkan_DestroyFontUploadObjects();
+		// Setup Renderer backend
+		{
+			auto phase = m_StartupReport.Trace("ImGui Vulkan Init");
+			ImGui_ImplVulkan_InitInfo init_info = {};
+			init_info.Instance = g_Instance;
+			init_info.PhysicalDevice = g_PhysicalDevice;
+			init_info.Device = g_Device;
+			init_info.QueueFamily = g_QueueFamily;
+			init_info.Queue = g_Queue;
+			init_info.PipelineCache = g_PipelineCache;
+			init_info.DescriptorPool = g_DescriptorPool;
+			init_info.Subpass = 0;
+			init_info.MinImageCount = g_MinImageCount;
+			// ImGui cycles its vertex/index buffers through ImageCount sets, one per frame: never fewer than can be in flight
+			init_info.ImageCount = std::max(wd->ImageCount, (uint32_t)s_FramesInFlight.size());
+			init_info.MSAASamples = VK_SAMPLE_COUNT_1_BIT;
+			init_info.Allocator = g_Allocator;
+			init_info.CheckVkResultFn = check_vk_result;
+			ImGui_ImplVulkan_Init(&init_info, wd->RenderPass);
+		}
+
+		// Load default font, the upload is only waited for before the first frame
+		{
+			auto phase = m_StartupReport.Trace("Font Atlas Upload");
+			ImGuiIO& io = ImGui::GetIO();
+			if (!FontAtlasCache::Deserialize(io.Fonts, m_FontAtlasData.get()))
+			{
+				ImFontConfig fontConfig;
+				fontConfig.FontDataOwnedByAtlas = false;
+				io.Fonts->AddFontFromMemoryTTF((void*)g_RobotoRegular, sizeof(g_RobotoRegular), s_DefaultFontSize * s_FontContentScale, &fontConfig);
+			}
+			io.FontDefault = io.Fonts->Fonts[0];
+
+			SubmitFontsTexture();
+		}
+
+		// Only now can workers waiting in WaitForStartup use the device
+		{
+			std::scoped_lock<std::mutex> lock(m_StartupMutex);
+			m_VulkanInitialized = true;
+		}
+		m_StartupCondition.notify_all();
+	}
+
+	void Application::UpdateFontAtlas()
+	{
+		if (s_FontAtlasBuild && s_FontAtlasBuild->Ready)
+		{
+			ImGuiIO& io = ImGui::GetIO();
+			if (FontAtlasCache::Deserialize(io.Fonts, s_FontAtlasBuild->Data))
+			{
+				io.FontDefault = io.Fonts->Fonts[0];
+				s_FontContentScale = s_FontAtlasBuild->ContentScale;
+
+				ImGuiBackend::ReleaseFontsTexture();
+				UploadFontsTexture();
+			}
+			s_FontAtlasBuild.reset();
+		}
+
+		// Only one rebuild at a time, a scale change during a rebuild starts another one afterwards
+		if (s_FontAtlasBuild || s_PendingFontContentScale == s_FontContentScale || s_PendingFontContentScale <= 0.0f)
+			return;
+
+		s_FontAtlasBuild = std::make_shared<FontAtlasBuild>();
+		s_FontAtlasBuild->ContentScale = s_PendingFontContentScale;
+		m_ThreadPool->Submit([build = s_FontAtlasBuild, cacheDirectory = m_Specification.FontCacheDirectory]()
+		{
+			build->Data = BakeDefaultFontAtlas(build->ContentScale, cacheDirectory);
+			build->Ready = true;
+		});
+	}
+
+	void Application::AddLayerUpdateDependency(const std::shared_ptr<Layer>& layer, const std::shared_ptr<Layer>& dependency)
+	{
+		// The fixed update thread updates the layers under the same lock
+		std::scoped_lock<std::mutex> lock(m_LayerStackMutex);
+		m_LayerUpdateScheduler.AddDependency(layer.get(), dependency.get());
+	}
+
+	void Application::PushLayer(const std::shared_ptr<Layer>& layer)
+	{
+		uint32_t layerIndex;
+		{
+			// Counted under the same lock as the push, so an update that holds the layer stack and finds no
+			// attach pending never sees a layer whose OnAttach has not run yet
+			std::scoped_lock<std::mutex> lock(m_LayerStackMutex);
+			{
+				std::scoped_lock<std::mutex> attachLock(m_AsyncAttachMutex);
+				m_AsyncAttachCount++;
+			}
+			layerIndex = (uint32_t)m_LayerStack.size();
+			m_LayerStack.emplace_back(layer);
+			m_LayerUpdateScheduler.Invalidate();
+		}
+
+		// OnAttach follows on the main thread once OnAttachAsync has returned, see Layer::OnAttachAsync
+		m_ThreadPool->Submit([this, layer, layerIndex]()
+		{
+			{
+				auto phase = m_StartupReport.Trace("Layer " + std::to_string(layerIndex) + " OnAttachAsync", true);
+				layer->OnAttachAsync();
+			}
+
+			{
+				std::scoped_lock<std::mutex> lock(m_AsyncAttachMutex);
+				m_AttachQueue.emplace_back(layerIndex, layer);
+			}
+			m_AsyncAttachCondition.notify_all();
+		});
+	}
+
+	void Application::WaitForAsyncAttach()
+	{
+		std::unique_lock<std::mutex> lock(m_AsyncAttachMutex);
+		m_AsyncAttachCondition.wait(lock, [this]() { return m_AsyncAttachCount == 0; });
+	}
+
+	bool Application::IsAsyncAttachPending()
+	{
+		std::scoped_lock<std::mutex> lock(m_AsyncAttachMutex);
+		return m_AsyncAttachCount != 0;
+	}
+
+	void Application::AttachPendingLayers()
+	{
+		std::unique_lock<std::mutex> lock(m_AsyncAttachMutex);
+		while (m_AsyncAttachCount > 0)
+		{
+			// Attached together and in stack order, whichever OnAttachAsync finished first
+			{
+				auto phase = m_StartupReport.Trace("Layer OnAttachAsync Wait");
+				m_AsyncAttachCondition.wait(lock, [this]() { return m_AttachQueue.size() == m_AsyncAttachCount; });
+			}
+			std::vector<std::pair<uint32_t, std::shared_ptr<Layer>>> layers;
+			std::swap(layers, m_AttachQueue);
+			lock.unlock();
+
+			std::sort(layers.begin(), layers.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+			{
+				auto phase = m_StartupReport.Trace("Layer OnAttach");
+				for (auto& [layerIndex, layer] : layers)
+					layer->OnAttach();
+			}
+
+			// An OnAttach that pushed another layer is caught by the next iteration
+			lock.lock();
+			m_AsyncAttachCount -= (uint32_t)layers.size();
+			m_AsyncAttachCondition.notify_all();
 		}
 	}
 
 	void Application::Shutdown()
 	{
+		// An application destroyed without running still attaches its layers, so every OnDetach has its OnAttach
+		CompleteInit();
+		AttachPendingLayers();
+
 		for (auto& layer : m_LayerStack)
 			layer->OnDetach();
 
 		m_LayerStack.clear();
 
+		StopRecording();
+
+		// Finishes any outstanding jobs
+		m_ThreadPool.reset();
+		s_FontAtlasBuild.reset();
+
 		// Cleanup
 		VkResult err = vkDeviceWaitIdle(g_Device);
 		check_vk_result(err);
 
+		// Run may never have waited for it
+		WaitForFontsTexture();
+
 		// Free resources in queue
-		for (auto& queue : s_ResourceFreeQueue)
-		{
-			for (auto& func : queue)
-				func();
-		}
-		s_ResourceFreeQueue.clear();
+		ImGuiBackend::ReleaseRetiredSwapchains();
+		DestroyFramesInFlight();
+
+		SamplerCache::Shutdown();
+		TonemapPass::Shutdown();
 
+		// Their callbacks go before ImGui's are restored
+		m_InputRecorder.reset();
+		m_InputReplayer.reset();
+
+		ImGuiBackend::UntrackRenderBuffers();
 		ImGui_ImplVulkan_Shutdown();
 		ImGui_ImplGlfw_Shutdown();
 		ImGui::DestroyContext();
+		if (s_PreviousImGuiAllocate)
+		{
+			ImGui::SetAllocatorFunctions(s_PreviousImGuiAllocate, s_PreviousImGuiFree, s_PreviousImGuiAllocatorUserData);
+			s_PreviousImGuiAllocate = nullptr;
+			s_PreviousImGuiFree = nullptr;
+			s_PreviousImGuiAllocatorUserData = nullptr;
+		}
+		Input::Shutdown();
+		GPUMemory::Shutdown();
 
 		CleanupVulkanWindow();
 		CleanupVulkan();
@@ -559,9 +1117,34 @@ namespace Walnut {
 		ImVec4 clear_color = ImVec4(0.45f, 0.55f, 0.60f, 1.00f);
 		ImGuiIO& io = ImGui::GetIO();
 
+		CompleteInit();
+
+		// Only now does the first frame need layer assets and the font texture
+		AttachPendingLayers();
+		{
+			auto phase = m_StartupReport.Trace("Font Atlas Upload Wait");
+			WaitForFontsTexture();
+		}
+		{
+			auto phase = m_StartupReport.Trace("Clock Calibration");
+			Clock::EndCalibration();
+		}
+		float firstFrameStart = m_StartupReport.GetElapsedMillis();
+		m_LastFrameTicks = Clock::Now();
+
+		if (m_Specification.FixedUpdateRate > 0.0f)
+		{
+			Input::EnableFixedUpdate();
+			m_UpdateThreadRunning = true;
+			m_UpdateThread = std::thread([this]() { FixedUpdateLoop(); });
+		}
+
 		// Main loop
 		while (!glfwWindowShouldClose(m_WindowHandle) && m_Running)
 		{
+			// Waits for the GPU before polling, so the frame starts with the latest input
+			FrameBegin();
+
 			// Poll and handle events (inputs, window resize, etc.)
 			// You can read the io.WantCaptureMouse, io.WantCaptureKeyboard flags to tell if dear imgui wants to use your inputs.
 			// - When io.WantCaptureMouse is true, do not dispatch mouse input data to your main application.
@@ -569,31 +1152,67 @@ namespace Walnut {
 			// Generally you may always pass all inputs to dear imgui, and hide them from your application based on those two flags.
 			glfwPollEvents();
 
-			for (auto& layer : m_LayerStack)
-				layer->OnUpdate(m_TimeStep);
+			// A replayed frame gets its recorded input and time step instead, until the recording runs out
+			if (m_InputReplayer && !m_InputReplayer->NextFrame(m_TimeStep))
+				break;
+			if (m_InputRecorder)
+				m_InputRecorder->NextFrame(m_TimeStep);
+
+			Input::NewFrame();
+			m_FrameAllocator.NextFrame();
+
+			// Layers pushed since the last frame, before any of their OnUpdate or OnUIRender
+			AttachPendingLayers();
 
-			// Resize swap chain?
+			if (!m_UpdateThread.joinable())
+			{
+				m_LayerUpdateScheduler.Update(m_LayerStack, m_TimeStep, *m_ThreadPool);
+			}
+
+			// Resize swap chain? Only once the size has settled, a suboptimal swapchain is still presented in the
+			// meantime. An out of date one can't be, it is rebuilt at most once per interval while the size keeps changing
 			if (g_SwapChainRebuild)
 			{
 				int width, height;
 				glfwGetFramebufferSize(m_WindowHandle, &width, &height);
 				if (width > 0 && height > 0)
 				{
-					ImGui_ImplVulkan_SetMinImageCount(g_MinImageCount);
-					ImGui_ImplVulkanH_CreateOrResizeWindow(g_Instance, g_PhysicalDevice, g_Device, &g_MainWindowData, g_QueueFamily, g_Allocator, width, height, g_MinImageCount);
-					g_MainWindowData.FrameIndex = 0;
+					int64_t now = Clock::Now();
+					if (width != s_SwapchainPendingWidth || height != s_SwapchainPendingHeight)
+					{
+						s_SwapchainPendingWidth = width;
+						s_SwapchainPendingHeight = height;
+						s_SwapchainPendingTicks = now;
+					}
 
-					// Clear allocated command buffers from here since entire pool is destroyed
-					s_AllocatedCommandBuffers.clear();
-					s_AllocatedCommandBuffers.resize(g_MainWindowData.ImageCount);
+					int64_t debounce = Clock::FromSeconds(m_Specification.SwapchainResizeDebounce);
+					bool settled = now - s_SwapchainPendingTicks >= debounce;
+					bool overdue = g_SwapChainOutOfDate && now - s_SwapchainRebuildTicks >= debounce;
+					if (settled || overdue)
+					{
+						// No device wait, the old swapchain goes away once the new one has been presented and that frame is done
+						g_SwapChainImageUsage = ImGuiBackend::ResizeWindow(&g_MainWindowData, width, height);
+						s_SwapchainRebuildTicks = now;
 
-					g_SwapChainRebuild = false;
+						g_SwapChainRebuild = false;
+						g_SwapChainOutOfDate = false;
+					}
 				}
 			}
 
+			UpdateFontAtlas();
+			GPUMemory::Update();
+			if (m_FrameRecorder)
+				m_FrameRecorder->Collect();
+
 			// Start the Dear ImGui frame
 			ImGui_ImplVulkan_NewFrame();
 			ImGui_ImplGlfw_NewFrame();
+
+			// ImGui's own clock would make double clicks and animations differ between recording and replay
+			if ((m_InputRecorder || m_InputReplayer) && m_TimeStep > 0.0f)
+				io.DeltaTime = m_TimeStep;
+
 			ImGui::NewFrame();
 
 			{
@@ -661,26 +1280,126 @@ namespace Walnut {
 			wd->ClearValue.color.float32[1] = clear_color.y * clear_color.w;
 			wd->ClearValue.color.float32[2] = clear_color.z * clear_color.w;
 			wd->ClearValue.color.float32[3] = clear_color.w;
+			bool main_is_recorded = false;
 			if (!main_is_minimized)
-				FrameRender(wd, main_draw_data);
+				main_is_recorded = FrameRender(wd, main_draw_data, m_LayerStack, m_FrameRecorder.get());
 
 			// Update and Render additional Platform Windows
 			if (io.ConfigFlags & ImGuiConfigFlags_ViewportsEnable)
 			{
 				ImGui::UpdatePlatformWindows();
-				ImGui::RenderPlatformWindowsDefault();
+				if (main_is_recorded && m_Specification.BatchPlatformWindows)
+				{
+					Walnut::ImGuiBackend::RecordPlatformWindows(s_FrameBatch, s_Submission + 1, WaitForSubmission);
+					s_PlatformWindowsBatched = true;
+				}
+				else
+				{
+					// Batched frames never signal the platform windows' own fences, which the default path waits on
+					if (s_PlatformWindowsBatched)
+					{
+						VkResult err = vkQueueWaitIdle(g_Queue);
+						check_vk_result(err);
+						s_CompletedSubmission = s_Submission;
+						s_PlatformWindowsBatched = false;
+
+						// The default path presents through the backend, which never marks what ResizeWindow retired
+						Walnut::ImGuiBackend::ReleaseRetiredSwapchains();
+					}
+					ImGui::RenderPlatformWindowsDefault();
+				}
 			}
+			ImGuiBackend::TrackRenderBuffers();
 
-			// Present Main Platform Window
-			if (!main_is_minimized)
+			// Submit and present every window recorded this frame at once
+			if (main_is_recorded)
+			{
+				FrameSubmit();
 				FramePresent(wd);
+			}
+
+			if (!m_StartupReport.IsFinished())
+			{
+				m_StartupReport.AddPhase("First Frame", firstFrameStart, m_StartupReport.GetElapsedMillis() - firstFrameStart, false);
+				m_StartupReport.Finish();
+				if (m_ReadyCallback)
+					m_ReadyCallback(m_StartupReport);
+			}
 
-			float time = GetTime();
-			m_FrameTime = time - m_LastFrameTime;
+			int64_t ticks = Clock::Now();
+			int64_t frameTicks = ticks - m_LastFrameTicks;
+			m_FrameTime = (float)Clock::ToSeconds(frameTicks);
 			m_TimeStep = glm::min<float>(m_FrameTime, 0.0333f);
-			m_LastFrameTime = time;
+			m_LastFrameTicks = ticks;
+			m_FrameTimeHistory.Add(frameTicks);
+			if (m_InputReplayer)
+				m_InputReplayer->AddFrameTime(frameTicks);
 		}
 
+		if (m_UpdateThread.joinable())
+		{
+			m_UpdateThreadRunning = false;
+			m_UpdateThread.join();
+		}
+
+		if (m_InputReplayer)
+		{
+			m_InputReplayer->PrintReport();
+			if (!m_Specification.InputReplayReportPath.empty() && m_InputReplayer->WriteReport(m_Specification.InputReplayReportPath))
+				std::cout << "[REPLAY] Report written to " << m_Specification.InputReplayReportPath << "\n";
+		}
+	}
+
+	void Application::FixedUpdateLoop()
+	{
+		using SteadyClock = std::chrono::steady_clock;
+
+		const float timeStep = 1.0f / m_Specification.FixedUpdateRate;
+		const SteadyClock::duration tickDuration = std::chrono::duration_cast<SteadyClock::duration>(std::chrono::duration<double>(1.0 / m_Specification.FixedUpdateRate));
+
+		SteadyClock::time_point tickTime = SteadyClock::now();
+		while (m_UpdateThreadRunning)
+		{
+			Input::BeginFixedUpdate();
+			{
+				// Waits without holding the layer stack, PushLayer needs it before it submits the OnAttachAsync
+				// being waited for. A layer pushed in between is counted under the lock and caught by the recheck
+				std::unique_lock<std::mutex> lock(m_LayerStackMutex);
+				while (IsAsyncAttachPending())
+				{
+					lock.unlock();
+					WaitForAsyncAttach();
+					lock.lock();
+				}
+				m_LayerUpdateScheduler.Update(m_LayerStack, timeStep, *m_ThreadPool);
+			}
+			m_LastFixedUpdateTime = tickTime.time_since_epoch().count();
+
+			// Late ticks run back to back to catch up, but never more than a few, otherwise a slow
+			// update would keep falling further behind
+			tickTime += tickDuration;
+			SteadyClock::time_point now = SteadyClock::now();
+			if (now - tickTime > tickDuration * 4)
+				tickTime = now;
+
+			// OS sleeps are too coarse for rates like 240 Hz, so sleep most of the way and yield for the rest
+			const SteadyClock::duration sleepMargin = std::chrono::milliseconds(2);
+			if (tickTime - now > sleepMargin)
+				std::this_thread::sleep_until(tickTime - sleepMargin);
+			while (SteadyClock::now() < tickTime)
+				std::this_thread::yield();
+		}
+	}
+
+	float Application::GetFixedUpdateAlpha() const
+	{
+		if (m_Specification.FixedUpdateRate <= 0.0f)
+			return 1.0f;
+
+		using SteadyClock = std::chrono::steady_clock;
+		SteadyClock::duration sinceLastUpdate = SteadyClock::now().time_since_epoch() - SteadyClock::duration(m_LastFixedUpdateTime.load());
+		float alpha = std::chrono::duration<float>(sinceLastUpdate).count() * m_Specification.FixedUpdateRate;
+		return glm::clamp(alpha, 0.0f, 1.0f);
 	}
 
 	void Application::Close()
@@ -688,32 +1407,123 @@ namespace Walnut {
 		m_Running = false;
 	}
 
-	float Application::GetTime()
+	double Application::GetTime()
+	{
+		return Clock::ToSeconds(Clock::Now());
+	}
+
+	void Application::StartRecording(const FrameRecordingSpecification& specification)
+	{
+		StopRecording();
+		m_FrameRecorder = std::make_unique<FrameRecorder>(specification);
+
+		// ImGui creates swapchain images for rendering only, rebuilding makes them copyable where the surface allows
+		if (!specification.Source && !(g_SwapChainImageUsage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT))
+			g_SwapChainRebuild = true;
+	}
+
+	void Application::StopRecording()
+	{
+		if (!m_FrameRecorder)
+			return;
+
+		m_FrameRecorder->Stop();
+		m_LastRecordingStatistics = m_FrameRecorder->GetStatistics();
+		m_FrameRecorder.reset();
+	}
+
+	FrameRecordingStatistics Application::GetRecordingStatistics() const
 	{
-		return (float)glfwGetTime();
+		return m_FrameRecorder ? m_FrameRecorder->GetStatistics() : m_LastRecordingStatistics;
+	}
+
+	void Application::WaitForStartup()
+	{
+		Application* app = s_Instance;
+		if (!app || app->m_VulkanInitialized)
+			return;
+
+		// Only the main thread can finish startup, see CompleteInit
+		if (std::this_thread::get_id() == app->m_MainThreadId)
+		{
+			app->CompleteInit();
+			return;
+		}
+
+		// Eg. an OnAttachAsync, Run completes startup before it waits for them
+		std::unique_lock<std::mutex> lock(app->m_StartupMutex);
+		app->m_StartupCondition.wait(lock, [app]() { return app->m_VulkanInitialized.load(); });
 	}
 
 	VkInstance Application::GetInstance()
 	{
+		WaitForStartup();
 		return g_Instance;
 	}
 
 	VkPhysicalDevice Application::GetPhysicalDevice()
 	{
+		WaitForStartup();
 		return g_PhysicalDevice;
 	}
 
 	VkDevice Application::GetDevice()
 	{
+		WaitForStartup();
 		return g_Device;
 	}
 
-	VkCommandBuffer Application::GetCommandBuffer(bool begin)
+	VkQueue Application::GetQueue()
 	{
-		ImGui_ImplVulkanH_Window* wd = &g_MainWindowData;
+		WaitForStartup();
+		return g_Queue;
+	}
 
+	uint32_t Application::GetQueueFamilyIndex()
+	{
+		WaitForStartup();
+		return g_QueueFamily;
+	}
+
+	VkDescriptorPool Application::GetDescriptorPool()
+	{
+		WaitForStartup();
+		return g_DescriptorPool;
+	}
+
+	const VkAllocationCallbacks* Application::GetAllocator()
+	{
+		return g_Allocator;
+	}
+
+	VulkanHostAllocationStatistics Application::GetVulkanHostAllocationStatistics()
+	{
+		return VulkanHostAllocator::GetStatistics();
+	}
+
+	uint32_t Application::GetMaxFramesInFlight()
+	{
+		WaitForStartup();
+		return (uint32_t)s_FramesInFlight.size();
+	}
+
+	uint32_t Application::GetCurrentFrameIndex()
+	{
+		return s_CurrentFrameIndex;
+	}
+
+	VkRenderPass Application::GetRenderPass()
+	{
+		WaitForStartup();
+		return g_MainWindowData.RenderPass;
+	}
+
+	VkCommandBuffer Application::GetCommandBuffer(bool begin)
+	{
+		WaitForStartup();
 		// Use any command queue
-		VkCommandPool command_pool = wd->Frames[wd->FrameIndex].CommandPool;
+		FrameInFlight& frame = s_FramesInFlight[s_CurrentFrameIndex];
+		VkCommandPool command_pool = frame.CommandPool;
 
 		VkCommandBufferAllocateInfo cmdBufAllocateInfo = {};
 		cmdBufAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -721,7 +1531,7 @@ namespace Walnut {
 		cmdBufAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
 		cmdBufAllocateInfo.commandBufferCount = 1;
 
-		VkCommandBuffer& command_buffer = s_AllocatedCommandBuffers[wd->FrameIndex].emplace_back();
+		VkCommandBuffer& command_buffer = frame.AllocatedCommandBuffers.emplace_back();
 		auto err = vkAllocateCommandBuffers(g_Device, &cmdBufAllocateInfo, &command_buffer);
 
 		VkCommandBufferBeginInfo begin_info = {};
@@ -749,7 +1559,7 @@ namespace Walnut {
 		fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
 		fenceCreateInfo.flags = 0;
 		VkFence fence;
-		err = vkCreateFence(g_Device, &fenceCreateInfo, nullptr, &fence);
+		err = vkCreateFence(g_Device, &fenceCreateInfo, g_Allocator, &fence);
 		check_vk_result(err);
 
 		err = vkQueueSubmit(g_Queue, 1, &end_info, fence);
@@ -758,13 +1568,14 @@ namespace Walnut {
 		err = vkWaitForFences(g_Device, 1, &fence, VK_TRUE, DEFAULT_FENCE_TIMEOUT);
 		check_vk_result(err);
 
-		vkDestroyFence(g_Device, fence, nullptr);
+		vkDestroyFence(g_Device, fence, g_Allocator);
 	}
 
 
 	void Application::SubmitResourceFree(std::function<void()>&& func)
 	{
-		s_ResourceFreeQueue[s_CurrentFrameIndex].emplace_back(func);
+		WaitForStartup();
+		s_FramesInFlight[s_CurrentFrameIndex].ResourceFreeQueue.emplace_back(func);
 	}
 
 }
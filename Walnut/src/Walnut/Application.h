@@ -1,11 +1,25 @@
 #pragma once
 
+#include "FontAtlasCache.h"
+#include "FrameAllocator.h"
+#include "FrameRecorder.h"
+#include "FrameTimeStatistics.h"
+#include "Input/InputRecording.h"
 #include "Layer.h"
+#include "LayerUpdateScheduler.h"
+#include "StartupReport.h"
+#include "ThreadPool.h"
+#include "VulkanHostAllocator.h"
 
 #include <string>
 #include <vector>
 #include <memory>
 #include <functional>
+#include <future>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 #include "imgui.h"
 #include "vulkan/vulkan.h"
@@ -21,6 +35,50 @@ namespace Walnut {
 		std::string Name = "Walnut App";
 		uint32_t Width = 1600;
 		uint32_t Height = 900;
+
+		// Disabling VSync prefers mailbox/immediate presentation when the surface supports it
+		bool VSync = true;
+
+		// Frames the CPU can record ahead of the GPU, each with its own command pool, fence and deletion queue,
+		// independent of the swapchain image count. 1 has the lowest latency, 3 the most throughput
+		uint32_t MaxFramesInFlight = 2;
+
+		// Seconds the window size must stay unchanged before the swapchain is rebuilt for it, so dragging a window edge
+		// doesn't rebuild it every frame. Swapchains that can't be presented to anymore are rebuilt at most this often
+		float SwapchainResizeDebounce = 0.05f;
+
+		// Records ImGui's platform windows (multi-viewport) next to the main window and submits and presents
+		// them all at once, instead of one submission and present per window
+		bool BatchPlatformWindows = true;
+
+		// Routes Vulkan's host allocations through VulkanHostAllocator, on top of PoolAllocator, and counts them per
+		// allocation scope, see Application::GetVulkanHostAllocationStatistics. Off uses the driver's allocator
+		bool TrackVulkanHostAllocations = false;
+
+		// Allocates ImGui's memory from PoolAllocator instead of malloc, see PoolAllocator::GetStatistics
+		bool PoolImGuiAllocations = false;
+
+		// Baked font atlases are cached here, by default in the per-user cache directory. Empty disables the cache
+		std::string FontCacheDirectory = FontAtlasCache::GetDefaultDirectory();
+
+		// When non-zero, Layer::OnUpdate runs on its own thread at this fixed rate (in Hz) instead of once per frame.
+		// Hand state to OnUIRender through a SnapshotBuffer and interpolate with Application::GetFixedUpdateAlpha().
+		// OnUpdate then runs concurrently with rendering and must not create, update or free an Image or StreamingImage,
+		// or otherwise touch Vulkan: that happens in OnUIRender or OnRender, from the snapshot
+		float FixedUpdateRate = 0.0f;
+
+		// Writes the main window's input and every frame's time step to this file, see InputRecorder
+		std::string InputRecordPath;
+
+		// Replays a file written with InputRecordPath instead of live input, frame by frame with the recorded time
+		// steps, then prints a timing report and closes. The window gets the recorded size
+		std::string InputReplayPath;
+
+		// Writes every replayed frame's time step and measured time as CSV, empty only prints the summary
+		std::string InputReplayReportPath;
+
+		// Keeps the main window hidden and doesn't wait for VSync, eg. to replay on a build machine
+		bool Headless = false;
 	};
 
 	class Application
@@ -33,43 +91,139 @@ namespace Walnut {
 
 		void Run();
 		void SetMenubarCallback(const std::function<void()>& menubarCallback) { m_MenubarCallback = menubarCallback; }
+
+		// Called once the first frame has been presented, with the finished startup report
+		void SetReadyCallback(const std::function<void(const StartupReport&)>& readyCallback) { m_ReadyCallback = readyCallback; }
 		
 		template<typename T>
-		void PushLayer()
+		std::shared_ptr<T> PushLayer()
 		{
 			static_assert(std::is_base_of<Layer, T>::value, "Pushed type is not subclass of Layer!");
-			m_LayerStack.emplace_back(std::make_shared<T>())->OnAttach();
+			std::shared_ptr<T> layer = std::make_shared<T>();
+			PushLayer(layer);
+			return layer;
 		}
 
-		void PushLayer(const std::shared_ptr<Layer>& layer) { m_LayerStack.emplace_back(layer); layer->OnAttach(); }
+		void PushLayer(const std::shared_ptr<Layer>& layer);
+
+		// `layer`'s OnUpdate only starts once `dependency`'s OnUpdate has finished.
+		// Both layers must update in parallel, see Layer::IsUpdateParallel
+		void AddLayerUpdateDependency(const std::shared_ptr<Layer>& layer, const std::shared_ptr<Layer>& dependency);
 
 		void Close();
 
-		float GetTime();
+		// Seconds since startup, see Clock
+		double GetTime();
+
+		// Rolling statistics over the most recent frames, from the main thread
+		FrameTimeStatistics GetFrameTimeStatistics() const { return m_FrameTimeHistory.Compute(); }
+		const FrameTimeHistory& GetFrameTimeHistory() const { return m_FrameTimeHistory; }
+
+		// Progress from the last fixed update towards the next one in [0, 1], always 1 without a FixedUpdateRate
+		float GetFixedUpdateAlpha() const;
 		GLFWwindow* GetWindowHandle() const { return m_WindowHandle; }
+		ThreadPool& GetThreadPool() { return *m_ThreadPool; }
+		const StartupReport& GetStartupReport() const { return m_StartupReport; }
+
+		// Scratch memory valid until the end of the next frame, see FrameAllocator
+		FrameAllocator& GetFrameAllocator() { return m_FrameAllocator; }
+
+		// Records every presented frame (or specification.Source) from the next one on, replacing a recording in
+		// progress. Frames are read back and written on a worker thread, and dropped rather than waited for
+		void StartRecording(const FrameRecordingSpecification& specification);
+		void StopRecording(); // Writes the frames still in flight first
+		bool IsRecording() const { return m_FrameRecorder != nullptr; }
 
+		// Of the current recording, or of the last one once stopped
+		FrameRecordingStatistics GetRecordingStatistics() const;
+
+		// Input and time steps come from ApplicationSpecification::InputReplayPath
+		bool IsReplayingInput() const { return m_InputReplayer != nullptr; }
+
+		// The device is only waited for at the start of Run, so that layers pushed before it load their assets in
+		// parallel. Before that, the first call from the main thread completes startup, calls from other threads
+		// wait for it
 		static VkInstance GetInstance();
 		static VkPhysicalDevice GetPhysicalDevice();
 		static VkDevice GetDevice();
+		static VkQueue GetQueue();
+		static uint32_t GetQueueFamilyIndex();
+		static VkDescriptorPool GetDescriptorPool();
+
+		// Pass to every vkCreate*/vkDestroy* call, nullptr unless TrackVulkanHostAllocations is set
+		static const VkAllocationCallbacks* GetAllocator();
+		static VulkanHostAllocationStatistics GetVulkanHostAllocationStatistics();
+
+		// Slot of the current frame, in [0, GetMaxFramesInFlight()), from OnUpdate through OnRender: index per-frame
+		// resources used by Layer::OnRender with it. The slot is reused once the GPU has finished the frame that last used it
+		static uint32_t GetMaxFramesInFlight();
+		static uint32_t GetCurrentFrameIndex();
+
+		// Main window render pass, kept when the swapchain is resized
+		static VkRenderPass GetRenderPass();
 
 		static VkCommandBuffer GetCommandBuffer(bool begin);
 		static void FlushCommandBuffer(VkCommandBuffer commandBuffer);
 
+		// Runs func once the GPU has finished the current frame
 		static void SubmitResourceFree(std::function<void()>&& func);
 	private:
 		void Init();
+		// The part of startup that needs the Vulkan device, at the start of Run or when something needs Vulkan earlier
+		void CompleteInit();
+		static void WaitForStartup();
 		void Shutdown();
+
+		void FixedUpdateLoop();
+		void WaitForAsyncAttach();
+		bool IsAsyncAttachPending();
+		// Main thread: waits for the pending OnAttachAsync calls, then calls OnAttach for those layers
+		void AttachPendingLayers();
+
+		void UpdateFontAtlas();
 	private:
 		ApplicationSpecification m_Specification;
+		StartupReport m_StartupReport;
 		GLFWwindow* m_WindowHandle = nullptr;
 		bool m_Running = false;
 
 		float m_TimeStep = 0.0f;
 		float m_FrameTime = 0.0f;
-		float m_LastFrameTime = 0.0f;
+		int64_t m_LastFrameTicks = 0;
+		FrameTimeHistory m_FrameTimeHistory;
+		FrameAllocator m_FrameAllocator;
+
+		std::unique_ptr<FrameRecorder> m_FrameRecorder;
+		FrameRecordingStatistics m_LastRecordingStatistics;
+
+		std::unique_ptr<InputRecorder> m_InputRecorder;
+		std::unique_ptr<InputReplayer> m_InputReplayer;
 
 		std::vector<std::shared_ptr<Layer>> m_LayerStack;
+		std::mutex m_LayerStackMutex;
+		LayerUpdateScheduler m_LayerUpdateScheduler;
+		std::unique_ptr<ThreadPool> m_ThreadPool;
+
+		// Startup jobs still running on workers, see CompleteInit
+		std::future<void> m_VulkanSetup;
+		std::future<std::vector<uint8_t>> m_FontAtlasData;
+		std::atomic<bool> m_VulkanInitialized = false; // Once CompleteInit has finished
+		bool m_CompletingInit = false;
+		std::thread::id m_MainThreadId;
+		std::mutex m_StartupMutex;
+		std::condition_variable m_StartupCondition;
+
+		// Layers whose OnAttach has not run yet, and those of them whose OnAttachAsync has returned
+		std::mutex m_AsyncAttachMutex;
+		std::condition_variable m_AsyncAttachCondition;
+		std::vector<std::pair<uint32_t, std::shared_ptr<Layer>>> m_AttachQueue;
+		uint32_t m_AsyncAttachCount = 0;
+
+		std::thread m_UpdateThread;
+		std::atomic<bool> m_UpdateThreadRunning = false;
+		std::atomic<int64_t> m_LastFixedUpdateTime = 0; // steady_clock ticks
 		std::function<void()> m_MenubarCallback;
+		std::function<void(const StartupReport&)> m_ReadyCallback;
 	};
 
 	// Implemented by CLIENT
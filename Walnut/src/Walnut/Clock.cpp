@@ -0,0 +1,158 @@
+#include "Clock.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+	#define WL_CLOCK_TIMESTAMP_COUNTER
+	#ifdef _MSC_VER
+		#include <intrin.h>
+	#else
+		#include <cpuid.h>
+		#include <x86intrin.h>
+	#endif
+#endif
+
+namespace Walnut {
+
+	struct ClockCalibration
+	{
+		uint64_t BaseCounter = 0;
+		int64_t BaseTicks = 0;
+		uint64_t TicksPerCount = 0; // 32.32 fixed point
+		double Frequency = 0.0;
+	};
+
+	static const std::chrono::steady_clock::time_point s_ClockEpoch = std::chrono::steady_clock::now();
+
+	// Written once, before s_ClockCalibrated is set
+	static ClockCalibration s_ClockCalibration;
+	static std::atomic<bool> s_ClockCalibrated = false;
+
+	// Sample taken by BeginCalibration
+	static bool s_ClockCalibrationStarted = false;
+	static uint64_t s_ClockCalibrationCounter = 0;
+	static int64_t s_ClockCalibrationTicks = 0;
+
+	namespace Utils {
+
+		static int64_t SteadyClockTicks()
+		{
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - s_ClockEpoch).count();
+		}
+
+#ifdef WL_CLOCK_TIMESTAMP_COUNTER
+		static bool HasInvariantTimestampCounter()
+		{
+#ifdef _MSC_VER
+			int info[4];
+			__cpuid(info, 0x80000000);
+			if ((uint32_t)info[0] < 0x80000007)
+				return false;
+			__cpuid(info, 0x80000007);
+			return info[3] & (1 << 8);
+#else
+			unsigned int eax, ebx, ecx, edx;
+			if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx))
+				return false;
+			return edx & (1 << 8);
+#endif
+		}
+
+		// Reads the counter on both sides of steady_clock and keeps the tightest of a few tries,
+		// so a preemption in between does not skew the calibration
+		static void SampleClocks(uint64_t& counter, int64_t& ticks)
+		{
+			uint64_t best = UINT64_MAX;
+			for (int i = 0; i < 8; i++)
+			{
+				uint64_t before = __rdtsc();
+				int64_t now = SteadyClockTicks();
+				uint64_t after = __rdtsc();
+				if (after - before < best)
+				{
+					best = after - before;
+					counter = before + (after - before) / 2;
+					ticks = now;
+				}
+			}
+		}
+
+		// (a * b) >> 32 without overflowing, for any a and b
+		static uint64_t MultiplyShift32(uint64_t a, uint64_t b)
+		{
+			uint64_t aHigh = a >> 32, aLow = a & 0xffffffff;
+			uint64_t bHigh = b >> 32, bLow = b & 0xffffffff;
+			return aHigh * b + aLow * bHigh + ((aLow * bLow) >> 32);
+		}
+#endif
+
+	}
+
+	int64_t Clock::Now()
+	{
+#ifdef WL_CLOCK_TIMESTAMP_COUNTER
+		if (s_ClockCalibrated.load(std::memory_order_acquire))
+		{
+			// Counters of different cores can be a few cycles apart, never go before the calibration point
+			int64_t counts = (int64_t)(__rdtsc() - s_ClockCalibration.BaseCounter);
+			if (counts < 0)
+				counts = 0;
+			return s_ClockCalibration.BaseTicks + (int64_t)Utils::MultiplyShift32((uint64_t)counts, s_ClockCalibration.TicksPerCount);
+		}
+#endif
+		return Utils::SteadyClockTicks();
+	}
+
+	void Clock::BeginCalibration()
+	{
+#ifdef WL_CLOCK_TIMESTAMP_COUNTER
+		if (s_ClockCalibrated || !Utils::HasInvariantTimestampCounter())
+			return;
+
+		Utils::SampleClocks(s_ClockCalibrationCounter, s_ClockCalibrationTicks);
+		s_ClockCalibrationStarted = true;
+#endif
+	}
+
+	void Clock::EndCalibration()
+	{
+#ifdef WL_CLOCK_TIMESTAMP_COUNTER
+		if (s_ClockCalibrated || !s_ClockCalibrationStarted)
+			return;
+
+		int64_t remaining = s_ClockCalibrationTicks + MinCalibrationTime - Utils::SteadyClockTicks();
+		if (remaining > 0)
+			std::this_thread::sleep_for(std::chrono::nanoseconds(remaining));
+
+		uint64_t counter = 0;
+		int64_t ticks = 0;
+		Utils::SampleClocks(counter, ticks);
+
+		double frequency = (double)(counter - s_ClockCalibrationCounter) * TicksPerSecond / (double)(ticks - s_ClockCalibrationTicks);
+
+		// Anything below 100 MHz is not a usable timestamp counter (some virtual machines), stay on steady_clock
+		if (!(frequency >= 1.0e8))
+			return;
+
+		// Continues from steady_clock at the calibration point, so Now() does not jump when switching over
+		s_ClockCalibration.BaseCounter = counter;
+		s_ClockCalibration.BaseTicks = ticks;
+		s_ClockCalibration.TicksPerCount = (uint64_t)((double)TicksPerSecond / frequency * 4294967296.0 + 0.5);
+		s_ClockCalibration.Frequency = frequency;
+		s_ClockCalibrated.store(true, std::memory_order_release);
+#endif
+	}
+
+	bool Clock::IsUsingTimestampCounter()
+	{
+		return s_ClockCalibrated.load(std::memory_order_acquire);
+	}
+
+	double Clock::GetTimestampCounterFrequency()
+	{
+		return IsUsingTimestampCounter() ? s_ClockCalibration.Frequency : 0.0;
+	}
+
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdint.h>
+
+namespace Walnut {
+
+	// Monotonic 64-bit clock counting nanoseconds since the process started. Integer ticks never lose precision,
+	// convert to seconds only for differences. Reads the CPU timestamp counter when it is invariant (constant rate
+	// across power states and cores) and has been calibrated, std::chrono::steady_clock otherwise.
+	class Clock
+	{
+	public:
+		static constexpr int64_t TicksPerSecond = 1000000000;
+
+		static int64_t Now();
+
+		static double ToSeconds(int64_t ticks) { return (double)ticks / TicksPerSecond; }
+		static double ToMillis(int64_t ticks) { return (double)ticks / (TicksPerSecond / 1000); }
+		static int64_t FromSeconds(double seconds) { return (int64_t)(seconds * TicksPerSecond); }
+
+		// Measures the timestamp counter against steady_clock over everything in between, so calibration costs
+		// nothing when there is other work to do (Application calibrates across startup). EndCalibration only
+		// waits when less than MinCalibrationTime has passed. Call both from one thread, without an invariant counter
+		// they are no-ops.
+		static void BeginCalibration();
+		static void EndCalibration();
+
+		static bool IsUsingTimestampCounter();
+		static double GetTimestampCounterFrequency(); // Hz, 0 when not calibrated
+
+		static constexpr int64_t MinCalibrationTime = 20000000;
+	};
+
+}
@@ -0,0 +1,325 @@
+#include "FontAtlasCache.h"
+
+#include "imgui.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+
+namespace Walnut {
+
+	static constexpr uint32_t c_FontAtlasMagic = 0x4146574E; // "NWFA"
+	static constexpr uint32_t c_FontAtlasVersion = 2;
+
+	struct FontAtlasHeader
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		uint32_t ImGuiVersion;
+		uint32_t FontCount;
+		uint64_t Key;
+		int32_t TexWidth, TexHeight;
+		int32_t Flags;
+		ImVec2 TexUvScale;
+		ImVec2 TexUvWhitePixel;
+		ImVec4 TexUvLines[IM_DRAWLIST_TEX_LINES_WIDTH_MAX + 1];
+	};
+
+	struct FontAtlasFontHeader
+	{
+		float FontSize;
+		float Ascent, Descent;
+		uint32_t EllipsisChar;
+		uint32_t DotChar;
+		uint32_t GlyphCount;
+		char Name[40];
+	};
+
+	struct FontAtlasGlyph
+	{
+		uint32_t Codepoint;
+		uint32_t Colored;
+		float AdvanceX;
+		float X0, Y0, X1, Y1;
+		float U0, V0, U1, V1;
+	};
+
+	namespace Utils {
+
+		// FNV-1a, only needs to tell fonts apart
+		static uint64_t HashFontData(const void* data, size_t size, uint64_t hash = 0xcbf29ce484222325ull)
+		{
+			const uint8_t* bytes = (const uint8_t*)data;
+			for (size_t i = 0; i < size; i++)
+			{
+				hash ^= bytes[i];
+				hash *= 0x100000001b3ull;
+			}
+			return hash;
+		}
+
+		template<typename T>
+		static void WriteFontAtlasData(std::vector<uint8_t>& buffer, const T& value)
+		{
+			const uint8_t* bytes = (const uint8_t*)&value;
+			buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+		}
+
+		template<typename T>
+		static bool ReadFontAtlasData(const std::vector<uint8_t>& buffer, size_t& offset, T& value)
+		{
+			if (offset + sizeof(T) > buffer.size())
+				return false;
+
+			memcpy(&value, buffer.data() + offset, sizeof(T));
+			offset += sizeof(T);
+			return true;
+		}
+
+		static std::vector<uint8_t> ReadFontAtlasFile(const std::filesystem::path& filepath, uint64_t key)
+		{
+			std::ifstream stream(filepath, std::ios::binary | std::ios::ate);
+			if (!stream)
+				return {};
+
+			std::vector<uint8_t> data((size_t)stream.tellg());
+			stream.seekg(0);
+			stream.read((char*)data.data(), data.size());
+
+			size_t offset = 0;
+			FontAtlasHeader header;
+			if (!stream || !ReadFontAtlasData(data, offset, header))
+				return {};
+
+			if (header.Magic != c_FontAtlasMagic || header.Version != c_FontAtlasVersion || header.ImGuiVersion != IMGUI_VERSION_NUM || header.Key != key)
+				return {};
+
+			return data;
+		}
+
+		static void WriteFontAtlasFile(const std::filesystem::path& filepath, const std::vector<uint8_t>& data)
+		{
+			std::error_code error;
+			std::filesystem::create_directories(filepath.parent_path(), error);
+
+			// Several instances may start at once, so write to a unique file and move it into place
+			std::filesystem::path temporaryPath = filepath;
+			temporaryPath += "." + std::to_string(std::random_device()()) + ".tmp";
+			{
+				std::ofstream stream(temporaryPath, std::ios::binary);
+				stream.write((const char*)data.data(), data.size());
+				if (!stream)
+				{
+					std::cerr << "Could not write font atlas cache " << temporaryPath << "\n";
+					return;
+				}
+			}
+
+			std::filesystem::rename(temporaryPath, filepath, error);
+			if (error)
+				std::filesystem::remove(temporaryPath, error);
+		}
+
+	}
+
+	std::vector<uint8_t> FontAtlasCache::GetOrBake(const void* ttfData, size_t ttfSize, float sizePixels, const std::string& name, const std::string& cacheDirectory)
+	{
+		uint64_t key = Utils::HashFontData(ttfData, ttfSize);
+		key = Utils::HashFontData(&sizePixels, sizeof(sizePixels), key);
+
+		char filename[128];
+		snprintf(filename, sizeof(filename), "%s-%.2fpx-%016llx.fontatlas", name.c_str(), sizePixels, (unsigned long long)key);
+		std::filesystem::path filepath = std::filesystem::path(cacheDirectory) / filename;
+
+		if (!cacheDirectory.empty())
+		{
+			std::vector<uint8_t> data = Utils::ReadFontAtlasFile(filepath, key);
+			if (!data.empty())
+				return data;
+		}
+
+		// A standalone atlas only uses the ImGui allocator, never the current context
+		ImFontAtlas atlas;
+		atlas.Flags |= ImFontAtlasFlags_NoMouseCursors;
+
+		ImFontConfig fontConfig;
+		fontConfig.FontDataOwnedByAtlas = false;
+		snprintf(fontConfig.Name, IM_ARRAYSIZE(fontConfig.Name), "%s, %.0fpx", name.c_str(), sizePixels);
+		atlas.AddFontFromMemoryTTF((void*)ttfData, (int)ttfSize, sizePixels, &fontConfig);
+		if (!atlas.Build())
+		{
+			std::cerr << "Could not bake font " << name << "\n";
+			return {};
+		}
+
+		std::vector<uint8_t> data = Serialize(&atlas, key);
+		if (!cacheDirectory.empty())
+			Utils::WriteFontAtlasFile(filepath, data);
+
+		return data;
+	}
+
+	std::string FontAtlasCache::GetDefaultDirectory()
+	{
+#ifdef WL_PLATFORM_WINDOWS
+		if (const char* localAppData = std::getenv("LOCALAPPDATA"); localAppData && *localAppData)
+			return (std::filesystem::path(localAppData) / "Walnut" / "FontCache").string();
+#else
+		if (const char* cacheHome = std::getenv("XDG_CACHE_HOME"); cacheHome && *cacheHome)
+			return (std::filesystem::path(cacheHome) / "walnut" / "FontCache").string();
+		if (const char* home = std::getenv("HOME"); home && *home)
+			return (std::filesystem::path(home) / ".cache" / "walnut" / "FontCache").string();
+#endif
+		return {};
+	}
+
+	std::vector<uint8_t> FontAtlasCache::Serialize(ImFontAtlas* atlas, uint64_t key)
+	{
+		unsigned char* pixels;
+		int width, height;
+		atlas->GetTexDataAsAlpha8(&pixels, &width, &height);
+
+		std::vector<uint8_t> buffer;
+		buffer.reserve(sizeof(FontAtlasHeader) + (size_t)width * height);
+
+		FontAtlasHeader header = {};
+		header.Magic = c_FontAtlasMagic;
+		header.Version = c_FontAtlasVersion;
+		header.ImGuiVersion = IMGUI_VERSION_NUM;
+		header.FontCount = (uint32_t)atlas->Fonts.Size;
+		header.Key = key;
+		header.TexWidth = width;
+		header.TexHeight = height;
+		header.Flags = atlas->Flags;
+		header.TexUvScale = atlas->TexUvScale;
+		header.TexUvWhitePixel = atlas->TexUvWhitePixel;
+		memcpy(header.TexUvLines, atlas->TexUvLines, sizeof(header.TexUvLines));
+		Utils::WriteFontAtlasData(buffer, header);
+
+		for (ImFont* font : atlas->Fonts)
+		{
+			FontAtlasFontHeader fontHeader = {};
+			fontHeader.FontSize = font->FontSize;
+			fontHeader.Ascent = font->Ascent;
+			fontHeader.Descent = font->Descent;
+			fontHeader.EllipsisChar = font->EllipsisChar;
+#if IMGUI_VERSION_NUM >= 18800
+			fontHeader.DotChar = font->DotChar;
+#endif
+			fontHeader.GlyphCount = (uint32_t)font->Glyphs.Size;
+			if (font->ConfigData)
+				memcpy(fontHeader.Name, font->ConfigData->Name, sizeof(fontHeader.Name));
+			Utils::WriteFontAtlasData(buffer, fontHeader);
+
+			for (const ImFontGlyph& glyph : font->Glyphs)
+			{
+				FontAtlasGlyph serializedGlyph;
+				serializedGlyph.Codepoint = glyph.Codepoint;
+				serializedGlyph.Colored = glyph.Colored;
+				serializedGlyph.AdvanceX = glyph.AdvanceX;
+				serializedGlyph.X0 = glyph.X0;
+				serializedGlyph.Y0 = glyph.Y0;
+				serializedGlyph.X1 = glyph.X1;
+				serializedGlyph.Y1 = glyph.Y1;
+				serializedGlyph.U0 = glyph.U0;
+				serializedGlyph.V0 = glyph.V0;
+				serializedGlyph.U1 = glyph.U1;
+				serializedGlyph.V1 = glyph.V1;
+				Utils::WriteFontAtlasData(buffer, serializedGlyph);
+			}
+		}
+
+		buffer.insert(buffer.end(), pixels, pixels + (size_t)width * height);
+		return buffer;
+	}
+
+	bool FontAtlasCache::Deserialize(ImFontAtlas* atlas, const std::vector<uint8_t>& data)
+	{
+		size_t offset = 0;
+		FontAtlasHeader header;
+		if (!Utils::ReadFontAtlasData(data, offset, header) || header.Magic != c_FontAtlasMagic || header.Version != c_FontAtlasVersion)
+			return false;
+
+		atlas->Clear();
+		atlas->Flags = header.Flags;
+		atlas->TexWidth = header.TexWidth;
+		atlas->TexHeight = header.TexHeight;
+		atlas->TexUvScale = header.TexUvScale;
+		atlas->TexUvWhitePixel = header.TexUvWhitePixel;
+		memcpy(atlas->TexUvLines, header.TexUvLines, sizeof(header.TexUvLines));
+
+		// Reserve up front, fonts keep pointers into ConfigData
+		atlas->ConfigData.reserve((int)header.FontCount);
+
+		for (uint32_t i = 0; i < header.FontCount; i++)
+		{
+			FontAtlasFontHeader fontHeader;
+			if (!Utils::ReadFontAtlasData(data, offset, fontHeader))
+			{
+				atlas->Clear();
+				return false;
+			}
+
+			ImFont* font = IM_NEW(ImFont);
+			atlas->Fonts.push_back(font);
+
+			atlas->ConfigData.push_back(ImFontConfig());
+			ImFontConfig& config = atlas->ConfigData.back();
+			config.FontData = nullptr;
+			config.FontDataOwnedByAtlas = false;
+			config.SizePixels = fontHeader.FontSize;
+			config.DstFont = font;
+			memcpy(config.Name, fontHeader.Name, sizeof(config.Name));
+			config.Name[sizeof(config.Name) - 1] = 0;
+
+			font->FontSize = fontHeader.FontSize;
+			font->Ascent = fontHeader.Ascent;
+			font->Descent = fontHeader.Descent;
+			font->ContainerAtlas = atlas;
+			font->ConfigData = &config;
+			font->ConfigDataCount = 1;
+
+			// Before BuildLookupTable, which derives the ellipsis rendering from them
+			font->EllipsisChar = (ImWchar)fontHeader.EllipsisChar;
+#if IMGUI_VERSION_NUM >= 18800
+			font->DotChar = (ImWchar)fontHeader.DotChar;
+#endif
+
+			font->Glyphs.reserve((int)fontHeader.GlyphCount);
+			for (uint32_t g = 0; g < fontHeader.GlyphCount; g++)
+			{
+				FontAtlasGlyph glyph;
+				if (!Utils::ReadFontAtlasData(data, offset, glyph))
+				{
+					atlas->Clear();
+					return false;
+				}
+
+				font->AddGlyph(nullptr, (ImWchar)glyph.Codepoint, glyph.X0, glyph.Y0, glyph.X1, glyph.Y1, glyph.U0, glyph.V0, glyph.U1, glyph.V1, glyph.AdvanceX);
+				font->Glyphs.back().Colored = glyph.Colored != 0;
+			}
+
+			font->BuildLookupTable();
+		}
+
+		size_t pixelCount = (size_t)header.TexWidth * header.TexHeight;
+		if (offset + pixelCount > data.size())
+		{
+			atlas->Clear();
+			return false;
+		}
+
+		atlas->TexPixelsAlpha8 = (unsigned char*)IM_ALLOC(pixelCount);
+		memcpy(atlas->TexPixelsAlpha8, data.data() + offset, pixelCount);
+#if IMGUI_VERSION_NUM >= 18800
+		atlas->TexReady = true;
+#endif
+
+		return true;
+	}
+
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+struct ImFontAtlas;
+
+namespace Walnut {
+
+	// Rasterizing a TTF font into an ImFontAtlas takes a noticeable part of startup, so baked
+	// atlases (pixels plus glyph metrics) are kept on disk keyed by font data and pixel size.
+	class FontAtlasCache
+	{
+	public:
+		// Returns the serialized atlas for a TTF font at the given pixel size, read from cacheDirectory
+		// when present, otherwise baked and written there. An empty directory disables the disk cache.
+		// Does not touch the current ImGui context, so it can run on a worker thread.
+		static std::vector<uint8_t> GetOrBake(const void* ttfData, size_t ttfSize, float sizePixels, const std::string& name, const std::string& cacheDirectory);
+
+		// Per-user cache directory: %LOCALAPPDATA%/Walnut/FontCache on Windows, $XDG_CACHE_HOME/walnut/FontCache
+		// (or ~/.cache/walnut/FontCache) elsewhere. Empty, which disables the cache, when none of these are set
+		static std::string GetDefaultDirectory();
+
+		// Serializes a built atlas: alpha8 pixels, white pixel/line UVs and every font's glyph metrics.
+		// The key identifies the font source and size and is checked when reading the cache.
+		static std::vector<uint8_t> Serialize(ImFontAtlas* atlas, uint64_t key);
+
+		// Fills a cleared atlas from serialized data without rasterizing anything
+		static bool Deserialize(ImFontAtlas* atlas, const std::vector<uint8_t>& data);
+	};
+
+}
@@ -0,0 +1,122 @@
+#include "FrameAllocator.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <algorithm>
+
+namespace Walnut {
+
+	FrameAllocator::FrameAllocator(size_t initialSize)
+	{
+		for (Arena& arena : m_Arenas)
+		{
+			arena.Blocks.push_back(CreateBlock(std::max<size_t>(initialSize, 64)));
+			arena.Current = arena.Blocks[0].get();
+		}
+	}
+
+	std::unique_ptr<FrameAllocator::Block> FrameAllocator::CreateBlock(size_t capacity)
+	{
+		std::unique_ptr<Block> block = std::make_unique<Block>();
+		block->Memory = std::make_unique<uint8_t[]>(capacity);
+		block->Capacity = capacity;
+		return block;
+	}
+
+	size_t FrameAllocator::GetUsedBytes(const Arena& arena)
+	{
+		// Failed bumps never move the offset past the capacity, see Allocate
+		size_t used = 0;
+		for (const auto& block : arena.Blocks)
+			used += block->Offset.load(std::memory_order_relaxed);
+		return used;
+	}
+
+	void* FrameAllocator::Allocate(size_t size, size_t alignment)
+	{
+		Arena& arena = m_Arenas[m_ArenaIndex];
+		for (;;)
+		{
+			Block* block = arena.Current.load(std::memory_order_acquire);
+			uintptr_t base = (uintptr_t)block->Memory.get();
+
+			size_t offset = block->Offset.load(std::memory_order_relaxed);
+			size_t alignedOffset, end;
+			do
+			{
+				alignedOffset = ((base + offset + alignment - 1) & ~(uintptr_t)(alignment - 1)) - base;
+				end = alignedOffset + size;
+				if (end > block->Capacity)
+					break;
+			} while (!block->Offset.compare_exchange_weak(offset, end, std::memory_order_relaxed));
+
+			if (end <= block->Capacity)
+				return block->Memory.get() + alignedOffset;
+
+			// Full: chain a new block, unless another thread already has
+			std::scoped_lock<std::mutex> lock(m_OverflowMutex);
+			if (arena.Current.load(std::memory_order_relaxed) == block)
+			{
+				size_t capacity = std::max(arena.Blocks[0]->Capacity, size + alignment);
+				arena.Blocks.push_back(CreateBlock(capacity));
+				arena.Current.store(arena.Blocks.back().get(), std::memory_order_release);
+				m_OverflowCount++;
+			}
+		}
+	}
+
+	const char* FrameAllocator::Format(const char* format, ...)
+	{
+		va_list args;
+		va_start(args, format);
+		va_list argsCopy;
+		va_copy(argsCopy, args);
+		int length = vsnprintf(nullptr, 0, format, argsCopy);
+		va_end(argsCopy);
+
+		char* buffer = (char*)Allocate(length > 0 ? (size_t)length + 1 : 1, 1);
+		if (length > 0)
+			vsnprintf(buffer, (size_t)length + 1, format, args);
+		else
+			buffer[0] = '\0';
+		va_end(args);
+		return buffer;
+	}
+
+	void FrameAllocator::NextFrame()
+	{
+		m_ArenaIndex ^= 1;
+		Arena& arena = m_Arenas[m_ArenaIndex];
+
+		size_t used = GetUsedBytes(arena);
+		m_PeakBytes = std::max(m_PeakBytes, used);
+
+		// That frame needed more than one block, make the next ones fit in one
+		if (arena.Blocks.size() > 1)
+		{
+			size_t capacity = 0;
+			for (const auto& block : arena.Blocks)
+				capacity += block->Capacity;
+			arena.Blocks.clear();
+			arena.Blocks.push_back(CreateBlock(capacity));
+		}
+
+		arena.Blocks[0]->Offset.store(0, std::memory_order_relaxed);
+		arena.Current.store(arena.Blocks[0].get(), std::memory_order_release);
+	}
+
+	FrameAllocatorStatistics FrameAllocator::GetStatistics() const
+	{
+		FrameAllocatorStatistics statistics;
+		statistics.UsedBytes = GetUsedBytes(m_Arenas[m_ArenaIndex]);
+		statistics.PeakBytes = std::max(m_PeakBytes, statistics.UsedBytes);
+		for (const Arena& arena : m_Arenas)
+		{
+			for (const auto& block : arena.Blocks)
+				statistics.CapacityBytes += block->Capacity;
+		}
+		statistics.OverflowCount = m_OverflowCount;
+		return statistics;
+	}
+
+}
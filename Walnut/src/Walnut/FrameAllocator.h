@@ -0,0 +1,113 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace Walnut {
+
+	struct FrameAllocatorStatistics
+	{
+		size_t UsedBytes = 0;       // By the current frame so far
+		size_t PeakBytes = 0;       // Most used by a single frame
+		size_t CapacityBytes = 0;   // Reserved by both halves
+		uint32_t OverflowCount = 0; // Times a frame ran out of space and chained another block
+	};
+
+	// Linear allocator for memory that only lives for a frame or two: allocating is a pointer bump and nothing is
+	// freed individually. Allocate is lock-free, so layers updating in parallel can use it too (but not the fixed
+	// update thread, which is not in step with frames). Double buffered: NextFrame() resets the half used two frames
+	// ago, so memory stays valid until the end of the next frame. A frame that fills its block chains another one,
+	// and the next reset of that half grows its block to fit. Destructors are never run.
+	class FrameAllocator
+	{
+	public:
+		FrameAllocator(size_t initialSize = 1024 * 1024);
+		~FrameAllocator() = default;
+
+		FrameAllocator(const FrameAllocator&) = delete;
+		FrameAllocator& operator=(const FrameAllocator&) = delete;
+
+		void* Allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+		template<typename T, typename... Args>
+		T* New(Args&&... args)
+		{
+			static_assert(std::is_trivially_destructible<T>::value, "FrameAllocator never runs destructors");
+			return new (Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+		}
+
+		// Default initialized
+		template<typename T>
+		T* NewArray(size_t count)
+		{
+			static_assert(std::is_trivially_destructible<T>::value, "FrameAllocator never runs destructors");
+			T* array = (T*)Allocate(sizeof(T) * count, alignof(T));
+			for (size_t i = 0; i < count; i++)
+				new (array + i) T;
+			return array;
+		}
+
+		// printf-style formatting into frame memory
+		const char* Format(const char* format, ...);
+
+		// Called by Application at the start of every frame, while nothing else is allocating
+		void NextFrame();
+
+		FrameAllocatorStatistics GetStatistics() const;
+	private:
+		struct Block
+		{
+			std::unique_ptr<uint8_t[]> Memory;
+			size_t Capacity = 0;
+			std::atomic<size_t> Offset = 0;
+		};
+
+		struct Arena
+		{
+			std::vector<std::unique_ptr<Block>> Blocks; // Blocks[0] is reused every frame, the rest are overflow
+			std::atomic<Block*> Current = nullptr;
+		};
+
+		static std::unique_ptr<Block> CreateBlock(size_t capacity);
+		static size_t GetUsedBytes(const Arena& arena);
+	private:
+		Arena m_Arenas[2];
+		uint32_t m_ArenaIndex = 0;
+
+		std::mutex m_OverflowMutex;
+		uint32_t m_OverflowCount = 0;
+		size_t m_PeakBytes = 0;
+	};
+
+	// For per-frame standard containers, eg. std::vector<int, FrameSTLAllocator<int>> v(Application::Get().GetFrameAllocator());
+	// Element destructors still run, but their memory is only reclaimed with the frame
+	template<typename T>
+	struct FrameSTLAllocator
+	{
+		using value_type = T;
+
+		FrameAllocator* Allocator;
+
+		FrameSTLAllocator(FrameAllocator& allocator) : Allocator(&allocator) {}
+
+		template<typename U>
+		FrameSTLAllocator(const FrameSTLAllocator<U>& other) : Allocator(other.Allocator) {}
+
+		T* allocate(size_t count) { return (T*)Allocator->Allocate(sizeof(T) * count, alignof(T)); }
+		void deallocate(T*, size_t) {}
+
+		template<typename U>
+		bool operator==(const FrameSTLAllocator<U>& other) const { return Allocator == other.Allocator; }
+		template<typename U>
+		bool operator!=(const FrameSTLAllocator<U>& other) const { return Allocator != other.Allocator; }
+	};
+
+}
@@ -0,0 +1,501 @@
+#include "FrameRecorder.h"
+
+#include "Application.h"
+#include "GPUMemory.h"
+#include "PixelConversion.h"
+
+#include <string.h>
+#include <algorithm>
+#include <array>
+#include <iostream>
+
+namespace Walnut {
+
+	namespace Utils {
+
+		static uint32_t RecordingCRC32(uint32_t crc, const uint8_t* data, size_t size)
+		{
+			static const auto table = []()
+			{
+				std::array<uint32_t, 256> table;
+				for (uint32_t i = 0; i < 256; i++)
+				{
+					uint32_t c = i;
+					for (int k = 0; k < 8; k++)
+						c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+					table[i] = c;
+				}
+				return table;
+			}();
+
+			crc = ~crc;
+			for (size_t i = 0; i < size; i++)
+				crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+			return ~crc;
+		}
+
+		static void AppendBigEndian32(std::vector<uint8_t>& buffer, uint32_t value)
+		{
+			buffer.push_back((uint8_t)(value >> 24));
+			buffer.push_back((uint8_t)(value >> 16));
+			buffer.push_back((uint8_t)(value >> 8));
+			buffer.push_back((uint8_t)value);
+		}
+
+		// Default name for the format, a PNG sequence drops the extension so frames don't end up as Path.png_000000.png
+		static std::string GetRecordingPath(const std::string& path, FrameRecordingFormat format)
+		{
+			switch (format)
+			{
+				case FrameRecordingFormat::Y4M:     return path.empty() ? "Recording.y4m" : path;
+				case FrameRecordingFormat::RawRGBA: return path.empty() ? "Recording.rgba" : path;
+				case FrameRecordingFormat::PNGSequence:
+				{
+					if (path.empty())
+						return "Recording";
+
+					size_t extension = path.find_last_of('.');
+					size_t directory = path.find_last_of("/\\");
+					if (extension == std::string::npos || extension == 0 || (directory != std::string::npos && extension <= directory + 1))
+						return path;
+					return path.substr(0, extension);
+				}
+			}
+			return path;
+		}
+
+		static bool WritePNGChunk(FILE* file, const char* type, const uint8_t* data, size_t size)
+		{
+			uint8_t header[8] = { (uint8_t)(size >> 24), (uint8_t)(size >> 16), (uint8_t)(size >> 8), (uint8_t)size };
+			memcpy(header + 4, type, 4);
+			uint32_t crc = RecordingCRC32(RecordingCRC32(0, header + 4, 4), data, size);
+			uint8_t footer[4] = { (uint8_t)(crc >> 24), (uint8_t)(crc >> 16), (uint8_t)(crc >> 8), (uint8_t)crc };
+			return fwrite(header, 1, 8, file) == 8 && (size == 0 || fwrite(data, 1, size, file) == size) && fwrite(footer, 1, 4, file) == 4;
+		}
+
+		// RGBA8 PNG in stored (uncompressed) deflate blocks: writing is bound by the disk, not by the encoder
+		static bool WriteRecordingPNG(FILE* file, std::vector<uint8_t>& scratch, const uint8_t* rgba, uint32_t width, uint32_t height)
+		{
+			const size_t rowSize = (size_t)width * 4 + 1; // Filter type 0 in front of every row
+			const size_t dataSize = rowSize * height;
+			const size_t maxBlockSize = 65535;
+			const size_t adlerInterval = 5552; // Most bytes the Adler-32 sums can take before they need a modulo
+
+			scratch.clear();
+			scratch.reserve(2 + dataSize + (dataSize / maxBlockSize + 1) * 5 + 4);
+			scratch.push_back(0x78); // zlib header, 32K window, no preset dictionary
+			scratch.push_back(0x01);
+
+			uint32_t adlerA = 1, adlerB = 0;
+			size_t blockRemaining = 0;
+			for (uint32_t y = 0; y < height; y++)
+			{
+				const uint8_t filter = 0;
+				const uint8_t* row = rgba + (size_t)y * width * 4;
+				for (size_t x = 0; x < rowSize;)
+				{
+					if (blockRemaining == 0)
+					{
+						size_t written = (size_t)y * rowSize + x;
+						blockRemaining = std::min(maxBlockSize, dataSize - written);
+						bool final = written + blockRemaining == dataSize;
+						scratch.push_back(final ? 1 : 0);
+						scratch.push_back((uint8_t)blockRemaining);
+						scratch.push_back((uint8_t)(blockRemaining >> 8));
+						scratch.push_back((uint8_t)~blockRemaining);
+						scratch.push_back((uint8_t)(~blockRemaining >> 8));
+					}
+
+					const uint8_t* source = x == 0 ? &filter : row + x - 1;
+					size_t count = x == 0 ? 1 : std::min(std::min(blockRemaining, rowSize - x), adlerInterval);
+					scratch.insert(scratch.end(), source, source + count);
+					x += count;
+					blockRemaining -= count;
+
+					for (size_t i = 0; i < count; i++)
+					{
+						adlerA += source[i];
+						adlerB += adlerA;
+					}
+					adlerA %= 65521;
+					adlerB %= 65521;
+				}
+			}
+			AppendBigEndian32(scratch, (adlerB << 16) | adlerA);
+
+			static const uint8_t signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+			uint8_t header[13] =
+			{
+				(uint8_t)(width >> 24), (uint8_t)(width >> 16), (uint8_t)(width >> 8), (uint8_t)width,
+				(uint8_t)(height >> 24), (uint8_t)(height >> 16), (uint8_t)(height >> 8), (uint8_t)height,
+				8, 6, 0, 0, 0 // 8 bits, RGBA, deflate, no filtering, no interlacing
+			};
+			return fwrite(signature, 1, sizeof(signature), file) == sizeof(signature)
+				&& WritePNGChunk(file, "IHDR", header, sizeof(header))
+				&& WritePNGChunk(file, "IDAT", scratch.data(), scratch.size())
+				&& WritePNGChunk(file, "IEND", nullptr, 0);
+		}
+
+		// BT.601 limited range, what Y4M readers assume without a color range tag
+		static void RGBA8ToYUV444(const uint8_t* rgba, uint8_t* y, uint8_t* u, uint8_t* v, size_t pixelCount)
+		{
+			for (size_t i = 0; i < pixelCount; i++)
+			{
+				int r = rgba[i * 4 + 0];
+				int g = rgba[i * 4 + 1];
+				int b = rgba[i * 4 + 2];
+				y[i] = (uint8_t)(16 + ((66 * r + 129 * g + 25 * b + 128) >> 8));
+				u[i] = (uint8_t)(128 + ((-38 * r - 74 * g + 112 * b + 128) >> 8));
+				v[i] = (uint8_t)(128 + ((112 * r - 94 * g - 18 * b + 128) >> 8));
+			}
+		}
+
+	}
+
+	FrameRecorder::FrameRecorder(const FrameRecordingSpecification& specification)
+		: m_Specification(specification)
+	{
+		m_Specification.Path = Utils::GetRecordingPath(m_Specification.Path, m_Specification.Format);
+
+		m_Buffers.resize(std::clamp(m_Specification.ReadbackBufferCount, 2u, 32u));
+		for (uint32_t i = 0; i < (uint32_t)m_Buffers.size(); i++)
+			m_FreeBuffers.push_back(i);
+
+		m_WriterThread = std::thread([this]() { WriterLoop(); });
+	}
+
+	FrameRecorder::~FrameRecorder()
+	{
+		Stop();
+
+		// Every copy has completed, nothing to defer
+		for (ReadbackBuffer& buffer : m_Buffers)
+			ReleaseReadbackBuffer(buffer);
+	}
+
+	void FrameRecorder::Stop()
+	{
+		if (!m_WriterThread.joinable())
+			return;
+
+		VkDevice device = Application::GetDevice();
+		for (uint32_t index : m_PendingBuffers)
+		{
+			VkResult err = vkWaitForFences(device, 1, &m_Buffers[index].Fence, VK_TRUE, UINT64_MAX);
+			check_vk_result(err);
+		}
+		Collect();
+
+		// The writer finishes everything queued before it stops
+		{
+			std::scoped_lock<std::mutex> lock(m_WriterMutex);
+			m_WriterRunning = false;
+		}
+		m_WriterCondition.notify_one();
+		m_WriterThread.join();
+
+		if (m_File)
+			fclose(m_File);
+		m_File = nullptr;
+	}
+
+	void FrameRecorder::AllocateReadbackBuffer(ReadbackBuffer& buffer, VkDeviceSize size)
+	{
+		VkDevice device = Application::GetDevice();
+		VkResult err;
+
+		VkBufferCreateInfo buffer_info = {};
+		buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		buffer_info.size = size;
+		buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		err = vkCreateBuffer(device, &buffer_info, Application::GetAllocator(), &buffer.Buffer);
+		check_vk_result(err);
+		VkMemoryRequirements req;
+		vkGetBufferMemoryRequirements(device, buffer.Buffer, &req);
+
+		// Cached memory is much faster to read from the CPU, coherent memory saves the invalidate
+		const VkMemoryPropertyFlags preferences[] =
+		{
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+		};
+		uint32_t memoryType = 0xffffffff;
+		for (VkMemoryPropertyFlags properties : preferences)
+		{
+			memoryType = Utils::GetVulkanMemoryType(properties, req.memoryTypeBits);
+			if (memoryType != 0xffffffff)
+			{
+				buffer.Coherent = (properties & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+				break;
+			}
+		}
+
+		VkMemoryAllocateInfo alloc_info = {};
+		alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		alloc_info.allocationSize = req.size;
+		alloc_info.memoryTypeIndex = memoryType;
+		err = GPUMemory::Allocate(alloc_info, GPUMemoryCategory::Staging, &buffer.Memory);
+		check_vk_result(err);
+		err = vkBindBufferMemory(device, buffer.Buffer, buffer.Memory, 0);
+		check_vk_result(err);
+		err = vkMapMemory(device, buffer.Memory, 0, VK_WHOLE_SIZE, 0, &buffer.Mapped);
+		check_vk_result(err);
+		buffer.Size = size;
+	}
+
+	void FrameRecorder::ReleaseReadbackBuffer(ReadbackBuffer& buffer)
+	{
+		if (!buffer.Buffer)
+			return;
+
+		vkDestroyBuffer(Application::GetDevice(), buffer.Buffer, Application::GetAllocator());
+		GPUMemory::Free(buffer.Memory);
+		buffer.Buffer = nullptr;
+		buffer.Memory = nullptr;
+		buffer.Mapped = nullptr;
+		buffer.Size = 0;
+	}
+
+	void FrameRecorder::Capture(VkCommandBuffer commandBuffer, VkFence fence, VkImage image, VkFormat format, VkImageLayout layout, uint32_t width, uint32_t height, bool opaque)
+	{
+		uint32_t index;
+		while (m_ReturnQueue.Pop(index))
+			m_FreeBuffers.push_back(index);
+
+		bool bgra;
+		switch (format)
+		{
+			case VK_FORMAT_B8G8R8A8_UNORM:
+			case VK_FORMAT_B8G8R8A8_SRGB:
+				bgra = true;
+				break;
+			case VK_FORMAT_R8G8B8A8_UNORM:
+			case VK_FORMAT_R8G8B8A8_SRGB:
+				bgra = false;
+				break;
+			default:
+				m_DroppedFrames++;
+				return;
+		}
+
+		bool fixedSize = m_Specification.Format != FrameRecordingFormat::PNGSequence;
+		if (fixedSize && m_FrameWidth && (width != m_FrameWidth || height != m_FrameHeight))
+		{
+			m_DroppedFrames++;
+			return;
+		}
+
+		if (m_FreeBuffers.empty() || m_WriteFailed || !m_WriterThread.joinable())
+		{
+			m_DroppedFrames++;
+			return;
+		}
+		index = m_FreeBuffers.back();
+		m_FreeBuffers.pop_back();
+
+		// Free buffers are done on both the GPU and the writer, so they can be replaced right away
+		ReadbackBuffer& buffer = m_Buffers[index];
+		VkDeviceSize size = (VkDeviceSize)width * height * 4;
+		if (buffer.Size < size)
+		{
+			ReleaseReadbackBuffer(buffer);
+			AllocateReadbackBuffer(buffer, size);
+		}
+
+		VkImageMemoryBarrier copy_barrier = {};
+		copy_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		copy_barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+		copy_barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		copy_barrier.oldLayout = layout;
+		copy_barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		copy_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		copy_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		copy_barrier.image = image;
+		copy_barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		copy_barrier.subresourceRange.levelCount = 1;
+		copy_barrier.subresourceRange.layerCount = 1;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1, &copy_barrier);
+
+		VkBufferImageCopy region = {};
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.layerCount = 1;
+		region.imageExtent.width = width;
+		region.imageExtent.height = height;
+		region.imageExtent.depth = 1;
+		vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, buffer.Buffer, 1, &region);
+
+		VkImageMemoryBarrier use_barrier = copy_barrier;
+		use_barrier.srcAccessMask = 0;
+		use_barrier.dstAccessMask = 0;
+		use_barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		use_barrier.newLayout = layout;
+
+		VkBufferMemoryBarrier host_barrier = {};
+		host_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		host_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		host_barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		host_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		host_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		host_barrier.buffer = buffer.Buffer;
+		host_barrier.size = size;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0, 0, NULL, 1, &host_barrier, 1, &use_barrier);
+
+		buffer.Fence = fence;
+		buffer.Width = width;
+		buffer.Height = height;
+		buffer.BGRA = bgra;
+		buffer.Opaque = opaque;
+		buffer.FrameNumber = m_FrameNumber++;
+		m_PendingBuffers.push_back(index);
+		m_CapturedFrames++;
+
+		if (!m_FrameWidth)
+		{
+			m_FrameWidth = width;
+			m_FrameHeight = height;
+		}
+	}
+
+	void FrameRecorder::Collect()
+	{
+		VkDevice device = Application::GetDevice();
+
+		// A frame fence stays signaled until its slot is reused, which only happens once it has been waited on.
+		// A reset one just means waiting for the next frame of that slot, which covers this copy too
+		size_t completed = 0;
+		for (; completed < m_PendingBuffers.size(); completed++)
+		{
+			ReadbackBuffer& buffer = m_Buffers[m_PendingBuffers[completed]];
+			if (vkGetFenceStatus(device, buffer.Fence) != VK_SUCCESS)
+				break;
+
+			if (!buffer.Coherent)
+			{
+				VkMappedMemoryRange range = {};
+				range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+				range.memory = buffer.Memory;
+				range.size = VK_WHOLE_SIZE;
+				VkResult err = vkInvalidateMappedMemoryRanges(device, 1, &range);
+				check_vk_result(err);
+			}
+
+			// Never full, it holds more than there are buffers
+			m_WriteQueue.Push(m_PendingBuffers[completed]);
+		}
+
+		if (completed == 0)
+			return;
+
+		m_PendingBuffers.erase(m_PendingBuffers.begin(), m_PendingBuffers.begin() + completed);
+		{
+			std::scoped_lock<std::mutex> lock(m_WriterMutex);
+		}
+		m_WriterCondition.notify_one();
+	}
+
+	FrameRecordingStatistics FrameRecorder::GetStatistics() const
+	{
+		FrameRecordingStatistics statistics;
+		statistics.CapturedFrames = m_CapturedFrames;
+		statistics.WrittenFrames = m_WrittenFrames;
+		statistics.DroppedFrames = m_DroppedFrames;
+		statistics.WriteFailed = m_WriteFailed;
+		return statistics;
+	}
+
+	void FrameRecorder::WriterLoop()
+	{
+		for (;;)
+		{
+			uint32_t index;
+			if (m_WriteQueue.Pop(index))
+			{
+				if (!m_WriteFailed)
+					WriteFrame(m_Buffers[index]);
+				m_ReturnQueue.Push(index);
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(m_WriterMutex);
+			if (!m_WriterRunning && m_WriteQueue.IsEmpty())
+				break;
+			m_WriterCondition.wait(lock, [this]() { return !m_WriterRunning || !m_WriteQueue.IsEmpty(); });
+		}
+	}
+
+	void FrameRecorder::WriteFrame(const ReadbackBuffer& buffer)
+	{
+		const size_t pixelCount = (size_t)buffer.Width * buffer.Height;
+
+		// Straight RGBA8 first, every format starts from it
+		m_WriteBuffer.resize(pixelCount * 4);
+		uint32_t* rgba = (uint32_t*)m_WriteBuffer.data();
+		if (buffer.BGRA)
+			PixelConversion::SwizzleRGBA8BGRA8((const uint32_t*)buffer.Mapped, rgba, pixelCount);
+		else
+			memcpy(rgba, buffer.Mapped, pixelCount * 4);
+		if (buffer.Opaque)
+		{
+			for (size_t i = 0; i < pixelCount; i++)
+				rgba[i] |= 0xff000000;
+		}
+
+		bool written = false;
+		switch (m_Specification.Format)
+		{
+			case FrameRecordingFormat::Y4M:
+			{
+				if (!m_File)
+				{
+					m_File = fopen(m_Specification.Path.c_str(), "wb");
+					if (m_File)
+						fprintf(m_File, "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C444\n", buffer.Width, buffer.Height, std::max(m_Specification.FrameRate, 1u));
+				}
+				if (!m_File)
+					break;
+
+				m_EncodeBuffer.resize(pixelCount * 3);
+				uint8_t* y = m_EncodeBuffer.data();
+				Utils::RGBA8ToYUV444(m_WriteBuffer.data(), y, y + pixelCount, y + pixelCount * 2, pixelCount);
+				written = fputs("FRAME\n", m_File) >= 0 && fwrite(m_EncodeBuffer.data(), 1, m_EncodeBuffer.size(), m_File) == m_EncodeBuffer.size();
+				break;
+			}
+			case FrameRecordingFormat::RawRGBA:
+			{
+				if (!m_File)
+					m_File = fopen(m_Specification.Path.c_str(), "wb");
+				if (!m_File)
+					break;
+
+				written = fwrite(m_WriteBuffer.data(), 1, m_WriteBuffer.size(), m_File) == m_WriteBuffer.size();
+				break;
+			}
+			case FrameRecordingFormat::PNGSequence:
+			{
+				char suffix[32];
+				snprintf(suffix, sizeof(suffix), "_%06llu.png", (unsigned long long)buffer.FrameNumber);
+				FILE* file = fopen((m_Specification.Path + suffix).c_str(), "wb");
+				if (!file)
+					break;
+				written = Utils::WriteRecordingPNG(file, m_EncodeBuffer, m_WriteBuffer.data(), buffer.Width, buffer.Height);
+				written &= fclose(file) == 0;
+				break;
+			}
+		}
+
+		if (written)
+		{
+			m_WrittenFrames++;
+		}
+		else
+		{
+			// Later frames are dropped as soon as they are captured
+			std::cerr << "FrameRecorder: could not write " << m_Specification.Path << "\n";
+			m_WriteFailed = true;
+		}
+	}
+
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+
+#include "Image.h"
+#include "SPSCQueue.h"
+
+namespace Walnut {
+
+	enum class FrameRecordingFormat : uint8_t
+	{
+		Y4M = 0,    // YUV 4:4:4, BT.601 limited range, eg. ffmpeg -i Recording.y4m Recording.mp4
+		RawRGBA,    // Frames back to back, eg. ffmpeg -f rawvideo -pixel_format rgba -video_size WxH -i Recording.rgba
+		PNGSequence // Path_000000.png, Path_000001.png, ... stored without compression to keep the writer fast
+	};
+
+	struct FrameRecordingSpecification
+	{
+		// The file for Y4M and RawRGBA, the prefix of the numbered files for PNGSequence (without its extension, if any).
+		// Empty records to Recording.y4m, Recording.rgba or Recording_000000.png, ...
+		std::string Path;
+		FrameRecordingFormat Format = FrameRecordingFormat::Y4M;
+
+		// Only written to the Y4M header, frames are stored as they were presented
+		uint32_t FrameRate = 60;
+
+		// Recorded instead of the main window when set
+		std::shared_ptr<Image> Source;
+
+		// Host readback buffers (2 to 32). A frame is dropped when all are waiting for the GPU or the writer
+		uint32_t ReadbackBufferCount = 4;
+	};
+
+	struct FrameRecordingStatistics
+	{
+		uint64_t CapturedFrames = 0; // Copies recorded on the GPU
+		uint64_t WrittenFrames = 0;
+		uint64_t DroppedFrames = 0;  // No free readback buffer, or a size change Y4M/RawRGBA can't follow
+		bool WriteFailed = false;
+	};
+
+	// Copies frames into a ring of host-visible buffers from the frame's own command buffer, picks each copy up once
+	// the fence of its frame has signaled and hands it to a writer thread. Nothing on the main thread waits for the
+	// GPU or the disk: frames are dropped instead. Created by Application::StartRecording
+	class FrameRecorder
+	{
+	public:
+		FrameRecorder(const FrameRecordingSpecification& specification);
+		~FrameRecorder();
+
+		FrameRecorder(const FrameRecorder&) = delete;
+		FrameRecorder& operator=(const FrameRecorder&) = delete;
+
+		// Records the copy of an RGBA8/BGRA8 image into commandBuffer, which must signal fence once executed. The image
+		// is returned to layout afterwards. Opaque frames get their alpha set to 1, eg. for the swapchain
+		void Capture(VkCommandBuffer commandBuffer, VkFence fence, VkImage image, VkFormat format, VkImageLayout layout, uint32_t width, uint32_t height, bool opaque);
+
+		// Hands the copies whose fence has signaled to the writer, without waiting. Called by Application every frame
+		void Collect();
+
+		// Waits for the copies in flight and for the writer to finish them, later captures are dropped
+		void Stop();
+
+		const FrameRecordingSpecification& GetSpecification() const { return m_Specification; }
+		FrameRecordingStatistics GetStatistics() const;
+	private:
+		struct ReadbackBuffer
+		{
+			VkBuffer Buffer = nullptr;
+			VkDeviceMemory Memory = nullptr;
+			void* Mapped = nullptr;
+			VkDeviceSize Size = 0;
+			bool Coherent = false;
+
+			// The frame last copied into it
+			VkFence Fence = nullptr;
+			uint32_t Width = 0, Height = 0;
+			bool BGRA = false;
+			bool Opaque = false;
+			uint64_t FrameNumber = 0;
+		};
+
+		void AllocateReadbackBuffer(ReadbackBuffer& buffer, VkDeviceSize size);
+		void ReleaseReadbackBuffer(ReadbackBuffer& buffer);
+
+		void WriterLoop();
+		void WriteFrame(const ReadbackBuffer& buffer);
+	private:
+		FrameRecordingSpecification m_Specification;
+
+		// Not resized after construction, an index is owned by either the main thread or the writer
+		std::vector<ReadbackBuffer> m_Buffers;
+		std::vector<uint32_t> m_FreeBuffers;
+		std::vector<uint32_t> m_PendingBuffers; // Copies waiting for their fence, oldest first
+
+		SPSCQueue<uint32_t, 32> m_WriteQueue;  // To the writer
+		SPSCQueue<uint32_t, 32> m_ReturnQueue; // Back from the writer
+
+		// Size of the first frame, the only one Y4M and RawRGBA can store
+		uint32_t m_FrameWidth = 0, m_FrameHeight = 0;
+		uint64_t m_FrameNumber = 0;
+
+		std::thread m_WriterThread;
+		std::mutex m_WriterMutex;
+		std::condition_variable m_WriterCondition;
+		bool m_WriterRunning = true;
+
+		// Writer thread only
+		FILE* m_File = nullptr;
+		std::vector<uint8_t> m_WriteBuffer;
+		std::vector<uint8_t> m_EncodeBuffer;
+
+		std::atomic<uint64_t> m_CapturedFrames = 0;
+		std::atomic<uint64_t> m_WrittenFrames = 0;
+		std::atomic<uint64_t> m_DroppedFrames = 0;
+		std::atomic<bool> m_WriteFailed = false;
+	};
+
+}
@@ -0,0 +1,60 @@
+#include "FrameTimeStatistics.h"
+
+#include "Clock.h"
+
+#include <algorithm>
+
+namespace Walnut {
+
+	FrameTimeHistory::FrameTimeHistory(uint32_t capacity)
+		: m_FrameTicks(std::max(capacity, 1u))
+	{
+	}
+
+	void FrameTimeHistory::Add(int64_t frameTicks)
+	{
+		m_FrameTicks[m_Next] = frameTicks;
+		m_Next = (m_Next + 1) % (uint32_t)m_FrameTicks.size();
+		m_Count = std::min(m_Count + 1, (uint32_t)m_FrameTicks.size());
+	}
+
+	void FrameTimeHistory::Clear()
+	{
+		m_Next = 0;
+		m_Count = 0;
+	}
+
+	FrameTimeStatistics FrameTimeHistory::Compute() const
+	{
+		FrameTimeStatistics statistics;
+		if (m_Count == 0)
+			return statistics;
+
+		// Until the window is full, the recorded frames are the first m_Count entries
+		std::vector<int64_t> sorted(m_FrameTicks.begin(), m_FrameTicks.begin() + m_Count);
+		std::sort(sorted.begin(), sorted.end());
+
+		auto percentile = [&sorted](double p)
+		{
+			size_t index = (size_t)(p * (double)(sorted.size() - 1) + 0.5);
+			return Clock::ToMillis(sorted[index]);
+		};
+
+		int64_t total = 0;
+		for (int64_t ticks : sorted)
+			total += ticks;
+
+		statistics.FrameCount = m_Count;
+		statistics.Mean = Clock::ToMillis(total) / m_Count;
+		statistics.P50 = percentile(0.50);
+		statistics.P95 = percentile(0.95);
+		statistics.P99 = percentile(0.99);
+		statistics.Max = Clock::ToMillis(sorted.back());
+
+		int64_t hitchTicks = (int64_t)((double)sorted[(sorted.size() - 1) / 2] * HitchFactor);
+		statistics.HitchCount = (uint32_t)(sorted.end() - std::upper_bound(sorted.begin(), sorted.end(), hitchTicks));
+
+		return statistics;
+	}
+
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+namespace Walnut {
+
+	// Over the last FrameTimeHistory::GetCapacity() frames, in milliseconds
+	struct FrameTimeStatistics
+	{
+		uint32_t FrameCount = 0;
+		double Mean = 0.0;
+		double P50 = 0.0, P95 = 0.0, P99 = 0.0;
+		double Max = 0.0;
+
+		// Frames longer than HitchFactor times the median
+		uint32_t HitchCount = 0;
+	};
+
+	// Rolling window of frame times in Clock ticks
+	class FrameTimeHistory
+	{
+	public:
+		static constexpr double HitchFactor = 2.0;
+
+		FrameTimeHistory(uint32_t capacity = 1024);
+
+		void Add(int64_t frameTicks);
+		void Clear();
+
+		// Sorts a copy of the window, call it when the statistics are shown rather than every frame
+		FrameTimeStatistics Compute() const;
+
+		uint32_t GetCapacity() const { return (uint32_t)m_FrameTicks.size(); }
+	private:
+		std::vector<int64_t> m_FrameTicks;
+		uint32_t m_Next = 0;
+		uint32_t m_Count = 0;
+	};
+
+}
@@ -0,0 +1,280 @@
+#include "GPUMemory.h"
+
+#include "imgui.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+
+namespace Walnut {
+
+	struct GPUAllocation
+	{
+		VkDeviceSize Size = 0;
+		uint32_t HeapIndex = 0;
+		GPUMemoryCategory Category = GPUMemoryCategory::Other;
+	};
+
+	static std::mutex s_GPUMemoryMutex;
+	static VkDevice s_Device = VK_NULL_HANDLE;
+	static VkPhysicalDevice s_PhysicalDevice = VK_NULL_HANDLE;
+	static const VkAllocationCallbacks* s_Allocator = nullptr;
+	static VkPhysicalDeviceMemoryProperties s_MemoryProperties = {};
+	static PFN_vkGetPhysicalDeviceMemoryProperties2KHR s_GetMemoryProperties2 = nullptr;
+
+	static std::unordered_map<VkDeviceMemory, GPUAllocation> s_Allocations;
+	static GPUMemoryStatistics s_Statistics;
+
+	static float s_BudgetThreshold = 0.9f;
+	static GPUMemory::BudgetCallback s_BudgetCallback;
+	static std::vector<bool> s_HeapOverThreshold;
+
+	namespace Utils {
+
+		static void FormatBytes(char* buffer, size_t bufferSize, VkDeviceSize bytes)
+		{
+			if (bytes >= (VkDeviceSize)1 << 30)
+				snprintf(buffer, bufferSize, "%.2f GiB", (double)bytes / (1 << 30));
+			else
+				snprintf(buffer, bufferSize, "%.1f MiB", (double)bytes / (1 << 20));
+		}
+
+	}
+
+	void GPUMemory::Init(VkInstance instance, VkPhysicalDevice physicalDevice, VkDevice device, const VkAllocationCallbacks* allocator, bool memoryBudgetEnabled)
+	{
+		std::scoped_lock<std::mutex> lock(s_GPUMemoryMutex);
+
+		s_Device = device;
+		s_PhysicalDevice = physicalDevice;
+		s_Allocator = allocator;
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &s_MemoryProperties);
+
+		if (memoryBudgetEnabled)
+			s_GetMemoryProperties2 = (PFN_vkGetPhysicalDeviceMemoryProperties2KHR)vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceMemoryProperties2KHR");
+
+		s_Statistics = GPUMemoryStatistics();
+		s_Statistics.MemoryBudgetSupported = s_GetMemoryProperties2 != nullptr;
+		s_Statistics.Heaps.resize(s_MemoryProperties.memoryHeapCount);
+		for (uint32_t i = 0; i < s_MemoryProperties.memoryHeapCount; i++)
+		{
+			const VkMemoryHeap& heap = s_MemoryProperties.memoryHeaps[i];
+			s_Statistics.Heaps[i].Size = heap.size;
+			s_Statistics.Heaps[i].DeviceLocal = heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+			s_Statistics.Heaps[i].Budget = heap.size / 10 * 8;
+		}
+		s_HeapOverThreshold.assign(s_MemoryProperties.memoryHeapCount, false);
+	}
+
+	void GPUMemory::Shutdown()
+	{
+		std::scoped_lock<std::mutex> lock(s_GPUMemoryMutex);
+
+		s_Allocations.clear();
+		s_BudgetCallback = nullptr;
+		s_GetMemoryProperties2 = nullptr;
+		s_Device = VK_NULL_HANDLE;
+		s_PhysicalDevice = VK_NULL_HANDLE;
+		s_Allocator = nullptr;
+	}
+
+	uint32_t GPUMemory::FindMemoryType(VkMemoryPropertyFlags properties, uint32_t typeBits)
+	{
+		for (uint32_t i = 0; i < s_MemoryProperties.memoryTypeCount; i++)
+		{
+			if ((s_MemoryProperties.memoryTypes[i].propertyFlags & properties) == properties && typeBits & (1 << i))
+				return i;
+		}
+
+		return 0xffffffff;
+	}
+
+	VkResult GPUMemory::Allocate(const VkMemoryAllocateInfo& allocateInfo, GPUMemoryCategory category, VkDeviceMemory* memory)
+	{
+		VkResult err = vkAllocateMemory(s_Device, &allocateInfo, s_Allocator, memory);
+		if (err == VK_SUCCESS)
+			Track(*memory, allocateInfo.allocationSize, allocateInfo.memoryTypeIndex, category);
+		return err;
+	}
+
+	void GPUMemory::Free(VkDeviceMemory memory)
+	{
+		if (!memory)
+			return;
+
+		Untrack(memory);
+		vkFreeMemory(s_Device, memory, s_Allocator);
+	}
+
+	void GPUMemory::Track(VkDeviceMemory memory, VkDeviceSize size, uint32_t memoryTypeIndex, GPUMemoryCategory category)
+	{
+		std::scoped_lock<std::mutex> lock(s_GPUMemoryMutex);
+
+		GPUAllocation allocation;
+		allocation.Size = size;
+		allocation.HeapIndex = s_MemoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+		allocation.Category = category;
+		s_Allocations[memory] = allocation;
+
+		GPUHeapStatistics& heap = s_Statistics.Heaps[allocation.HeapIndex];
+		heap.AllocatedBytes += size;
+		heap.AllocationCount++;
+
+		GPUCategoryStatistics& categoryStatistics = s_Statistics.Categories[(size_t)category];
+		categoryStatistics.AllocatedBytes += size;
+		categoryStatistics.AllocationCount++;
+	}
+
+	void GPUMemory::Untrack(VkDeviceMemory memory)
+	{
+		std::scoped_lock<std::mutex> lock(s_GPUMemoryMutex);
+
+		auto it = s_Allocations.find(memory);
+		if (it == s_Allocations.end())
+			return;
+
+		const GPUAllocation& allocation = it->second;
+
+		GPUHeapStatistics& heap = s_Statistics.Heaps[allocation.HeapIndex];
+		heap.AllocatedBytes -= allocation.Size;
+		heap.AllocationCount--;
+
+		GPUCategoryStatistics& categoryStatistics = s_Statistics.Categories[(size_t)allocation.Category];
+		categoryStatistics.AllocatedBytes -= allocation.Size;
+		categoryStatistics.AllocationCount--;
+
+		s_Allocations.erase(it);
+	}
+
+	void GPUMemory::Update()
+	{
+		std::vector<std::pair<uint32_t, GPUHeapStatistics>> crossed;
+		GPUMemory::BudgetCallback callback;
+
+		{
+			std::scoped_lock<std::mutex> lock(s_GPUMemoryMutex);
+
+			if (s_GetMemoryProperties2)
+			{
+				VkPhysicalDeviceMemoryBudgetPropertiesEXT budget = {};
+				budget.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+				VkPhysicalDeviceMemoryProperties2 properties = {};
+				properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+				properties.pNext = &budget;
+				s_GetMemoryProperties2(s_PhysicalDevice, &properties);
+
+				for (size_t i = 0; i < s_Statistics.Heaps.size(); i++)
+				{
+					s_Statistics.Heaps[i].Budget = budget.heapBudget[i];
+					s_Statistics.Heaps[i].Usage = budget.heapUsage[i];
+				}
+			}
+			else
+			{
+				for (GPUHeapStatistics& heap : s_Statistics.Heaps)
+					heap.Usage = heap.AllocatedBytes;
+			}
+
+			if (!s_BudgetCallback)
+				return;
+
+			for (size_t i = 0; i < s_Statistics.Heaps.size(); i++)
+			{
+				const GPUHeapStatistics& heap = s_Statistics.Heaps[i];
+				bool over = heap.Budget > 0 && (double)heap.Usage > (double)heap.Budget * s_BudgetThreshold;
+				if (over && !s_HeapOverThreshold[i])
+					crossed.emplace_back((uint32_t)i, heap);
+				s_HeapOverThreshold[i] = over;
+			}
+
+			if (!crossed.empty())
+				callback = s_BudgetCallback;
+		}
+
+		// Outside the lock, the callback is expected to free memory. The copy keeps SetBudgetCallback from racing with the call
+		for (auto& [heapIndex, heap] : crossed)
+			callback(heapIndex, heap);
+	}
+
+	GPUMemoryStatistics GPUMemory::GetStatistics()
+	{
+		std::scoped_lock<std::mutex> lock(s_GPUMemoryMutex);
+		return s_Statistics;
+	}
+
+	void GPUMemory::SetBudgetCallback(float threshold, const BudgetCallback& callback)
+	{
+		std::scoped_lock<std::mutex> lock(s_GPUMemoryMutex);
+		s_BudgetThreshold = threshold;
+		s_BudgetCallback = callback;
+		std::fill(s_HeapOverThreshold.begin(), s_HeapOverThreshold.end(), false);
+	}
+
+	void GPUMemory::DrawPanel(bool* open)
+	{
+		if (!ImGui::Begin("GPU Memory", open))
+		{
+			ImGui::End();
+			return;
+		}
+
+		GPUMemoryStatistics statistics = GetStatistics();
+		char used[32], budget[32], allocated[32];
+
+		ImGui::TextUnformatted(statistics.MemoryBudgetSupported ? "Budget: VK_EXT_memory_budget" : "Budget: estimated (80% of heap)");
+
+		for (size_t i = 0; i < statistics.Heaps.size(); i++)
+		{
+			const GPUHeapStatistics& heap = statistics.Heaps[i];
+			Utils::FormatBytes(used, sizeof(used), heap.Usage);
+			Utils::FormatBytes(budget, sizeof(budget), heap.Budget);
+			Utils::FormatBytes(allocated, sizeof(allocated), heap.AllocatedBytes);
+
+			ImGui::Separator();
+			ImGui::Text("Heap %d (%s)", (int)i, heap.DeviceLocal ? "device local" : "host");
+			char overlay[80];
+			snprintf(overlay, sizeof(overlay), "%s / %s", used, budget);
+			ImGui::ProgressBar(heap.Budget > 0 ? (float)((double)heap.Usage / heap.Budget) : 0.0f, ImVec2(-1.0f, 0.0f), overlay);
+			ImGui::Text("Walnut: %s in %u allocations", allocated, heap.AllocationCount);
+		}
+
+		ImGui::Separator();
+		if (ImGui::BeginTable("Categories", 3, ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV))
+		{
+			ImGui::TableSetupColumn("Category");
+			ImGui::TableSetupColumn("Size");
+			ImGui::TableSetupColumn("Allocations");
+			ImGui::TableHeadersRow();
+
+			for (size_t i = 0; i < (size_t)GPUMemoryCategory::Count; i++)
+			{
+				Utils::FormatBytes(allocated, sizeof(allocated), statistics.Categories[i].AllocatedBytes);
+
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn();
+				ImGui::TextUnformatted(GetCategoryName((GPUMemoryCategory)i));
+				ImGui::TableNextColumn();
+				ImGui::TextUnformatted(allocated);
+				ImGui::TableNextColumn();
+				ImGui::Text("%u", statistics.Categories[i].AllocationCount);
+			}
+			ImGui::EndTable();
+		}
+
+		ImGui::End();
+	}
+
+	const char* GPUMemory::GetCategoryName(GPUMemoryCategory category)
+	{
+		switch (category)
+		{
+			case GPUMemoryCategory::Image:   return "Images";
+			case GPUMemoryCategory::Staging: return "Staging";
+			case GPUMemoryCategory::ImGui:   return "ImGui";
+			case GPUMemoryCategory::Other:   return "Other";
+		}
+		return "Unknown";
+	}
+
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stdint.h>
+#include <functional>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+
+namespace Walnut {
+
+	enum class GPUMemoryCategory : uint8_t
+	{
+		Image = 0,
+		Staging,
+		ImGui, // Font texture and per-frame vertex/index buffers of the ImGui backend
+		Other,
+		Count
+	};
+
+	struct GPUHeapStatistics
+	{
+		VkDeviceSize Size = 0;
+		bool DeviceLocal = false;
+
+		// From VK_EXT_memory_budget when available. Otherwise Budget is 80% of the heap
+		// and Usage is what Walnut allocated
+		VkDeviceSize Budget = 0;
+		VkDeviceSize Usage = 0;
+
+		// Allocated through GPUMemory by this process
+		VkDeviceSize AllocatedBytes = 0;
+		uint32_t AllocationCount = 0;
+	};
+
+	struct GPUCategoryStatistics
+	{
+		VkDeviceSize AllocatedBytes = 0;
+		uint32_t AllocationCount = 0;
+	};
+
+	struct GPUMemoryStatistics
+	{
+		bool MemoryBudgetSupported = false;
+		std::vector<GPUHeapStatistics> Heaps;
+		GPUCategoryStatistics Categories[(size_t)GPUMemoryCategory::Count];
+	};
+
+	// Tracks the device memory allocated by Walnut per heap and per category, together with
+	// the driver's budget for each heap so tools sharing a GPU can back off before running out.
+	class GPUMemory
+	{
+	public:
+		using BudgetCallback = std::function<void(uint32_t heapIndex, const GPUHeapStatistics& heap)>;
+
+		// Called by Application once the device exists
+		static void Init(VkInstance instance, VkPhysicalDevice physicalDevice, VkDevice device, const VkAllocationCallbacks* allocator, bool memoryBudgetEnabled);
+		static void Shutdown();
+
+		// Memory properties are queried once in Init. 0xffffffff when no memory type matches
+		static uint32_t FindMemoryType(VkMemoryPropertyFlags properties, uint32_t typeBits);
+
+		// vkAllocateMemory/vkFreeMemory with tracking
+		static VkResult Allocate(const VkMemoryAllocateInfo& allocateInfo, GPUMemoryCategory category, VkDeviceMemory* memory);
+		static void Free(VkDeviceMemory memory);
+
+		// For memory allocated outside of Walnut, eg. by the ImGui backend
+		static void Track(VkDeviceMemory memory, VkDeviceSize size, uint32_t memoryTypeIndex, GPUMemoryCategory category);
+		static void Untrack(VkDeviceMemory memory);
+
+		// Refreshes the budget. Called by Application once per frame, which is also
+		// when the budget callback is invoked
+		static void Update();
+
+		static GPUMemoryStatistics GetStatistics();
+
+		// Called from Update when a heap's usage rises above threshold * budget,
+		// and again only once it has dropped back below
+		static void SetBudgetCallback(float threshold, const BudgetCallback& callback);
+
+		// ImGui window with the heaps and categories
+		static void DrawPanel(bool* open = nullptr);
+
+		static const char* GetCategoryName(GPUMemoryCategory category);
+	};
+
+}
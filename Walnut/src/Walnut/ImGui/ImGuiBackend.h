@@ -0,0 +1,77 @@
+#pragma once
+
+#include <vector>
+
+#include "vulkan/vulkan.h"
+
+struct ImGui_ImplVulkanH_Window;
+
+//
+// Walnut additions to the Dear ImGui backends that need their internal state,
+// implemented in ImGuiBuild.cpp next to the backend sources
+//
+
+namespace Walnut {
+
+	namespace ImGuiBackend {
+
+		// Queues the current font texture for destruction (once in-flight frames are done with it),
+		// so ImGui_ImplVulkan_CreateFontsTexture can upload a rebuilt atlas
+		void ReleaseFontsTexture();
+
+		// Recreates wd's swapchain at the new size without waiting for the device: the new swapchain replaces the old one
+		// through oldSwapchain, and the old swapchain, image views, framebuffers and semaphores are retired until wd has
+		// presented on the new one. The render pass and the per-image command pools are kept. The images can
+		// also be copied from where the surface supports it, returns their usage
+		VkImageUsageFlags ResizeWindow(ImGui_ImplVulkanH_Window* wd, int width, int height);
+
+		// Call after presenting wd, out of date included. Platform windows are marked by PresentPlatformWindows
+		void MarkSwapchainPresented(ImGui_ImplVulkanH_Window* wd);
+
+		// Hands the swapchains retired before their window's last present to Application::SubmitResourceFree.
+		// Call in a frame after that present, so they go once a later submission has completed
+		void ReleasePresentedSwapchains();
+
+		// Destroys every retired swapchain right away, once the device is idle
+		void ReleaseRetiredSwapchains();
+
+		// Reports the font texture created by ImGui_ImplVulkan_CreateFontsTexture to GPUMemory
+		void TrackFontsTexture();
+
+		// Brings GPUMemory up to date with the vertex/index buffers ImGui_ImplVulkan_RenderDrawData (re)allocated
+		// for every viewport, call once all windows have been rendered. Untrack before the backend shuts down
+		void TrackRenderBuffers();
+		void UntrackRenderBuffers();
+
+		// Vulkan work for every window of one frame, submitted with a single vkQueueSubmit
+		// and presented with a single vkQueuePresentKHR
+		struct FrameBatch
+		{
+			std::vector<VkSemaphore> WaitSemaphores;
+			std::vector<VkPipelineStageFlags> WaitStages;
+			std::vector<VkCommandBuffer> CommandBuffers;
+			std::vector<VkSemaphore> SignalSemaphores;
+
+			std::vector<VkSwapchainKHR> Swapchains;
+			std::vector<uint32_t> ImageIndices;
+			std::vector<VkResult> PresentResults;
+
+			// Secondary platform windows, parallel to Swapchains after the main window's entry
+			std::vector<void*> Viewports;
+
+			void Clear();
+		};
+
+		// Acquires and records every visible secondary platform window into batch, instead of
+		// ImGui::RenderPlatformWindowsDefault. Their command buffers are only reused once
+		// waitForSubmission has returned for the submission they last went out with. Hooks the renderer's
+		// DestroyWindow/SetWindowSize so that bookkeeping is dropped with the windows' frames
+		void RecordPlatformWindows(FrameBatch& batch, uint64_t submission, void(*waitForSubmission)(uint64_t));
+
+		// Advances the platform windows after the batch has been presented, recreating
+		// the swapchains that reported themselves out of date
+		void PresentPlatformWindows(FrameBatch& batch, uint32_t firstSwapchain);
+
+	}
+
+}
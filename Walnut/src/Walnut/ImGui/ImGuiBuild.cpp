@@ -1,2 +1,502 @@
 #include "backends/imgui_impl_vulkan.cpp"
-#include "backends/imgui_impl_glfw.cpp"
\ No newline at end of file
+#include "backends/imgui_impl_glfw.cpp"
+
+#include "ImGuiBackend.h"
+
+#include "Walnut/Application.h"
+#include "Walnut/GPUMemory.h"
+
+#include <functional>
+#include <unordered_map>
+
+namespace Walnut {
+
+	namespace ImGuiBackend {
+
+		// Submission each platform window frame last went out with, keyed by the frame's fence
+		static std::unordered_map<VkFence, uint64_t> s_PlatformFrameSubmissions;
+		static void (*s_RendererDestroyWindow)(ImGuiViewport* viewport) = nullptr;
+		static void (*s_RendererSetWindowSize)(ImGuiViewport* viewport, ImVec2 size) = nullptr;
+
+		// What ResizeWindow replaced, held until an image of its window's new swapchain has been presented
+		struct RetiredSwapchain
+		{
+			ImGui_ImplVulkanH_Window* Window = nullptr;
+			std::function<void()> Destroy;
+			bool Presented = false; // The window has presented since
+			bool Queued = false;    // Handed to Application::SubmitResourceFree
+		};
+
+		static std::unordered_map<uint64_t, RetiredSwapchain> s_RetiredSwapchains;
+		static uint64_t s_RetiredSwapchainCount = 0;
+
+		// Also reached from the resource free queue after the window has destroyed it, then nothing is left to do
+		static void DestroyRetiredSwapchain(uint64_t id)
+		{
+			auto it = s_RetiredSwapchains.find(id);
+			if (it == s_RetiredSwapchains.end())
+				return;
+			it->second.Destroy();
+			s_RetiredSwapchains.erase(it);
+		}
+
+		static void ForgetPlatformFrames(const ImGui_ImplVulkanH_Frame* frames, uint32_t begin, uint32_t end)
+		{
+			for (uint32_t i = begin; i < end; i++)
+				s_PlatformFrameSubmissions.erase(frames[i].Fence);
+		}
+
+		// Drops the destroyed window's entries, their fences are gone and the handles may be reused. Its retired
+		// swapchains go first, Vulkan requires them to be destroyed before the surface the backend destroys
+		static void DestroyPlatformWindow(ImGuiViewport* viewport)
+		{
+			if (ImGui_ImplVulkan_ViewportData* vd = (ImGui_ImplVulkan_ViewportData*)viewport->RendererUserData)
+			{
+				ForgetPlatformFrames(vd->Window.Frames, 0, vd->Window.ImageCount);
+
+				std::vector<uint64_t> retired;
+				for (auto& [id, swapchain] : s_RetiredSwapchains)
+				{
+					if (swapchain.Window == &vd->Window)
+						retired.push_back(id);
+				}
+				if (!retired.empty())
+				{
+					// The backend waits for the device itself right after, the window is gone anyway
+					vkDeviceWaitIdle(ImGui_ImplVulkan_GetBackendData()->VulkanInitInfo.Device);
+					for (uint64_t id : retired)
+						DestroyRetiredSwapchain(id);
+				}
+			}
+			s_RendererDestroyWindow(viewport);
+		}
+
+		// The backend recreates every frame of a window it resizes, fences included
+		static void SetPlatformWindowSize(ImGuiViewport* viewport, ImVec2 size)
+		{
+			if (ImGui_ImplVulkan_ViewportData* vd = (ImGui_ImplVulkan_ViewportData*)viewport->RendererUserData)
+				ForgetPlatformFrames(vd->Window.Frames, 0, vd->Window.ImageCount);
+			s_RendererSetWindowSize(viewport, size);
+		}
+
+		void ReleaseFontsTexture()
+		{
+			ImGui_ImplVulkan_Data* bd = ImGui_ImplVulkan_GetBackendData();
+			ImGui_ImplVulkan_InitInfo* v = &bd->VulkanInitInfo;
+
+			Application::SubmitResourceFree([device = v->Device, allocator = v->Allocator, descriptorPool = v->DescriptorPool,
+				descriptorSet = bd->FontDescriptorSet, view = bd->FontView, image = bd->FontImage, memory = bd->FontMemory]()
+			{
+				if (descriptorSet)
+					vkFreeDescriptorSets(device, descriptorPool, 1, &descriptorSet);
+				vkDestroyImageView(device, view, allocator);
+				vkDestroyImage(device, image, allocator);
+				GPUMemory::Untrack(memory);
+				vkFreeMemory(device, memory, allocator);
+			});
+
+			bd->FontDescriptorSet = VK_NULL_HANDLE;
+			bd->FontView = VK_NULL_HANDLE;
+			bd->FontImage = VK_NULL_HANDLE;
+			bd->FontMemory = VK_NULL_HANDLE;
+			ImGui::GetIO().Fonts->SetTexID(0);
+		}
+
+		void TrackFontsTexture()
+		{
+			ImGui_ImplVulkan_Data* bd = ImGui_ImplVulkan_GetBackendData();
+			ImGui_ImplVulkan_InitInfo* v = &bd->VulkanInitInfo;
+
+			VkMemoryRequirements req;
+			vkGetImageMemoryRequirements(v->Device, bd->FontImage, &req);
+			GPUMemory::Track(bd->FontMemory, req.size, ImGui_ImplVulkan_MemoryType(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, req.memoryTypeBits), GPUMemoryCategory::ImGui);
+		}
+
+		// Vertex/index buffer memory of every viewport, as last reported to GPUMemory
+		static std::unordered_map<VkDeviceMemory, VkDeviceSize> s_TrackedRenderBuffers;
+
+		void TrackRenderBuffers()
+		{
+			ImGui_ImplVulkan_Data* bd = ImGui_ImplVulkan_GetBackendData();
+			ImGui_ImplVulkan_InitInfo* v = &bd->VulkanInitInfo;
+			ImGuiPlatformIO& platform_io = ImGui::GetPlatformIO();
+
+			static std::unordered_map<VkDeviceMemory, VkDeviceSize> s_Current;
+			s_Current.clear();
+
+			auto track = [&](VkDeviceMemory memory, VkDeviceSize size, VkBuffer buffer)
+			{
+				if (memory == VK_NULL_HANDLE)
+					return;
+
+				s_Current[memory] = size;
+				auto it = s_TrackedRenderBuffers.find(memory);
+				if (it != s_TrackedRenderBuffers.end() && it->second == size)
+					return;
+
+				// Grown buffers are reallocated, a freed handle may come back for the new memory
+				if (it != s_TrackedRenderBuffers.end())
+					GPUMemory::Untrack(memory);
+
+				VkMemoryRequirements req;
+				vkGetBufferMemoryRequirements(v->Device, buffer, &req);
+				GPUMemory::Track(memory, size, ImGui_ImplVulkan_MemoryType(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, req.memoryTypeBits), GPUMemoryCategory::ImGui);
+			};
+
+			for (int i = 0; i < platform_io.Viewports.Size; i++)
+			{
+				ImGui_ImplVulkan_ViewportData* vd = (ImGui_ImplVulkan_ViewportData*)platform_io.Viewports[i]->RendererUserData;
+				if (!vd)
+					continue;
+
+				ImGui_ImplVulkanH_WindowRenderBuffers* wrb = &vd->RenderBuffers;
+				for (uint32_t frame = 0; frame < wrb->Count; frame++)
+				{
+					ImGui_ImplVulkanH_FrameRenderBuffers* frb = &wrb->FrameRenderBuffers[frame];
+					track(frb->VertexBufferMemory, frb->VertexBufferSize, frb->VertexBuffer);
+					track(frb->IndexBufferMemory, frb->IndexBufferSize, frb->IndexBuffer);
+				}
+			}
+
+			// Freed by the backend when it grew them or destroyed their window
+			for (auto& [memory, size] : s_TrackedRenderBuffers)
+			{
+				if (s_Current.find(memory) == s_Current.end())
+					GPUMemory::Untrack(memory);
+			}
+			std::swap(s_TrackedRenderBuffers, s_Current);
+		}
+
+		void UntrackRenderBuffers()
+		{
+			for (auto& [memory, size] : s_TrackedRenderBuffers)
+				GPUMemory::Untrack(memory);
+			s_TrackedRenderBuffers.clear();
+		}
+
+		VkImageUsageFlags ResizeWindow(ImGui_ImplVulkanH_Window* wd, int width, int height)
+		{
+			ImGui_ImplVulkan_Data* bd = ImGui_ImplVulkan_GetBackendData();
+			ImGui_ImplVulkan_InitInfo* v = &bd->VulkanInitInfo;
+			VkResult err;
+
+			VkSwapchainKHR old_swapchain = wd->Swapchain;
+			uint32_t old_image_count = wd->ImageCount;
+			ImGui_ImplVulkanH_Frame* old_frames = wd->Frames;
+			ImGui_ImplVulkanH_FrameSemaphores* old_semaphores = wd->FrameSemaphores;
+
+			// Same surface format and present mode, so the render pass stays compatible
+			VkImageUsageFlags usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+			{
+				VkSurfaceCapabilitiesKHR cap;
+				err = vkGetPhysicalDeviceSurfaceCapabilitiesKHR(v->PhysicalDevice, wd->Surface, &cap);
+				check_vk_result(err);
+
+				VkSwapchainCreateInfoKHR info = {};
+				info.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+				info.surface = wd->Surface;
+				info.minImageCount = v->MinImageCount;
+				info.imageFormat = wd->SurfaceFormat.format;
+				info.imageColorSpace = wd->SurfaceFormat.colorSpace;
+				info.imageArrayLayers = 1;
+				info.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+				info.preTransform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
+				info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+				info.presentMode = wd->PresentMode;
+				info.clipped = VK_TRUE;
+				info.oldSwapchain = old_swapchain;
+				usage |= cap.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT; // For FrameRecorder
+				info.imageUsage = usage;
+				if (info.minImageCount < cap.minImageCount)
+					info.minImageCount = cap.minImageCount;
+				else if (cap.maxImageCount != 0 && info.minImageCount > cap.maxImageCount)
+					info.minImageCount = cap.maxImageCount;
+
+				if (cap.currentExtent.width == 0xffffffff)
+				{
+					info.imageExtent.width = wd->Width = width;
+					info.imageExtent.height = wd->Height = height;
+				}
+				else
+				{
+					info.imageExtent.width = wd->Width = cap.currentExtent.width;
+					info.imageExtent.height = wd->Height = cap.currentExtent.height;
+				}
+				err = vkCreateSwapchainKHR(v->Device, &info, v->Allocator, &wd->Swapchain);
+				check_vk_result(err);
+			}
+
+			err = vkGetSwapchainImagesKHR(v->Device, wd->Swapchain, &wd->ImageCount, NULL);
+			check_vk_result(err);
+			VkImage backbuffers[16] = {};
+			IM_ASSERT(wd->ImageCount <= IM_ARRAYSIZE(backbuffers));
+			err = vkGetSwapchainImagesKHR(v->Device, wd->Swapchain, &wd->ImageCount, backbuffers);
+			check_vk_result(err);
+
+			wd->Frames = (ImGui_ImplVulkanH_Frame*)IM_ALLOC(sizeof(ImGui_ImplVulkanH_Frame) * wd->ImageCount);
+			wd->FrameSemaphores = (ImGui_ImplVulkanH_FrameSemaphores*)IM_ALLOC(sizeof(ImGui_ImplVulkanH_FrameSemaphores) * wd->ImageCount);
+			memset(wd->Frames, 0, sizeof(wd->Frames[0]) * wd->ImageCount);
+			memset(wd->FrameSemaphores, 0, sizeof(wd->FrameSemaphores[0]) * wd->ImageCount);
+			wd->FrameIndex = 0;
+			wd->SemaphoreIndex = 0;
+
+			for (uint32_t i = 0; i < wd->ImageCount; i++)
+			{
+				ImGui_ImplVulkanH_Frame* fd = &wd->Frames[i];
+				fd->Backbuffer = backbuffers[i];
+
+				// Command pools (and fences, which platform windows still wait on) are kept for the images both
+				// swapchains have, only an image count that grew needs new ones
+				if (i < old_image_count)
+				{
+					fd->CommandPool = old_frames[i].CommandPool;
+					fd->CommandBuffer = old_frames[i].CommandBuffer;
+					fd->Fence = old_frames[i].Fence;
+				}
+				else
+				{
+					{
+						VkCommandPoolCreateInfo info = {};
+						info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+						info.queueFamilyIndex = v->QueueFamily;
+						err = vkCreateCommandPool(v->Device, &info, v->Allocator, &fd->CommandPool);
+						check_vk_result(err);
+					}
+					{
+						VkCommandBufferAllocateInfo info = {};
+						info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+						info.commandPool = fd->CommandPool;
+						info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+						info.commandBufferCount = 1;
+						err = vkAllocateCommandBuffers(v->Device, &info, &fd->CommandBuffer);
+						check_vk_result(err);
+					}
+					{
+						VkFenceCreateInfo info = {};
+						info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+						info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+						err = vkCreateFence(v->Device, &info, v->Allocator, &fd->Fence);
+						check_vk_result(err);
+					}
+				}
+
+				{
+					VkImageViewCreateInfo info = {};
+					info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+					info.image = fd->Backbuffer;
+					info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+					info.format = wd->SurfaceFormat.format;
+					info.components = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A };
+					info.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+					err = vkCreateImageView(v->Device, &info, v->Allocator, &fd->BackbufferView);
+					check_vk_result(err);
+				}
+				{
+					VkFramebufferCreateInfo info = {};
+					info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+					info.renderPass = wd->RenderPass;
+					info.attachmentCount = 1;
+					info.pAttachments = &fd->BackbufferView;
+					info.width = wd->Width;
+					info.height = wd->Height;
+					info.layers = 1;
+					err = vkCreateFramebuffer(v->Device, &info, v->Allocator, &fd->Framebuffer);
+					check_vk_result(err);
+				}
+
+				// New ones, a present of the old swapchain may still be waiting on the old render complete semaphores
+				{
+					ImGui_ImplVulkanH_FrameSemaphores* fsd = &wd->FrameSemaphores[i];
+					VkSemaphoreCreateInfo info = {};
+					info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+					err = vkCreateSemaphore(v->Device, &info, v->Allocator, &fsd->ImageAcquiredSemaphore);
+					check_vk_result(err);
+					err = vkCreateSemaphore(v->Device, &info, v->Allocator, &fsd->RenderCompleteSemaphore);
+					check_vk_result(err);
+				}
+			}
+
+			// The fences of images the new swapchain no longer has are destroyed with the old frames
+			ForgetPlatformFrames(old_frames, wd->ImageCount, old_image_count);
+
+			// Frames in flight may still render to the old images, and presents queued on the old swapchain may still be
+			// waiting on its render complete semaphores, which only a present on the new swapchain is ordered after
+			RetiredSwapchain& retired = s_RetiredSwapchains[++s_RetiredSwapchainCount];
+			retired.Window = wd;
+			retired.Destroy = [device = v->Device, allocator = v->Allocator, image_count = wd->ImageCount,
+				old_swapchain, old_image_count, old_frames, old_semaphores]()
+			{
+				for (uint32_t i = 0; i < old_image_count; i++)
+				{
+					ImGui_ImplVulkanH_Frame* fd = &old_frames[i];
+					if (i >= image_count)
+					{
+						vkDestroyFence(device, fd->Fence, allocator);
+						vkFreeCommandBuffers(device, fd->CommandPool, 1, &fd->CommandBuffer);
+						vkDestroyCommandPool(device, fd->CommandPool, allocator);
+					}
+					vkDestroyFramebuffer(device, fd->Framebuffer, allocator);
+					vkDestroyImageView(device, fd->BackbufferView, allocator);
+					vkDestroySemaphore(device, old_semaphores[i].ImageAcquiredSemaphore, allocator);
+					vkDestroySemaphore(device, old_semaphores[i].RenderCompleteSemaphore, allocator);
+				}
+				IM_FREE(old_frames);
+				IM_FREE(old_semaphores);
+				vkDestroySwapchainKHR(device, old_swapchain, allocator);
+			};
+
+			return usage;
+		}
+
+		void MarkSwapchainPresented(ImGui_ImplVulkanH_Window* wd)
+		{
+			for (auto& [id, swapchain] : s_RetiredSwapchains)
+			{
+				if (swapchain.Window == wd)
+					swapchain.Presented = true;
+			}
+		}
+
+		void ReleasePresentedSwapchains()
+		{
+			for (auto& [id, swapchain] : s_RetiredSwapchains)
+			{
+				if (!swapchain.Presented || swapchain.Queued)
+					continue;
+				swapchain.Queued = true;
+				Application::SubmitResourceFree([id = id]() { DestroyRetiredSwapchain(id); });
+			}
+		}
+
+		void ReleaseRetiredSwapchains()
+		{
+			for (auto& [id, swapchain] : s_RetiredSwapchains)
+				swapchain.Destroy();
+			s_RetiredSwapchains.clear();
+		}
+
+		void FrameBatch::Clear()
+		{
+			WaitSemaphores.clear();
+			WaitStages.clear();
+			CommandBuffers.clear();
+			SignalSemaphores.clear();
+			Swapchains.clear();
+			ImageIndices.clear();
+			PresentResults.clear();
+			Viewports.clear();
+		}
+
+		void RecordPlatformWindows(FrameBatch& batch, uint64_t submission, void(*waitForSubmission)(uint64_t))
+		{
+			ImGui_ImplVulkan_Data* bd = ImGui_ImplVulkan_GetBackendData();
+			ImGui_ImplVulkan_InitInfo* v = &bd->VulkanInitInfo;
+			ImGuiPlatformIO& platform_io = ImGui::GetPlatformIO();
+			VkResult err;
+
+			// Installed over the backend's once per ImGui context, so entries never outlive their window's fences
+			if (platform_io.Renderer_DestroyWindow != DestroyPlatformWindow)
+			{
+				s_RendererDestroyWindow = platform_io.Renderer_DestroyWindow;
+				platform_io.Renderer_DestroyWindow = DestroyPlatformWindow;
+				s_RendererSetWindowSize = platform_io.Renderer_SetWindowSize;
+				platform_io.Renderer_SetWindowSize = SetPlatformWindowSize;
+			}
+
+			for (int i = 1; i < platform_io.Viewports.Size; i++)
+			{
+				ImGuiViewport* viewport = platform_io.Viewports[i];
+				if (viewport->Flags & ImGuiViewportFlags_Minimized)
+					continue;
+				if (platform_io.Platform_RenderWindow)
+					platform_io.Platform_RenderWindow(viewport, nullptr);
+
+				ImGui_ImplVulkan_ViewportData* vd = (ImGui_ImplVulkan_ViewportData*)viewport->RendererUserData;
+				ImGui_ImplVulkanH_Window* wd = &vd->Window;
+				ImGui_ImplVulkanH_FrameSemaphores* fsd = &wd->FrameSemaphores[wd->SemaphoreIndex];
+
+				err = vkAcquireNextImageKHR(v->Device, wd->Swapchain, UINT64_MAX, fsd->ImageAcquiredSemaphore, VK_NULL_HANDLE, &wd->FrameIndex);
+				if (err == VK_ERROR_OUT_OF_DATE_KHR)
+				{
+					// Skipped this frame, nothing waits on the semaphore
+					ResizeWindow(wd, (int)viewport->Size.x, (int)viewport->Size.y);
+					continue;
+				}
+				if (err != VK_SUBOPTIMAL_KHR)
+					check_vk_result(err);
+
+				ImGui_ImplVulkanH_Frame* fd = &wd->Frames[wd->FrameIndex];
+
+				// The frame's own fence is only signaled by ImGui::RenderPlatformWindowsDefault,
+				// batched submissions are tracked by the main window's fences
+				err = vkWaitForFences(v->Device, 1, &fd->Fence, VK_TRUE, UINT64_MAX);
+				check_vk_result(err);
+				auto it = s_PlatformFrameSubmissions.find(fd->Fence);
+				if (it != s_PlatformFrameSubmissions.end())
+					waitForSubmission(it->second);
+				s_PlatformFrameSubmissions[fd->Fence] = submission;
+
+				{
+					err = vkResetCommandPool(v->Device, fd->CommandPool, 0);
+					check_vk_result(err);
+					VkCommandBufferBeginInfo info = {};
+					info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+					info.flags |= VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+					err = vkBeginCommandBuffer(fd->CommandBuffer, &info);
+					check_vk_result(err);
+				}
+				{
+					ImVec4 clear_color = ImVec4(0.0f, 0.0f, 0.0f, 1.0f);
+					memcpy(&wd->ClearValue.color.float32[0], &clear_color, 4 * sizeof(float));
+
+					VkRenderPassBeginInfo info = {};
+					info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+					info.renderPass = wd->RenderPass;
+					info.framebuffer = fd->Framebuffer;
+					info.renderArea.extent.width = wd->Width;
+					info.renderArea.extent.height = wd->Height;
+					info.clearValueCount = (viewport->Flags & ImGuiViewportFlags_NoRendererClear) ? 0 : 1;
+					info.pClearValues = (viewport->Flags & ImGuiViewportFlags_NoRendererClear) ? NULL : &wd->ClearValue;
+					vkCmdBeginRenderPass(fd->CommandBuffer, &info, VK_SUBPASS_CONTENTS_INLINE);
+				}
+
+				ImGui_ImplVulkan_RenderDrawData(viewport->DrawData, fd->CommandBuffer, wd->Pipeline);
+
+				vkCmdEndRenderPass(fd->CommandBuffer);
+				err = vkEndCommandBuffer(fd->CommandBuffer);
+				check_vk_result(err);
+
+				batch.WaitSemaphores.push_back(fsd->ImageAcquiredSemaphore);
+				batch.WaitStages.push_back(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+				batch.CommandBuffers.push_back(fd->CommandBuffer);
+				batch.SignalSemaphores.push_back(fsd->RenderCompleteSemaphore);
+				batch.Swapchains.push_back(wd->Swapchain);
+				batch.ImageIndices.push_back(wd->FrameIndex);
+				batch.Viewports.push_back(viewport);
+			}
+		}
+
+		void PresentPlatformWindows(FrameBatch& batch, uint32_t firstSwapchain)
+		{
+			for (size_t i = 0; i < batch.Viewports.size(); i++)
+			{
+				ImGuiViewport* viewport = (ImGuiViewport*)batch.Viewports[i];
+				ImGui_ImplVulkan_ViewportData* vd = (ImGui_ImplVulkan_ViewportData*)viewport->RendererUserData;
+				ImGui_ImplVulkanH_Window* wd = &vd->Window;
+
+				// Out of date still waits on the semaphores
+				MarkSwapchainPresented(wd);
+
+				VkResult err = batch.PresentResults[firstSwapchain + i];
+				if (err == VK_ERROR_OUT_OF_DATE_KHR || err == VK_SUBOPTIMAL_KHR)
+					ResizeWindow(wd, (int)viewport->Size.x, (int)viewport->Size.y);
+				else
+					check_vk_result(err);
+
+				wd->SemaphoreIndex = (wd->SemaphoreIndex + 1) % wd->ImageCount; // Now we can use the next set of semaphores
+			}
+		}
+
+	}
+
+}
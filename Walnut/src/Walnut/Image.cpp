@@ -4,6 +4,7 @@
 #include "backends/imgui_impl_vulkan.h"
 
 #include "Application.h"
+#include "GPUMemory.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
@@ -12,20 +13,12 @@ namespace Walnut {
 
 	namespace Utils {
 
-		static uint32_t GetVulkanMemoryType(VkMemoryPropertyFlags properties, uint32_t type_bits)
+		uint32_t GetVulkanMemoryType(VkMemoryPropertyFlags properties, uint32_t type_bits)
 		{
-			VkPhysicalDeviceMemoryProperties prop;
-			vkGetPhysicalDeviceMemoryProperties(Application::GetPhysicalDevice(), &prop);
-			for (uint32_t i = 0; i < prop.memoryTypeCount; i++)
-			{
-				if ((prop.memoryTypes[i].propertyFlags & properties) == properties && type_bits & (1 << i))
-					return i;
-			}
-			
-			return 0xffffffff;
+			return GPUMemory::FindMemoryType(properties, type_bits);
 		}
 
-		static uint32_t BytesPerPixel(ImageFormat format)
+		uint32_t BytesPerPixel(ImageFormat format)
 		{
 			switch (format)
 			{
@@ -35,7 +28,7 @@ namespace Walnut {
 			return 0;
 		}
 		
-		static VkFormat WalnutFormatToVulkanFormat(ImageFormat format)
+		VkFormat WalnutFormatToVulkanFormat(ImageFormat format)
 		{
 			switch (format)
 			{
@@ -47,8 +40,8 @@ namespace Walnut {
 
 	}
 
-	Image::Image(std::string_view path)
-		: m_Filepath(path)
+	Image::Image(std::string_view path, const SamplerSpecification& samplerSpecification)
+		: m_Filepath(path), m_SamplerSpecification(samplerSpecification)
 	{
 		int width, height, channels;
 		uint8_t* data = nullptr;
@@ -72,8 +65,8 @@ namespace Walnut {
 		stbi_image_free(data);
 	}
 
-	Image::Image(uint32_t width, uint32_t height, ImageFormat format, const void* data)
-		: m_Width(width), m_Height(height), m_Format(format)
+	Image::Image(uint32_t width, uint32_t height, ImageFormat format, const void* data, const SamplerSpecification& samplerSpecification)
+		: m_Width(width), m_Height(height), m_Format(format), m_SamplerSpecification(samplerSpecification)
 	{
 		AllocateMemory(m_Width * m_Height * Utils::BytesPerPixel(m_Format));
 		if (data)
@@ -106,10 +99,10 @@ namespace Walnut {
 			info.arrayLayers = 1;
 			info.samples = VK_SAMPLE_COUNT_1_BIT;
 			info.tiling = VK_IMAGE_TILING_OPTIMAL;
-			info.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+			info.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT; // Source for FrameRecorder
 			info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 			info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-			err = vkCreateImage(device, &info, nullptr, &m_Image);
+			err = vkCreateImage(device, &info, Application::GetAllocator(), &m_Image);
 			check_vk_result(err);
 			VkMemoryRequirements req;
 			vkGetImageMemoryRequirements(device, m_Image, &req);
@@ -117,7 +110,7 @@ namespace Walnut {
 			alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
 			alloc_info.allocationSize = req.size;
 			alloc_info.memoryTypeIndex = Utils::GetVulkanMemoryType(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, req.memoryTypeBits);
-			err = vkAllocateMemory(device, &alloc_info, nullptr, &m_Memory);
+			err = GPUMemory::Allocate(alloc_info, GPUMemoryCategory::Image, &m_Memory);
 			check_vk_result(err);
 			err = vkBindImageMemory(device, m_Image, m_Memory, 0);
 			check_vk_result(err);
@@ -133,47 +126,94 @@ namespace Walnut {
 			info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 			info.subresourceRange.levelCount = 1;
 			info.subresourceRange.layerCount = 1;
-			err = vkCreateImageView(device, &info, nullptr, &m_ImageView);
+			err = vkCreateImageView(device, &info, Application::GetAllocator(), &m_ImageView);
 			check_vk_result(err);
 		}
 
-		// Create sampler:
+		// Borrow a shared sampler:
+		m_Sampler = SamplerCache::Get(m_SamplerSpecification);
+
+		// Create the Descriptor Set:
+		m_DescriptorSet = (VkDescriptorSet)ImGui_ImplVulkan_AddTexture(m_Sampler, m_ImageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+		if (m_DisplaySpecification.Tonemap && m_Format == ImageFormat::RGBA32F)
+			AllocateDisplayImage();
+	}
+
+	void Image::AllocateDisplayImage()
+	{
+		VkDevice device = Application::GetDevice();
+
+		VkResult err;
+
+		// Create the Display Image, written by the tonemap pass and sampled by ImGui
 		{
-			VkSamplerCreateInfo info = {};
-			info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-			info.magFilter = VK_FILTER_LINEAR;
-			info.minFilter = VK_FILTER_LINEAR;
-			info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-			info.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-			info.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-			info.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-			info.minLod = -1000;
-			info.maxLod = 1000;
-			info.maxAnisotropy = 1.0f;
-			VkResult err = vkCreateSampler(device, &info, nullptr, &m_Sampler);
+			VkImageCreateInfo info = {};
+			info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+			info.imageType = VK_IMAGE_TYPE_2D;
+			info.format = VK_FORMAT_R8G8B8A8_UNORM;
+			info.extent.width = m_Width;
+			info.extent.height = m_Height;
+			info.extent.depth = 1;
+			info.mipLevels = 1;
+			info.arrayLayers = 1;
+			info.samples = VK_SAMPLE_COUNT_1_BIT;
+			info.tiling = VK_IMAGE_TILING_OPTIMAL;
+			info.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+			info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			err = vkCreateImage(device, &info, Application::GetAllocator(), &m_DisplayImage);
+			check_vk_result(err);
+			VkMemoryRequirements req;
+			vkGetImageMemoryRequirements(device, m_DisplayImage, &req);
+			VkMemoryAllocateInfo alloc_info = {};
+			alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+			alloc_info.allocationSize = req.size;
+			alloc_info.memoryTypeIndex = Utils::GetVulkanMemoryType(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, req.memoryTypeBits);
+			err = GPUMemory::Allocate(alloc_info, GPUMemoryCategory::Image, &m_DisplayMemory);
+			check_vk_result(err);
+			err = vkBindImageMemory(device, m_DisplayImage, m_DisplayMemory, 0);
 			check_vk_result(err);
 		}
 
-		// Create the Descriptor Set:
-		m_DescriptorSet = (VkDescriptorSet)ImGui_ImplVulkan_AddTexture(m_Sampler, m_ImageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		{
+			VkImageViewCreateInfo info = {};
+			info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+			info.image = m_DisplayImage;
+			info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			info.format = VK_FORMAT_R8G8B8A8_UNORM;
+			info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			info.subresourceRange.levelCount = 1;
+			info.subresourceRange.layerCount = 1;
+			err = vkCreateImageView(device, &info, Application::GetAllocator(), &m_DisplayImageView);
+			check_vk_result(err);
+		}
+
+		// The pass reads texels directly, so the source sampler's filtering does not matter
+		m_TonemapDescriptorSet = TonemapPass::AllocateDescriptorSet(SamplerCache::Get(SamplerSpecification::Nearest()), m_ImageView, m_DisplayImageView);
+		m_DisplayDescriptorSet = (VkDescriptorSet)ImGui_ImplVulkan_AddTexture(m_Sampler, m_DisplayImageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 	}
 
 	void Image::Release()
 	{
-		Application::SubmitResourceFree([sampler = m_Sampler, imageView = m_ImageView, image = m_Image,
+		ReleaseDisplayImage();
+
+		Application::SubmitResourceFree([descriptorSet = m_DescriptorSet, imageView = m_ImageView, image = m_Image,
 			memory = m_Memory, stagingBuffer = m_StagingBuffer, stagingBufferMemory = m_StagingBufferMemory]()
 		{
 			VkDevice device = Application::GetDevice();
 
-			vkDestroySampler(device, sampler, nullptr);
-			vkDestroyImageView(device, imageView, nullptr);
-			vkDestroyImage(device, image, nullptr);
-			vkFreeMemory(device, memory, nullptr);
-			vkDestroyBuffer(device, stagingBuffer, nullptr);
-			vkFreeMemory(device, stagingBufferMemory, nullptr);
+			if (descriptorSet)
+				vkFreeDescriptorSets(device, Application::GetDescriptorPool(), 1, &descriptorSet);
+			vkDestroyImageView(device, imageView, Application::GetAllocator());
+			vkDestroyImage(device, image, Application::GetAllocator());
+			GPUMemory::Free(memory);
+			vkDestroyBuffer(device, stagingBuffer, Application::GetAllocator());
+			GPUMemory::Free(stagingBufferMemory);
 		});
 
 		m_Sampler = nullptr;
+		m_DescriptorSet = nullptr;
 		m_ImageView = nullptr;
 		m_Image = nullptr;
 		m_Memory = nullptr;
@@ -181,6 +221,30 @@ namespace Walnut {
 		m_StagingBufferMemory = nullptr;
 	}
 
+	void Image::ReleaseDisplayImage()
+	{
+		if (!m_DisplayImage)
+			return;
+
+		Application::SubmitResourceFree([displayDescriptorSet = m_DisplayDescriptorSet, tonemapDescriptorSet = m_TonemapDescriptorSet,
+			imageView = m_DisplayImageView, image = m_DisplayImage, memory = m_DisplayMemory]()
+		{
+			VkDevice device = Application::GetDevice();
+
+			VkDescriptorSet descriptorSets[] = { displayDescriptorSet, tonemapDescriptorSet };
+			vkFreeDescriptorSets(device, Application::GetDescriptorPool(), 2, descriptorSets);
+			vkDestroyImageView(device, imageView, Application::GetAllocator());
+			vkDestroyImage(device, image, Application::GetAllocator());
+			GPUMemory::Free(memory);
+		});
+
+		m_DisplayDescriptorSet = nullptr;
+		m_TonemapDescriptorSet = nullptr;
+		m_DisplayImageView = nullptr;
+		m_DisplayImage = nullptr;
+		m_DisplayMemory = nullptr;
+	}
+
 	void Image::SetData(const void* data)
 	{
 		VkDevice device = Application::GetDevice();
@@ -198,7 +262,7 @@ namespace Walnut {
 				buffer_info.size = upload_size;
 				buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
 				buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-				err = vkCreateBuffer(device, &buffer_info, nullptr, &m_StagingBuffer);
+				err = vkCreateBuffer(device, &buffer_info, Application::GetAllocator(), &m_StagingBuffer);
 				check_vk_result(err);
 				VkMemoryRequirements req;
 				vkGetBufferMemoryRequirements(device, m_StagingBuffer, &req);
@@ -207,7 +271,7 @@ namespace Walnut {
 				alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
 				alloc_info.allocationSize = req.size;
 				alloc_info.memoryTypeIndex = Utils::GetVulkanMemoryType(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, req.memoryTypeBits);
-				err = vkAllocateMemory(device, &alloc_info, nullptr, &m_StagingBufferMemory);
+				err = GPUMemory::Allocate(alloc_info, GPUMemoryCategory::Staging, &m_StagingBufferMemory);
 				check_vk_result(err);
 				err = vkBindBufferMemory(device, m_StagingBuffer, m_StagingBufferMemory, 0);
 				check_vk_result(err);
@@ -268,10 +332,15 @@ namespace Walnut {
 			use_barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 			use_barrier.subresourceRange.levelCount = 1;
 			use_barrier.subresourceRange.layerCount = 1;
-			vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, NULL, 0, NULL, 1, &use_barrier);
+			vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL, 0, NULL, 1, &use_barrier);
+
+			if (m_DisplayImage)
+				TonemapPass::Record(command_buffer, m_TonemapDescriptorSet, m_DisplayImage, m_Width, m_Height, m_DisplaySpecification);
 
 			Application::FlushCommandBuffer(command_buffer);
 		}
+
+		m_HasData = true;
 	}
 
 	void Image::Resize(uint32_t width, uint32_t height)
@@ -283,9 +352,60 @@ namespace Walnut {
 
 		m_Width = width;
 		m_Height = height;
+		m_HasData = false;
 
 		Release();
 		AllocateMemory(m_Width * m_Height * Utils::BytesPerPixel(m_Format));
 	}
 
+	void Image::SetSamplerSpecification(const SamplerSpecification& samplerSpecification)
+	{
+		m_SamplerSpecification = samplerSpecification;
+		if (!m_Image)
+			return;
+
+		VkSampler sampler = SamplerCache::Get(m_SamplerSpecification);
+		if (sampler == m_Sampler)
+			return;
+
+		// The current descriptor set may still be referenced by frames in flight
+		Application::SubmitResourceFree([descriptorSet = m_DescriptorSet]()
+		{
+			vkFreeDescriptorSets(Application::GetDevice(), Application::GetDescriptorPool(), 1, &descriptorSet);
+		});
+
+		m_Sampler = sampler;
+		m_DescriptorSet = (VkDescriptorSet)ImGui_ImplVulkan_AddTexture(m_Sampler, m_ImageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+		if (m_DisplayImage)
+		{
+			Application::SubmitResourceFree([descriptorSet = m_DisplayDescriptorSet]()
+			{
+				vkFreeDescriptorSets(Application::GetDevice(), Application::GetDescriptorPool(), 1, &descriptorSet);
+			});
+			m_DisplayDescriptorSet = (VkDescriptorSet)ImGui_ImplVulkan_AddTexture(m_Sampler, m_DisplayImageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		}
+	}
+
+	void Image::SetDisplaySpecification(const ImageDisplaySpecification& displaySpecification)
+	{
+		m_DisplaySpecification = displaySpecification;
+		if (!m_Image)
+			return;
+
+		bool tonemap = m_DisplaySpecification.Tonemap && m_Format == ImageFormat::RGBA32F;
+		if (tonemap && !m_DisplayImage)
+			AllocateDisplayImage();
+		else if (!tonemap)
+			ReleaseDisplayImage();
+
+		// Re-run the pass on the current data, no upload needed
+		if (m_DisplayImage && m_HasData)
+		{
+			VkCommandBuffer command_buffer = Application::GetCommandBuffer(true);
+			TonemapPass::Record(command_buffer, m_TonemapDescriptorSet, m_DisplayImage, m_Width, m_Height, m_DisplaySpecification);
+			Application::FlushCommandBuffer(command_buffer);
+		}
+	}
+
 }
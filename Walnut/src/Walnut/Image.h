@@ -4,6 +4,9 @@
 
 #include "vulkan/vulkan.h"
 
+#include "SamplerCache.h"
+#include "TonemapPass.h"
+
 namespace Walnut {
 
 	enum class ImageFormat
@@ -13,31 +16,64 @@ namespace Walnut {
 		RGBA32F
 	};
 
+	namespace Utils {
+
+		// Shared by the image types, 0xffffffff when no memory type matches
+		uint32_t GetVulkanMemoryType(VkMemoryPropertyFlags properties, uint32_t type_bits);
+		uint32_t BytesPerPixel(ImageFormat format);
+		VkFormat WalnutFormatToVulkanFormat(ImageFormat format);
+
+	}
+
 	class Image
 	{
 	public:
-		Image(std::string_view path);
-		Image(uint32_t width, uint32_t height, ImageFormat format, const void* data = nullptr);
+		Image(std::string_view path, const SamplerSpecification& samplerSpecification = SamplerSpecification());
+		Image(uint32_t width, uint32_t height, ImageFormat format, const void* data = nullptr, const SamplerSpecification& samplerSpecification = SamplerSpecification());
 		~Image();
 
 		void SetData(const void* data);
 
-		VkDescriptorSet GetDescriptorSet() const { return m_DescriptorSet; }
+		// The tonemapped display image once it has data, see SetDisplaySpecification
+		VkDescriptorSet GetDescriptorSet() const { return m_DisplayDescriptorSet && m_HasData ? m_DisplayDescriptorSet : m_DescriptorSet; }
 
 		void Resize(uint32_t width, uint32_t height);
 
+		// Switches to the shared sampler matching the specification, the pixel data is kept
+		void SetSamplerSpecification(const SamplerSpecification& samplerSpecification);
+		const SamplerSpecification& GetSamplerSpecification() const { return m_SamplerSpecification; }
+
+		// Only affects RGBA32F images. With tonemapping on, exposure, the tonemap operator and sRGB encoding are
+		// applied on the GPU into an 8-bit display image, so float buffers can be passed to SetData as they are.
+		void SetDisplaySpecification(const ImageDisplaySpecification& displaySpecification);
+		const ImageDisplaySpecification& GetDisplaySpecification() const { return m_DisplaySpecification; }
+
 		uint32_t GetWidth() const { return m_Width; }
 		uint32_t GetHeight() const { return m_Height; }
+
+		// The RGBA8 image GetDescriptorSet() shows, in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL. nullptr before
+		// the first SetData and for RGBA32F images without tonemapping. Read back by FrameRecorder
+		VkImage GetDisplayImage() const
+		{
+			if (!m_HasData)
+				return nullptr;
+			if (m_DisplayImage)
+				return m_DisplayImage;
+			return m_Format == ImageFormat::RGBA ? m_Image : nullptr;
+		}
 	private:
 		void AllocateMemory(uint64_t size);
+		void AllocateDisplayImage();
 		void Release();
+		void ReleaseDisplayImage();
 	private:
 		uint32_t m_Width = 0, m_Height = 0;
 
 		VkImage m_Image = nullptr;
 		VkImageView m_ImageView = nullptr;
 		VkDeviceMemory m_Memory = nullptr;
-		VkSampler m_Sampler = nullptr;
+		VkSampler m_Sampler = nullptr; // Owned by SamplerCache
+		SamplerSpecification m_SamplerSpecification;
 
 		ImageFormat m_Format = ImageFormat::None;
 
@@ -47,6 +83,15 @@ namespace Walnut {
 		size_t m_AlignedSize = 0;
 
 		VkDescriptorSet m_DescriptorSet = nullptr;
+		bool m_HasData = false;
+
+		// Tonemapped RGBA8 copy shown instead of m_Image
+		VkImage m_DisplayImage = nullptr;
+		VkImageView m_DisplayImageView = nullptr;
+		VkDeviceMemory m_DisplayMemory = nullptr;
+		VkDescriptorSet m_DisplayDescriptorSet = nullptr;
+		VkDescriptorSet m_TonemapDescriptorSet = nullptr;
+		ImageDisplaySpecification m_DisplaySpecification;
 
 		std::string m_Filepath;
 	};
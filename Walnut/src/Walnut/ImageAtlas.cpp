@@ -0,0 +1,654 @@
+#include "ImageAtlas.h"
+
+#include "backends/imgui_impl_vulkan.h"
+
+#include "Application.h"
+#include "GPUMemory.h"
+#include "Image.h"
+
+#include "stb_image.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+namespace Walnut {
+
+	namespace Utils {
+
+		static void TransitionAtlasPage(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout,
+			VkAccessFlags srcAccess, VkAccessFlags dstAccess, VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage)
+		{
+			VkImageMemoryBarrier barrier = {};
+			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			barrier.srcAccessMask = srcAccess;
+			barrier.dstAccessMask = dstAccess;
+			barrier.oldLayout = oldLayout;
+			barrier.newLayout = newLayout;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.image = image;
+			barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			barrier.subresourceRange.levelCount = 1;
+			barrier.subresourceRange.layerCount = 1;
+			vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, NULL, 0, NULL, 1, &barrier);
+		}
+
+	}
+
+	void ImageAtlas::SkylinePacker::Reset(uint32_t size)
+	{
+		Size = size;
+		Skyline.clear();
+		Skyline.push_back({ 0, 0, size });
+	}
+
+	bool ImageAtlas::SkylinePacker::Fit(size_t index, uint32_t width, uint32_t height, uint32_t& y) const
+	{
+		if (Skyline[index].X + width > Size)
+			return false;
+
+		// The lowest position the rectangle can rest on across the nodes it spans
+		y = 0;
+		int64_t widthLeft = width;
+		for (size_t i = index; widthLeft > 0; i++)
+		{
+			y = std::max(y, Skyline[i].Y);
+			if (y + height > Size)
+				return false;
+			widthLeft -= Skyline[i].Width;
+		}
+		return true;
+	}
+
+	bool ImageAtlas::SkylinePacker::Insert(uint32_t width, uint32_t height, uint32_t& x, uint32_t& y)
+	{
+		size_t bestIndex = Skyline.size();
+		uint32_t bestY = UINT32_MAX, bestWidth = UINT32_MAX;
+
+		for (size_t i = 0; i < Skyline.size(); i++)
+		{
+			uint32_t fitY;
+			if (!Fit(i, width, height, fitY))
+				continue;
+
+			// Lowest top edge first, then the narrowest spot to keep wide gaps for wide images
+			if (fitY + height < bestY || (fitY + height == bestY && Skyline[i].Width < bestWidth))
+			{
+				bestIndex = i;
+				bestY = fitY + height;
+				bestWidth = Skyline[i].Width;
+			}
+		}
+
+		if (bestIndex == Skyline.size())
+			return false;
+
+		x = Skyline[bestIndex].X;
+		y = bestY - height;
+
+		Skyline.insert(Skyline.begin() + bestIndex, { x, bestY, width });
+
+		// Shrink or remove the nodes now covered by the new one
+		for (size_t i = bestIndex + 1; i < Skyline.size();)
+		{
+			Node& previous = Skyline[i - 1];
+			Node& node = Skyline[i];
+			uint32_t previousEnd = previous.X + previous.Width;
+			if (node.X >= previousEnd)
+				break;
+
+			uint32_t shrink = previousEnd - node.X;
+			if (node.Width > shrink)
+			{
+				node.X += shrink;
+				node.Width -= shrink;
+				break;
+			}
+			Skyline.erase(Skyline.begin() + i);
+		}
+
+		// Merge neighbours at the same height
+		for (size_t i = 0; i + 1 < Skyline.size();)
+		{
+			if (Skyline[i].Y == Skyline[i + 1].Y)
+			{
+				Skyline[i].Width += Skyline[i + 1].Width;
+				Skyline.erase(Skyline.begin() + i + 1);
+			}
+			else
+			{
+				i++;
+			}
+		}
+
+		return true;
+	}
+
+	ImageAtlas::ImageAtlas(uint32_t pageSize, uint32_t padding, const SamplerSpecification& samplerSpecification)
+		: m_PageSize(pageSize), m_Padding(padding)
+	{
+		m_Sampler = SamplerCache::Get(samplerSpecification);
+		m_Entries.emplace_back(); // InvalidHandle
+	}
+
+	ImageAtlas::~ImageAtlas()
+	{
+		if (m_CommandPool)
+		{
+			std::vector<Page> sourcePages;
+			for (Upload& upload : m_Uploads)
+			{
+				sourcePages.insert(sourcePages.end(), upload.SourcePages.begin(), upload.SourcePages.end());
+				upload.SourcePages.clear();
+			}
+
+			// Queued ahead of the pages, which uploads still in flight may be reading or writing.
+			// Uploads are separate submissions, so the frame fences alone do not cover them
+			Application::SubmitResourceFree([commandPool = m_CommandPool, uploads = std::move(m_Uploads)]()
+			{
+				VkDevice device = Application::GetDevice();
+
+				for (const Upload& upload : uploads)
+				{
+					vkWaitForFences(device, 1, &upload.Fence, VK_TRUE, UINT64_MAX);
+					DestroyUpload(commandPool, upload);
+				}
+				vkDestroyCommandPool(device, commandPool, Application::GetAllocator());
+			});
+
+			for (Page& page : sourcePages)
+				ReleasePage(page);
+		}
+
+		for (Page& page : m_Pages)
+			ReleasePage(page);
+	}
+
+	ImageAtlas::Page ImageAtlas::CreatePage()
+	{
+		VkDevice device = Application::GetDevice();
+		VkResult err;
+
+		Page page;
+		page.Packer.Reset(m_PageSize);
+
+		{
+			VkImageCreateInfo info = {};
+			info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+			info.imageType = VK_IMAGE_TYPE_2D;
+			info.format = VK_FORMAT_R8G8B8A8_UNORM;
+			info.extent.width = m_PageSize;
+			info.extent.height = m_PageSize;
+			info.extent.depth = 1;
+			info.mipLevels = 1;
+			info.arrayLayers = 1;
+			info.samples = VK_SAMPLE_COUNT_1_BIT;
+			info.tiling = VK_IMAGE_TILING_OPTIMAL;
+			info.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+			info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			err = vkCreateImage(device, &info, Application::GetAllocator(), &page.Image);
+			check_vk_result(err);
+			VkMemoryRequirements req;
+			vkGetImageMemoryRequirements(device, page.Image, &req);
+			VkMemoryAllocateInfo alloc_info = {};
+			alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+			alloc_info.allocationSize = req.size;
+			alloc_info.memoryTypeIndex = Utils::GetVulkanMemoryType(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, req.memoryTypeBits);
+			err = GPUMemory::Allocate(alloc_info, GPUMemoryCategory::Image, &page.Memory);
+			check_vk_result(err);
+			err = vkBindImageMemory(device, page.Image, page.Memory, 0);
+			check_vk_result(err);
+		}
+
+		{
+			VkImageViewCreateInfo info = {};
+			info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+			info.image = page.Image;
+			info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			info.format = VK_FORMAT_R8G8B8A8_UNORM;
+			info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			info.subresourceRange.levelCount = 1;
+			info.subresourceRange.layerCount = 1;
+			err = vkCreateImageView(device, &info, Application::GetAllocator(), &page.ImageView);
+			check_vk_result(err);
+		}
+
+		page.DescriptorSet = (VkDescriptorSet)ImGui_ImplVulkan_AddTexture(m_Sampler, page.ImageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		return page;
+	}
+
+	void ImageAtlas::ReleasePage(Page& page)
+	{
+		Application::SubmitResourceFree([descriptorSet = page.DescriptorSet, imageView = page.ImageView, image = page.Image, memory = page.Memory]()
+		{
+			VkDevice device = Application::GetDevice();
+
+			vkFreeDescriptorSets(device, Application::GetDescriptorPool(), 1, &descriptorSet);
+			vkDestroyImageView(device, imageView, Application::GetAllocator());
+			vkDestroyImage(device, image, Application::GetAllocator());
+			GPUMemory::Free(memory);
+		});
+
+		page = Page();
+	}
+
+	bool ImageAtlas::Place(Entry& entry, std::vector<Page>& pages)
+	{
+		uint32_t width = entry.Width + 2 * m_Padding;
+		uint32_t height = entry.Height + 2 * m_Padding;
+		if (width > m_PageSize || height > m_PageSize)
+			return false;
+
+		uint32_t x, y;
+		for (uint32_t i = 0; i < (uint32_t)pages.size(); i++)
+		{
+			if (pages[i].Packer.Insert(width, height, x, y))
+			{
+				entry.PageIndex = i;
+				entry.X = x + m_Padding;
+				entry.Y = y + m_Padding;
+				return true;
+			}
+		}
+
+		pages.push_back(CreatePage());
+		pages.back().Packer.Insert(width, height, x, y);
+		entry.PageIndex = (uint32_t)pages.size() - 1;
+		entry.X = x + m_Padding;
+		entry.Y = y + m_Padding;
+		return true;
+	}
+
+	ImageAtlasHandle ImageAtlas::Add(uint32_t width, uint32_t height, const void* data)
+	{
+		Entry entry;
+		entry.Alive = true;
+		entry.Width = width;
+		entry.Height = height;
+		if (width == 0 || height == 0 || !Place(entry, m_Pages))
+			return InvalidHandle;
+
+		ImageAtlasHandle handle;
+		if (!m_FreeHandles.empty())
+		{
+			handle = m_FreeHandles.back();
+			m_FreeHandles.pop_back();
+			m_Entries[handle] = entry;
+		}
+		else
+		{
+			handle = (ImageAtlasHandle)m_Entries.size();
+			m_Entries.push_back(entry);
+		}
+
+		// Staging copies are tightly packed, vkCmdCopyBufferToImage only needs 4 byte aligned offsets
+		size_t size = (size_t)width * height * 4;
+		m_PendingUploads.push_back({ handle, m_PendingData.size() });
+		m_PendingData.insert(m_PendingData.end(), (const uint8_t*)data, (const uint8_t*)data + size);
+
+		m_ImageCount++;
+		m_UsedArea += (uint64_t)width * height;
+		return handle;
+	}
+
+	ImageAtlasHandle ImageAtlas::Add(std::string_view path)
+	{
+		std::string filepath(path);
+
+		int width, height, channels;
+		uint8_t* data = stbi_load(filepath.c_str(), &width, &height, &channels, 4);
+		if (!data)
+			return InvalidHandle;
+
+		ImageAtlasHandle handle = Add((uint32_t)width, (uint32_t)height, data);
+		stbi_image_free(data);
+		return handle;
+	}
+
+	void ImageAtlas::Remove(ImageAtlasHandle handle)
+	{
+		if (!Contains(handle))
+			return;
+
+		Entry& entry = m_Entries[handle];
+		entry.Alive = false;
+		m_ImageCount--;
+		m_UsedArea -= (uint64_t)entry.Width * entry.Height;
+		m_FreeHandles.push_back(handle);
+
+		// The handle may be reused before the next flush
+		m_PendingUploads.erase(std::remove_if(m_PendingUploads.begin(), m_PendingUploads.end(),
+			[handle](const PendingUpload& upload) { return upload.Handle == handle; }), m_PendingUploads.end());
+	}
+
+	bool ImageAtlas::Contains(ImageAtlasHandle handle) const
+	{
+		return handle != InvalidHandle && handle < m_Entries.size() && m_Entries[handle].Alive;
+	}
+
+	ImageAtlasRegion ImageAtlas::GetRegion(ImageAtlasHandle handle) const
+	{
+		if (!Contains(handle))
+			return ImageAtlasRegion();
+
+		const Entry& entry = m_Entries[handle];
+		float scale = 1.0f / m_PageSize;
+
+		ImageAtlasRegion region;
+		region.DescriptorSet = m_Pages[entry.PageIndex].DescriptorSet;
+		region.UV0 = ImVec2(entry.X * scale, entry.Y * scale);
+		region.UV1 = ImVec2((entry.X + entry.Width) * scale, (entry.Y + entry.Height) * scale);
+		region.Width = entry.Width;
+		region.Height = entry.Height;
+		return region;
+	}
+
+	float ImageAtlas::GetOccupancy() const
+	{
+		if (m_Pages.empty())
+			return 0.0f;
+		return (float)((double)m_UsedArea / ((double)m_PageSize * m_PageSize * m_Pages.size()));
+	}
+
+	void ImageAtlas::BeginPageWrites(VkCommandBuffer commandBuffer, std::vector<Page>& pages, const std::vector<bool>& written)
+	{
+		bool cleared = false;
+		for (size_t i = 0; i < pages.size(); i++)
+		{
+			if (!written[i])
+				continue;
+
+			Page& page = pages[i];
+			if (page.Initialized)
+			{
+				Utils::TransitionAtlasPage(commandBuffer, page.Image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+					VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+				continue;
+			}
+
+			// New pages start out transparent, which is what the padding shows
+			Utils::TransitionAtlasPage(commandBuffer, page.Image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+			VkClearColorValue clear = {};
+			VkImageSubresourceRange range = {};
+			range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			range.levelCount = 1;
+			range.layerCount = 1;
+			vkCmdClearColorImage(commandBuffer, page.Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clear, 1, &range);
+			cleared = true;
+		}
+
+		// The copies land on top of the clears
+		if (cleared)
+		{
+			VkMemoryBarrier barrier = {};
+			barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, NULL, 0, NULL);
+		}
+	}
+
+	void ImageAtlas::EndPageWrites(VkCommandBuffer commandBuffer, std::vector<Page>& pages, const std::vector<bool>& written)
+	{
+		for (size_t i = 0; i < pages.size(); i++)
+		{
+			if (!written[i])
+				continue;
+
+			Utils::TransitionAtlasPage(commandBuffer, pages[i].Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+				VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+			pages[i].Initialized = true;
+		}
+	}
+
+	VkCommandBuffer ImageAtlas::BeginUpload(Upload& upload)
+	{
+		VkDevice device = Application::GetDevice();
+		VkResult err;
+
+		if (!m_CommandPool)
+		{
+			VkCommandPoolCreateInfo pool_info = {};
+			pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+			pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+			pool_info.queueFamilyIndex = Application::GetQueueFamilyIndex();
+			err = vkCreateCommandPool(device, &pool_info, Application::GetAllocator(), &m_CommandPool);
+			check_vk_result(err);
+		}
+
+		VkCommandBufferAllocateInfo command_buffer_info = {};
+		command_buffer_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		command_buffer_info.commandPool = m_CommandPool;
+		command_buffer_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		command_buffer_info.commandBufferCount = 1;
+		err = vkAllocateCommandBuffers(device, &command_buffer_info, &upload.CommandBuffer);
+		check_vk_result(err);
+
+		VkFenceCreateInfo fence_info = {};
+		fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		err = vkCreateFence(device, &fence_info, Application::GetAllocator(), &upload.Fence);
+		check_vk_result(err);
+
+		VkCommandBufferBeginInfo begin_info = {};
+		begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		begin_info.flags |= VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		err = vkBeginCommandBuffer(upload.CommandBuffer, &begin_info);
+		check_vk_result(err);
+
+		return upload.CommandBuffer;
+	}
+
+	void ImageAtlas::SubmitUpload(Upload&& upload)
+	{
+		VkResult err = vkEndCommandBuffer(upload.CommandBuffer);
+		check_vk_result(err);
+
+		// Ahead of this frame's submission on the same queue, so the frame already samples the written pages
+		VkSubmitInfo submit_info = {};
+		submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submit_info.commandBufferCount = 1;
+		submit_info.pCommandBuffers = &upload.CommandBuffer;
+		err = vkQueueSubmit(Application::GetQueue(), 1, &submit_info, upload.Fence);
+		check_vk_result(err);
+
+		m_Uploads.push_back(std::move(upload));
+	}
+
+	void ImageAtlas::RetireUploads()
+	{
+		VkDevice device = Application::GetDevice();
+
+		for (size_t i = 0; i < m_Uploads.size();)
+		{
+			Upload& upload = m_Uploads[i];
+			if (vkGetFenceStatus(device, upload.Fence) != VK_SUCCESS)
+			{
+				i++;
+				continue;
+			}
+
+			// Draws recorded earlier this frame may still sample the replaced pages
+			for (Page& page : upload.SourcePages)
+				ReleasePage(page);
+			DestroyUpload(m_CommandPool, upload);
+			m_Uploads.erase(m_Uploads.begin() + i);
+		}
+	}
+
+	void ImageAtlas::DestroyUpload(VkCommandPool commandPool, const Upload& upload)
+	{
+		VkDevice device = Application::GetDevice();
+
+		vkDestroyFence(device, upload.Fence, Application::GetAllocator());
+		vkFreeCommandBuffers(device, commandPool, 1, &upload.CommandBuffer);
+		if (upload.StagingBuffer)
+		{
+			vkDestroyBuffer(device, upload.StagingBuffer, Application::GetAllocator());
+			GPUMemory::Free(upload.StagingBufferMemory);
+		}
+	}
+
+	void ImageAtlas::Flush()
+	{
+		RetireUploads();
+
+		if (m_PendingUploads.empty())
+		{
+			m_PendingData.clear();
+			return;
+		}
+
+		VkDevice device = Application::GetDevice();
+		VkResult err;
+
+		// One staging buffer for the whole batch, freed with the upload
+		Upload upload;
+		VkBuffer& stagingBuffer = upload.StagingBuffer;
+		VkDeviceMemory& stagingBufferMemory = upload.StagingBufferMemory;
+		{
+			VkBufferCreateInfo buffer_info = {};
+			buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+			buffer_info.size = m_PendingData.size();
+			buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+			buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			err = vkCreateBuffer(device, &buffer_info, Application::GetAllocator(), &stagingBuffer);
+			check_vk_result(err);
+			VkMemoryRequirements req;
+			vkGetBufferMemoryRequirements(device, stagingBuffer, &req);
+			VkMemoryAllocateInfo alloc_info = {};
+			alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+			alloc_info.allocationSize = req.size;
+			alloc_info.memoryTypeIndex = Utils::GetVulkanMemoryType(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, req.memoryTypeBits);
+			err = GPUMemory::Allocate(alloc_info, GPUMemoryCategory::Staging, &stagingBufferMemory);
+			check_vk_result(err);
+			err = vkBindBufferMemory(device, stagingBuffer, stagingBufferMemory, 0);
+			check_vk_result(err);
+
+			void* map = NULL;
+			err = vkMapMemory(device, stagingBufferMemory, 0, VK_WHOLE_SIZE, 0, &map);
+			check_vk_result(err);
+			memcpy(map, m_PendingData.data(), m_PendingData.size());
+			VkMappedMemoryRange range = {};
+			range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+			range.memory = stagingBufferMemory;
+			range.size = VK_WHOLE_SIZE;
+			err = vkFlushMappedMemoryRanges(device, 1, &range);
+			check_vk_result(err);
+			vkUnmapMemory(device, stagingBufferMemory);
+		}
+
+		// Group the copies per page, one vkCmdCopyBufferToImage each
+		std::vector<std::vector<VkBufferImageCopy>> regions(m_Pages.size());
+		std::vector<bool> written(m_Pages.size(), false);
+		for (const PendingUpload& upload : m_PendingUploads)
+		{
+			const Entry& entry = m_Entries[upload.Handle];
+
+			VkBufferImageCopy region = {};
+			region.bufferOffset = upload.Offset;
+			region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			region.imageSubresource.layerCount = 1;
+			region.imageOffset = { (int32_t)entry.X, (int32_t)entry.Y, 0 };
+			region.imageExtent = { entry.Width, entry.Height, 1 };
+			regions[entry.PageIndex].push_back(region);
+			written[entry.PageIndex] = true;
+		}
+
+		VkCommandBuffer command_buffer = BeginUpload(upload);
+		BeginPageWrites(command_buffer, m_Pages, written);
+		for (size_t i = 0; i < m_Pages.size(); i++)
+		{
+			if (!regions[i].empty())
+				vkCmdCopyBufferToImage(command_buffer, stagingBuffer, m_Pages[i].Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, (uint32_t)regions[i].size(), regions[i].data());
+		}
+		EndPageWrites(command_buffer, m_Pages, written);
+		SubmitUpload(std::move(upload));
+
+		m_PendingUploads.clear();
+		m_PendingData.clear();
+	}
+
+	void ImageAtlas::Repack()
+	{
+		Flush();
+		if (m_Pages.empty())
+			return;
+
+		// Tallest first packs a skyline tightest
+		std::vector<ImageAtlasHandle> handles;
+		handles.reserve(m_ImageCount);
+		for (ImageAtlasHandle handle = 1; handle < (ImageAtlasHandle)m_Entries.size(); handle++)
+		{
+			if (m_Entries[handle].Alive)
+				handles.push_back(handle);
+		}
+		std::sort(handles.begin(), handles.end(), [this](ImageAtlasHandle a, ImageAtlasHandle b)
+		{
+			const Entry& entryA = m_Entries[a];
+			const Entry& entryB = m_Entries[b];
+			return entryA.Height != entryB.Height ? entryA.Height > entryB.Height : entryA.Width > entryB.Width;
+		});
+
+		std::vector<Page> pages;
+		std::vector<std::pair<Entry, Entry>> moves; // Old and new placement
+		moves.reserve(handles.size());
+		for (ImageAtlasHandle handle : handles)
+		{
+			Entry& entry = m_Entries[handle];
+			Entry previous = entry;
+			Place(entry, pages);
+			moves.emplace_back(previous, entry);
+		}
+
+		std::vector<bool> newPages(pages.size(), true);
+
+		Upload upload;
+		VkCommandBuffer command_buffer = BeginUpload(upload);
+
+		// A page whose images were all removed before they were flushed was never written and has nothing to copy,
+		// it is still in UNDEFINED layout
+		for (const Page& page : m_Pages)
+		{
+			if (!page.Initialized)
+				continue;
+
+			Utils::TransitionAtlasPage(command_buffer, page.Image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+		}
+		BeginPageWrites(command_buffer, pages, newPages);
+
+		for (const auto& [previous, entry] : moves)
+		{
+			VkImageCopy region = {};
+			region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			region.srcSubresource.layerCount = 1;
+			region.srcOffset = { (int32_t)previous.X, (int32_t)previous.Y, 0 };
+			region.dstSubresource = region.srcSubresource;
+			region.dstOffset = { (int32_t)entry.X, (int32_t)entry.Y, 0 };
+			region.extent = { entry.Width, entry.Height, 1 };
+			vkCmdCopyImage(command_buffer, m_Pages[previous.PageIndex].Image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				pages[entry.PageIndex].Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+		}
+
+		EndPageWrites(command_buffer, pages, newPages);
+
+		// Draws recorded earlier this frame still sample the old pages
+		for (const Page& page : m_Pages)
+		{
+			if (!page.Initialized)
+				continue;
+
+			Utils::TransitionAtlasPage(command_buffer, page.Image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+				VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+		}
+
+		upload.SourcePages = std::move(m_Pages);
+		SubmitUpload(std::move(upload));
+		m_Pages = std::move(pages);
+	}
+
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <string_view>
+#include <vector>
+
+#include "imgui.h"
+#include "vulkan/vulkan.h"
+
+#include "SamplerCache.h"
+
+namespace Walnut {
+
+	using ImageAtlasHandle = uint32_t;
+
+	// Where an atlas entry lives, for ImGui::Image(region.DescriptorSet, size, region.UV0, region.UV1)
+	struct ImageAtlasRegion
+	{
+		VkDescriptorSet DescriptorSet = nullptr;
+		ImVec2 UV0 = ImVec2(0.0f, 0.0f);
+		ImVec2 UV1 = ImVec2(0.0f, 0.0f);
+		uint32_t Width = 0, Height = 0;
+	};
+
+	// Packs many small RGBA images into a few large pages, so drawing them binds one descriptor set
+	// per page instead of one per image. Added images are uploaded together by the next Flush().
+	// Regions move when the atlas is repacked: look them up by handle every frame rather than caching them.
+	class ImageAtlas
+	{
+	public:
+		static constexpr ImageAtlasHandle InvalidHandle = 0;
+
+		// padding texels are left empty (transparent) around every image so linear filtering does not bleed
+		ImageAtlas(uint32_t pageSize = 2048, uint32_t padding = 1, const SamplerSpecification& samplerSpecification = SamplerSpecification());
+		~ImageAtlas();
+
+		ImageAtlas(const ImageAtlas&) = delete;
+		ImageAtlas& operator=(const ImageAtlas&) = delete;
+
+		// RGBA8 pixels, copied. InvalidHandle when the image is larger than a page
+		ImageAtlasHandle Add(uint32_t width, uint32_t height, const void* data);
+		ImageAtlasHandle Add(std::string_view path);
+
+		// The space is only reclaimed by Repack()
+		void Remove(ImageAtlasHandle handle);
+
+		bool Contains(ImageAtlasHandle handle) const;
+		ImageAtlasRegion GetRegion(ImageAtlasHandle handle) const;
+
+		// Uploads every image added since the last flush in a single command buffer. Submitted with its own fence
+		// ahead of the frame, without waiting for the copy
+		void Flush();
+
+		// Packs the remaining images tightly into new pages, copying on the GPU, and drops pages left empty.
+		// The old pages are released once the copy has completed
+		void Repack();
+
+		uint32_t GetPageCount() const { return (uint32_t)m_Pages.size(); }
+		uint32_t GetImageCount() const { return m_ImageCount; }
+
+		// Fraction of the page area covered by live images
+		float GetOccupancy() const;
+	private:
+		// Skyline bottom-left packer
+		struct SkylinePacker
+		{
+			struct Node
+			{
+				uint32_t X, Y, Width;
+			};
+
+			std::vector<Node> Skyline;
+			uint32_t Size = 0;
+
+			void Reset(uint32_t size);
+			bool Insert(uint32_t width, uint32_t height, uint32_t& x, uint32_t& y);
+		private:
+			bool Fit(size_t index, uint32_t width, uint32_t height, uint32_t& y) const;
+		};
+
+		struct Page
+		{
+			VkImage Image = nullptr;
+			VkImageView ImageView = nullptr;
+			VkDeviceMemory Memory = nullptr;
+			VkDescriptorSet DescriptorSet = nullptr;
+			SkylinePacker Packer;
+			bool Initialized = false; // Cleared and in SHADER_READ_ONLY_OPTIMAL
+		};
+
+		struct Entry
+		{
+			bool Alive = false;
+			uint32_t PageIndex = 0;
+			uint32_t X = 0, Y = 0;
+			uint32_t Width = 0, Height = 0;
+		};
+
+		struct PendingUpload
+		{
+			ImageAtlasHandle Handle;
+			size_t Offset; // Into m_PendingData
+		};
+
+		// A Flush or Repack submission, freed by a later Flush once its fence has signaled
+		struct Upload
+		{
+			VkCommandBuffer CommandBuffer = nullptr;
+			VkFence Fence = nullptr;
+			VkBuffer StagingBuffer = nullptr;
+			VkDeviceMemory StagingBufferMemory = nullptr;
+			std::vector<Page> SourcePages; // Replaced by a repack, read by its copy
+		};
+
+		Page CreatePage();
+		void ReleasePage(Page& page);
+		bool Place(Entry& entry, std::vector<Page>& pages);
+
+		// Layout transitions around transfer writes to the pages flagged in written. New pages are cleared first
+		void BeginPageWrites(VkCommandBuffer commandBuffer, std::vector<Page>& pages, const std::vector<bool>& written);
+		void EndPageWrites(VkCommandBuffer commandBuffer, std::vector<Page>& pages, const std::vector<bool>& written);
+
+		VkCommandBuffer BeginUpload(Upload& upload);
+		void SubmitUpload(Upload&& upload);
+
+		// Frees the uploads whose copy has completed, without waiting
+		void RetireUploads();
+		static void DestroyUpload(VkCommandPool commandPool, const Upload& upload);
+	private:
+		uint32_t m_PageSize = 0;
+		uint32_t m_Padding = 0;
+		VkSampler m_Sampler = nullptr; // Owned by SamplerCache
+
+		std::vector<Page> m_Pages;
+
+		// Indexed by handle, slot 0 is InvalidHandle
+		std::vector<Entry> m_Entries;
+		std::vector<ImageAtlasHandle> m_FreeHandles;
+		uint32_t m_ImageCount = 0;
+		uint64_t m_UsedArea = 0;
+
+		std::vector<PendingUpload> m_PendingUploads;
+		std::vector<uint8_t> m_PendingData;
+
+		VkCommandPool m_CommandPool = nullptr; // Created by the first upload
+		std::vector<Upload> m_Uploads;         // In flight
+	};
+
+}
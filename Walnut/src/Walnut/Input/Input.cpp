@@ -1,38 +1,309 @@
 #include "Input.h"
 
-#include "Walnut/Application.h"
+#include "Walnut/Clock.h"
+#include "Walnut/SPSCQueue.h"
 
 #include <GLFW/glfw3.h>
 
+#include <atomic>
+#include <iostream>
+#include <mutex>
+
 namespace Walnut {
 
+	static GLFWwindow* s_WindowHandle = nullptr;
+
+	// Filled by the GLFW callbacks during glfwPollEvents, drained by Input::NewFrame
+	static SPSCQueue<InputEvent, 4096> s_EventQueue;
+	static bool s_ReportedDroppedEvents = false;
+
+	// The frame's state, rebuilt by NewFrame on the main thread
+	static InputState s_State;
+
+	// With a fixed update rate, NewFrame also applies the events here, where the edges accumulate until the fixed
+	// update thread takes them in BeginFixedUpdate: every step sees each edge exactly once, whatever the frame rate
+	static std::mutex s_FixedUpdateMutex;
+	static InputState s_FixedUpdatePending;
+	static InputState s_FixedUpdateState;
+	static std::atomic<bool> s_FixedUpdateEnabled = false;
+
+	// What the queries read on this thread, no lock needed: the frame only changes between updates
+	static thread_local const InputState* s_ThreadState = &s_State;
+
+	static void QueueInputEvent(const InputEvent& event)
+	{
+		if (!s_EventQueue.Push(event) && !s_ReportedDroppedEvents)
+		{
+			std::cerr << "[Walnut] Input event queue is full, dropping events\n";
+			s_ReportedDroppedEvents = true;
+		}
+	}
+
+	static void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods)
+	{
+		if (key < 0 || key >= (int)InputState::MaxKeys)
+			return;
+
+		InputEvent event;
+		event.Type = InputEventType::Key;
+		event.Action = (uint8_t)action;
+		event.Code = (uint16_t)key;
+		event.Time = Clock::ToSeconds(Clock::Now());
+		QueueInputEvent(event);
+	}
+
+	static void MouseButtonCallback(GLFWwindow* window, int button, int action, int mods)
+	{
+		if (button < 0 || button >= (int)InputState::MaxMouseButtons)
+			return;
+
+		InputEvent event;
+		event.Type = InputEventType::MouseButton;
+		event.Action = (uint8_t)action;
+		event.Code = (uint16_t)button;
+		event.Time = Clock::ToSeconds(Clock::Now());
+		QueueInputEvent(event);
+	}
+
+	static void CursorPosCallback(GLFWwindow* window, double x, double y)
+	{
+		InputEvent event;
+		event.Type = InputEventType::MouseMove;
+		event.X = (float)x;
+		event.Y = (float)y;
+		event.Time = Clock::ToSeconds(Clock::Now());
+		QueueInputEvent(event);
+	}
+
+	static void ScrollCallback(GLFWwindow* window, double xOffset, double yOffset)
+	{
+		InputEvent event;
+		event.Type = InputEventType::MouseScroll;
+		event.X = (float)xOffset;
+		event.Y = (float)yOffset;
+		event.Time = Clock::ToSeconds(Clock::Now());
+		QueueInputEvent(event);
+	}
+
+	static void WindowFocusCallback(GLFWwindow* window, int focused)
+	{
+		// Releases are not reported for keys still held when focus moves to another window
+		if (focused)
+			return;
+
+		InputEvent event;
+		event.Type = InputEventType::FocusLost;
+		event.Time = Clock::ToSeconds(Clock::Now());
+		QueueInputEvent(event);
+	}
+
+	static void ClearInputEdges(InputState& state)
+	{
+		state.KeysPressed.reset();
+		state.KeysReleased.reset();
+		state.MouseButtonsPressed.reset();
+		state.MouseButtonsReleased.reset();
+		state.MouseScrollDelta = { 0.0f, 0.0f };
+		state.MouseSamples.clear();
+	}
+
+	static void ApplyInputEvent(InputState& state, const InputEvent& event)
+	{
+		switch (event.Type)
+		{
+			case InputEventType::Key:
+			{
+				if (event.Action == GLFW_PRESS)
+				{
+					state.KeysDown.set(event.Code);
+					state.KeysPressed.set(event.Code);
+				}
+				else if (event.Action == GLFW_RELEASE)
+				{
+					state.KeysDown.reset(event.Code);
+					state.KeysReleased.set(event.Code);
+				}
+				break;
+			}
+			case InputEventType::MouseButton:
+			{
+				if (event.Action == GLFW_PRESS)
+				{
+					state.MouseButtonsDown.set(event.Code);
+					state.MouseButtonsPressed.set(event.Code);
+				}
+				else if (event.Action == GLFW_RELEASE)
+				{
+					state.MouseButtonsDown.reset(event.Code);
+					state.MouseButtonsReleased.set(event.Code);
+				}
+				break;
+			}
+			case InputEventType::MouseMove:
+			{
+				state.MousePosition = { event.X, event.Y };
+				state.MouseSamples.push_back({ state.MousePosition, event.Time });
+				break;
+			}
+			case InputEventType::MouseScroll:
+			{
+				state.MouseScrollDelta += glm::vec2(event.X, event.Y);
+				break;
+			}
+			case InputEventType::FocusLost:
+			{
+				state.KeysReleased |= state.KeysDown;
+				state.KeysDown.reset();
+				state.MouseButtonsReleased |= state.MouseButtonsDown;
+				state.MouseButtonsDown.reset();
+				break;
+			}
+		}
+	}
+
+	void Input::Init(GLFWwindow* windowHandle)
+	{
+		s_WindowHandle = windowHandle;
+
+		double x, y;
+		glfwGetCursorPos(windowHandle, &x, &y);
+		s_State = InputState();
+		s_State.MousePosition = { (float)x, (float)y };
+
+		// Installed before the ImGui GLFW backend, which chains to these callbacks
+		glfwSetKeyCallback(windowHandle, KeyCallback);
+		glfwSetMouseButtonCallback(windowHandle, MouseButtonCallback);
+		glfwSetCursorPosCallback(windowHandle, CursorPosCallback);
+		glfwSetScrollCallback(windowHandle, ScrollCallback);
+		glfwSetWindowFocusCallback(windowHandle, WindowFocusCallback);
+	}
+
+	void Input::Shutdown()
+	{
+		InputEvent event;
+		while (s_EventQueue.Pop(event)) {}
+
+		s_FixedUpdateEnabled = false;
+		s_WindowHandle = nullptr;
+	}
+
+	void Input::NewFrame()
+	{
+		ClearInputEdges(s_State);
+
+		std::unique_lock<std::mutex> lock(s_FixedUpdateMutex, std::defer_lock);
+		bool fixedUpdate = s_FixedUpdateEnabled.load(std::memory_order_relaxed);
+		if (fixedUpdate)
+			lock.lock();
+
+		InputEvent event;
+		while (s_EventQueue.Pop(event))
+		{
+			ApplyInputEvent(s_State, event);
+			if (fixedUpdate)
+				ApplyInputEvent(s_FixedUpdatePending, event);
+		}
+	}
+
+	void Input::EnableFixedUpdate()
+	{
+		std::scoped_lock<std::mutex> lock(s_FixedUpdateMutex);
+		s_FixedUpdatePending = s_State;
+		ClearInputEdges(s_FixedUpdatePending);
+		s_FixedUpdateEnabled = true;
+	}
+
+	void Input::BeginFixedUpdate()
+	{
+		s_ThreadState = &s_FixedUpdateState;
+
+		std::scoped_lock<std::mutex> lock(s_FixedUpdateMutex);
+		std::swap(s_FixedUpdateState, s_FixedUpdatePending);
+
+		// The next step starts from this one's held keys and cursor
+		ClearInputEdges(s_FixedUpdatePending);
+		s_FixedUpdatePending.KeysDown = s_FixedUpdateState.KeysDown;
+		s_FixedUpdatePending.MouseButtonsDown = s_FixedUpdateState.MouseButtonsDown;
+		s_FixedUpdatePending.MousePosition = s_FixedUpdateState.MousePosition;
+	}
+
+	const InputState* Input::SetThreadState(const InputState* state)
+	{
+		const InputState* previous = s_ThreadState;
+		s_ThreadState = state;
+		return previous;
+	}
+
 	bool Input::IsKeyDown(KeyCode keycode)
 	{
-		GLFWwindow* windowHandle = Application::Get().GetWindowHandle();
-		int state = glfwGetKey(windowHandle, (int)keycode);
-		return state == GLFW_PRESS || state == GLFW_REPEAT;
+		return s_ThreadState->KeysDown.test((size_t)keycode);
+	}
+
+	bool Input::IsKeyPressed(KeyCode keycode)
+	{
+		return s_ThreadState->KeysPressed.test((size_t)keycode);
+	}
+
+	bool Input::IsKeyReleased(KeyCode keycode)
+	{
+		return s_ThreadState->KeysReleased.test((size_t)keycode);
+	}
+
+	KeyState Input::GetKeyState(KeyCode keycode)
+	{
+		const InputState& state = *s_ThreadState;
+		if (state.KeysPressed.test((size_t)keycode))
+			return KeyState::Pressed;
+		if (state.KeysDown.test((size_t)keycode))
+			return KeyState::Held;
+		if (state.KeysReleased.test((size_t)keycode))
+			return KeyState::Released;
+		return KeyState::None;
 	}
 
 	bool Input::IsMouseButtonDown(MouseButton button)
 	{
-		GLFWwindow* windowHandle = Application::Get().GetWindowHandle();
-		int state = glfwGetMouseButton(windowHandle, (int)button);
-		return state == GLFW_PRESS;
+		return s_ThreadState->MouseButtonsDown.test((size_t)button);
+	}
+
+	bool Input::IsMouseButtonPressed(MouseButton button)
+	{
+		return s_ThreadState->MouseButtonsPressed.test((size_t)button);
+	}
+
+	bool Input::IsMouseButtonReleased(MouseButton button)
+	{
+		return s_ThreadState->MouseButtonsReleased.test((size_t)button);
 	}
 
 	glm::vec2 Input::GetMousePosition()
 	{
-		GLFWwindow* windowHandle = Application::Get().GetWindowHandle();
+		return s_ThreadState->MousePosition;
+	}
 
-		double x, y;
-		glfwGetCursorPos(windowHandle, &x, &y);
-		return { (float)x, (float)y };
+	glm::vec2 Input::GetMouseScrollDelta()
+	{
+		return s_ThreadState->MouseScrollDelta;
+	}
+
+	const std::vector<MouseSample>& Input::GetMouseSamples()
+	{
+		return s_ThreadState->MouseSamples;
+	}
+
+	const InputState& Input::GetState()
+	{
+		return *s_ThreadState;
+	}
+
+	InputState Input::GetStateCopy()
+	{
+		return *s_ThreadState;
 	}
 
 	void Input::SetCursorMode(CursorMode mode)
 	{
-		GLFWwindow* windowHandle = Application::Get().GetWindowHandle();
-		glfwSetInputMode(windowHandle, GLFW_CURSOR, GLFW_CURSOR_NORMAL + (int)mode);
+		glfwSetInputMode(s_WindowHandle, GLFW_CURSOR, GLFW_CURSOR_NORMAL + (int)mode);
 	}
 
-}
\ No newline at end of file
+}
@@ -4,17 +4,96 @@
 
 #include <glm/glm.hpp>
 
+#include <bitset>
+#include <vector>
+
+struct GLFWwindow;
+
 namespace Walnut {
 
+	enum class InputEventType : uint8_t
+	{
+		Key = 0,
+		MouseButton,
+		MouseMove,
+		MouseScroll,
+		FocusLost
+	};
+
+	// Raw GLFW event as queued by the window callbacks, X/Y hold cursor position or scroll offset
+	struct InputEvent
+	{
+		InputEventType Type = InputEventType::Key;
+		uint8_t Action = 0; // GLFW_PRESS, GLFW_RELEASE or GLFW_REPEAT
+		uint16_t Code = 0;  // KeyCode or MouseButton
+		float X = 0.0f, Y = 0.0f;
+		double Time = 0.0; // Same timeline as Application::GetTime()
+	};
+
+	struct MouseSample
+	{
+		glm::vec2 Position;
+		double Time;
+	};
+
+	// Input state for one frame, rebuilt from the queued events at the start of every frame
+	struct InputState
+	{
+		static constexpr uint32_t MaxKeys = 512;
+		static constexpr uint32_t MaxMouseButtons = 8;
+
+		std::bitset<MaxKeys> KeysDown, KeysPressed, KeysReleased;
+		std::bitset<MaxMouseButtons> MouseButtonsDown, MouseButtonsPressed, MouseButtonsReleased;
+
+		glm::vec2 MousePosition = { 0.0f, 0.0f };
+		glm::vec2 MouseScrollDelta = { 0.0f, 0.0f };
+
+		// Every cursor position reported since the previous frame, oldest first
+		std::vector<MouseSample> MouseSamples;
+	};
+
+	// Queries read the state of the update they are called from, without locking: the frame's on the main thread and
+	// in OnUpdate/OnUIRender (parallel layers included), or, with ApplicationSpecification::FixedUpdateRate, the fixed
+	// update step's, which reports every edge since the previous step exactly once. Other threads must not query.
+	// A key pressed and released within one frame or step still reports both edges.
 	class Input
 	{
 	public:
 		static bool IsKeyDown(KeyCode keycode);
+		static bool IsKeyPressed(KeyCode keycode);
+		static bool IsKeyReleased(KeyCode keycode);
+		static KeyState GetKeyState(KeyCode keycode);
+
 		static bool IsMouseButtonDown(MouseButton button);
+		static bool IsMouseButtonPressed(MouseButton button);
+		static bool IsMouseButtonReleased(MouseButton button);
 
 		static glm::vec2 GetMousePosition();
+		static glm::vec2 GetMouseScrollDelta();
+
+		// Valid until the end of the update they were returned in
+		static const std::vector<MouseSample>& GetMouseSamples();
+		static const InputState& GetState();
+
+		// Copy of GetState() to keep past the update
+		static InputState GetStateCopy();
 
 		static void SetCursorMode(CursorMode mode);
+	private:
+		// Called by Application
+		static void Init(GLFWwindow* windowHandle);
+		static void Shutdown();
+		static void NewFrame();
+
+		// Before the fixed update thread starts, then on that thread at the start of every step
+		static void EnableFixedUpdate();
+		static void BeginFixedUpdate();
+
+		// Lets the thread pool run a layer's OnUpdate with the state of the update that dispatched it
+		static const InputState* SetThreadState(const InputState* state);
+
+		friend class Application;
+		friend class LayerUpdateScheduler;
 	};
 
 }
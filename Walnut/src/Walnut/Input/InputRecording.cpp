@@ -0,0 +1,437 @@
+#include "InputRecording.h"
+
+#include "Walnut/Clock.h"
+#include "Walnut/FrameTimeStatistics.h"
+
+#include <GLFW/glfw3.h>
+
+#include <string.h>
+#include <algorithm>
+#include <iostream>
+
+namespace Walnut {
+
+	static_assert(sizeof(RecordedInputEvent) == 20, "RecordedInputEvent is written to the file as is");
+	static_assert(sizeof(InputRecordingHeader) == 16, "InputRecordingHeader is written to the file as is");
+
+	struct InputRecordingFrameHeader
+	{
+		uint32_t EventCount = 0;
+		float TimeStep = 0.0f;
+	};
+
+	// Callbacks on top of the window's own while recording or replaying. Only one of either exists at a time
+	struct InputRecordingCallbacks
+	{
+		static inline InputRecorder* Recorder = nullptr;
+		static inline InputReplayer* Replayer = nullptr;
+
+		// The callbacks that were set before, called with the recorded events
+		static inline GLFWkeyfun Key = nullptr;
+		static inline GLFWcharfun Char = nullptr;
+		static inline GLFWmousebuttonfun MouseButton = nullptr;
+		static inline GLFWcursorposfun CursorPos = nullptr;
+		static inline GLFWcursorenterfun CursorEnter = nullptr;
+		static inline GLFWscrollfun Scroll = nullptr;
+		static inline GLFWwindowfocusfun Focus = nullptr;
+		static inline GLFWwindowsizefun WindowSize = nullptr;
+
+		static void Install(GLFWwindow* window)
+		{
+			Key = glfwSetKeyCallback(window, OnKey);
+			Char = glfwSetCharCallback(window, OnChar);
+			MouseButton = glfwSetMouseButtonCallback(window, OnMouseButton);
+			CursorPos = glfwSetCursorPosCallback(window, OnCursorPos);
+			CursorEnter = glfwSetCursorEnterCallback(window, OnCursorEnter);
+			Scroll = glfwSetScrollCallback(window, OnScroll);
+			Focus = glfwSetWindowFocusCallback(window, OnFocus);
+			WindowSize = glfwSetWindowSizeCallback(window, OnWindowSize);
+		}
+
+		static void Restore(GLFWwindow* window)
+		{
+			glfwSetKeyCallback(window, Key);
+			glfwSetCharCallback(window, Char);
+			glfwSetMouseButtonCallback(window, MouseButton);
+			glfwSetCursorPosCallback(window, CursorPos);
+			glfwSetCursorEnterCallback(window, CursorEnter);
+			glfwSetScrollCallback(window, Scroll);
+			glfwSetWindowFocusCallback(window, Focus);
+			glfwSetWindowSizeCallback(window, WindowSize);
+		}
+
+		// Live input is recorded and passed on, or dropped while replaying
+		static bool Record(const RecordedInputEvent& event)
+		{
+			if (Recorder)
+				Recorder->Add(event);
+			return !Replayer;
+		}
+
+		static void OnKey(GLFWwindow* window, int key, int scancode, int action, int mods)
+		{
+			RecordedInputEvent event;
+			event.Type = RecordedInputType::Key;
+			event.Action = (uint8_t)action;
+			event.Mods = (uint16_t)mods;
+			event.Code = key;
+			event.Scancode = scancode;
+			if (Record(event) && Key)
+				Key(window, key, scancode, action, mods);
+		}
+
+		static void OnChar(GLFWwindow* window, unsigned int codepoint)
+		{
+			RecordedInputEvent event;
+			event.Type = RecordedInputType::Char;
+			event.Code = (int32_t)codepoint;
+			if (Record(event) && Char)
+				Char(window, codepoint);
+		}
+
+		static void OnMouseButton(GLFWwindow* window, int button, int action, int mods)
+		{
+			RecordedInputEvent event;
+			event.Type = RecordedInputType::MouseButton;
+			event.Action = (uint8_t)action;
+			event.Mods = (uint16_t)mods;
+			event.Code = button;
+			if (Record(event) && MouseButton)
+				MouseButton(window, button, action, mods);
+		}
+
+		static void OnCursorPos(GLFWwindow* window, double x, double y)
+		{
+			RecordedInputEvent event;
+			event.Type = RecordedInputType::CursorPos;
+			event.X = (float)x;
+			event.Y = (float)y;
+			if (Record(event) && CursorPos)
+				CursorPos(window, x, y);
+		}
+
+		static void OnCursorEnter(GLFWwindow* window, int entered)
+		{
+			RecordedInputEvent event;
+			event.Type = RecordedInputType::CursorEnter;
+			event.Action = (uint8_t)entered;
+			if (Record(event) && CursorEnter)
+				CursorEnter(window, entered);
+		}
+
+		static void OnScroll(GLFWwindow* window, double xOffset, double yOffset)
+		{
+			RecordedInputEvent event;
+			event.Type = RecordedInputType::Scroll;
+			event.X = (float)xOffset;
+			event.Y = (float)yOffset;
+			if (Record(event) && Scroll)
+				Scroll(window, xOffset, yOffset);
+		}
+
+		static void OnFocus(GLFWwindow* window, int focused)
+		{
+			RecordedInputEvent event;
+			event.Type = RecordedInputType::Focus;
+			event.Action = (uint8_t)focused;
+			if (Record(event) && Focus)
+				Focus(window, focused);
+		}
+
+		// Passed on while replaying too: the replayed sizes are applied with glfwSetWindowSize
+		static void OnWindowSize(GLFWwindow* window, int width, int height)
+		{
+			if (Recorder)
+			{
+				RecordedInputEvent event;
+				event.Type = RecordedInputType::WindowSize;
+				event.X = (float)width;
+				event.Y = (float)height;
+				Recorder->Add(event);
+			}
+			if (WindowSize)
+				WindowSize(window, width, height);
+		}
+	};
+
+	InputRecorder::InputRecorder(GLFWwindow* windowHandle, const std::string& path)
+		: m_WindowHandle(windowHandle)
+	{
+		if (InputRecordingCallbacks::Recorder || InputRecordingCallbacks::Replayer)
+		{
+			std::cerr << "[Walnut] Input is already being recorded or replayed\n";
+			return;
+		}
+
+		m_File = fopen(path.c_str(), "wb");
+		if (!m_File)
+		{
+			std::cerr << "[Walnut] Could not open " << path << " to record input\n";
+			return;
+		}
+
+		int width, height;
+		glfwGetWindowSize(windowHandle, &width, &height);
+
+		InputRecordingHeader header;
+		header.WindowWidth = (uint32_t)width;
+		header.WindowHeight = (uint32_t)height;
+		fwrite(&header, sizeof(header), 1, m_File);
+
+		// A cursor already over the window never reports entering it, replay would otherwise start without it
+		if (glfwGetWindowAttrib(windowHandle, GLFW_HOVERED))
+		{
+			double x, y;
+			glfwGetCursorPos(windowHandle, &x, &y);
+
+			RecordedInputEvent enter;
+			enter.Type = RecordedInputType::CursorEnter;
+			enter.Action = 1;
+			Add(enter);
+
+			RecordedInputEvent position;
+			position.Type = RecordedInputType::CursorPos;
+			position.X = (float)x;
+			position.Y = (float)y;
+			Add(position);
+		}
+
+		InputRecordingCallbacks::Recorder = this;
+		InputRecordingCallbacks::Install(windowHandle);
+	}
+
+	InputRecorder::~InputRecorder()
+	{
+		if (!m_File)
+			return;
+
+		InputRecordingCallbacks::Restore(m_WindowHandle);
+		InputRecordingCallbacks::Recorder = nullptr;
+
+		fclose(m_File);
+	}
+
+	void InputRecorder::NextFrame(float timeStep)
+	{
+		if (!m_File)
+			return;
+
+		InputRecordingFrameHeader frame;
+		frame.EventCount = (uint32_t)m_FrameEvents.size();
+		frame.TimeStep = timeStep;
+		fwrite(&frame, sizeof(frame), 1, m_File);
+		if (!m_FrameEvents.empty())
+			fwrite(m_FrameEvents.data(), sizeof(RecordedInputEvent), m_FrameEvents.size(), m_File);
+
+		m_FrameEvents.clear();
+		m_FrameCount++;
+	}
+
+	InputReplayer::InputReplayer(const std::string& path)
+	{
+		FILE* file = fopen(path.c_str(), "rb");
+		if (!file)
+		{
+			std::cerr << "[Walnut] Could not open input recording " << path << "\n";
+			return;
+		}
+
+		InputRecordingHeader expected;
+		if (fread(&m_Header, sizeof(m_Header), 1, file) != 1 || memcmp(m_Header.Magic, expected.Magic, sizeof(expected.Magic)) != 0
+			|| m_Header.Version != InputRecordingHeader::CurrentVersion)
+		{
+			std::cerr << "[Walnut] " << path << " is not an input recording of this version\n";
+			fclose(file);
+			return;
+		}
+
+		// A recording cut short (eg. by a crash) ends with the last complete frame
+		InputRecordingFrameHeader frameHeader;
+		while (fread(&frameHeader, sizeof(frameHeader), 1, file) == 1)
+		{
+			// Far more than a frame's worth of input, the rest of the file can't be trusted
+			if (frameHeader.EventCount > 1u << 20)
+				break;
+
+			Frame frame;
+			frame.TimeStep = frameHeader.TimeStep;
+			frame.FirstEvent = (uint32_t)m_Events.size();
+			frame.EventCount = frameHeader.EventCount;
+
+			m_Events.resize(m_Events.size() + frame.EventCount);
+			if (frame.EventCount > 0 && fread(m_Events.data() + frame.FirstEvent, sizeof(RecordedInputEvent), frame.EventCount, file) != frame.EventCount)
+			{
+				m_Events.resize(frame.FirstEvent);
+				break;
+			}
+			m_Frames.push_back(frame);
+		}
+		fclose(file);
+
+		if (m_Frames.empty())
+			std::cerr << "[Walnut] Input recording " << path << " has no frames\n";
+		m_FrameTicks.reserve(m_Frames.size());
+	}
+
+	InputReplayer::~InputReplayer()
+	{
+		Detach();
+	}
+
+	void InputReplayer::Attach(GLFWwindow* windowHandle)
+	{
+		if (m_WindowHandle || InputRecordingCallbacks::Recorder || InputRecordingCallbacks::Replayer)
+		{
+			std::cerr << "[Walnut] Input is already being recorded or replayed\n";
+			return;
+		}
+
+		m_WindowHandle = windowHandle;
+		InputRecordingCallbacks::Replayer = this;
+		InputRecordingCallbacks::Install(windowHandle);
+	}
+
+	void InputReplayer::Detach()
+	{
+		if (!m_WindowHandle)
+			return;
+
+		InputRecordingCallbacks::Restore(m_WindowHandle);
+		InputRecordingCallbacks::Replayer = nullptr;
+		m_WindowHandle = nullptr;
+	}
+
+	bool InputReplayer::NextFrame(float& timeStep)
+	{
+		if (m_NextFrame >= m_Frames.size())
+			return false;
+
+		const Frame& frame = m_Frames[m_NextFrame++];
+		if (m_WindowHandle)
+		{
+			for (uint32_t i = 0; i < frame.EventCount; i++)
+				Dispatch(m_Events[frame.FirstEvent + i]);
+		}
+
+		timeStep = frame.TimeStep;
+		return true;
+	}
+
+	void InputReplayer::Dispatch(const RecordedInputEvent& event)
+	{
+		using Callbacks = InputRecordingCallbacks;
+		GLFWwindow* window = m_WindowHandle;
+
+		switch (event.Type)
+		{
+			case RecordedInputType::Key:
+			{
+				if (Callbacks::Key)
+					Callbacks::Key(window, event.Code, event.Scancode, event.Action, event.Mods);
+				break;
+			}
+			case RecordedInputType::Char:
+			{
+				if (Callbacks::Char)
+					Callbacks::Char(window, (unsigned int)event.Code);
+				break;
+			}
+			case RecordedInputType::MouseButton:
+			{
+				if (Callbacks::MouseButton)
+					Callbacks::MouseButton(window, event.Code, event.Action, event.Mods);
+				break;
+			}
+			case RecordedInputType::CursorPos:
+			{
+				if (Callbacks::CursorPos)
+					Callbacks::CursorPos(window, event.X, event.Y);
+				break;
+			}
+			case RecordedInputType::CursorEnter:
+			{
+				if (Callbacks::CursorEnter)
+					Callbacks::CursorEnter(window, event.Action);
+				break;
+			}
+			case RecordedInputType::Scroll:
+			{
+				if (Callbacks::Scroll)
+					Callbacks::Scroll(window, event.X, event.Y);
+				break;
+			}
+			case RecordedInputType::Focus:
+			{
+				if (Callbacks::Focus)
+					Callbacks::Focus(window, event.Action);
+				break;
+			}
+			case RecordedInputType::WindowSize:
+			{
+				// The swapchain follows once the new size has settled, as with a live resize
+				glfwSetWindowSize(window, (int)event.X, (int)event.Y);
+				break;
+			}
+		}
+	}
+
+	void InputReplayer::AddFrameTime(int64_t frameTicks)
+	{
+		m_FrameTicks.push_back(frameTicks);
+	}
+
+	void InputReplayer::PrintReport() const
+	{
+		if (m_FrameTicks.empty())
+		{
+			std::cout << "[REPLAY] No frames replayed\n";
+			return;
+		}
+
+		FrameTimeHistory history((uint32_t)m_FrameTicks.size());
+		for (int64_t ticks : m_FrameTicks)
+			history.Add(ticks);
+		FrameTimeStatistics statistics = history.Compute();
+
+		std::cout << "[REPLAY] " << statistics.FrameCount << " of " << m_Frames.size() << " frames - mean " << statistics.Mean
+			<< "ms, median " << statistics.P50 << "ms, 95th " << statistics.P95 << "ms, 99th " << statistics.P99
+			<< "ms, max " << statistics.Max << "ms, " << statistics.HitchCount << " hitches\n";
+
+		std::vector<uint32_t> slowest(m_FrameTicks.size());
+		for (uint32_t i = 0; i < (uint32_t)slowest.size(); i++)
+			slowest[i] = i;
+
+		size_t count = std::min<size_t>(slowest.size(), 5);
+		std::partial_sort(slowest.begin(), slowest.begin() + count, slowest.end(), [this](uint32_t a, uint32_t b)
+		{
+			return m_FrameTicks[a] > m_FrameTicks[b];
+		});
+
+		std::cout << "[REPLAY] Slowest frames:";
+		for (size_t i = 0; i < count; i++)
+			std::cout << " #" << slowest[i] << " " << Clock::ToMillis(m_FrameTicks[slowest[i]]) << "ms";
+		std::cout << "\n";
+	}
+
+	bool InputReplayer::WriteReport(const std::string& path) const
+	{
+		FILE* file = fopen(path.c_str(), "w");
+		if (!file)
+		{
+			std::cerr << "[Walnut] Could not open " << path << " to write the replay report\n";
+			return false;
+		}
+
+		fprintf(file, "frame,time_step_ms,frame_time_ms,events\n");
+		for (size_t i = 0; i < m_FrameTicks.size(); i++)
+		{
+			const Frame& frame = m_Frames[i];
+			fprintf(file, "%zu,%.4f,%.4f,%u\n", i, frame.TimeStep * 1000.0f, Clock::ToMillis(m_FrameTicks[i]), frame.EventCount);
+		}
+
+		bool written = ferror(file) == 0;
+		fclose(file);
+		return written;
+	}
+
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+struct GLFWwindow;
+
+namespace Walnut {
+
+	enum class RecordedInputType : uint8_t
+	{
+		Key = 0,
+		Char,
+		MouseButton,
+		CursorPos,
+		CursorEnter,
+		Scroll,
+		Focus,
+		WindowSize
+	};
+
+	// One GLFW callback of the main window, as stored in the file
+	struct RecordedInputEvent
+	{
+		RecordedInputType Type = RecordedInputType::Key;
+		uint8_t Action = 0; // GLFW_PRESS, GLFW_RELEASE or GLFW_REPEAT, or entered/focused
+		uint16_t Mods = 0;
+		int32_t Code = 0;   // Key, mouse button or codepoint
+		int32_t Scancode = 0;
+		float X = 0.0f, Y = 0.0f; // Cursor position, scroll offset or window size
+	};
+
+	// Header followed by one record per frame: the event count, the frame's time step and its events, in native
+	// byte order. A frame without input takes 8 bytes
+	struct InputRecordingHeader
+	{
+		static constexpr uint32_t CurrentVersion = 2; // 2 added RecordedInputEvent::Scancode
+
+		char Magic[4] = { 'W', 'N', 'I', 'R' };
+		uint32_t Version = CurrentVersion;
+		uint32_t WindowWidth = 0, WindowHeight = 0;
+	};
+
+	// Writes every callback the main window receives, and the time step of every frame, to a file. Installed on top
+	// of the callbacks already set (ImGui's, which chain to Input's) and forwards to them
+	class InputRecorder
+	{
+	public:
+		// Create after ImGui_ImplGlfw_Init and destroy before ImGui_ImplGlfw_Shutdown, one at a time
+		InputRecorder(GLFWwindow* windowHandle, const std::string& path);
+		~InputRecorder();
+
+		InputRecorder(const InputRecorder&) = delete;
+		InputRecorder& operator=(const InputRecorder&) = delete;
+
+		bool IsOpen() const { return m_File != nullptr; }
+
+		// Writes the events received since the previous call with the time step the frame runs with.
+		// Called by Application after polling events
+		void NextFrame(float timeStep);
+
+		uint32_t GetFrameCount() const { return m_FrameCount; }
+	private:
+		void Add(const RecordedInputEvent& event) { m_FrameEvents.push_back(event); }
+	private:
+		GLFWwindow* m_WindowHandle = nullptr;
+		FILE* m_File = nullptr;
+		std::vector<RecordedInputEvent> m_FrameEvents;
+		uint32_t m_FrameCount = 0;
+
+		friend struct InputRecordingCallbacks;
+	};
+
+	// Plays a recording back one frame at a time, through the callbacks that were installed when it was recorded,
+	// while live input to the window is ignored. Measures every replayed frame for the timing report
+	class InputReplayer
+	{
+	public:
+		// Reads the whole file, so the window can be created with the recorded size
+		InputReplayer(const std::string& path);
+		~InputReplayer();
+
+		InputReplayer(const InputReplayer&) = delete;
+		InputReplayer& operator=(const InputReplayer&) = delete;
+
+		bool IsLoaded() const { return !m_Frames.empty(); }
+		uint32_t GetWindowWidth() const { return m_Header.WindowWidth; }
+		uint32_t GetWindowHeight() const { return m_Header.WindowHeight; }
+		uint32_t GetFrameCount() const { return (uint32_t)m_Frames.size(); }
+
+		// Same requirements as InputRecorder's constructor and destructor
+		void Attach(GLFWwindow* windowHandle);
+		void Detach();
+
+		// Delivers the next frame's events and returns its time step, false once every frame has been replayed
+		bool NextFrame(float& timeStep);
+
+		// Wall-clock duration of the frame that was just replayed
+		void AddFrameTime(int64_t frameTicks);
+
+		// Summary and slowest frames to stdout
+		void PrintReport() const;
+		// CSV with the time step and the measured time of every frame, in milliseconds
+		bool WriteReport(const std::string& path) const;
+	private:
+		struct Frame
+		{
+			float TimeStep = 0.0f;
+			uint32_t FirstEvent = 0;
+			uint32_t EventCount = 0;
+		};
+
+		void Dispatch(const RecordedInputEvent& event);
+	private:
+		InputRecordingHeader m_Header;
+		std::vector<Frame> m_Frames;
+		std::vector<RecordedInputEvent> m_Events;
+		uint32_t m_NextFrame = 0;
+
+		std::vector<int64_t> m_FrameTicks;
+
+		GLFWwindow* m_WindowHandle = nullptr;
+
+		friend struct InputRecordingCallbacks;
+	};
+
+}
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "vulkan/vulkan.h"
+
 namespace Walnut {
 
 	class Layer
@@ -10,8 +12,30 @@ namespace Walnut {
 		virtual void OnAttach() {}
 		virtual void OnDetach() {}
 
+		// Runs on a worker thread, meant for CPU-side asset loading (file IO, decoding), so it must not touch
+		// Vulkan, ImGui or Image. It starts as soon as the layer is pushed, for layers pushed before Application::Run
+		// overlapping Vulkan initialization. OnAttach is called on the main thread after it has returned, before the
+		// layer's first OnUpdate, and every pending OnAttachAsync has returned before the next OnUpdate of any layer.
+		virtual void OnAttachAsync() {}
+
+		// On the fixed update thread when ApplicationSpecification::FixedUpdateRate is set, see its restrictions
 		virtual void OnUpdate(float ts) {}
 		virtual void OnUIRender() {}
+
+		// Record GPU work into the main window's command buffer, after every layer's OnUIRender. It is submitted
+		// with the frame, so there is no extra submit or CPU wait as with Application::GetCommandBuffer.
+		// OnRender runs before the render pass that draws ImGui: record compute dispatches, uploads and offscreen
+		// passes here, ending with a barrier that makes the results visible to fragment shaders if ImGui draws them.
+		// OnRenderInPass runs inside that render pass, before ImGui draws, with pipelines created against
+		// Application::GetRenderPass(). Neither is called while the main window is minimized.
+		virtual void OnRender(VkCommandBuffer commandBuffer) {}
+		virtual void OnRenderInPass(VkCommandBuffer commandBuffer) {}
+
+		// Layers returning true get OnUpdate called on a worker thread, concurrently with other
+		// parallel layers and with the main thread's layers. OnUIRender stays on the main thread.
+		// A parallel OnUpdate must not touch Vulkan, Image, StreamingImage or anything else that submits to the queue
+		// or frees through Application::SubmitResourceFree: hand the data to OnUIRender or OnRender instead.
+		virtual bool IsUpdateParallel() const { return false; }
 	};
 
 }
\ No newline at end of file
@@ -0,0 +1,137 @@
+#include "LayerUpdateScheduler.h"
+
+#include <iostream>
+#include <unordered_map>
+
+namespace Walnut {
+
+	void LayerUpdateScheduler::AddDependency(Layer* layer, Layer* dependency)
+	{
+		m_Dependencies.emplace_back(layer, dependency);
+		m_Dirty = true;
+	}
+
+	void LayerUpdateScheduler::Rebuild(const std::vector<std::shared_ptr<Layer>>& layerStack)
+	{
+		m_Nodes.clear();
+		m_RootNodes.clear();
+		m_SerialLayers.clear();
+
+		std::unordered_map<Layer*, uint32_t> nodeIndices;
+		for (auto& layer : layerStack)
+		{
+			if (layer->IsUpdateParallel())
+			{
+				nodeIndices[layer.get()] = (uint32_t)m_Nodes.size();
+				m_Nodes.emplace_back().UpdateLayer = layer.get();
+			}
+			else
+			{
+				m_SerialLayers.push_back(layer.get());
+			}
+		}
+
+		for (auto& [layer, dependency] : m_Dependencies)
+		{
+			auto layerIt = nodeIndices.find(layer);
+			auto dependencyIt = nodeIndices.find(dependency);
+			if (layerIt == nodeIndices.end() || dependencyIt == nodeIndices.end())
+			{
+				std::cerr << "[Walnut] Ignoring layer update dependency, both layers must be pushed and update in parallel\n";
+				continue;
+			}
+
+			m_Nodes[dependencyIt->second].Dependents.push_back(layerIt->second);
+			m_Nodes[layerIt->second].DependencyCount++;
+		}
+
+		// Kahn's algorithm, any node never reached is part of a cycle
+		std::vector<uint32_t> pending(m_Nodes.size());
+		std::vector<uint32_t> ready;
+		for (uint32_t i = 0; i < (uint32_t)m_Nodes.size(); i++)
+		{
+			pending[i] = m_Nodes[i].DependencyCount;
+			if (pending[i] == 0)
+			{
+				m_RootNodes.push_back(i);
+				ready.push_back(i);
+			}
+		}
+
+		uint32_t visited = 0;
+		while (!ready.empty())
+		{
+			uint32_t index = ready.back();
+			ready.pop_back();
+			visited++;
+
+			for (uint32_t dependent : m_Nodes[index].Dependents)
+			{
+				if (--pending[dependent] == 0)
+					ready.push_back(dependent);
+			}
+		}
+
+		if (visited != m_Nodes.size())
+		{
+			std::cerr << "[Walnut] Layer update dependencies contain a cycle, updating all layers serially\n";
+			m_SerialLayers.clear();
+			for (auto& layer : layerStack)
+				m_SerialLayers.push_back(layer.get());
+			m_Nodes.clear();
+			m_RootNodes.clear();
+		}
+
+		m_PendingDependencies = std::make_unique<std::atomic<uint32_t>[]>(m_Nodes.size());
+		m_Dirty = false;
+	}
+
+	void LayerUpdateScheduler::Update(const std::vector<std::shared_ptr<Layer>>& layerStack, float ts, ThreadPool& threadPool)
+	{
+		if (m_Dirty)
+			Rebuild(layerStack);
+
+		if (m_Nodes.empty())
+		{
+			for (Layer* layer : m_SerialLayers)
+				layer->OnUpdate(ts);
+			return;
+		}
+
+		m_ThreadPool = &threadPool;
+		m_TimeStep = ts;
+		m_InputState = &Input::GetState();
+		m_RemainingNodes = (uint32_t)m_Nodes.size();
+		for (uint32_t i = 0; i < (uint32_t)m_Nodes.size(); i++)
+			m_PendingDependencies[i].store(m_Nodes[i].DependencyCount, std::memory_order_relaxed);
+
+		for (uint32_t index : m_RootNodes)
+			threadPool.Submit([this, index]() { RunNode(index); });
+
+		for (Layer* layer : m_SerialLayers)
+			layer->OnUpdate(ts);
+
+		std::unique_lock<std::mutex> lock(m_CompletionMutex);
+		m_CompletionCondition.wait(lock, [this]() { return m_RemainingNodes == 0; });
+	}
+
+	void LayerUpdateScheduler::RunNode(uint32_t nodeIndex)
+	{
+		const Node& node = m_Nodes[nodeIndex];
+		const InputState* previousInputState = Input::SetThreadState(m_InputState);
+		node.UpdateLayer->OnUpdate(m_TimeStep);
+		Input::SetThreadState(previousInputState);
+
+		for (uint32_t dependent : node.Dependents)
+		{
+			if (m_PendingDependencies[dependent].fetch_sub(1, std::memory_order_acq_rel) == 1)
+				m_ThreadPool->Submit([this, dependent]() { RunNode(dependent); });
+		}
+
+		// Notify under the lock, Update may return and start the next frame as soon as it sees zero
+		std::scoped_lock<std::mutex> lock(m_CompletionMutex);
+		if (--m_RemainingNodes == 0)
+			m_CompletionCondition.notify_all();
+	}
+
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "Layer.h"
+#include "ThreadPool.h"
+#include "Input/Input.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace Walnut {
+
+	// Runs Layer::OnUpdate for a layer stack. Layers that opt in through Layer::IsUpdateParallel
+	// are dispatched to the thread pool as a dependency graph while the remaining layers update
+	// on the calling thread in stack order; Update returns once every layer has finished.
+	class LayerUpdateScheduler
+	{
+	public:
+		// `layer` will only start updating once `dependency` has finished. Both must be parallel layers.
+		void AddDependency(Layer* layer, Layer* dependency);
+
+		// Must be called whenever the layer stack changes
+		void Invalidate() { m_Dirty = true; }
+
+		void Update(const std::vector<std::shared_ptr<Layer>>& layerStack, float ts, ThreadPool& threadPool);
+	private:
+		void Rebuild(const std::vector<std::shared_ptr<Layer>>& layerStack);
+		void RunNode(uint32_t nodeIndex);
+	private:
+		struct Node
+		{
+			Layer* UpdateLayer = nullptr;
+			std::vector<uint32_t> Dependents;
+			uint32_t DependencyCount = 0;
+		};
+
+		std::vector<std::pair<Layer*, Layer*>> m_Dependencies;
+
+		std::vector<Node> m_Nodes;
+		std::vector<uint32_t> m_RootNodes;
+		std::vector<Layer*> m_SerialLayers;
+		bool m_Dirty = true;
+
+		// Per-update state, only touched while an Update is in progress
+		std::unique_ptr<std::atomic<uint32_t>[]> m_PendingDependencies;
+		ThreadPool* m_ThreadPool = nullptr;
+		float m_TimeStep = 0.0f;
+		const InputState* m_InputState = nullptr; // The calling thread's, see Input
+
+		std::mutex m_CompletionMutex;
+		std::condition_variable m_CompletionCondition;
+		uint32_t m_RemainingNodes = 0;
+	};
+
+}
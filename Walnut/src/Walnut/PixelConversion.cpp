@@ -0,0 +1,601 @@
+#include "PixelConversion.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+	#define WL_PIXEL_CONVERSION_X86
+	#include <immintrin.h>
+	#ifdef _MSC_VER
+		#include <intrin.h>
+		#define WL_TARGET_SSE41
+		#define WL_TARGET_AVX2
+	#else
+		#define WL_TARGET_SSE41 __attribute__((target("sse4.1")))
+		#define WL_TARGET_AVX2 __attribute__((target("avx2")))
+	#endif
+#endif
+
+namespace Walnut {
+
+	// Polynomial fits of log2(1 + t) and 2^t on [0, 1), accurate to ~2e-5, far below 1/255.
+	// Every SIMD level evaluates them with the same operations, so all levels round to the same bytes.
+	static constexpr float c_Log2Coefficients[] = { 1.6514671e-05f, 1.4414924f, -0.70648645f, 0.40947030f, -0.18748860f, 0.043004958f };
+	static constexpr float c_Exp2Coefficients[] = { 1.0000035f, 0.69297292f, 0.24160436f, 0.051744998f, 0.013670309f };
+
+	static constexpr float c_SRGBLinearThreshold = 0.0031308f;
+	static constexpr float c_SRGBInverseGamma = 1.0f / 2.4f;
+
+	static std::atomic<SIMDLevel> s_MaxSIMDLevel = SIMDLevel::AVX2;
+
+	struct EncodeSettings
+	{
+		float Scale = 1.0f;
+		float InverseGamma = 1.0f / 2.2f;
+	};
+
+	namespace Utils {
+
+		static float FloatFromBits(uint32_t bits)
+		{
+			float value;
+			memcpy(&value, &bits, sizeof(value));
+			return value;
+		}
+
+		static uint32_t FloatToBits(float value)
+		{
+			uint32_t bits;
+			memcpy(&bits, &value, sizeof(bits));
+			return bits;
+		}
+
+		// x >= 0, zero and denormals come out around -127
+		static float FastLog2(float x)
+		{
+			uint32_t bits = FloatToBits(x);
+			float exponent = (float)((int32_t)(bits >> 23) - 127);
+			float t = FloatFromBits((bits & 0x007fffff) | 0x3f800000) - 1.0f;
+
+			float p = c_Log2Coefficients[5];
+			p = p * t + c_Log2Coefficients[4];
+			p = p * t + c_Log2Coefficients[3];
+			p = p * t + c_Log2Coefficients[2];
+			p = p * t + c_Log2Coefficients[1];
+			p = p * t + c_Log2Coefficients[0];
+			return exponent + p;
+		}
+
+		// y <= ~0, anything below -126 flushes towards zero
+		static float FastExp2(float y)
+		{
+			y = y > -126.0f ? y : -126.0f;
+			float i = std::floor(y);
+			float t = y - i;
+
+			float p = c_Exp2Coefficients[4];
+			p = p * t + c_Exp2Coefficients[3];
+			p = p * t + c_Exp2Coefficients[2];
+			p = p * t + c_Exp2Coefficients[1];
+			p = p * t + c_Exp2Coefficients[0];
+			return p * FloatFromBits((uint32_t)((int32_t)i + 127) << 23);
+		}
+
+		template<ColorEncoding Encoding>
+		static uint32_t EncodeChannel(float value, const EncodeSettings& settings, bool alpha)
+		{
+			// Written so NaN clamps to 0, like the SIMD min/max
+			value *= settings.Scale;
+			value = value > 0.0f ? value : 0.0f;
+			value = value < 1.0f ? value : 1.0f;
+
+			if (!alpha)
+			{
+				if constexpr (Encoding == ColorEncoding::SRGB)
+					value = value <= c_SRGBLinearThreshold ? value * 12.92f : 1.055f * FastExp2(FastLog2(value) * c_SRGBInverseGamma) - 0.055f;
+				else if constexpr (Encoding == ColorEncoding::Gamma)
+					value = FastExp2(FastLog2(value) * settings.InverseGamma);
+			}
+
+			return (uint32_t)(value * 255.0f + 0.5f);
+		}
+
+		template<ColorEncoding Encoding>
+		static void FloatToRGBA8Scalar(const float* source, uint32_t* destination, size_t pixelCount, const EncodeSettings& settings)
+		{
+			for (size_t i = 0; i < pixelCount; i++)
+			{
+				const float* pixel = source + i * 4;
+				uint32_t r = EncodeChannel<Encoding>(pixel[0], settings, false);
+				uint32_t g = EncodeChannel<Encoding>(pixel[1], settings, false);
+				uint32_t b = EncodeChannel<Encoding>(pixel[2], settings, false);
+				uint32_t a = EncodeChannel<Encoding>(pixel[3], settings, true);
+				destination[i] = r | (g << 8) | (b << 16) | (a << 24);
+			}
+		}
+
+		static void ScaleFloatsScalar(const float* source, float* destination, size_t count, float scale)
+		{
+			for (size_t i = 0; i < count; i++)
+				destination[i] = source[i] * scale;
+		}
+
+		static void SwizzleRGBA8BGRA8Scalar(const uint32_t* source, uint32_t* destination, size_t pixelCount)
+		{
+			for (size_t i = 0; i < pixelCount; i++)
+			{
+				uint32_t pixel = source[i];
+				destination[i] = (pixel & 0xff00ff00) | ((pixel >> 16) & 0xff) | ((pixel & 0xff) << 16);
+			}
+		}
+
+		// Round to nearest even without a branch on the rounding itself
+		static uint16_t FloatToHalfScalar(float value)
+		{
+			const uint32_t f32Infinity = 255u << 23;
+			const uint32_t f16Overflow = (127u + 16u) << 23;
+			const uint32_t denormalMagic = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+
+			uint32_t bits = FloatToBits(value);
+			uint32_t sign = bits & 0x80000000u;
+			bits ^= sign;
+
+			uint32_t half;
+			if (bits >= f16Overflow)
+			{
+				half = bits > f32Infinity ? 0x7e00 : 0x7c00;
+			}
+			else if (bits < (113u << 23))
+			{
+				// Denormal or zero, let the FPU do the rounding
+				half = FloatToBits(FloatFromBits(bits) + FloatFromBits(denormalMagic)) - denormalMagic;
+			}
+			else
+			{
+				uint32_t mantissaOdd = (bits >> 13) & 1;
+				bits += ((uint32_t)(15 - 127) << 23) + 0xfff;
+				bits += mantissaOdd;
+				half = bits >> 13;
+			}
+
+			return (uint16_t)(half | (sign >> 16));
+		}
+
+		static void FloatToHalfScalar(const float* source, uint16_t* destination, size_t count)
+		{
+			for (size_t i = 0; i < count; i++)
+				destination[i] = FloatToHalfScalar(source[i]);
+		}
+
+#ifdef WL_PIXEL_CONVERSION_X86
+
+		//////////////////////////////////////////////////////////////////////////////////
+		// SSE4.1
+		//////////////////////////////////////////////////////////////////////////////////
+
+		WL_TARGET_SSE41 static inline __m128 FastLog2SSE41(__m128 x)
+		{
+			__m128i bits = _mm_castps_si128(x);
+			__m128 exponent = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127)));
+			__m128i mantissa = _mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007fffff)), _mm_set1_epi32(0x3f800000));
+			__m128 t = _mm_sub_ps(_mm_castsi128_ps(mantissa), _mm_set1_ps(1.0f));
+
+			__m128 p = _mm_set1_ps(c_Log2Coefficients[5]);
+			p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(c_Log2Coefficients[4]));
+			p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(c_Log2Coefficients[3]));
+			p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(c_Log2Coefficients[2]));
+			p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(c_Log2Coefficients[1]));
+			p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(c_Log2Coefficients[0]));
+			return _mm_add_ps(exponent, p);
+		}
+
+		WL_TARGET_SSE41 static inline __m128 FastExp2SSE41(__m128 y)
+		{
+			y = _mm_max_ps(y, _mm_set1_ps(-126.0f));
+			__m128 i = _mm_floor_ps(y);
+			__m128 t = _mm_sub_ps(y, i);
+
+			__m128 p = _mm_set1_ps(c_Exp2Coefficients[4]);
+			p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(c_Exp2Coefficients[3]));
+			p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(c_Exp2Coefficients[2]));
+			p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(c_Exp2Coefficients[1]));
+			p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(c_Exp2Coefficients[0]));
+			__m128i scale = _mm_slli_epi32(_mm_add_epi32(_mm_cvtps_epi32(i), _mm_set1_epi32(127)), 23);
+			return _mm_mul_ps(p, _mm_castsi128_ps(scale));
+		}
+
+		// One RGBA pixel per register, returns 32-bit channel values
+		template<ColorEncoding Encoding>
+		WL_TARGET_SSE41 static inline __m128i EncodePixelSSE41(__m128 pixel, __m128 scale, __m128 inverseGamma)
+		{
+			pixel = _mm_mul_ps(pixel, scale);
+			pixel = _mm_max_ps(pixel, _mm_setzero_ps());
+			pixel = _mm_min_ps(pixel, _mm_set1_ps(1.0f));
+
+			__m128 encoded = pixel;
+			if constexpr (Encoding == ColorEncoding::SRGB)
+			{
+				__m128 low = _mm_mul_ps(pixel, _mm_set1_ps(12.92f));
+				__m128 high = FastExp2SSE41(_mm_mul_ps(FastLog2SSE41(pixel), _mm_set1_ps(c_SRGBInverseGamma)));
+				high = _mm_sub_ps(_mm_mul_ps(high, _mm_set1_ps(1.055f)), _mm_set1_ps(0.055f));
+				encoded = _mm_blendv_ps(high, low, _mm_cmple_ps(pixel, _mm_set1_ps(c_SRGBLinearThreshold)));
+			}
+			else if constexpr (Encoding == ColorEncoding::Gamma)
+			{
+				encoded = FastExp2SSE41(_mm_mul_ps(FastLog2SSE41(pixel), inverseGamma));
+			}
+
+			// Alpha stays linear
+			encoded = _mm_blend_ps(encoded, pixel, 0x8);
+			return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(encoded, _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f)));
+		}
+
+		template<ColorEncoding Encoding>
+		WL_TARGET_SSE41 static void FloatToRGBA8SSE41(const float* source, uint32_t* destination, size_t pixelCount, const EncodeSettings& settings)
+		{
+			const __m128 scale = _mm_set1_ps(settings.Scale);
+			const __m128 inverseGamma = _mm_set1_ps(settings.InverseGamma);
+
+			size_t i = 0;
+			for (; i + 4 <= pixelCount; i += 4)
+			{
+				const float* pixels = source + i * 4;
+				__m128i p0 = EncodePixelSSE41<Encoding>(_mm_loadu_ps(pixels + 0), scale, inverseGamma);
+				__m128i p1 = EncodePixelSSE41<Encoding>(_mm_loadu_ps(pixels + 4), scale, inverseGamma);
+				__m128i p2 = EncodePixelSSE41<Encoding>(_mm_loadu_ps(pixels + 8), scale, inverseGamma);
+				__m128i p3 = EncodePixelSSE41<Encoding>(_mm_loadu_ps(pixels + 12), scale, inverseGamma);
+
+				__m128i packed = _mm_packus_epi16(_mm_packus_epi32(p0, p1), _mm_packus_epi32(p2, p3));
+				_mm_storeu_si128((__m128i*)(destination + i), packed);
+			}
+
+			FloatToRGBA8Scalar<Encoding>(source + i * 4, destination + i, pixelCount - i, settings);
+		}
+
+		WL_TARGET_SSE41 static void ScaleFloatsSSE41(const float* source, float* destination, size_t count, float scale)
+		{
+			const __m128 scaleVector = _mm_set1_ps(scale);
+
+			size_t i = 0;
+			for (; i + 4 <= count; i += 4)
+				_mm_storeu_ps(destination + i, _mm_mul_ps(_mm_loadu_ps(source + i), scaleVector));
+
+			ScaleFloatsScalar(source + i, destination + i, count - i, scale);
+		}
+
+		WL_TARGET_SSE41 static void SwizzleRGBA8BGRA8SSE41(const uint32_t* source, uint32_t* destination, size_t pixelCount)
+		{
+			const __m128i shuffle = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+
+			size_t i = 0;
+			for (; i + 4 <= pixelCount; i += 4)
+			{
+				__m128i pixels = _mm_loadu_si128((const __m128i*)(source + i));
+				_mm_storeu_si128((__m128i*)(destination + i), _mm_shuffle_epi8(pixels, shuffle));
+			}
+
+			SwizzleRGBA8BGRA8Scalar(source + i, destination + i, pixelCount - i);
+		}
+
+		// FloatToHalfScalar with every case computed and blended
+		WL_TARGET_SSE41 static inline __m128i FloatToHalfSSE41(__m128 value)
+		{
+			const __m128i denormalMagic = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+
+			__m128i bits = _mm_castps_si128(value);
+			__m128i sign = _mm_and_si128(bits, _mm_set1_epi32((int)0x80000000u));
+			bits = _mm_xor_si128(bits, sign);
+
+			__m128i isNaN = _mm_cmpgt_epi32(bits, _mm_set1_epi32(255 << 23));
+			__m128i infinityOrNaN = _mm_or_si128(_mm_set1_epi32(0x7c00), _mm_and_si128(isNaN, _mm_set1_epi32(0x0200)));
+
+			__m128i denormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(_mm_castsi128_ps(bits), _mm_castsi128_ps(denormalMagic))), denormalMagic);
+
+			__m128i mantissaOdd = _mm_and_si128(_mm_srli_epi32(bits, 13), _mm_set1_epi32(1));
+			__m128i normal = _mm_add_epi32(bits, _mm_set1_epi32(((15 - 127) * (1 << 23)) + 0xfff));
+			normal = _mm_srli_epi32(_mm_add_epi32(normal, mantissaOdd), 13);
+
+			__m128i isOverflow = _mm_cmpgt_epi32(bits, _mm_set1_epi32(((127 + 16) << 23) - 1));
+			__m128i isDenormal = _mm_cmpgt_epi32(_mm_set1_epi32(113 << 23), bits);
+
+			__m128i half = _mm_blendv_epi8(normal, denormal, isDenormal);
+			half = _mm_blendv_epi8(half, infinityOrNaN, isOverflow);
+			return _mm_or_si128(half, _mm_srli_epi32(sign, 16));
+		}
+
+		WL_TARGET_SSE41 static void FloatToHalfSSE41(const float* source, uint16_t* destination, size_t count)
+		{
+			size_t i = 0;
+			for (; i + 8 <= count; i += 8)
+			{
+				__m128i low = FloatToHalfSSE41(_mm_loadu_ps(source + i));
+				__m128i high = FloatToHalfSSE41(_mm_loadu_ps(source + i + 4));
+				_mm_storeu_si128((__m128i*)(destination + i), _mm_packus_epi32(low, high));
+			}
+
+			FloatToHalfScalar(source + i, destination + i, count - i);
+		}
+
+		//////////////////////////////////////////////////////////////////////////////////
+		// AVX2
+		//////////////////////////////////////////////////////////////////////////////////
+
+		WL_TARGET_AVX2 static inline __m256 FastLog2AVX2(__m256 x)
+		{
+			__m256i bits = _mm256_castps_si256(x);
+			__m256 exponent = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127)));
+			__m256i mantissa = _mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007fffff)), _mm256_set1_epi32(0x3f800000));
+			__m256 t = _mm256_sub_ps(_mm256_castsi256_ps(mantissa), _mm256_set1_ps(1.0f));
+
+			__m256 p = _mm256_set1_ps(c_Log2Coefficients[5]);
+			p = _mm256_add_ps(_mm256_mul_ps(p, t), _mm256_set1_ps(c_Log2Coefficients[4]));
+			p = _mm256_add_ps(_mm256_mul_ps(p, t), _mm256_set1_ps(c_Log2Coefficients[3]));
+			p = _mm256_add_ps(_mm256_mul_ps(p, t), _mm256_set1_ps(c_Log2Coefficients[2]));
+			p = _mm256_add_ps(_mm256_mul_ps(p, t), _mm256_set1_ps(c_Log2Coefficients[1]));
+			p = _mm256_add_ps(_mm256_mul_ps(p, t), _mm256_set1_ps(c_Log2Coefficients[0]));
+			return _mm256_add_ps(exponent, p);
+		}
+
+		WL_TARGET_AVX2 static inline __m256 FastExp2AVX2(__m256 y)
+		{
+			y = _mm256_max_ps(y, _mm256_set1_ps(-126.0f));
+			__m256 i = _mm256_floor_ps(y);
+			__m256 t = _mm256_sub_ps(y, i);
+
+			__m256 p = _mm256_set1_ps(c_Exp2Coefficients[4]);
+			p = _mm256_add_ps(_mm256_mul_ps(p, t), _mm256_set1_ps(c_Exp2Coefficients[3]));
+			p = _mm256_add_ps(_mm256_mul_ps(p, t), _mm256_set1_ps(c_Exp2Coefficients[2]));
+			p = _mm256_add_ps(_mm256_mul_ps(p, t), _mm256_set1_ps(c_Exp2Coefficients[1]));
+			p = _mm256_add_ps(_mm256_mul_ps(p, t), _mm256_set1_ps(c_Exp2Coefficients[0]));
+			__m256i scale = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(i), _mm256_set1_epi32(127)), 23);
+			return _mm256_mul_ps(p, _mm256_castsi256_ps(scale));
+		}
+
+		// Two RGBA pixels per register
+		template<ColorEncoding Encoding>
+		WL_TARGET_AVX2 static inline __m256i EncodePixelsAVX2(__m256 pixels, __m256 scale, __m256 inverseGamma)
+		{
+			pixels = _mm256_mul_ps(pixels, scale);
+			pixels = _mm256_max_ps(pixels, _mm256_setzero_ps());
+			pixels = _mm256_min_ps(pixels, _mm256_set1_ps(1.0f));
+
+			__m256 encoded = pixels;
+			if constexpr (Encoding == ColorEncoding::SRGB)
+			{
+				__m256 low = _mm256_mul_ps(pixels, _mm256_set1_ps(12.92f));
+				__m256 high = FastExp2AVX2(_mm256_mul_ps(FastLog2AVX2(pixels), _mm256_set1_ps(c_SRGBInverseGamma)));
+				high = _mm256_sub_ps(_mm256_mul_ps(high, _mm256_set1_ps(1.055f)), _mm256_set1_ps(0.055f));
+				encoded = _mm256_blendv_ps(high, low, _mm256_cmp_ps(pixels, _mm256_set1_ps(c_SRGBLinearThreshold), _CMP_LE_OQ));
+			}
+			else if constexpr (Encoding == ColorEncoding::Gamma)
+			{
+				encoded = FastExp2AVX2(_mm256_mul_ps(FastLog2AVX2(pixels), inverseGamma));
+			}
+
+			encoded = _mm256_blend_ps(encoded, pixels, 0x88);
+			return _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(encoded, _mm256_set1_ps(255.0f)), _mm256_set1_ps(0.5f)));
+		}
+
+		template<ColorEncoding Encoding>
+		WL_TARGET_AVX2 static void FloatToRGBA8AVX2(const float* source, uint32_t* destination, size_t pixelCount, const EncodeSettings& settings)
+		{
+			const __m256 scale = _mm256_set1_ps(settings.Scale);
+			const __m256 inverseGamma = _mm256_set1_ps(settings.InverseGamma);
+
+			// The packs work within 128-bit lanes, leaving pixels in the order 0 2 4 6 | 1 3 5 7
+			const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+			size_t i = 0;
+			for (; i + 8 <= pixelCount; i += 8)
+			{
+				const float* pixels = source + i * 4;
+				__m256i p01 = EncodePixelsAVX2<Encoding>(_mm256_loadu_ps(pixels + 0), scale, inverseGamma);
+				__m256i p23 = EncodePixelsAVX2<Encoding>(_mm256_loadu_ps(pixels + 8), scale, inverseGamma);
+				__m256i p45 = EncodePixelsAVX2<Encoding>(_mm256_loadu_ps(pixels + 16), scale, inverseGamma);
+				__m256i p67 = EncodePixelsAVX2<Encoding>(_mm256_loadu_ps(pixels + 24), scale, inverseGamma);
+
+				__m256i packed = _mm256_packus_epi16(_mm256_packus_epi32(p01, p23), _mm256_packus_epi32(p45, p67));
+				_mm256_storeu_si256((__m256i*)(destination + i), _mm256_permutevar8x32_epi32(packed, order));
+			}
+
+			FloatToRGBA8Scalar<Encoding>(source + i * 4, destination + i, pixelCount - i, settings);
+		}
+
+		WL_TARGET_AVX2 static void ScaleFloatsAVX2(const float* source, float* destination, size_t count, float scale)
+		{
+			const __m256 scaleVector = _mm256_set1_ps(scale);
+
+			size_t i = 0;
+			for (; i + 8 <= count; i += 8)
+				_mm256_storeu_ps(destination + i, _mm256_mul_ps(_mm256_loadu_ps(source + i), scaleVector));
+
+			ScaleFloatsScalar(source + i, destination + i, count - i, scale);
+		}
+
+		WL_TARGET_AVX2 static void SwizzleRGBA8BGRA8AVX2(const uint32_t* source, uint32_t* destination, size_t pixelCount)
+		{
+			const __m256i shuffle = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+				2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+
+			size_t i = 0;
+			for (; i + 8 <= pixelCount; i += 8)
+			{
+				__m256i pixels = _mm256_loadu_si256((const __m256i*)(source + i));
+				_mm256_storeu_si256((__m256i*)(destination + i), _mm256_shuffle_epi8(pixels, shuffle));
+			}
+
+			SwizzleRGBA8BGRA8Scalar(source + i, destination + i, pixelCount - i);
+		}
+
+		WL_TARGET_AVX2 static inline __m256i FloatToHalfAVX2(__m256 value)
+		{
+			const __m256i denormalMagic = _mm256_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+
+			__m256i bits = _mm256_castps_si256(value);
+			__m256i sign = _mm256_and_si256(bits, _mm256_set1_epi32((int)0x80000000u));
+			bits = _mm256_xor_si256(bits, sign);
+
+			__m256i isNaN = _mm256_cmpgt_epi32(bits, _mm256_set1_epi32(255 << 23));
+			__m256i infinityOrNaN = _mm256_or_si256(_mm256_set1_epi32(0x7c00), _mm256_and_si256(isNaN, _mm256_set1_epi32(0x0200)));
+
+			__m256i denormal = _mm256_sub_epi32(_mm256_castps_si256(_mm256_add_ps(_mm256_castsi256_ps(bits), _mm256_castsi256_ps(denormalMagic))), denormalMagic);
+
+			__m256i mantissaOdd = _mm256_and_si256(_mm256_srli_epi32(bits, 13), _mm256_set1_epi32(1));
+			__m256i normal = _mm256_add_epi32(bits, _mm256_set1_epi32(((15 - 127) * (1 << 23)) + 0xfff));
+			normal = _mm256_srli_epi32(_mm256_add_epi32(normal, mantissaOdd), 13);
+
+			__m256i isOverflow = _mm256_cmpgt_epi32(bits, _mm256_set1_epi32(((127 + 16) << 23) - 1));
+			__m256i isDenormal = _mm256_cmpgt_epi32(_mm256_set1_epi32(113 << 23), bits);
+
+			__m256i half = _mm256_blendv_epi8(normal, denormal, isDenormal);
+			half = _mm256_blendv_epi8(half, infinityOrNaN, isOverflow);
+			return _mm256_or_si256(half, _mm256_srli_epi32(sign, 16));
+		}
+
+		WL_TARGET_AVX2 static void FloatToHalfAVX2(const float* source, uint16_t* destination, size_t count)
+		{
+			size_t i = 0;
+			for (; i + 16 <= count; i += 16)
+			{
+				__m256i low = FloatToHalfAVX2(_mm256_loadu_ps(source + i));
+				__m256i high = FloatToHalfAVX2(_mm256_loadu_ps(source + i + 8));
+
+				// Per-lane pack gives 0-3 8-11 | 4-7 12-15
+				__m256i packed = _mm256_packus_epi32(low, high);
+				_mm256_storeu_si256((__m256i*)(destination + i), _mm256_permute4x64_epi64(packed, 0xd8));
+			}
+
+			FloatToHalfScalar(source + i, destination + i, count - i);
+		}
+
+#endif
+
+		static SIMDLevel DetectSIMDLevel()
+		{
+#ifdef WL_PIXEL_CONVERSION_X86
+	#ifdef _MSC_VER
+			int info[4];
+			__cpuid(info, 0);
+			int maxLeaf = info[0];
+
+			__cpuid(info, 1);
+			bool sse41 = (info[2] & (1 << 19)) != 0;
+			bool osxsave = (info[2] & (1 << 27)) != 0;
+			bool avx = (info[2] & (1 << 28)) != 0;
+
+			// AVX state must also be enabled by the OS
+			bool avx2 = false;
+			if (maxLeaf >= 7 && osxsave && avx && (_xgetbv(0) & 0x6) == 0x6)
+			{
+				__cpuidex(info, 7, 0);
+				avx2 = (info[1] & (1 << 5)) != 0;
+			}
+	#else
+			__builtin_cpu_init();
+			bool sse41 = __builtin_cpu_supports("sse4.1");
+			bool avx2 = __builtin_cpu_supports("avx2");
+	#endif
+			if (avx2)
+				return SIMDLevel::AVX2;
+			if (sse41)
+				return SIMDLevel::SSE41;
+#endif
+			return SIMDLevel::Scalar;
+		}
+
+		template<ColorEncoding Encoding>
+		static void FloatToRGBA8(const float* source, uint32_t* destination, size_t pixelCount, const EncodeSettings& settings)
+		{
+			switch (PixelConversion::GetSIMDLevel())
+			{
+#ifdef WL_PIXEL_CONVERSION_X86
+				case SIMDLevel::AVX2:  FloatToRGBA8AVX2<Encoding>(source, destination, pixelCount, settings); return;
+				case SIMDLevel::SSE41: FloatToRGBA8SSE41<Encoding>(source, destination, pixelCount, settings); return;
+#endif
+				default:               FloatToRGBA8Scalar<Encoding>(source, destination, pixelCount, settings); return;
+			}
+		}
+
+		static void FloatToRGBA8(const float* source, uint32_t* destination, size_t pixelCount, ColorEncoding encoding, const EncodeSettings& settings)
+		{
+			switch (encoding)
+			{
+				case ColorEncoding::Linear: FloatToRGBA8<ColorEncoding::Linear>(source, destination, pixelCount, settings); return;
+				case ColorEncoding::SRGB:   FloatToRGBA8<ColorEncoding::SRGB>(source, destination, pixelCount, settings); return;
+				case ColorEncoding::Gamma:  FloatToRGBA8<ColorEncoding::Gamma>(source, destination, pixelCount, settings); return;
+			}
+		}
+
+	}
+
+	void PixelConversion::FloatToRGBA8(const float* source, uint32_t* destination, size_t pixelCount, ColorEncoding encoding, float gamma)
+	{
+		EncodeSettings settings;
+		settings.InverseGamma = 1.0f / gamma;
+		Utils::FloatToRGBA8(source, destination, pixelCount, encoding, settings);
+	}
+
+	void PixelConversion::AccumulationToRGBA8(const float* accumulation, uint32_t* destination, size_t pixelCount, uint32_t sampleCount, ColorEncoding encoding, float gamma)
+	{
+		EncodeSettings settings;
+		settings.Scale = 1.0f / (float)std::max(sampleCount, 1u);
+		settings.InverseGamma = 1.0f / gamma;
+		Utils::FloatToRGBA8(accumulation, destination, pixelCount, encoding, settings);
+	}
+
+	void PixelConversion::AverageAccumulation(const float* accumulation, float* destination, size_t floatCount, uint32_t sampleCount)
+	{
+		float scale = 1.0f / (float)std::max(sampleCount, 1u);
+		switch (GetSIMDLevel())
+		{
+#ifdef WL_PIXEL_CONVERSION_X86
+			case SIMDLevel::AVX2:  Utils::ScaleFloatsAVX2(accumulation, destination, floatCount, scale); return;
+			case SIMDLevel::SSE41: Utils::ScaleFloatsSSE41(accumulation, destination, floatCount, scale); return;
+#endif
+			default:               Utils::ScaleFloatsScalar(accumulation, destination, floatCount, scale); return;
+		}
+	}
+
+	void PixelConversion::SwizzleRGBA8BGRA8(const uint32_t* source, uint32_t* destination, size_t pixelCount)
+	{
+		switch (GetSIMDLevel())
+		{
+#ifdef WL_PIXEL_CONVERSION_X86
+			case SIMDLevel::AVX2:  Utils::SwizzleRGBA8BGRA8AVX2(source, destination, pixelCount); return;
+			case SIMDLevel::SSE41: Utils::SwizzleRGBA8BGRA8SSE41(source, destination, pixelCount); return;
+#endif
+			default:               Utils::SwizzleRGBA8BGRA8Scalar(source, destination, pixelCount); return;
+		}
+	}
+
+	void PixelConversion::FloatToHalf(const float* source, uint16_t* destination, size_t count)
+	{
+		switch (GetSIMDLevel())
+		{
+#ifdef WL_PIXEL_CONVERSION_X86
+			case SIMDLevel::AVX2:  Utils::FloatToHalfAVX2(source, destination, count); return;
+			case SIMDLevel::SSE41: Utils::FloatToHalfSSE41(source, destination, count); return;
+#endif
+			default:               Utils::FloatToHalfScalar(source, destination, count); return;
+		}
+	}
+
+	SIMDLevel PixelConversion::GetSupportedSIMDLevel()
+	{
+		static const SIMDLevel s_SupportedLevel = Utils::DetectSIMDLevel();
+		return s_SupportedLevel;
+	}
+
+	SIMDLevel PixelConversion::GetSIMDLevel()
+	{
+		return std::min(GetSupportedSIMDLevel(), s_MaxSIMDLevel.load(std::memory_order_relaxed));
+	}
+
+	void PixelConversion::SetSIMDLevel(SIMDLevel level)
+	{
+		s_MaxSIMDLevel = level;
+	}
+
+}
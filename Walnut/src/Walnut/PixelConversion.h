@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <glm/glm.hpp>
+
+namespace Walnut {
+
+	enum class ColorEncoding : uint8_t
+	{
+		Linear = 0,
+		SRGB,   // sRGB transfer function, for an UNORM swapchain like Walnut's
+		Gamma   // x^(1 / gamma)
+	};
+
+	enum class SIMDLevel : uint8_t
+	{
+		Scalar = 0,
+		SSE41,
+		AVX2
+	};
+
+	// Pixel loops for preparing Image data. Kernels are picked at runtime from the best instruction
+	// set the CPU supports, every level produces the same output. Packed RGBA8 matches ImageFormat::RGBA:
+	// R in the lowest byte. Source and destination may be the same buffer where the element sizes match.
+	class PixelConversion
+	{
+	public:
+		// RGBA floats to RGBA8, clamped to [0, 1]. Alpha is always stored linearly
+		static void FloatToRGBA8(const float* source, uint32_t* destination, size_t pixelCount, ColorEncoding encoding = ColorEncoding::Linear, float gamma = 2.2f);
+		static void FloatToRGBA8(const glm::vec4* source, uint32_t* destination, size_t pixelCount, ColorEncoding encoding = ColorEncoding::Linear, float gamma = 2.2f)
+		{
+			FloatToRGBA8(&source->x, destination, pixelCount, encoding, gamma);
+		}
+
+		// Same as FloatToRGBA8 on accumulation / sampleCount, without the intermediate buffer
+		static void AccumulationToRGBA8(const float* accumulation, uint32_t* destination, size_t pixelCount, uint32_t sampleCount, ColorEncoding encoding = ColorEncoding::Linear, float gamma = 2.2f);
+		static void AccumulationToRGBA8(const glm::vec4* accumulation, uint32_t* destination, size_t pixelCount, uint32_t sampleCount, ColorEncoding encoding = ColorEncoding::Linear, float gamma = 2.2f)
+		{
+			AccumulationToRGBA8(&accumulation->x, destination, pixelCount, sampleCount, encoding, gamma);
+		}
+
+		// accumulation / sampleCount for floatCount floats, eg. for an RGBA32F Image
+		static void AverageAccumulation(const float* accumulation, float* destination, size_t floatCount, uint32_t sampleCount);
+
+		// Swaps R and B, works in both directions
+		static void SwizzleRGBA8BGRA8(const uint32_t* source, uint32_t* destination, size_t pixelCount);
+
+		// IEEE half precision, round to nearest even. Overflow gives infinity, NaNs stay NaN
+		static void FloatToHalf(const float* source, uint16_t* destination, size_t count);
+
+		static SIMDLevel GetSupportedSIMDLevel();
+		static SIMDLevel GetSIMDLevel();
+
+		// Caps the level used, eg. to benchmark the fallbacks. Clamped to the supported level
+		static void SetSIMDLevel(SIMDLevel level);
+	};
+
+}
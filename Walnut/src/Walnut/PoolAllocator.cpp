@@ -0,0 +1,238 @@
+#include "PoolAllocator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace Walnut {
+
+	// Multiples of 16, at most a third of a block is wasted by rounding up
+	static constexpr uint32_t c_PoolSizeClasses[] = { 16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048, 3072, 4096, 6144, 8192 };
+	static constexpr uint32_t c_PoolSizeClassCount = sizeof(c_PoolSizeClasses) / sizeof(c_PoolSizeClasses[0]);
+	static constexpr size_t c_PoolChunkSize = 64 * 1024;
+	static constexpr std::align_val_t c_PoolBlockAlignment = std::align_val_t(16);
+
+	// Right before every pointer handed out
+	struct PoolBlockHeader
+	{
+		uint64_t Size;
+		uint32_t SizeClass; // c_PoolSizeClassCount for blocks from the system heap
+		uint32_t Reserved;
+	};
+
+	static_assert(sizeof(PoolBlockHeader) == 16);
+	static_assert(c_PoolSizeClasses[c_PoolSizeClassCount - 1] - sizeof(PoolBlockHeader) == PoolAllocator::MaxPooledSize);
+
+	struct PoolFreeList
+	{
+		void* Head = nullptr;
+		void* Tail = nullptr; // So whole lists are spliced without walking them
+		uint64_t Count = 0;
+	};
+
+	// Blocks handed over by threads that freed more than they allocate and by threads that exited, adopted by
+	// threads that run out. Trivially destructible, so frees during static destruction can still use it
+	static std::mutex s_PoolGlobalMutex;
+	static PoolFreeList s_PoolGlobalLists[c_PoolSizeClassCount];
+
+	// A thread's free list past two chunks' worth of blocks goes to the global list
+	static constexpr size_t c_PoolMaxThreadListBytes = 2 * c_PoolChunkSize;
+
+	static std::atomic<uint64_t> s_PoolAllocationCount = 0;
+	static std::atomic<uint64_t> s_PoolFreeCount = 0;
+	static std::atomic<uint64_t> s_PoolCurrentBytes = 0;
+	static std::atomic<uint64_t> s_PoolPeakBytes = 0;
+	static std::atomic<uint64_t> s_PoolReservedBytes = 0;
+	static std::atomic<uint64_t> s_PoolLargeAllocationCount = 0;
+
+	namespace Utils {
+
+		static void PushPoolBlock(PoolFreeList& list, void* block)
+		{
+			*(void**)block = list.Head;
+			list.Head = block;
+			if (!list.Tail)
+				list.Tail = block;
+			list.Count++;
+		}
+
+		static void* PopPoolBlock(PoolFreeList& list)
+		{
+			void* block = list.Head;
+			list.Head = *(void**)block;
+			if (!list.Head)
+				list.Tail = nullptr;
+			list.Count--;
+			return block;
+		}
+
+		// Moves every block of from to the front of to
+		static void SplicePoolFreeList(PoolFreeList& to, PoolFreeList& from)
+		{
+			if (!from.Head)
+				return;
+
+			*(void**)from.Tail = to.Head;
+			if (!to.Head)
+				to.Tail = from.Tail;
+			to.Head = from.Head;
+			to.Count += from.Count;
+			from = PoolFreeList();
+		}
+
+	}
+
+	// Set when the thread's cache is destroyed: frees during thread exit, and on the main thread during static
+	// destruction, go through the global lists instead
+	static thread_local bool s_PoolThreadCacheDestroyed = false;
+
+	struct PoolThreadCache
+	{
+		PoolFreeList FreeLists[c_PoolSizeClassCount];
+
+		~PoolThreadCache()
+		{
+			s_PoolThreadCacheDestroyed = true;
+
+			std::scoped_lock<std::mutex> lock(s_PoolGlobalMutex);
+			for (uint32_t i = 0; i < c_PoolSizeClassCount; i++)
+				Utils::SplicePoolFreeList(s_PoolGlobalLists[i], FreeLists[i]);
+		}
+	};
+
+	static thread_local PoolThreadCache s_PoolThreadCache;
+
+	namespace Utils {
+
+		static bool RefillPoolFreeList(PoolThreadCache& cache, uint32_t sizeClass)
+		{
+			std::scoped_lock<std::mutex> lock(s_PoolGlobalMutex);
+
+			if (s_PoolGlobalLists[sizeClass].Head)
+			{
+				SplicePoolFreeList(cache.FreeLists[sizeClass], s_PoolGlobalLists[sizeClass]);
+				return true;
+			}
+
+			uint8_t* chunk = (uint8_t*)operator new(c_PoolChunkSize, c_PoolBlockAlignment, std::nothrow);
+			if (!chunk)
+				return false;
+			s_PoolReservedBytes += c_PoolChunkSize;
+
+			// Threaded back to front so blocks are handed out in address order
+			size_t classSize = c_PoolSizeClasses[sizeClass];
+			for (size_t offset = c_PoolChunkSize / classSize * classSize; offset > 0;)
+			{
+				offset -= classSize;
+				PushPoolBlock(cache.FreeLists[sizeClass], chunk + offset);
+			}
+			return true;
+		}
+
+	}
+
+	void* PoolAllocator::Allocate(size_t size)
+	{
+		size_t blockSize = size + sizeof(PoolBlockHeader);
+		uint32_t sizeClass = (uint32_t)(std::lower_bound(c_PoolSizeClasses, c_PoolSizeClasses + c_PoolSizeClassCount, blockSize) - c_PoolSizeClasses);
+
+		uint8_t* block = nullptr;
+		if (sizeClass < c_PoolSizeClassCount)
+		{
+			if (!s_PoolThreadCacheDestroyed)
+			{
+				PoolThreadCache& cache = s_PoolThreadCache;
+				if (!cache.FreeLists[sizeClass].Head && !Utils::RefillPoolFreeList(cache, sizeClass))
+					return nullptr;
+
+				block = (uint8_t*)Utils::PopPoolBlock(cache.FreeLists[sizeClass]);
+			}
+			else
+			{
+				// Thread exit: a global block if there is one, otherwise the system heap below
+				std::scoped_lock<std::mutex> lock(s_PoolGlobalMutex);
+				if (s_PoolGlobalLists[sizeClass].Head)
+					block = (uint8_t*)Utils::PopPoolBlock(s_PoolGlobalLists[sizeClass]);
+				else
+					sizeClass = c_PoolSizeClassCount;
+			}
+		}
+
+		if (sizeClass == c_PoolSizeClassCount)
+		{
+			block = (uint8_t*)operator new(blockSize, c_PoolBlockAlignment, std::nothrow);
+			if (!block)
+				return nullptr;
+			s_PoolLargeAllocationCount++;
+		}
+
+		PoolBlockHeader* header = (PoolBlockHeader*)block;
+		header->Size = size;
+		header->SizeClass = sizeClass;
+
+		s_PoolAllocationCount.fetch_add(1, std::memory_order_relaxed);
+		uint64_t current = s_PoolCurrentBytes.fetch_add(size, std::memory_order_relaxed) + size;
+		uint64_t peak = s_PoolPeakBytes.load(std::memory_order_relaxed);
+		while (current > peak && !s_PoolPeakBytes.compare_exchange_weak(peak, current, std::memory_order_relaxed));
+
+		return block + sizeof(PoolBlockHeader);
+	}
+
+	void PoolAllocator::Free(void* memory)
+	{
+		if (!memory)
+			return;
+
+		PoolBlockHeader* header = (PoolBlockHeader*)memory - 1;
+		s_PoolFreeCount.fetch_add(1, std::memory_order_relaxed);
+		s_PoolCurrentBytes.fetch_sub(header->Size, std::memory_order_relaxed);
+
+		if (header->SizeClass == c_PoolSizeClassCount)
+		{
+			operator delete(header, c_PoolBlockAlignment);
+			s_PoolLargeAllocationCount--;
+			return;
+		}
+
+		uint32_t sizeClass = header->SizeClass;
+		if (s_PoolThreadCacheDestroyed)
+		{
+			std::scoped_lock<std::mutex> lock(s_PoolGlobalMutex);
+			Utils::PushPoolBlock(s_PoolGlobalLists[sizeClass], header);
+			return;
+		}
+
+		PoolFreeList& list = s_PoolThreadCache.FreeLists[sizeClass];
+		Utils::PushPoolBlock(list, header);
+
+		// A thread that mostly frees what others allocated would otherwise grow its list without bound
+		if (list.Count * c_PoolSizeClasses[sizeClass] > c_PoolMaxThreadListBytes)
+		{
+			std::scoped_lock<std::mutex> lock(s_PoolGlobalMutex);
+			Utils::SplicePoolFreeList(s_PoolGlobalLists[sizeClass], list);
+		}
+	}
+
+	size_t PoolAllocator::GetUsableSize(const void* memory)
+	{
+		const PoolBlockHeader* header = (const PoolBlockHeader*)memory - 1;
+		if (header->SizeClass == c_PoolSizeClassCount)
+			return header->Size;
+		return c_PoolSizeClasses[header->SizeClass] - sizeof(PoolBlockHeader);
+	}
+
+	PoolAllocatorStatistics PoolAllocator::GetStatistics()
+	{
+		PoolAllocatorStatistics statistics;
+		statistics.AllocationCount = s_PoolAllocationCount;
+		statistics.FreeCount = s_PoolFreeCount;
+		statistics.CurrentBytes = s_PoolCurrentBytes;
+		statistics.PeakBytes = s_PoolPeakBytes;
+		statistics.PoolReservedBytes = s_PoolReservedBytes;
+		statistics.LargeAllocationCount = s_PoolLargeAllocationCount;
+		return statistics;
+	}
+
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace Walnut {
+
+	struct PoolAllocatorStatistics
+	{
+		uint64_t AllocationCount = 0;
+		uint64_t FreeCount = 0;
+		uint64_t CurrentBytes = 0;
+		uint64_t PeakBytes = 0;
+
+		uint64_t PoolReservedBytes = 0;    // Carved into size-class blocks, free ones included
+		uint64_t LargeAllocationCount = 0; // Live blocks from the system heap: too large for a size class, or allocated during thread exit
+	};
+
+	// General purpose allocator for small blocks, with a free list per size class and per thread, so allocating and
+	// freeing take no lock; a thread only locks to take a new 64 KiB chunk or to adopt free blocks. Blocks may be freed
+	// on any thread and join that thread's free lists. A list growing past two chunks' worth, and every list of an
+	// exiting thread, is handed to a global list the other threads adopt from; frees and allocations after the thread's
+	// lists are gone (thread exit, static destruction) use the global list directly. Pooled memory is kept until the
+	// process exits. ImGui allocates through it with ApplicationSpecification::PoolImGuiAllocations, and
+	// VulkanHostAllocator with ApplicationSpecification::TrackVulkanHostAllocations; the statistics cover both.
+	class PoolAllocator
+	{
+	public:
+		static constexpr size_t MaxPooledSize = 8192 - 16;
+
+		// 16 byte aligned, nullptr when out of memory
+		static void* Allocate(size_t size);
+		static void Free(void* memory);
+
+		// Bytes the block can hold, at least the size it was allocated with
+		static size_t GetUsableSize(const void* memory);
+
+		static PoolAllocatorStatistics GetStatistics();
+	};
+
+}
@@ -39,6 +39,8 @@ namespace Walnut {
 			return glm::vec3(Float() * (max - min) + min, Float() * (max - min) + min, Float() * (max - min) + min);
 		}
 
+		// A direction, not uniform: biased towards the cube's corners. See Sampling::SquareToUnitSphere and
+		// Sampling::CubeToUnitBall for uniform samples
 		static glm::vec3 InUnitSphere()
 		{
 			return glm::normalize(Vec3(-1.0f, 1.0f));
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdint.h>
+#include <array>
+#include <atomic>
+
+namespace Walnut {
+
+	// Bounded lock-free queue for exactly one producer thread and one consumer thread.
+	// Capacity must be a power of two; pushing into a full queue fails instead of blocking.
+	template<typename T, uint32_t Capacity>
+	class SPSCQueue
+	{
+		static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "SPSCQueue capacity must be a power of two");
+	public:
+		bool Push(const T& value)
+		{
+			uint32_t tail = m_Tail.load(std::memory_order_relaxed);
+			if (tail - m_Head.load(std::memory_order_acquire) == Capacity)
+				return false;
+
+			m_Items[tail & (Capacity - 1)] = value;
+			m_Tail.store(tail + 1, std::memory_order_release);
+			return true;
+		}
+
+		bool Pop(T& value)
+		{
+			uint32_t head = m_Head.load(std::memory_order_relaxed);
+			if (head == m_Tail.load(std::memory_order_acquire))
+				return false;
+
+			value = m_Items[head & (Capacity - 1)];
+			m_Head.store(head + 1, std::memory_order_release);
+			return true;
+		}
+
+		bool IsEmpty() const { return m_Head.load(std::memory_order_acquire) == m_Tail.load(std::memory_order_acquire); }
+	private:
+		// Producer and consumer indices live on separate cache lines to avoid false sharing
+		alignas(64) std::atomic<uint32_t> m_Head = 0;
+		alignas(64) std::atomic<uint32_t> m_Tail = 0;
+		std::array<T, Capacity> m_Items;
+	};
+
+}
@@ -0,0 +1,133 @@
+#include "SamplerCache.h"
+
+#include "Application.h"
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+
+namespace Walnut {
+
+	static std::mutex s_SamplerCacheMutex;
+	static std::unordered_map<uint64_t, VkSampler> s_Samplers;
+
+	// 0.0f until the device has been queried, 1.0f when anisotropy is unsupported
+	static float s_DeviceMaxAnisotropy = 0.0f;
+
+	namespace Utils {
+
+		static VkFilter SamplerFilterToVulkanFilter(SamplerFilter filter)
+		{
+			switch (filter)
+			{
+				case SamplerFilter::Linear:  return VK_FILTER_LINEAR;
+				case SamplerFilter::Nearest: return VK_FILTER_NEAREST;
+			}
+			return VK_FILTER_LINEAR;
+		}
+
+		static VkSamplerMipmapMode SamplerFilterToVulkanMipmapMode(SamplerFilter filter)
+		{
+			switch (filter)
+			{
+				case SamplerFilter::Linear:  return VK_SAMPLER_MIPMAP_MODE_LINEAR;
+				case SamplerFilter::Nearest: return VK_SAMPLER_MIPMAP_MODE_NEAREST;
+			}
+			return VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		}
+
+		static VkSamplerAddressMode SamplerAddressModeToVulkanAddressMode(SamplerAddressMode mode)
+		{
+			switch (mode)
+			{
+				case SamplerAddressMode::Repeat:         return VK_SAMPLER_ADDRESS_MODE_REPEAT;
+				case SamplerAddressMode::MirroredRepeat: return VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
+				case SamplerAddressMode::ClampToEdge:    return VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+				case SamplerAddressMode::ClampToBorder:  return VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+			}
+			return VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		}
+
+		// Packs the whole sampler state into a single key: 2 bits per enum, anisotropy in the upper 32 bits
+		static uint64_t SamplerSpecificationKey(const SamplerSpecification& spec)
+		{
+			uint32_t anisotropyBits;
+			memcpy(&anisotropyBits, &spec.MaxAnisotropy, sizeof(anisotropyBits));
+
+			uint64_t key = 0;
+			key |= (uint64_t)spec.MinFilter << 0;
+			key |= (uint64_t)spec.MagFilter << 2;
+			key |= (uint64_t)spec.MipmapFilter << 4;
+			key |= (uint64_t)spec.AddressModeU << 6;
+			key |= (uint64_t)spec.AddressModeV << 8;
+			key |= (uint64_t)spec.AddressModeW << 10;
+			key |= (uint64_t)anisotropyBits << 32;
+			return key;
+		}
+
+	}
+
+	VkSampler SamplerCache::Get(const SamplerSpecification& specification)
+	{
+		std::scoped_lock<std::mutex> lock(s_SamplerCacheMutex);
+
+		if (s_DeviceMaxAnisotropy == 0.0f)
+		{
+			VkPhysicalDeviceFeatures features;
+			vkGetPhysicalDeviceFeatures(Application::GetPhysicalDevice(), &features);
+			VkPhysicalDeviceProperties properties;
+			vkGetPhysicalDeviceProperties(Application::GetPhysicalDevice(), &properties);
+			s_DeviceMaxAnisotropy = features.samplerAnisotropy ? properties.limits.maxSamplerAnisotropy : 1.0f;
+		}
+
+		// Clamp before hashing so specifications that end up identical share a sampler
+		SamplerSpecification spec = specification;
+		spec.MaxAnisotropy = std::clamp(spec.MaxAnisotropy, 1.0f, s_DeviceMaxAnisotropy);
+
+		uint64_t key = Utils::SamplerSpecificationKey(spec);
+		auto it = s_Samplers.find(key);
+		if (it != s_Samplers.end())
+			return it->second;
+
+		VkSamplerCreateInfo info = {};
+		info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		info.magFilter = Utils::SamplerFilterToVulkanFilter(spec.MagFilter);
+		info.minFilter = Utils::SamplerFilterToVulkanFilter(spec.MinFilter);
+		info.mipmapMode = Utils::SamplerFilterToVulkanMipmapMode(spec.MipmapFilter);
+		info.addressModeU = Utils::SamplerAddressModeToVulkanAddressMode(spec.AddressModeU);
+		info.addressModeV = Utils::SamplerAddressModeToVulkanAddressMode(spec.AddressModeV);
+		info.addressModeW = Utils::SamplerAddressModeToVulkanAddressMode(spec.AddressModeW);
+		info.minLod = -1000;
+		info.maxLod = 1000;
+		info.anisotropyEnable = spec.MaxAnisotropy > 1.0f ? VK_TRUE : VK_FALSE;
+		info.maxAnisotropy = spec.MaxAnisotropy;
+		info.borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK;
+
+		VkSampler sampler = VK_NULL_HANDLE;
+		VkResult err = vkCreateSampler(Application::GetDevice(), &info, Application::GetAllocator(), &sampler);
+		check_vk_result(err);
+
+		s_Samplers[key] = sampler;
+		return sampler;
+	}
+
+	uint32_t SamplerCache::GetSamplerCount()
+	{
+		std::scoped_lock<std::mutex> lock(s_SamplerCacheMutex);
+		return (uint32_t)s_Samplers.size();
+	}
+
+	void SamplerCache::Shutdown()
+	{
+		std::scoped_lock<std::mutex> lock(s_SamplerCacheMutex);
+
+		VkDevice device = Application::GetDevice();
+		for (auto& [key, sampler] : s_Samplers)
+			vkDestroySampler(device, sampler, Application::GetAllocator());
+		s_Samplers.clear();
+
+		s_DeviceMaxAnisotropy = 0.0f;
+	}
+
+}
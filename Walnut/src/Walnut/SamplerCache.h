@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "vulkan/vulkan.h"
+
+namespace Walnut {
+
+	enum class SamplerFilter : uint8_t
+	{
+		Linear = 0,
+		Nearest
+	};
+
+	enum class SamplerAddressMode : uint8_t
+	{
+		Repeat = 0,
+		MirroredRepeat,
+		ClampToEdge,
+		ClampToBorder
+	};
+
+	struct SamplerSpecification
+	{
+		SamplerFilter MinFilter = SamplerFilter::Linear;
+		SamplerFilter MagFilter = SamplerFilter::Linear;
+		SamplerFilter MipmapFilter = SamplerFilter::Linear;
+
+		SamplerAddressMode AddressModeU = SamplerAddressMode::Repeat;
+		SamplerAddressMode AddressModeV = SamplerAddressMode::Repeat;
+		SamplerAddressMode AddressModeW = SamplerAddressMode::Repeat;
+
+		// 1.0 disables anisotropic filtering, values are clamped to the device limit
+		float MaxAnisotropy = 1.0f;
+
+		// Nearest-neighbour filtering with clamped edges, for inspecting individual pixels
+		static SamplerSpecification Nearest()
+		{
+			SamplerSpecification spec;
+			spec.MinFilter = spec.MagFilter = spec.MipmapFilter = SamplerFilter::Nearest;
+			spec.AddressModeU = spec.AddressModeV = spec.AddressModeW = SamplerAddressMode::ClampToEdge;
+			return spec;
+		}
+	};
+
+	// Samplers are immutable and drivers cap how many may exist at once (often 4000),
+	// so every Image with the same sampler state shares a single VkSampler from here.
+	class SamplerCache
+	{
+	public:
+		// Returned samplers are owned by the cache and stay valid until Shutdown()
+		static VkSampler Get(const SamplerSpecification& specification);
+
+		static uint32_t GetSamplerCount();
+
+		// Called by Application once the device is idle
+		static void Shutdown();
+	};
+
+}
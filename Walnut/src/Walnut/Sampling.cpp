@@ -0,0 +1,197 @@
+#include "Sampling.h"
+
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+
+namespace Walnut {
+
+	namespace Utils {
+
+		// Primitive polynomial (degree, coefficients) and initial direction numbers of Sobol dimensions 1 and up
+		// (Joe and Kuo, new-joe-kuo-6.21201)
+		struct SobolPolynomial
+		{
+			uint32_t Degree;
+			uint32_t Coefficients;
+			uint32_t InitialDirections[5];
+		};
+
+		static constexpr SobolPolynomial c_SobolPolynomials[Sampling::SobolDimensions - 1] = {
+			{ 1, 0, { 1 } },
+			{ 2, 1, { 1, 3 } },
+			{ 3, 1, { 1, 3, 1 } },
+			{ 3, 2, { 1, 1, 1 } },
+			{ 4, 1, { 1, 1, 3, 3 } },
+			{ 4, 4, { 1, 3, 5, 13 } },
+			{ 5, 2, { 1, 1, 5, 5, 17 } }
+		};
+
+		static constexpr std::array<std::array<uint32_t, 32>, Sampling::SobolDimensions> GenerateSobolDirections()
+		{
+			std::array<std::array<uint32_t, 32>, Sampling::SobolDimensions> directions = {};
+
+			// Dimension 0 is the van der Corput sequence
+			for (uint32_t bit = 0; bit < 32; bit++)
+				directions[0][bit] = 1u << (31 - bit);
+
+			for (uint32_t dimension = 1; dimension < Sampling::SobolDimensions; dimension++)
+			{
+				const SobolPolynomial& polynomial = c_SobolPolynomials[dimension - 1];
+				std::array<uint32_t, 32>& v = directions[dimension];
+
+				uint32_t s = polynomial.Degree;
+				for (uint32_t bit = 0; bit < s; bit++)
+					v[bit] = polynomial.InitialDirections[bit] << (31 - bit);
+
+				for (uint32_t bit = s; bit < 32; bit++)
+				{
+					v[bit] = v[bit - s] ^ (v[bit - s] >> s);
+					for (uint32_t k = 1; k < s; k++)
+						v[bit] ^= ((polynomial.Coefficients >> (s - 1 - k)) & 1) * v[bit - k];
+				}
+			}
+			return directions;
+		}
+
+		static uint32_t BlueNoiseRandom(uint32_t& state)
+		{
+			state = state * 747796405u + 2891336453u;
+			return Sampling::Hash(state);
+		}
+
+	}
+
+	const std::array<std::array<uint32_t, 32>, Sampling::SobolDimensions> Sampling::s_SobolDirections = Utils::GenerateSobolDirections();
+
+	std::vector<uint16_t> Sampling::GenerateBlueNoise(uint32_t size, uint32_t seed)
+	{
+		size = std::min(std::max(size, 2u), 128u);
+		while (size & (size - 1))
+			size &= size - 1;
+
+		const uint32_t mask = size - 1;
+		const uint32_t count = size * size;
+
+		// Energy each set pixel adds to the others, by toroidal offset
+		const float sigma = 1.5f;
+		std::vector<float> kernel(count);
+		for (uint32_t y = 0; y < size; y++)
+		{
+			for (uint32_t x = 0; x < size; x++)
+			{
+				float dx = (float)std::min(x, size - x);
+				float dy = (float)std::min(y, size - y);
+				kernel[y * size + x] = std::exp(-(dx * dx + dy * dy) / (2.0f * sigma * sigma));
+			}
+		}
+
+		std::vector<uint8_t> pattern(count, 0);
+		std::vector<float> energy(count, 0.0f);
+		auto splat = [&](uint32_t index, float sign)
+		{
+			pattern[index] = sign > 0.0f;
+			uint32_t px = index & mask, py = index / size;
+			for (uint32_t y = 0; y < size; y++)
+			{
+				const float* row = &kernel[((y - py) & mask) * size];
+				float* energyRow = &energy[y * size];
+				for (uint32_t x = 0; x < size; x++)
+					energyRow[x] += sign * row[(x - px) & mask];
+			}
+		};
+
+		// The set pixel with the most energy around it, or the empty pixel with the least
+		auto tightestCluster = [&]()
+		{
+			uint32_t best = 0;
+			float bestEnergy = -1.0f;
+			for (uint32_t i = 0; i < count; i++)
+			{
+				if (pattern[i] && energy[i] > bestEnergy)
+				{
+					best = i;
+					bestEnergy = energy[i];
+				}
+			}
+			return best;
+		};
+		auto largestVoid = [&]()
+		{
+			uint32_t best = 0;
+			float bestEnergy = 3.4e38f;
+			for (uint32_t i = 0; i < count; i++)
+			{
+				if (!pattern[i] && energy[i] < bestEnergy)
+				{
+					best = i;
+					bestEnergy = energy[i];
+				}
+			}
+			return best;
+		};
+
+		// Random initial pattern of a tenth of the pixels, relaxed until moving its tightest cluster into its largest
+		// void changes nothing
+		uint32_t randomState = Hash(seed);
+		uint32_t initialCount = std::max(count / 10, 1u);
+		for (uint32_t placed = 0; placed < initialCount;)
+		{
+			uint32_t index = Utils::BlueNoiseRandom(randomState) & (count - 1);
+			if (!pattern[index])
+			{
+				splat(index, 1.0f);
+				placed++;
+			}
+		}
+
+		for (uint32_t iteration = 0; iteration < count; iteration++)
+		{
+			uint32_t cluster = tightestCluster();
+			splat(cluster, -1.0f);
+			uint32_t gap = largestVoid();
+			splat(gap, 1.0f);
+			if (gap == cluster)
+				break;
+		}
+
+		std::vector<uint16_t> ranks(count);
+		std::vector<uint8_t> initialPattern = pattern;
+		std::vector<float> initialEnergy = energy;
+
+		// The initial pixels are ranked by removing the tightest cluster, the rest by filling the largest void. Past
+		// half full, the tightest cluster of empty pixels is the one with the least energy from the set ones, so the
+		// same step also finishes the mask
+		for (uint32_t rank = initialCount; rank-- > 0;)
+		{
+			uint32_t cluster = tightestCluster();
+			splat(cluster, -1.0f);
+			ranks[cluster] = (uint16_t)rank;
+		}
+
+		pattern = std::move(initialPattern);
+		energy = std::move(initialEnergy);
+		for (uint32_t rank = initialCount; rank < count; rank++)
+		{
+			uint32_t gap = largestVoid();
+			splat(gap, 1.0f);
+			ranks[gap] = (uint16_t)rank;
+		}
+
+		return ranks;
+	}
+
+	const uint16_t* Sampling::GetBlueNoiseTile(uint32_t channel)
+	{
+		static std::vector<uint16_t> s_Tiles[2];
+		static std::once_flag s_Generated[2];
+
+		channel = std::min(channel, 1u);
+		std::call_once(s_Generated[channel], [channel]()
+		{
+			s_Tiles[channel] = GenerateBlueNoise(BlueNoiseTileSize, 0x5eed0000u + channel);
+		});
+		return s_Tiles[channel].data();
+	}
+
+}
@@ -0,0 +1,311 @@
+#pragma once
+
+#include <stdint.h>
+#include <array>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace Walnut {
+
+	// Sample patterns for Monte Carlo integration (eg. path tracing) that converge faster than Random's white noise,
+	// and the mappings from the unit square onto disks, spheres and hemispheres. Every sample is a pure function of
+	// its index and seed, so pixels and threads draw theirs independently. The mappings have no rejection loops and
+	// no branches beyond selects, so loops over them vectorize.
+	//
+	// Typical per-pixel use: seed = Sampling::Hash(x + Sampling::Hash(y)), then for sample i of the pixel
+	// Sampling::Sobol2D(i, Sampling::HashCombine(seed, bounce)) for every bounce.
+	class Sampling
+	{
+	public:
+		static constexpr uint32_t SobolDimensions = 8;
+		static constexpr uint32_t HaltonDimensions = 16;
+		static constexpr uint32_t BlueNoiseTileSize = 64;
+
+		static constexpr float Pi = 3.14159265358979323846f;
+		static constexpr float UnitSpherePdf = 1.0f / (4.0f * Pi);
+		static constexpr float HemispherePdf = 1.0f / (2.0f * Pi);
+
+		static uint32_t Hash(uint32_t x)
+		{
+			x ^= x >> 16;
+			x *= 0x7feb352du;
+			x ^= x >> 15;
+			x *= 0x846ca68bu;
+			x ^= x >> 16;
+			return x;
+		}
+
+		static uint32_t HashCombine(uint32_t seed, uint32_t value)
+		{
+			return seed ^ (Hash(value) + 0x9e3779b9u + (seed << 6) + (seed >> 2));
+		}
+
+		// 32-bit fraction to [0, 1), exact for the top 24 bits
+		static float ToFloat(uint32_t bits)
+		{
+			return (float)(bits >> 8) * (1.0f / 16777216.0f);
+		}
+
+		// Unscrambled Sobol sequence as 32-bit fractions, dimension < SobolDimensions
+		static uint32_t SobolBits(uint32_t index, uint32_t dimension)
+		{
+			const std::array<uint32_t, 32>& directions = s_SobolDirections[dimension];
+
+			uint32_t result = 0;
+			for (uint32_t bit = 0; index; index >>= 1, bit++)
+				result ^= directions[bit] & (0u - (index & 1));
+			return result;
+		}
+
+		// Shuffled, Owen scrambled Sobol sequence (Burley 2020): every seed gives a different sequence with the same
+		// stratification, so pixels don't share a pattern
+		static float Sobol(uint32_t index, uint32_t dimension, uint32_t seed)
+		{
+			uint32_t shuffled = OwenScramble(index, Hash(seed));
+			return ToFloat(OwenScramble(SobolBits(shuffled, dimension), HashCombine(seed, dimension)));
+		}
+
+		// Dimensions `dimension` and `dimension` + 1 with the same index shuffle. Dimensions 0 and 1 form a
+		// (0, 2)-sequence: the first 2^k samples are stratified in every power-of-two grid with 2^k cells. Prefer a
+		// new seed per pair over higher dimensions, which are less evenly stratified in pairs
+		static glm::vec2 Sobol2D(uint32_t index, uint32_t seed, uint32_t dimension = 0)
+		{
+			uint32_t shuffled = OwenScramble(index, Hash(seed));
+			return {
+				ToFloat(OwenScramble(SobolBits(shuffled, dimension), HashCombine(seed, dimension))),
+				ToFloat(OwenScramble(SobolBits(shuffled, dimension + 1), HashCombine(seed, dimension + 1)))
+			};
+		}
+
+		// Radical inverse in the dimension'th prime, dimension < HaltonDimensions. A non-zero seed permutes every
+		// digit randomly (the same permutation for every index), which removes the correlation between dimensions
+		// with large bases
+		static float Halton(uint32_t index, uint32_t dimension, uint32_t seed = 0)
+		{
+			const uint32_t base = c_HaltonPrimes[dimension];
+			const float inverseBase = 1.0f / (float)base;
+
+			float result = 0.0f;
+			float factor = inverseBase;
+			if (seed == 0)
+			{
+				for (; index; index /= base, factor *= inverseBase)
+					result += (float)(index % base) * factor;
+			}
+			else
+			{
+				// Zero digits past the index's last one are permuted too, down to float precision
+				uint32_t digitSeed = HashCombine(seed, dimension);
+				for (uint32_t digit = 0; factor > 1.0f / 16777216.0f; index /= base, factor *= inverseBase, digit++)
+					result += (float)((index % base + Hash(digitSeed + digit)) % base) * factor;
+			}
+			return glm::min(result, c_OneMinusEpsilon);
+		}
+
+		static glm::vec2 Halton2D(uint32_t index, uint32_t seed = 0, uint32_t dimension = 0)
+		{
+			return { Halton(index, dimension, seed), Halton(index, dimension + 1, seed) };
+		}
+
+		// Additive recurrence on the golden ratio, the seed is a random toroidal shift
+		static float R1(uint32_t index, uint32_t seed = 0)
+		{
+			uint32_t offset = seed ? Hash(seed) : 0x80000000u;
+			return ToFloat(offset + index * 2654435769u);
+		}
+
+		// Additive recurrence on the plastic number, well spread for any sample count (not only powers of two)
+		static glm::vec2 R2(uint32_t index, uint32_t seed = 0)
+		{
+			uint32_t offsetX = seed ? Hash(seed) : 0x80000000u;
+			uint32_t offsetY = seed ? Hash(seed ^ 0x68bc21ebu) : 0x80000000u;
+			return { ToFloat(offsetX + index * 3242174889u), ToFloat(offsetY + index * 2447445413u) };
+		}
+
+		// Sample `index` of a countX * countY grid, jittered within its cell
+		static glm::vec2 Jittered2D(uint32_t index, uint32_t countX, uint32_t countY, uint32_t seed)
+		{
+			uint32_t hash = HashCombine(seed, index);
+			glm::vec2 jitter = { ToFloat(hash), ToFloat(Hash(hash)) };
+			glm::vec2 cell = { (float)(index % countX), (float)((index / countX) % countY) };
+			return (cell + jitter) / glm::vec2((float)countX, (float)countY);
+		}
+
+		// Correlated multi-jittered sampling (Kensler 2013): stratified in the countX * countY grid and in both
+		// 1D projections. Any sample count works, index < countX * countY
+		static glm::vec2 MultiJittered2D(uint32_t index, uint32_t countX, uint32_t countY, uint32_t seed)
+		{
+			uint32_t sx = PermuteIndex(index % countX, countX, seed * 0xa511e9b3u);
+			uint32_t sy = PermuteIndex(index / countX, countY, seed * 0x63d83595u);
+			float jx = KenslerFloat(index, seed * 0xa399d265u);
+			float jy = KenslerFloat(index, seed * 0x711ad6a5u);
+			glm::vec2 sample = {
+				((float)(index % countX) + ((float)sy + jx) / (float)countY) / (float)countX,
+				((float)(index / countX) + ((float)sx + jy) / (float)countX) / (float)countY
+			};
+			return glm::min(sample, glm::vec2(c_OneMinusEpsilon));
+		}
+
+		// Ranks in [0, size * size) of a tileable blue noise mask (void-and-cluster), size a power of two up to 128.
+		// Takes O(size^4): milliseconds for 32, tens of milliseconds for 64 and about a second for 128 in an optimized
+		// build, so generate it once
+		static std::vector<uint16_t> GenerateBlueNoise(uint32_t size, uint32_t seed = 0);
+
+		// BlueNoiseTileSize^2 ranks generated on first use, channel 0 or 1
+		static const uint16_t* GetBlueNoiseTile(uint32_t channel = 0);
+
+		// Blue noise in [0, 1) tiled over the screen. Every frame shifts it by the golden ratio, which keeps each pixel's
+		// values well distributed over time while every frame stays blue
+		static float BlueNoise(uint32_t x, uint32_t y, uint32_t frame = 0, uint32_t channel = 0)
+		{
+			const uint16_t* tile = GetBlueNoiseTile(channel);
+			uint32_t rank = tile[(y % BlueNoiseTileSize) * BlueNoiseTileSize + (x % BlueNoiseTileSize)];
+
+			constexpr uint32_t rankShift = 32 - 12; // log2(BlueNoiseTileSize^2)
+			uint32_t value = (rank << rankShift) + (1u << (rankShift - 1)) + frame * 2654435769u;
+			return ToFloat(value);
+		}
+
+		// From two independently generated tiles
+		static glm::vec2 BlueNoise2D(uint32_t x, uint32_t y, uint32_t frame = 0)
+		{
+			return { BlueNoise(x, y, frame, 0), BlueNoise(x, y, frame, 1) };
+		}
+
+		// Uniform on the unit disk, concentric mapping (Shirley and Chiu), which keeps strata compact
+		static glm::vec2 SquareToUnitDisk(glm::vec2 u)
+		{
+			glm::vec2 a = 2.0f * u - 1.0f;
+			bool xMajor = glm::abs(a.x) > glm::abs(a.y);
+			float radius = xMajor ? a.x : a.y;
+			float numerator = xMajor ? a.y : a.x;
+			float denominator = radius != 0.0f ? radius : 1.0f;
+			float theta = xMajor ? (Pi / 4.0f) * (numerator / denominator) : (Pi / 2.0f) - (Pi / 4.0f) * (numerator / denominator);
+			return radius * glm::vec2(glm::cos(theta), glm::sin(theta));
+		}
+
+		// Uniform on the surface of the unit sphere
+		static glm::vec3 SquareToUnitSphere(glm::vec2 u)
+		{
+			float z = 1.0f - 2.0f * u.x;
+			float r = glm::sqrt(glm::max(0.0f, 1.0f - z * z));
+			float phi = 2.0f * Pi * u.y;
+			return { r * glm::cos(phi), r * glm::sin(phi), z };
+		}
+
+		// Uniform inside the unit ball, unlike Random::InUnitSphere
+		static glm::vec3 CubeToUnitBall(glm::vec3 u)
+		{
+			return SquareToUnitSphere(glm::vec2(u)) * glm::pow(u.z, 1.0f / 3.0f);
+		}
+
+		// Uniform on the hemisphere around +Z, pdf HemispherePdf
+		static glm::vec3 SquareToHemisphere(glm::vec2 u)
+		{
+			float z = u.x;
+			float r = glm::sqrt(glm::max(0.0f, 1.0f - z * z));
+			float phi = 2.0f * Pi * u.y;
+			return { r * glm::cos(phi), r * glm::sin(phi), z };
+		}
+
+		// Cosine weighted around +Z (Malley's method), pdf CosineHemispherePdf(z)
+		static glm::vec3 SquareToCosineHemisphere(glm::vec2 u)
+		{
+			glm::vec2 disk = SquareToUnitDisk(u);
+			return { disk.x, disk.y, glm::sqrt(glm::max(0.0f, 1.0f - glm::dot(disk, disk))) };
+		}
+
+		static float CosineHemispherePdf(float cosTheta)
+		{
+			return cosTheta * (1.0f / Pi);
+		}
+
+		// Rotates a direction around +Z (from the mappings above) to be around the unit vector normal
+		// (branchless orthonormal basis, Duff et al. 2017)
+		static glm::vec3 ToWorld(glm::vec3 local, glm::vec3 normal)
+		{
+			float sign = normal.z >= 0.0f ? 1.0f : -1.0f;
+			float a = -1.0f / (sign + normal.z);
+			float b = normal.x * normal.y * a;
+			glm::vec3 tangent = { 1.0f + sign * normal.x * normal.x * a, sign * b, -sign * normal.x };
+			glm::vec3 bitangent = { b, sign + normal.y * normal.y * a, -normal.y };
+			return local.x * tangent + local.y * bitangent + local.z * normal;
+		}
+	private:
+		// Nested uniform scramble of a 32-bit fraction (Laine-Karras hash as improved by Burley 2020)
+		static uint32_t OwenScramble(uint32_t x, uint32_t seed)
+		{
+			x = ReverseBits(x);
+			x += seed;
+			x ^= x * 0x6c50b47cu;
+			x ^= x * 0xb82f1e52u;
+			x ^= x * 0xc7afe638u;
+			x ^= x * 0x8d22f6e6u;
+			return ReverseBits(x);
+		}
+
+		static uint32_t ReverseBits(uint32_t x)
+		{
+			x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+			x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+			x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+			x = ((x >> 8) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8);
+			return (x >> 16) | (x << 16);
+		}
+
+		// Random permutation of [0, count) evaluated one element at a time (Kensler 2013)
+		static uint32_t PermuteIndex(uint32_t i, uint32_t count, uint32_t pattern)
+		{
+			uint32_t w = count - 1;
+			w |= w >> 1;
+			w |= w >> 2;
+			w |= w >> 4;
+			w |= w >> 8;
+			w |= w >> 16;
+			do
+			{
+				i ^= pattern;
+				i *= 0xe170893du;
+				i ^= pattern >> 16;
+				i ^= (i & w) >> 4;
+				i ^= pattern >> 8;
+				i *= 0x0929eb3fu;
+				i ^= pattern >> 23;
+				i ^= (i & w) >> 1;
+				i *= 1 | pattern >> 27;
+				i *= 0x6935fa69u;
+				i ^= (i & w) >> 11;
+				i *= 0x74dcb303u;
+				i ^= (i & w) >> 2;
+				i *= 0x9e501cc3u;
+				i ^= (i & w) >> 2;
+				i *= 0xc860a3dfu;
+				i &= w;
+				i ^= i >> 5;
+			} while (i >= count);
+			return (i + pattern) % count;
+		}
+
+		static float KenslerFloat(uint32_t i, uint32_t pattern)
+		{
+			i ^= pattern;
+			i ^= i >> 17;
+			i ^= i >> 10;
+			i *= 0xb36534e5u;
+			i ^= i >> 12;
+			i ^= i >> 21;
+			i *= 0x93fc4795u;
+			i ^= 0xdf6e307fu;
+			i ^= i >> 17;
+			i *= 1 | pattern >> 18;
+			return ToFloat(i);
+		}
+	private:
+		static constexpr float c_OneMinusEpsilon = 0.99999994f;
+		static constexpr uint32_t c_HaltonPrimes[HaltonDimensions] = { 2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53 };
+
+		static const std::array<std::array<uint32_t, 32>, SobolDimensions> s_SobolDirections;
+	};
+
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stdint.h>
+#include <array>
+#include <atomic>
+
+namespace Walnut {
+
+	// Lock-free hand-off of state from one writer thread to one reader thread, typically
+	// a fixed-rate OnUpdate publishing to OnUIRender. The reader sees the latest published
+	// snapshot together with the one published right before it, so it can interpolate between
+	// two consecutive steps even when the writer published several times since the last read.
+	//
+	// Three slots are rotated so that the writer, the reader and the shared hand-off slot never
+	// alias; Publish copies the state twice to pair it with its predecessor, neither side ever waits.
+	template<typename T>
+	class SnapshotBuffer
+	{
+	public:
+		// Writer side: fill in the returned snapshot, then Publish()
+		T& GetWriteBuffer() { return m_Slots[m_WriteIndex].Current; }
+
+		void Publish()
+		{
+			Slot& slot = m_Slots[m_WriteIndex];
+			slot.Previous = m_HasPublished ? m_LastPublished : slot.Current;
+			m_LastPublished = slot.Current;
+			m_HasPublished = true;
+
+			uint8_t previous = m_Shared.exchange(m_WriteIndex | FreshBit, std::memory_order_acq_rel);
+			m_WriteIndex = previous & IndexMask;
+		}
+
+		// Reader side: picks up the latest published snapshot, returns false if nothing new was published
+		bool Acquire()
+		{
+			if ((m_Shared.load(std::memory_order_relaxed) & FreshBit) == 0)
+				return false;
+
+			m_ReadIndex = m_Shared.exchange(m_ReadIndex, std::memory_order_acq_rel) & IndexMask;
+			return true;
+		}
+
+		const T& GetCurrent() const { return m_Slots[m_ReadIndex].Current; }
+		// The snapshot published right before GetCurrent(), not the one acquired before it
+		const T& GetPrevious() const { return m_Slots[m_ReadIndex].Previous; }
+	private:
+		struct Slot
+		{
+			T Previous{};
+			T Current{};
+		};
+
+		static constexpr uint8_t IndexMask = 0x3;
+		static constexpr uint8_t FreshBit = 0x4;
+
+		std::array<Slot, 3> m_Slots{};
+
+		// Writer only
+		uint8_t m_WriteIndex = 0;
+		T m_LastPublished{};
+		bool m_HasPublished = false;
+
+		std::atomic<uint8_t> m_Shared = 1;
+
+		// Reader only
+		uint8_t m_ReadIndex = 2;
+	};
+
+}
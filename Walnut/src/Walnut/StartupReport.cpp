@@ -0,0 +1,87 @@
+#include "StartupReport.h"
+
+#include <algorithm>
+#include <iostream>
+
+namespace Walnut {
+
+	StartupReport::ScopedPhase::ScopedPhase(StartupReport& report, std::string name, bool worker)
+		: m_Report(report), m_Name(std::move(name)), m_Worker(worker), m_Start(report.GetElapsedMillis())
+	{
+	}
+
+	StartupReport::ScopedPhase::~ScopedPhase()
+	{
+		m_Report.AddPhase(std::move(m_Name), m_Start, m_Report.GetElapsedMillis() - m_Start, m_Worker);
+	}
+
+	StartupReport::StartupReport()
+		: m_StartTime(std::chrono::steady_clock::now())
+	{
+	}
+
+	void StartupReport::AddPhase(std::string name, float start, float duration, bool worker)
+	{
+		std::scoped_lock<std::mutex> lock(m_Mutex);
+		if (m_Finished)
+			return;
+
+		StartupPhase& phase = m_Phases.emplace_back();
+		phase.Name = std::move(name);
+		phase.Start = start;
+		phase.Duration = duration;
+		phase.Worker = worker;
+	}
+
+	void StartupReport::Finish()
+	{
+		float totalTime = GetElapsedMillis();
+
+		std::scoped_lock<std::mutex> lock(m_Mutex);
+		if (m_Finished)
+			return;
+
+		m_TotalTime = totalTime;
+		m_Finished = true;
+	}
+
+	float StartupReport::GetElapsedMillis() const
+	{
+		return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - m_StartTime).count();
+	}
+
+	bool StartupReport::IsFinished() const
+	{
+		std::scoped_lock<std::mutex> lock(m_Mutex);
+		return m_Finished;
+	}
+
+	float StartupReport::GetTotalTime() const
+	{
+		std::scoped_lock<std::mutex> lock(m_Mutex);
+		return m_TotalTime;
+	}
+
+	std::vector<StartupPhase> StartupReport::GetPhases() const
+	{
+		std::vector<StartupPhase> phases;
+		{
+			std::scoped_lock<std::mutex> lock(m_Mutex);
+			phases = m_Phases;
+		}
+
+		std::stable_sort(phases.begin(), phases.end(), [](const StartupPhase& a, const StartupPhase& b) { return a.Start < b.Start; });
+		return phases;
+	}
+
+	void StartupReport::Print() const
+	{
+		for (const StartupPhase& phase : GetPhases())
+		{
+			std::cout << "[STARTUP] " << phase.Name << " - " << phase.Duration << "ms (at " << phase.Start << "ms";
+			std::cout << (phase.Worker ? ", worker)\n" : ")\n");
+		}
+		std::cout << "[STARTUP] Total - " << GetTotalTime() << "ms\n";
+	}
+
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Walnut {
+
+	struct StartupPhase
+	{
+		std::string Name;
+		float Start = 0.0f;    // ms since the Application was created
+		float Duration = 0.0f; // ms
+		bool Worker = false;   // ran on a worker thread, overlapping the main thread
+	};
+
+	// Per-phase timings from Application construction until the first frame is presented.
+	// Phases can be added from any thread until the report is finished.
+	class StartupReport
+	{
+	public:
+		class ScopedPhase
+		{
+		public:
+			ScopedPhase(StartupReport& report, std::string name, bool worker);
+			~ScopedPhase();
+
+			ScopedPhase(const ScopedPhase&) = delete;
+			ScopedPhase& operator=(const ScopedPhase&) = delete;
+		private:
+			StartupReport& m_Report;
+			std::string m_Name;
+			bool m_Worker;
+			float m_Start;
+		};
+
+		StartupReport();
+
+		StartupReport(const StartupReport&) = delete;
+		StartupReport& operator=(const StartupReport&) = delete;
+
+		// Records the phase when the returned object goes out of scope
+		ScopedPhase Trace(std::string name, bool worker = false) { return ScopedPhase(*this, std::move(name), worker); }
+
+		// Ignored once the report is finished
+		void AddPhase(std::string name, float start, float duration, bool worker);
+		void Finish();
+
+		float GetElapsedMillis() const;
+
+		bool IsFinished() const;
+		float GetTotalTime() const;
+
+		// Sorted by start time
+		std::vector<StartupPhase> GetPhases() const;
+
+		void Print() const;
+	private:
+		std::chrono::steady_clock::time_point m_StartTime;
+
+		mutable std::mutex m_Mutex;
+		std::vector<StartupPhase> m_Phases;
+		float m_TotalTime = 0.0f;
+		bool m_Finished = false;
+	};
+
+}
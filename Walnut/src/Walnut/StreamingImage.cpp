@@ -0,0 +1,352 @@
+#include "StreamingImage.h"
+
+#include "imgui.h"
+#include "backends/imgui_impl_vulkan.h"
+
+#include "Application.h"
+#include "GPUMemory.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace Walnut {
+
+	StreamingImage::StreamingImage(uint32_t width, uint32_t height, ImageFormat format, uint32_t bufferCount, const SamplerSpecification& samplerSpecification)
+		: m_Width(width), m_Height(height), m_Format(format), m_SamplerSpecification(samplerSpecification)
+	{
+		m_Buffers.resize(std::max(bufferCount, 2u));
+
+		VkCommandPoolCreateInfo pool_info = {};
+		pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+		pool_info.queueFamilyIndex = Application::GetQueueFamilyIndex();
+		VkResult err = vkCreateCommandPool(Application::GetDevice(), &pool_info, Application::GetAllocator(), &m_CommandPool);
+		check_vk_result(err);
+
+		AllocateBuffers();
+	}
+
+	StreamingImage::~StreamingImage()
+	{
+		Release();
+
+		Application::SubmitResourceFree([commandPool = m_CommandPool]()
+		{
+			vkDestroyCommandPool(Application::GetDevice(), commandPool, Application::GetAllocator());
+		});
+	}
+
+	void StreamingImage::AllocateBuffers()
+	{
+		VkDevice device = Application::GetDevice();
+		VkFormat vulkanFormat = Utils::WalnutFormatToVulkanFormat(m_Format);
+		m_StagingBufferSize = (size_t)m_Width * m_Height * Utils::BytesPerPixel(m_Format);
+		m_Sampler = SamplerCache::Get(m_SamplerSpecification);
+
+		VkResult err;
+
+		for (auto& buffer : m_Buffers)
+		{
+			buffer = std::make_shared<Buffer>();
+
+			// Create the Image
+			{
+				VkImageCreateInfo info = {};
+				info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+				info.imageType = VK_IMAGE_TYPE_2D;
+				info.format = vulkanFormat;
+				info.extent.width = m_Width;
+				info.extent.height = m_Height;
+				info.extent.depth = 1;
+				info.mipLevels = 1;
+				info.arrayLayers = 1;
+				info.samples = VK_SAMPLE_COUNT_1_BIT;
+				info.tiling = VK_IMAGE_TILING_OPTIMAL;
+				info.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+				info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+				info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+				err = vkCreateImage(device, &info, Application::GetAllocator(), &buffer->Image);
+				check_vk_result(err);
+				VkMemoryRequirements req;
+				vkGetImageMemoryRequirements(device, buffer->Image, &req);
+				VkMemoryAllocateInfo alloc_info = {};
+				alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+				alloc_info.allocationSize = req.size;
+				alloc_info.memoryTypeIndex = Utils::GetVulkanMemoryType(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, req.memoryTypeBits);
+				err = GPUMemory::Allocate(alloc_info, GPUMemoryCategory::Image, &buffer->Memory);
+				check_vk_result(err);
+				err = vkBindImageMemory(device, buffer->Image, buffer->Memory, 0);
+				check_vk_result(err);
+			}
+
+			// Create the Image View
+			{
+				VkImageViewCreateInfo info = {};
+				info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+				info.image = buffer->Image;
+				info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+				info.format = vulkanFormat;
+				info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				info.subresourceRange.levelCount = 1;
+				info.subresourceRange.layerCount = 1;
+				err = vkCreateImageView(device, &info, Application::GetAllocator(), &buffer->ImageView);
+				check_vk_result(err);
+			}
+
+			buffer->DescriptorSet = (VkDescriptorSet)ImGui_ImplVulkan_AddTexture(m_Sampler, buffer->ImageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+			// Create the Upload Buffer, kept mapped. Coherent memory saves the flush when available
+			{
+				VkBufferCreateInfo buffer_info = {};
+				buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+				buffer_info.size = m_StagingBufferSize;
+				buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+				buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+				err = vkCreateBuffer(device, &buffer_info, Application::GetAllocator(), &buffer->StagingBuffer);
+				check_vk_result(err);
+				VkMemoryRequirements req;
+				vkGetBufferMemoryRequirements(device, buffer->StagingBuffer, &req);
+
+				uint32_t memoryType = Utils::GetVulkanMemoryType(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, req.memoryTypeBits);
+				m_StagingBufferCoherent = memoryType != 0xffffffff;
+				if (!m_StagingBufferCoherent)
+					memoryType = Utils::GetVulkanMemoryType(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, req.memoryTypeBits);
+
+				VkMemoryAllocateInfo alloc_info = {};
+				alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+				alloc_info.allocationSize = req.size;
+				alloc_info.memoryTypeIndex = memoryType;
+				err = GPUMemory::Allocate(alloc_info, GPUMemoryCategory::Staging, &buffer->StagingBufferMemory);
+				check_vk_result(err);
+				err = vkBindBufferMemory(device, buffer->StagingBuffer, buffer->StagingBufferMemory, 0);
+				check_vk_result(err);
+				err = vkMapMemory(device, buffer->StagingBufferMemory, 0, VK_WHOLE_SIZE, 0, &buffer->MappedStagingBuffer);
+				check_vk_result(err);
+			}
+
+			{
+				VkCommandBufferAllocateInfo alloc_info = {};
+				alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+				alloc_info.commandPool = m_CommandPool;
+				alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+				alloc_info.commandBufferCount = 1;
+				err = vkAllocateCommandBuffers(device, &alloc_info, &buffer->CommandBuffer);
+				check_vk_result(err);
+
+				VkFenceCreateInfo fence_info = {};
+				fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+				err = vkCreateFence(device, &fence_info, Application::GetAllocator(), &buffer->Fence);
+				check_vk_result(err);
+			}
+		}
+	}
+
+	void StreamingImage::Release()
+	{
+		m_WritingBuffer = nullptr;
+
+		for (auto& buffer : m_Buffers)
+		{
+			// Uploads are separate submissions, so the frame fences alone do not cover them
+			Application::SubmitResourceFree([buffer, commandPool = m_CommandPool]()
+			{
+				VkDevice device = Application::GetDevice();
+
+				if (buffer->State == BufferState::Uploading)
+					vkWaitForFences(device, 1, &buffer->Fence, VK_TRUE, UINT64_MAX);
+
+				vkFreeDescriptorSets(device, Application::GetDescriptorPool(), 1, &buffer->DescriptorSet);
+				vkDestroyImageView(device, buffer->ImageView, Application::GetAllocator());
+				vkDestroyImage(device, buffer->Image, Application::GetAllocator());
+				GPUMemory::Free(buffer->Memory);
+				vkDestroyBuffer(device, buffer->StagingBuffer, Application::GetAllocator());
+				GPUMemory::Free(buffer->StagingBufferMemory);
+				vkFreeCommandBuffers(device, commandPool, 1, &buffer->CommandBuffer);
+				vkDestroyFence(device, buffer->Fence, Application::GetAllocator());
+			});
+			buffer = nullptr;
+		}
+	}
+
+	void StreamingImage::UpdateBufferStates()
+	{
+		VkDevice device = Application::GetDevice();
+
+		std::shared_ptr<Buffer> newest;
+		for (auto& buffer : m_Buffers)
+		{
+			if (buffer->State != BufferState::Uploading || vkGetFenceStatus(device, buffer->Fence) != VK_SUCCESS)
+				continue;
+
+			// Never displayed, so nothing can be reading it
+			if (newest && newest->UploadIndex > buffer->UploadIndex)
+			{
+				buffer->State = BufferState::Free;
+				continue;
+			}
+
+			if (newest)
+				newest->State = BufferState::Free;
+			newest = buffer;
+		}
+
+		if (!newest)
+			return;
+
+		for (auto& buffer : m_Buffers)
+		{
+			if (buffer->State != BufferState::Displayed)
+				continue;
+
+			// Frames recorded until now may still sample it, the free queue runs once they have finished
+			buffer->State = BufferState::Retiring;
+			Application::SubmitResourceFree([buffer]()
+			{
+				if (buffer->State == BufferState::Retiring)
+					buffer->State = BufferState::Free;
+			});
+		}
+
+		newest->State = BufferState::Displayed;
+	}
+
+	bool StreamingImage::SetData(const void* data)
+	{
+		void* destination = AcquireWriteBuffer();
+		if (!destination)
+			return false;
+
+		memcpy(destination, data, m_StagingBufferSize);
+		SubmitWriteBuffer();
+		return true;
+	}
+
+	void* StreamingImage::AcquireWriteBuffer()
+	{
+		if (m_WritingBuffer)
+			return m_WritingBuffer->MappedStagingBuffer;
+
+		UpdateBufferStates();
+
+		for (auto& buffer : m_Buffers)
+		{
+			if (buffer->State == BufferState::Free)
+			{
+				buffer->State = BufferState::Writing;
+				m_WritingBuffer = buffer;
+				return buffer->MappedStagingBuffer;
+			}
+		}
+
+		m_DroppedUploadCount++;
+		return nullptr;
+	}
+
+	void StreamingImage::SubmitWriteBuffer()
+	{
+		if (!m_WritingBuffer)
+			return;
+
+		std::shared_ptr<Buffer> buffer = std::move(m_WritingBuffer);
+		VkDevice device = Application::GetDevice();
+
+		VkResult err;
+
+		if (!m_StagingBufferCoherent)
+		{
+			VkMappedMemoryRange range = {};
+			range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+			range.memory = buffer->StagingBufferMemory;
+			range.size = VK_WHOLE_SIZE;
+			err = vkFlushMappedMemoryRanges(device, 1, &range);
+			check_vk_result(err);
+		}
+
+		err = vkResetFences(device, 1, &buffer->Fence);
+		check_vk_result(err);
+		err = vkResetCommandBuffer(buffer->CommandBuffer, 0);
+		check_vk_result(err);
+
+		VkCommandBufferBeginInfo begin_info = {};
+		begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		begin_info.flags |= VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		err = vkBeginCommandBuffer(buffer->CommandBuffer, &begin_info);
+		check_vk_result(err);
+
+		// Copy to Image, the previous contents are no longer sampled by any frame
+		{
+			VkImageMemoryBarrier copy_barrier = {};
+			copy_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			copy_barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			copy_barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			copy_barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			copy_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			copy_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			copy_barrier.image = buffer->Image;
+			copy_barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			copy_barrier.subresourceRange.levelCount = 1;
+			copy_barrier.subresourceRange.layerCount = 1;
+			vkCmdPipelineBarrier(buffer->CommandBuffer, VK_PIPELINE_STAGE_HOST_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1, &copy_barrier);
+
+			VkBufferImageCopy region = {};
+			region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			region.imageSubresource.layerCount = 1;
+			region.imageExtent.width = m_Width;
+			region.imageExtent.height = m_Height;
+			region.imageExtent.depth = 1;
+			vkCmdCopyBufferToImage(buffer->CommandBuffer, buffer->StagingBuffer, buffer->Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+			VkImageMemoryBarrier use_barrier = {};
+			use_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			use_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			use_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			use_barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			use_barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			use_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			use_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			use_barrier.image = buffer->Image;
+			use_barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			use_barrier.subresourceRange.levelCount = 1;
+			use_barrier.subresourceRange.layerCount = 1;
+			vkCmdPipelineBarrier(buffer->CommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, NULL, 0, NULL, 1, &use_barrier);
+		}
+
+		err = vkEndCommandBuffer(buffer->CommandBuffer);
+		check_vk_result(err);
+
+		VkSubmitInfo submit_info = {};
+		submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submit_info.commandBufferCount = 1;
+		submit_info.pCommandBuffers = &buffer->CommandBuffer;
+		err = vkQueueSubmit(Application::GetQueue(), 1, &submit_info, buffer->Fence);
+		check_vk_result(err);
+
+		buffer->State = BufferState::Uploading;
+		buffer->UploadIndex = ++m_UploadIndex;
+	}
+
+	VkDescriptorSet StreamingImage::GetDescriptorSet()
+	{
+		UpdateBufferStates();
+
+		for (auto& buffer : m_Buffers)
+		{
+			if (buffer->State == BufferState::Displayed)
+				return buffer->DescriptorSet;
+		}
+		return nullptr;
+	}
+
+	void StreamingImage::Resize(uint32_t width, uint32_t height)
+	{
+		if (m_Width == width && m_Height == height)
+			return;
+
+		m_Width = width;
+		m_Height = height;
+
+		Release();
+		AllocateBuffers();
+	}
+
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+
+#include "Image.h"
+
+namespace Walnut {
+
+	// An image updated every frame without waiting on the GPU. Each of its buffers has its own staging memory,
+	// image and fence: an upload goes to a free buffer, and GetDescriptorSet() switches to it once the copy has
+	// completed. The buffer shown before is only reused after the frames that may still sample it have finished.
+	// Main thread only (OnUIRender/OnRender): uploads submit to the shared queue without a lock and the buffer
+	// states are not synchronized. Produce the pixels elsewhere and pass them to SetData from the main thread.
+	class StreamingImage
+	{
+	public:
+		// 3 buffers cover one shown, one being uploaded and one waiting for the frames in flight
+		StreamingImage(uint32_t width, uint32_t height, ImageFormat format, uint32_t bufferCount = 3, const SamplerSpecification& samplerSpecification = SamplerSpecification());
+		~StreamingImage();
+
+		StreamingImage(const StreamingImage&) = delete;
+		StreamingImage& operator=(const StreamingImage&) = delete;
+
+		// Copies data to a free buffer and starts its upload. Returns false, dropping the data,
+		// when every buffer is still busy
+		bool SetData(const void* data);
+
+		// Zero-copy alternative to SetData: returns the mapped staging memory of a free buffer (nullptr when
+		// all are busy) to fill in place, then SubmitWriteBuffer starts the upload
+		void* AcquireWriteBuffer();
+		void SubmitWriteBuffer();
+
+		// The most recently completed upload, or nullptr before the first one has finished
+		VkDescriptorSet GetDescriptorSet();
+
+		// Drops every buffer, including uploads still in flight
+		void Resize(uint32_t width, uint32_t height);
+
+		uint32_t GetWidth() const { return m_Width; }
+		uint32_t GetHeight() const { return m_Height; }
+		uint32_t GetBufferCount() const { return (uint32_t)m_Buffers.size(); }
+
+		// Calls to SetData/AcquireWriteBuffer that found no free buffer
+		uint64_t GetDroppedUploadCount() const { return m_DroppedUploadCount; }
+	private:
+		enum class BufferState : uint8_t
+		{
+			Free = 0,
+			Writing,       // Handed out by AcquireWriteBuffer
+			Uploading,     // Copy submitted, fence pending
+			Displayed,     // Returned by GetDescriptorSet
+			Retiring       // Replaced, waiting for the frames in flight to finish with it
+		};
+
+		struct Buffer
+		{
+			BufferState State = BufferState::Free;
+			uint64_t UploadIndex = 0;
+
+			VkImage Image = nullptr;
+			VkImageView ImageView = nullptr;
+			VkDeviceMemory Memory = nullptr;
+			VkDescriptorSet DescriptorSet = nullptr;
+
+			VkBuffer StagingBuffer = nullptr;
+			VkDeviceMemory StagingBufferMemory = nullptr;
+			void* MappedStagingBuffer = nullptr;
+
+			VkCommandBuffer CommandBuffer = nullptr;
+			VkFence Fence = nullptr;
+		};
+
+		void AllocateBuffers();
+		void Release();
+
+		// Promotes finished uploads without waiting, older finished ones are freed right away
+		void UpdateBufferStates();
+	private:
+		uint32_t m_Width = 0, m_Height = 0;
+		ImageFormat m_Format = ImageFormat::None;
+		SamplerSpecification m_SamplerSpecification;
+		VkSampler m_Sampler = nullptr; // Owned by SamplerCache
+
+		bool m_StagingBufferCoherent = false;
+		size_t m_StagingBufferSize = 0;
+
+		VkCommandPool m_CommandPool = nullptr;
+
+		// Shared so buffers retired through the resource free queue can outlive the image
+		std::vector<std::shared_ptr<Buffer>> m_Buffers;
+		std::shared_ptr<Buffer> m_WritingBuffer;
+
+		uint64_t m_UploadIndex = 0;
+		uint64_t m_DroppedUploadCount = 0;
+	};
+
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdint.h>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Walnut {
+
+	class ThreadPool
+	{
+	public:
+		// 0 uses one thread per hardware thread, minus the main thread
+		ThreadPool(uint32_t threadCount = 0);
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		// Jobs run in submission order on whichever worker is free first
+		void Submit(std::function<void()>&& job);
+
+		uint32_t GetThreadCount() const { return (uint32_t)m_Threads.size(); }
+	private:
+		void WorkerLoop();
+	private:
+		std::vector<std::thread> m_Threads;
+
+		std::mutex m_Mutex;
+		std::condition_variable m_Condition;
+		std::deque<std::function<void()>> m_Jobs;
+		bool m_Stopping = false;
+	};
+
+}
@@ -0,0 +1,723 @@
+#include "TiledImage.h"
+
+#include "backends/imgui_impl_vulkan.h"
+
+#include "Application.h"
+#include "GPUMemory.h"
+#include "Image.h"
+#include "SamplerCache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+
+namespace Walnut {
+
+	static const char s_TiledPyramidMagic[4] = { 'W', 'T', 'P', '1' };
+	static const uint64_t s_TiledPyramidHeaderSize = 32;
+
+	struct TiledPyramidHeader
+	{
+		char Magic[4];
+		uint32_t Width, Height;
+		uint32_t TileSize;
+		uint32_t LevelCount;
+		uint32_t Reserved[3];
+	};
+	static_assert(sizeof(TiledPyramidHeader) == s_TiledPyramidHeaderSize);
+
+	uint32_t TiledPyramidInfo::GetLevelWidth(uint32_t level) const
+	{
+		return std::max(1u, (uint32_t)(((uint64_t)Width + (1ull << level) - 1) >> level));
+	}
+
+	uint32_t TiledPyramidInfo::GetLevelHeight(uint32_t level) const
+	{
+		return std::max(1u, (uint32_t)(((uint64_t)Height + (1ull << level) - 1) >> level));
+	}
+
+	uint32_t TiledPyramidInfo::GetTilesX(uint32_t level) const
+	{
+		return (GetLevelWidth(level) + TileSize - 1) / TileSize;
+	}
+
+	uint32_t TiledPyramidInfo::GetTilesY(uint32_t level) const
+	{
+		return (GetLevelHeight(level) + TileSize - 1) / TileSize;
+	}
+
+	uint64_t TiledPyramidInfo::GetTileOffset(uint32_t level, uint32_t x, uint32_t y) const
+	{
+		uint64_t tileIndex = 0;
+		for (uint32_t i = 0; i < level; i++)
+			tileIndex += (uint64_t)GetTilesX(i) * GetTilesY(i);
+		tileIndex += (uint64_t)y * GetTilesX(level) + x;
+
+		return s_TiledPyramidHeaderSize + tileIndex * GetTileBytes();
+	}
+
+	TiledPyramidInfo TiledPyramidInfo::Create(uint32_t width, uint32_t height, uint32_t tileSize)
+	{
+		TiledPyramidInfo info;
+		info.Width = width;
+		info.Height = height;
+		info.TileSize = tileSize;
+		info.LevelCount = 1;
+		while (info.GetLevelWidth(info.LevelCount - 1) > tileSize || info.GetLevelHeight(info.LevelCount - 1) > tileSize)
+			info.LevelCount++;
+		return info;
+	}
+
+	TiledPyramidWriter::TiledPyramidWriter(std::string_view path, uint32_t width, uint32_t height, uint32_t tileSize)
+		: m_Info(TiledPyramidInfo::Create(width, height, tileSize))
+	{
+		// Halving a tile into a quadrant of its parent needs an even size
+		IM_ASSERT(tileSize >= 2 && tileSize % 2 == 0);
+
+		m_Stream.open(std::string(path), std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!m_Stream)
+		{
+			std::cerr << "[TiledPyramidWriter] Could not open " << path << "\n";
+			return;
+		}
+
+		TiledPyramidHeader header = {};
+		memcpy(header.Magic, s_TiledPyramidMagic, sizeof(header.Magic));
+		header.Width = m_Info.Width;
+		header.Height = m_Info.Height;
+		header.TileSize = m_Info.TileSize;
+		header.LevelCount = m_Info.LevelCount;
+		m_Stream.write((const char*)&header, sizeof(header));
+	}
+
+	TiledPyramidWriter::~TiledPyramidWriter()
+	{
+		if (IsOpen() && !m_Finished)
+			Finish();
+	}
+
+	bool TiledPyramidWriter::WriteTile(uint32_t x, uint32_t y, const void* data)
+	{
+		if (x >= m_Info.GetTilesX(0) || y >= m_Info.GetTilesY(0))
+		{
+			std::cerr << "[TiledPyramidWriter] Tile (" << x << ", " << y << ") is outside the " << m_Info.GetTilesX(0) << "x" << m_Info.GetTilesY(0) << " tiles of level 0\n";
+			return false;
+		}
+
+		const uint32_t tileSize = m_Info.TileSize;
+		uint32_t validWidth = std::min(tileSize, m_Info.Width - x * tileSize);
+		uint32_t validHeight = std::min(tileSize, m_Info.Height - y * tileSize);
+
+		// Keep what lies past the edge transparent, the coarser levels average it out
+		std::vector<uint8_t> tile(m_Info.GetTileBytes(), 0);
+		for (uint32_t row = 0; row < validHeight; row++)
+			memcpy(&tile[(size_t)row * tileSize * 4], (const uint8_t*)data + (size_t)row * tileSize * 4, (size_t)validWidth * 4);
+
+		WriteLevelTile(0, x, y, tile.data());
+		return true;
+	}
+
+	void TiledPyramidWriter::WriteLevelTile(uint32_t level, uint32_t x, uint32_t y, const uint8_t* data)
+	{
+		m_Stream.seekp((std::streamoff)m_Info.GetTileOffset(level, x, y));
+		m_Stream.write((const char*)data, (std::streamsize)m_Info.GetTileBytes());
+	}
+
+	void TiledPyramidWriter::ReadLevelTile(uint32_t level, uint32_t x, uint32_t y, uint8_t* data)
+	{
+		memset(data, 0, m_Info.GetTileBytes());
+
+		// Tiles never written read as transparent, also past the end of the file
+		m_Stream.seekg((std::streamoff)m_Info.GetTileOffset(level, x, y));
+		m_Stream.read((char*)data, (std::streamsize)m_Info.GetTileBytes());
+		m_Stream.clear();
+	}
+
+	bool TiledPyramidWriter::Finish()
+	{
+		if (!IsOpen())
+			return false;
+
+		const uint32_t tileSize = m_Info.TileSize;
+		const uint32_t halfTileSize = tileSize / 2;
+		std::vector<uint8_t> child(m_Info.GetTileBytes());
+		std::vector<uint8_t> tile(m_Info.GetTileBytes());
+
+		for (uint32_t level = 1; level < m_Info.LevelCount; level++)
+		{
+			uint32_t childLevelWidth = m_Info.GetLevelWidth(level - 1);
+			uint32_t childLevelHeight = m_Info.GetLevelHeight(level - 1);
+			uint32_t childTilesX = m_Info.GetTilesX(level - 1);
+			uint32_t childTilesY = m_Info.GetTilesY(level - 1);
+
+			for (uint32_t y = 0; y < m_Info.GetTilesY(level); y++)
+			{
+				for (uint32_t x = 0; x < m_Info.GetTilesX(level); x++)
+				{
+					std::fill(tile.begin(), tile.end(), (uint8_t)0);
+
+					// Each child tile shrinks into one quadrant
+					for (uint32_t quadrant = 0; quadrant < 4; quadrant++)
+					{
+						uint32_t childX = x * 2 + (quadrant & 1);
+						uint32_t childY = y * 2 + (quadrant >> 1);
+						if (childX >= childTilesX || childY >= childTilesY)
+							continue;
+
+						ReadLevelTile(level - 1, childX, childY, child.data());
+
+						for (uint32_t py = 0; py < halfTileSize; py++)
+						{
+							for (uint32_t px = 0; px < halfTileSize; px++)
+							{
+								// Only average the source pixels inside the image
+								uint32_t sum[4] = {};
+								uint32_t count = 0;
+								for (uint32_t sy = py * 2; sy < py * 2 + 2; sy++)
+								{
+									if (childY * tileSize + sy >= childLevelHeight)
+										continue;
+									for (uint32_t sx = px * 2; sx < px * 2 + 2; sx++)
+									{
+										if (childX * tileSize + sx >= childLevelWidth)
+											continue;
+										const uint8_t* source = &child[((size_t)sy * tileSize + sx) * 4];
+										for (int c = 0; c < 4; c++)
+											sum[c] += source[c];
+										count++;
+									}
+								}
+								if (count == 0)
+									continue;
+
+								uint32_t tx = (quadrant & 1) * halfTileSize + px;
+								uint32_t ty = (quadrant >> 1) * halfTileSize + py;
+								uint8_t* destination = &tile[((size_t)ty * tileSize + tx) * 4];
+								for (int c = 0; c < 4; c++)
+									destination[c] = (uint8_t)((sum[c] + count / 2) / count);
+							}
+						}
+					}
+
+					WriteLevelTile(level, x, y, tile.data());
+				}
+			}
+		}
+
+		m_Finished = true;
+		m_Stream.flush();
+		return (bool)m_Stream;
+	}
+
+	struct TiledImage::TileStream
+	{
+		std::string Path;
+		TiledPyramidInfo Info;
+
+		std::mutex Mutex;
+		std::vector<LoadedTile> Loaded;
+	};
+
+	TiledImage::TiledImage(std::string_view path, uint32_t cacheSize)
+	{
+		m_Stream = std::make_shared<TileStream>();
+		m_Stream->Path = path;
+
+		std::ifstream stream(m_Stream->Path, std::ios::binary);
+		TiledPyramidHeader header = {};
+		if (!stream.read((char*)&header, sizeof(header)) || memcmp(header.Magic, s_TiledPyramidMagic, sizeof(header.Magic)) != 0)
+		{
+			std::cerr << "[TiledImage] " << path << " is not a tiled pyramid\n";
+			return;
+		}
+
+		bool validSize = header.Width > 0 && header.Height > 0 && header.TileSize >= 2 && header.TileSize % 2 == 0;
+		if (validSize)
+			m_Info = TiledPyramidInfo::Create(header.Width, header.Height, header.TileSize);
+		if (!validSize || m_Info.LevelCount != header.LevelCount)
+		{
+			std::cerr << "[TiledImage] " << path << " has an invalid header\n";
+			m_Info = TiledPyramidInfo();
+			return;
+		}
+		m_Stream->Info = m_Info;
+
+		AllocateCache(cacheSize);
+	}
+
+	TiledImage::~TiledImage()
+	{
+		Release();
+	}
+
+	void TiledImage::AllocateCache(uint32_t cacheSize)
+	{
+		VkDevice device = Application::GetDevice();
+		VkResult err;
+
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(Application::GetPhysicalDevice(), &properties);
+		cacheSize = std::min(cacheSize, properties.limits.maxImageDimension2D);
+
+		const uint32_t tileSize = m_Info.TileSize;
+		m_SlotsPerRow = std::max(1u, cacheSize / tileSize);
+		m_CacheSize = m_SlotsPerRow * tileSize;
+		m_Slots.assign((size_t)m_SlotsPerRow * m_SlotsPerRow, CacheSlot());
+
+		{
+			VkImageCreateInfo info = {};
+			info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+			info.imageType = VK_IMAGE_TYPE_2D;
+			info.format = VK_FORMAT_R8G8B8A8_UNORM;
+			info.extent.width = m_CacheSize;
+			info.extent.height = m_CacheSize;
+			info.extent.depth = 1;
+			info.mipLevels = 1;
+			info.arrayLayers = 1;
+			info.samples = VK_SAMPLE_COUNT_1_BIT;
+			info.tiling = VK_IMAGE_TILING_OPTIMAL;
+			info.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+			info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			err = vkCreateImage(device, &info, Application::GetAllocator(), &m_CacheImage);
+			check_vk_result(err);
+			VkMemoryRequirements req;
+			vkGetImageMemoryRequirements(device, m_CacheImage, &req);
+			VkMemoryAllocateInfo alloc_info = {};
+			alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+			alloc_info.allocationSize = req.size;
+			alloc_info.memoryTypeIndex = Utils::GetVulkanMemoryType(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, req.memoryTypeBits);
+			err = GPUMemory::Allocate(alloc_info, GPUMemoryCategory::Image, &m_CacheMemory);
+			check_vk_result(err);
+			err = vkBindImageMemory(device, m_CacheImage, m_CacheMemory, 0);
+			check_vk_result(err);
+		}
+
+		{
+			VkImageViewCreateInfo info = {};
+			info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+			info.image = m_CacheImage;
+			info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			info.format = VK_FORMAT_R8G8B8A8_UNORM;
+			info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			info.subresourceRange.levelCount = 1;
+			info.subresourceRange.layerCount = 1;
+			err = vkCreateImageView(device, &info, Application::GetAllocator(), &m_CacheImageView);
+			check_vk_result(err);
+		}
+
+		// UVs stay half a texel inside each slot, so linear filtering never reaches a neighbouring tile
+		SamplerSpecification samplerSpecification;
+		samplerSpecification.AddressModeU = samplerSpecification.AddressModeV = samplerSpecification.AddressModeW = SamplerAddressMode::ClampToEdge;
+		m_CacheDescriptorSet = (VkDescriptorSet)ImGui_ImplVulkan_AddTexture(SamplerCache::Get(samplerSpecification), m_CacheImageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+		{
+			VkCommandPoolCreateInfo pool_info = {};
+			pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+			pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+			pool_info.queueFamilyIndex = Application::GetQueueFamilyIndex();
+			err = vkCreateCommandPool(device, &pool_info, Application::GetAllocator(), &m_CommandPool);
+			check_vk_result(err);
+		}
+
+		// Persistently mapped, each is reused once its fence reports the previous copy done
+		for (UploadBuffer& upload : m_UploadBuffers)
+		{
+			VkBufferCreateInfo buffer_info = {};
+			buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+			buffer_info.size = m_Info.GetTileBytes() * MaxTileUploadsPerFrame;
+			buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+			buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			err = vkCreateBuffer(device, &buffer_info, Application::GetAllocator(), &upload.StagingBuffer);
+			check_vk_result(err);
+			VkMemoryRequirements req;
+			vkGetBufferMemoryRequirements(device, upload.StagingBuffer, &req);
+			VkMemoryAllocateInfo alloc_info = {};
+			alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+			alloc_info.allocationSize = req.size;
+			alloc_info.memoryTypeIndex = Utils::GetVulkanMemoryType(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, req.memoryTypeBits);
+			err = GPUMemory::Allocate(alloc_info, GPUMemoryCategory::Staging, &upload.StagingBufferMemory);
+			check_vk_result(err);
+			err = vkBindBufferMemory(device, upload.StagingBuffer, upload.StagingBufferMemory, 0);
+			check_vk_result(err);
+			err = vkMapMemory(device, upload.StagingBufferMemory, 0, VK_WHOLE_SIZE, 0, &upload.MappedStagingBuffer);
+			check_vk_result(err);
+
+			VkCommandBufferAllocateInfo command_buffer_info = {};
+			command_buffer_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			command_buffer_info.commandPool = m_CommandPool;
+			command_buffer_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			command_buffer_info.commandBufferCount = 1;
+			err = vkAllocateCommandBuffers(device, &command_buffer_info, &upload.CommandBuffer);
+			check_vk_result(err);
+
+			VkFenceCreateInfo fence_info = {};
+			fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+			fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+			err = vkCreateFence(device, &fence_info, Application::GetAllocator(), &upload.Fence);
+			check_vk_result(err);
+		}
+	}
+
+	void TiledImage::Release()
+	{
+		if (!m_CacheImage)
+			return;
+
+		Application::SubmitResourceFree([descriptorSet = m_CacheDescriptorSet, imageView = m_CacheImageView, image = m_CacheImage,
+			memory = m_CacheMemory, commandPool = m_CommandPool, uploads = m_UploadBuffers]()
+		{
+			VkDevice device = Application::GetDevice();
+
+			// Uploads are separate submissions, so the frame fences alone do not cover them
+			for (const UploadBuffer& upload : uploads)
+			{
+				vkWaitForFences(device, 1, &upload.Fence, VK_TRUE, UINT64_MAX);
+				vkDestroyFence(device, upload.Fence, Application::GetAllocator());
+				vkFreeCommandBuffers(device, commandPool, 1, &upload.CommandBuffer);
+				vkDestroyBuffer(device, upload.StagingBuffer, Application::GetAllocator());
+				GPUMemory::Free(upload.StagingBufferMemory);
+			}
+			vkDestroyCommandPool(device, commandPool, Application::GetAllocator());
+
+			vkFreeDescriptorSets(device, Application::GetDescriptorPool(), 1, &descriptorSet);
+			vkDestroyImageView(device, imageView, Application::GetAllocator());
+			vkDestroyImage(device, image, Application::GetAllocator());
+			GPUMemory::Free(memory);
+		});
+
+		m_CacheDescriptorSet = nullptr;
+		m_CacheImageView = nullptr;
+		m_CacheImage = nullptr;
+		m_CacheMemory = nullptr;
+		m_CommandPool = nullptr;
+		m_UploadBuffers = {};
+	}
+
+	uint32_t TiledImage::UseTile(uint64_t key)
+	{
+		auto it = m_ResidentTiles.find(key);
+		if (it == m_ResidentTiles.end())
+			return UINT32_MAX;
+
+		m_Slots[it->second].LastUsedFrame = m_Frame;
+		return it->second;
+	}
+
+	void TiledImage::RequestTile(uint64_t key, float priority)
+	{
+		if (m_ResidentTiles.count(key) || m_InFlightTiles.count(key))
+			return;
+		m_WantedTiles.emplace_back(priority, key);
+	}
+
+	void TiledImage::SubmitTileRequests()
+	{
+		std::sort(m_WantedTiles.begin(), m_WantedTiles.end());
+
+		// Requests for tiles that scrolled out of view before being submitted are simply dropped
+		for (const auto& [priority, key] : m_WantedTiles)
+		{
+			if (m_InFlightTiles.size() >= MaxTileRequests)
+				break;
+			if (!m_InFlightTiles.insert(key).second)
+				continue;
+
+			uint32_t level = (uint32_t)(key >> 48);
+			uint32_t y = (uint32_t)(key >> 24) & 0xffffff;
+			uint32_t x = (uint32_t)key & 0xffffff;
+
+			Application::Get().GetThreadPool().Submit([stream = m_Stream, key = key, offset = m_Info.GetTileOffset(level, x, y)]()
+			{
+				LoadedTile tile;
+				tile.Key = key;
+				tile.Pixels.resize(stream->Info.GetTileBytes(), 0);
+
+				// A failed read leaves the tile transparent rather than requesting it again every frame
+				std::ifstream file(stream->Path, std::ios::binary);
+				if (file.seekg((std::streamoff)offset))
+					file.read((char*)tile.Pixels.data(), (std::streamsize)tile.Pixels.size());
+
+				std::scoped_lock<std::mutex> lock(stream->Mutex);
+				stream->Loaded.push_back(std::move(tile));
+			});
+		}
+
+		m_WantedTiles.clear();
+	}
+
+	uint32_t TiledImage::AcquireSlot()
+	{
+		uint32_t best = UINT32_MAX;
+		for (uint32_t i = 0; i < (uint32_t)m_Slots.size(); i++)
+		{
+			const CacheSlot& slot = m_Slots[i];
+			if (slot.Key == UINT64_MAX)
+				return i;
+			if (slot.LastUsedFrame < m_Frame && (best == UINT32_MAX || slot.LastUsedFrame < m_Slots[best].LastUsedFrame))
+				best = i;
+		}
+
+		if (best != UINT32_MAX)
+			m_ResidentTiles.erase(m_Slots[best].Key);
+		return best;
+	}
+
+	void TiledImage::UploadLoadedTiles()
+	{
+		VkDevice device = Application::GetDevice();
+
+		UploadBuffer* upload = nullptr;
+		for (UploadBuffer& candidate : m_UploadBuffers)
+		{
+			if (vkGetFenceStatus(device, candidate.Fence) == VK_SUCCESS)
+			{
+				upload = &candidate;
+				break;
+			}
+		}
+		if (!upload)
+			return;
+
+		std::vector<LoadedTile> loaded;
+		{
+			std::scoped_lock<std::mutex> lock(m_Stream->Mutex);
+			size_t count = std::min<size_t>(m_Stream->Loaded.size(), MaxTileUploadsPerFrame);
+			loaded.assign(std::make_move_iterator(m_Stream->Loaded.begin()), std::make_move_iterator(m_Stream->Loaded.begin() + count));
+			m_Stream->Loaded.erase(m_Stream->Loaded.begin(), m_Stream->Loaded.begin() + count);
+		}
+		if (loaded.empty())
+			return;
+
+		const uint32_t tileSize = m_Info.TileSize;
+		const uint64_t tileBytes = m_Info.GetTileBytes();
+
+		std::vector<VkBufferImageCopy> regions;
+		regions.reserve(loaded.size());
+		for (LoadedTile& tile : loaded)
+		{
+			m_InFlightTiles.erase(tile.Key);
+
+			// Every slot is on screen, the tile is requested again once there is room
+			uint32_t slotIndex = AcquireSlot();
+			if (slotIndex == UINT32_MAX)
+				continue;
+
+			CacheSlot& slot = m_Slots[slotIndex];
+			slot.Key = tile.Key;
+			slot.LastUsedFrame = m_Frame;
+			m_ResidentTiles[tile.Key] = slotIndex;
+
+			VkBufferImageCopy region = {};
+			region.bufferOffset = regions.size() * tileBytes;
+			region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			region.imageSubresource.layerCount = 1;
+			region.imageOffset = { (int32_t)((slotIndex % m_SlotsPerRow) * tileSize), (int32_t)((slotIndex / m_SlotsPerRow) * tileSize), 0 };
+			region.imageExtent = { tileSize, tileSize, 1 };
+			memcpy((uint8_t*)upload->MappedStagingBuffer + region.bufferOffset, tile.Pixels.data(), tileBytes);
+			regions.push_back(region);
+		}
+		if (regions.empty())
+			return;
+
+		VkMappedMemoryRange range = {};
+		range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+		range.memory = upload->StagingBufferMemory;
+		range.size = VK_WHOLE_SIZE;
+		VkResult err = vkFlushMappedMemoryRanges(device, 1, &range);
+		check_vk_result(err);
+
+		err = vkResetFences(device, 1, &upload->Fence);
+		check_vk_result(err);
+		err = vkResetCommandBuffer(upload->CommandBuffer, 0);
+		check_vk_result(err);
+
+		VkCommandBuffer command_buffer = upload->CommandBuffer;
+		VkCommandBufferBeginInfo begin_info = {};
+		begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		begin_info.flags |= VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		err = vkBeginCommandBuffer(command_buffer, &begin_info);
+		check_vk_result(err);
+
+		// Slots being replaced may still be sampled by frames in flight, which were submitted before this
+		VkImageMemoryBarrier copy_barrier = {};
+		copy_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		copy_barrier.srcAccessMask = m_CacheInitialized ? VK_ACCESS_SHADER_READ_BIT : 0;
+		copy_barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		copy_barrier.oldLayout = m_CacheInitialized ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
+		copy_barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		copy_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		copy_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		copy_barrier.image = m_CacheImage;
+		copy_barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		copy_barrier.subresourceRange.levelCount = 1;
+		copy_barrier.subresourceRange.layerCount = 1;
+		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1, &copy_barrier);
+
+		vkCmdCopyBufferToImage(command_buffer, upload->StagingBuffer, m_CacheImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, (uint32_t)regions.size(), regions.data());
+
+		VkImageMemoryBarrier use_barrier = copy_barrier;
+		use_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		use_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		use_barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		use_barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, NULL, 0, NULL, 1, &use_barrier);
+
+		err = vkEndCommandBuffer(command_buffer);
+		check_vk_result(err);
+
+		// Ahead of this frame's submission on the same queue, so the frame already samples the new tiles
+		VkSubmitInfo submit_info = {};
+		submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submit_info.commandBufferCount = 1;
+		submit_info.pCommandBuffers = &command_buffer;
+		err = vkQueueSubmit(Application::GetQueue(), 1, &submit_info, upload->Fence);
+		check_vk_result(err);
+		m_CacheInitialized = true;
+	}
+
+	void TiledImage::SetView(ImVec2 center, float zoom)
+	{
+		m_ViewCenter = center;
+		m_Zoom = zoom;
+	}
+
+	void TiledImage::DrawView(const char* id, ImVec2 size)
+	{
+		ImVec2 available = ImGui::GetContentRegionAvail();
+		if (size.x <= 0.0f)
+			size.x = available.x;
+		if (size.y <= 0.0f)
+			size.y = available.y;
+		size.x = std::max(size.x, 1.0f);
+		size.y = std::max(size.y, 1.0f);
+
+		ImVec2 origin = ImGui::GetCursorScreenPos();
+		ImGui::InvisibleButton(id, size);
+		if (!IsLoaded())
+			return;
+
+		m_Frame++;
+
+		// Navigation
+		float fitZoom = std::min(size.x / m_Info.Width, size.y / m_Info.Height);
+		ImGuiIO& io = ImGui::GetIO();
+		if (m_Zoom <= 0.0f || (ImGui::IsItemHovered() && ImGui::IsMouseDoubleClicked(ImGuiMouseButton_Left)))
+		{
+			m_Zoom = fitZoom;
+			m_ViewCenter = ImVec2(m_Info.Width * 0.5f, m_Info.Height * 0.5f);
+		}
+		if (ImGui::IsItemActive() && ImGui::IsMouseDragging(ImGuiMouseButton_Left, 0.0f))
+		{
+			m_ViewCenter.x -= io.MouseDelta.x / m_Zoom;
+			m_ViewCenter.y -= io.MouseDelta.y / m_Zoom;
+		}
+		if (ImGui::IsItemHovered() && io.MouseWheel != 0.0f)
+		{
+			// Keep the image point under the cursor in place
+			ImVec2 cursor = ImVec2(io.MousePos.x - origin.x - size.x * 0.5f, io.MousePos.y - origin.y - size.y * 0.5f);
+			ImVec2 point = ImVec2(m_ViewCenter.x + cursor.x / m_Zoom, m_ViewCenter.y + cursor.y / m_Zoom);
+			m_Zoom = std::clamp(m_Zoom * std::pow(1.2f, io.MouseWheel), fitZoom * 0.25f, 64.0f);
+			m_ViewCenter = ImVec2(point.x - cursor.x / m_Zoom, point.y - cursor.y / m_Zoom);
+		}
+
+		UploadLoadedTiles();
+
+		// The coarsest level whose pixels are at most a screen pixel (more than half of one), so detail is never
+		// lost to a coarser level and the view is never minified more than 2x
+		const uint32_t coarsestLevel = m_Info.LevelCount - 1;
+		uint32_t level = m_Zoom >= 1.0f ? 0 : std::min((uint32_t)std::floor(std::log2(1.0f / m_Zoom)), coarsestLevel);
+
+		const float left = m_ViewCenter.x - size.x * 0.5f / m_Zoom;
+		const float top = m_ViewCenter.y - size.y * 0.5f / m_Zoom;
+		const float right = m_ViewCenter.x + size.x * 0.5f / m_Zoom;
+		const float bottom = m_ViewCenter.y + size.y * 0.5f / m_Zoom;
+
+		ImDrawList* drawList = ImGui::GetWindowDrawList();
+		drawList->PushClipRect(origin, ImVec2(origin.x + size.x, origin.y + size.y), true);
+
+		const float tileSize = (float)m_Info.TileSize;
+		const float cacheScale = 1.0f / m_CacheSize;
+
+		// Draws the part of a resident tile covering imageMin..imageMax (image pixels)
+		auto drawTile = [&](uint32_t slotIndex, uint32_t tileLevel, uint32_t tileX, uint32_t tileY, ImVec2 imageMin, ImVec2 imageMax)
+		{
+			float levelScale = (float)(1u << tileLevel);
+			float tileOriginX = tileX * tileSize * levelScale;
+			float tileOriginY = tileY * tileSize * levelScale;
+			float slotX = (float)(slotIndex % m_SlotsPerRow) * tileSize;
+			float slotY = (float)(slotIndex / m_SlotsPerRow) * tileSize;
+
+			auto uv = [&](float imageCoordinate, float tileOrigin, float slotOrigin)
+			{
+				float texel = std::clamp((imageCoordinate - tileOrigin) / levelScale, 0.5f, tileSize - 0.5f);
+				return (slotOrigin + texel) * cacheScale;
+			};
+
+			ImVec2 p0 = ImVec2(origin.x + (imageMin.x - left) * m_Zoom, origin.y + (imageMin.y - top) * m_Zoom);
+			ImVec2 p1 = ImVec2(origin.x + (imageMax.x - left) * m_Zoom, origin.y + (imageMax.y - top) * m_Zoom);
+			ImVec2 uv0 = ImVec2(uv(imageMin.x, tileOriginX, slotX), uv(imageMin.y, tileOriginY, slotY));
+			ImVec2 uv1 = ImVec2(uv(imageMax.x, tileOriginX, slotX), uv(imageMax.y, tileOriginY, slotY));
+			drawList->AddImage((ImTextureID)m_CacheDescriptorSet, p0, p1, uv0, uv1);
+		};
+
+		// The coarsest level is always wanted first, so there is something to fall back to
+		for (uint32_t y = 0; y < m_Info.GetTilesY(coarsestLevel); y++)
+		{
+			for (uint32_t x = 0; x < m_Info.GetTilesX(coarsestLevel); x++)
+			{
+				uint64_t key = TileKey(coarsestLevel, x, y);
+				UseTile(key);
+				RequestTile(key, 0.0f);
+			}
+		}
+
+		const float levelTileSize = tileSize * (float)(1u << level);
+		uint32_t tileX0 = (uint32_t)std::clamp(std::floor(left / levelTileSize), 0.0f, (float)(m_Info.GetTilesX(level) - 1));
+		uint32_t tileY0 = (uint32_t)std::clamp(std::floor(top / levelTileSize), 0.0f, (float)(m_Info.GetTilesY(level) - 1));
+		uint32_t tileX1 = (uint32_t)std::clamp(std::floor(right / levelTileSize), 0.0f, (float)(m_Info.GetTilesX(level) - 1));
+		uint32_t tileY1 = (uint32_t)std::clamp(std::floor(bottom / levelTileSize), 0.0f, (float)(m_Info.GetTilesY(level) - 1));
+
+		const float viewRadius = std::max(1.0f, std::sqrt(size.x * size.x + size.y * size.y) * 0.5f / m_Zoom);
+		for (uint32_t y = tileY0; y <= tileY1; y++)
+		{
+			for (uint32_t x = tileX0; x <= tileX1; x++)
+			{
+				ImVec2 imageMin = ImVec2(x * levelTileSize, y * levelTileSize);
+				ImVec2 imageMax = ImVec2(std::min(imageMin.x + levelTileSize, (float)m_Info.Width), std::min(imageMin.y + levelTileSize, (float)m_Info.Height));
+
+				uint64_t key = TileKey(level, x, y);
+				uint32_t slotIndex = UseTile(key);
+				if (slotIndex != UINT32_MAX)
+				{
+					drawTile(slotIndex, level, x, y, imageMin, imageMax);
+					continue;
+				}
+
+				// Center tiles first
+				float dx = (imageMin.x + imageMax.x) * 0.5f - m_ViewCenter.x;
+				float dy = (imageMin.y + imageMax.y) * 0.5f - m_ViewCenter.y;
+				RequestTile(key, 1.0f + std::sqrt(dx * dx + dy * dy) / viewRadius);
+
+				// Until then, the closest coarser level that is resident
+				for (uint32_t parentLevel = level + 1; parentLevel <= coarsestLevel; parentLevel++)
+				{
+					uint32_t shift = parentLevel - level;
+					uint32_t parentSlot = UseTile(TileKey(parentLevel, x >> shift, y >> shift));
+					if (parentSlot != UINT32_MAX)
+					{
+						drawTile(parentSlot, parentLevel, x >> shift, y >> shift, imageMin, imageMax);
+						break;
+					}
+				}
+			}
+		}
+
+		drawList->PopClipRect();
+
+		SubmitTileRequests();
+	}
+
+}
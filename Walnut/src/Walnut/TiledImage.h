@@ -0,0 +1,166 @@
+#pragma once
+
+#include <stdint.h>
+#include <array>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "imgui.h"
+#include "vulkan/vulkan.h"
+
+namespace Walnut {
+
+	// Tiled RGBA8 pyramid on disk (.wtp): a header followed by every level, finest first, each stored as
+	// row-major tiles of TileSize x TileSize pixels. Tiles have a fixed size so they can be read at computed
+	// offsets; pixels past the image edge are transparent. Level n is level 0 halved n times, down to one tile.
+	struct TiledPyramidInfo
+	{
+		uint32_t Width = 0, Height = 0;
+		uint32_t TileSize = 0;
+		uint32_t LevelCount = 0;
+
+		uint32_t GetLevelWidth(uint32_t level) const;
+		uint32_t GetLevelHeight(uint32_t level) const;
+		uint32_t GetTilesX(uint32_t level) const;
+		uint32_t GetTilesY(uint32_t level) const;
+		uint64_t GetTileOffset(uint32_t level, uint32_t x, uint32_t y) const;
+		uint64_t GetTileBytes() const { return (uint64_t)TileSize * TileSize * 4; }
+
+		static TiledPyramidInfo Create(uint32_t width, uint32_t height, uint32_t tileSize);
+	};
+
+	// Writes a pyramid without ever holding more than a few tiles in memory: level 0 is passed in tile by tile,
+	// Finish() builds the coarser levels by box filtering the level below, read back from the file
+	class TiledPyramidWriter
+	{
+	public:
+		TiledPyramidWriter(std::string_view path, uint32_t width, uint32_t height, uint32_t tileSize = 256);
+		~TiledPyramidWriter();
+
+		bool IsOpen() const { return m_Stream.is_open(); }
+		const TiledPyramidInfo& GetInfo() const { return m_Info; }
+
+		// TileSize x TileSize RGBA8 pixels of level 0. Pixels past the image edge are ignored.
+		// Returns false, writing nothing, when x or y is outside level 0's tiles
+		bool WriteTile(uint32_t x, uint32_t y, const void* data);
+
+		// Tiles never written stay transparent
+		bool Finish();
+	private:
+		void WriteLevelTile(uint32_t level, uint32_t x, uint32_t y, const uint8_t* data);
+		void ReadLevelTile(uint32_t level, uint32_t x, uint32_t y, uint8_t* data);
+	private:
+		TiledPyramidInfo m_Info;
+		std::fstream m_Stream;
+		bool m_Finished = false;
+	};
+
+	// Displays a pyramid of any size. Only the tiles covering the view are read, on worker threads, at the level
+	// matching the zoom, and kept in a fixed-size GPU tile cache. Missing tiles are drawn from a coarser level
+	// until they arrive. Every tile is drawn from the same cache texture, so the whole view is one descriptor set.
+	class TiledImage
+	{
+	public:
+		// cacheSize is the side of the cache texture in pixels, clamped to the device limit
+		TiledImage(std::string_view path, uint32_t cacheSize = 4096);
+		~TiledImage();
+
+		TiledImage(const TiledImage&) = delete;
+		TiledImage& operator=(const TiledImage&) = delete;
+
+		bool IsLoaded() const { return m_Info.LevelCount > 0; }
+		uint32_t GetWidth() const { return m_Info.Width; }
+		uint32_t GetHeight() const { return m_Info.Height; }
+		const TiledPyramidInfo& GetInfo() const { return m_Info; }
+
+		// Pan/zoom widget: drag to pan, mouse wheel to zoom around the cursor, double click to fit.
+		// size of 0 fills the available region
+		void DrawView(const char* id, ImVec2 size = ImVec2(0.0f, 0.0f));
+
+		// Image pixel at the center of the view and screen pixels per image pixel
+		void SetView(ImVec2 center, float zoom);
+		ImVec2 GetViewCenter() const { return m_ViewCenter; }
+		float GetZoom() const { return m_Zoom; }
+
+		uint32_t GetResidentTileCount() const { return (uint32_t)m_ResidentTiles.size(); }
+		uint32_t GetPendingTileCount() const { return (uint32_t)m_InFlightTiles.size(); }
+
+		// Tile reads in flight at once, and uploads to the cache per frame
+		static constexpr uint32_t MaxTileRequests = 32;
+		static constexpr uint32_t MaxTileUploadsPerFrame = 16;
+		// Uploads on the GPU at once, a frame with none free leaves its tiles for the next one
+		static constexpr uint32_t MaxUploadsInFlight = 3;
+	private:
+		struct LoadedTile
+		{
+			uint64_t Key;
+			std::vector<uint8_t> Pixels;
+		};
+
+		// Shared with the worker jobs, which may outlive the image
+		struct TileStream;
+
+		// Submitted on its own and polled through the fence, so streaming never waits for the queue
+		struct UploadBuffer
+		{
+			VkBuffer StagingBuffer = nullptr;
+			VkDeviceMemory StagingBufferMemory = nullptr;
+			void* MappedStagingBuffer = nullptr;
+			VkCommandBuffer CommandBuffer = nullptr;
+			VkFence Fence = nullptr; // Signaled while the buffer is free
+		};
+
+		struct CacheSlot
+		{
+			uint64_t Key = UINT64_MAX;
+			uint64_t LastUsedFrame = 0;
+		};
+
+		static uint64_t TileKey(uint32_t level, uint32_t x, uint32_t y) { return ((uint64_t)level << 48) | ((uint64_t)y << 24) | x; }
+
+		void AllocateCache(uint32_t cacheSize);
+		void Release();
+
+		// Finds a resident tile and marks it used this frame, UINT32_MAX when it is not resident
+		uint32_t UseTile(uint64_t key);
+
+		// Lower priorities are read first. Only the most urgent requests of a frame are submitted
+		void RequestTile(uint64_t key, float priority);
+		void SubmitTileRequests();
+
+		void UploadLoadedTiles();
+
+		// Least recently used slot not drawn this frame, UINT32_MAX when every slot is in use
+		uint32_t AcquireSlot();
+	private:
+		TiledPyramidInfo m_Info;
+		std::shared_ptr<TileStream> m_Stream;
+
+		// Cache texture of m_SlotsPerRow x m_SlotsPerRow tiles
+		uint32_t m_CacheSize = 0;
+		uint32_t m_SlotsPerRow = 0;
+		VkImage m_CacheImage = nullptr;
+		VkImageView m_CacheImageView = nullptr;
+		VkDeviceMemory m_CacheMemory = nullptr;
+		VkDescriptorSet m_CacheDescriptorSet = nullptr;
+		bool m_CacheInitialized = false;
+
+		VkCommandPool m_CommandPool = nullptr;
+		std::array<UploadBuffer, MaxUploadsInFlight> m_UploadBuffers;
+
+		std::vector<CacheSlot> m_Slots;
+		std::unordered_map<uint64_t, uint32_t> m_ResidentTiles; // Key to slot
+		std::unordered_set<uint64_t> m_InFlightTiles;
+		std::vector<std::pair<float, uint64_t>> m_WantedTiles;  // Requested this frame
+		uint64_t m_Frame = 0;
+
+		ImVec2 m_ViewCenter = ImVec2(0.0f, 0.0f);
+		float m_Zoom = 0.0f; // 0 fits the image on the first draw
+	};
+
+}
@@ -2,7 +2,8 @@
 
 #include <iostream>
 #include <string>
-#include <chrono>
+
+#include "Clock.h"
 
 namespace Walnut {
 
@@ -16,21 +17,26 @@ namespace Walnut {
 
 		void Reset()
 		{
-			m_Start = std::chrono::high_resolution_clock::now();
+			m_Start = Clock::Now();
+		}
+
+		double Elapsed()
+		{
+			return Clock::ToSeconds(Clock::Now() - m_Start);
 		}
 
-		float Elapsed()
+		double ElapsedMillis()
 		{
-			return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - m_Start).count() * 0.001f * 0.001f * 0.001f;
+			return Clock::ToMillis(Clock::Now() - m_Start);
 		}
 
-		float ElapsedMillis()
+		int64_t ElapsedTicks()
 		{
-			return Elapsed() * 1000.0f;
+			return Clock::Now() - m_Start;
 		}
 
 	private:
-		std::chrono::time_point<std::chrono::high_resolution_clock> m_Start;
+		int64_t m_Start;
 	};
 
 	class ScopedTimer
@@ -40,7 +46,7 @@ namespace Walnut {
 			: m_Name(name) {}
 		~ScopedTimer()
 		{
-			float time = m_Timer.ElapsedMillis();
+			double time = m_Timer.ElapsedMillis();
 			std::cout << "[TIMER] " << m_Name << " - " << time << "ms\n";
 		}
 	private:
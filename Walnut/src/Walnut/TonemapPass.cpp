@@ -0,0 +1,204 @@
+#include "TonemapPass.h"
+
+#include "Application.h"
+
+#include <cmath>
+#include <mutex>
+
+// Compiled from Shaders/Tonemap.comp, see scripts/CompileShaders.sh
+const uint32_t g_TonemapComputeShader[] =
+{
+#include "Shaders/Tonemap.comp.inc"
+};
+
+namespace Walnut {
+
+	static constexpr uint32_t c_TonemapGroupSize = 8;
+
+	// Matches the push constant block in Shaders/Tonemap.comp
+	struct TonemapPushConstants
+	{
+		float Exposure;
+		float Reinhard;
+		float ACES;
+		float SRGB;
+		uint32_t Width, Height;
+	};
+
+	static std::mutex s_TonemapPassMutex;
+	static VkDescriptorSetLayout s_TonemapDescriptorSetLayout = VK_NULL_HANDLE;
+	static VkPipelineLayout s_TonemapPipelineLayout = VK_NULL_HANDLE;
+	static VkPipeline s_TonemapPipeline = VK_NULL_HANDLE;
+
+	namespace Utils {
+
+		static void CreateTonemapPipeline()
+		{
+			std::scoped_lock<std::mutex> lock(s_TonemapPassMutex);
+			if (s_TonemapPipeline)
+				return;
+
+			VkDevice device = Application::GetDevice();
+			VkResult err;
+
+			{
+				VkDescriptorSetLayoutBinding bindings[2] = {};
+				bindings[0].binding = 0;
+				bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+				bindings[0].descriptorCount = 1;
+				bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+				bindings[1].binding = 1;
+				bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+				bindings[1].descriptorCount = 1;
+				bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+				VkDescriptorSetLayoutCreateInfo info = {};
+				info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+				info.bindingCount = 2;
+				info.pBindings = bindings;
+				err = vkCreateDescriptorSetLayout(device, &info, Application::GetAllocator(), &s_TonemapDescriptorSetLayout);
+				check_vk_result(err);
+			}
+
+			{
+				VkPushConstantRange push_constants = {};
+				push_constants.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+				push_constants.size = sizeof(TonemapPushConstants);
+
+				VkPipelineLayoutCreateInfo info = {};
+				info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+				info.setLayoutCount = 1;
+				info.pSetLayouts = &s_TonemapDescriptorSetLayout;
+				info.pushConstantRangeCount = 1;
+				info.pPushConstantRanges = &push_constants;
+				err = vkCreatePipelineLayout(device, &info, Application::GetAllocator(), &s_TonemapPipelineLayout);
+				check_vk_result(err);
+			}
+
+			{
+				VkShaderModuleCreateInfo module_info = {};
+				module_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+				module_info.codeSize = sizeof(g_TonemapComputeShader);
+				module_info.pCode = g_TonemapComputeShader;
+				VkShaderModule shader_module;
+				err = vkCreateShaderModule(device, &module_info, Application::GetAllocator(), &shader_module);
+				check_vk_result(err);
+
+				VkComputePipelineCreateInfo info = {};
+				info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+				info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+				info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+				info.stage.module = shader_module;
+				info.stage.pName = "main";
+				info.layout = s_TonemapPipelineLayout;
+				err = vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &info, Application::GetAllocator(), &s_TonemapPipeline);
+				check_vk_result(err);
+
+				// Only needed while creating the pipeline
+				vkDestroyShaderModule(device, shader_module, Application::GetAllocator());
+			}
+		}
+
+	}
+
+	VkDescriptorSet TonemapPass::AllocateDescriptorSet(VkSampler sampler, VkImageView sourceView, VkImageView displayView)
+	{
+		Utils::CreateTonemapPipeline();
+
+		VkDevice device = Application::GetDevice();
+
+		VkDescriptorSetAllocateInfo alloc_info = {};
+		alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		alloc_info.descriptorPool = Application::GetDescriptorPool();
+		alloc_info.descriptorSetCount = 1;
+		alloc_info.pSetLayouts = &s_TonemapDescriptorSetLayout;
+		VkDescriptorSet descriptorSet;
+		VkResult err = vkAllocateDescriptorSets(device, &alloc_info, &descriptorSet);
+		check_vk_result(err);
+
+		VkDescriptorImageInfo source_info = {};
+		source_info.sampler = sampler;
+		source_info.imageView = sourceView;
+		source_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		VkDescriptorImageInfo display_info = {};
+		display_info.imageView = displayView;
+		display_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+		VkWriteDescriptorSet writes[2] = {};
+		writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[0].dstSet = descriptorSet;
+		writes[0].dstBinding = 0;
+		writes[0].descriptorCount = 1;
+		writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		writes[0].pImageInfo = &source_info;
+		writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[1].dstSet = descriptorSet;
+		writes[1].dstBinding = 1;
+		writes[1].descriptorCount = 1;
+		writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		writes[1].pImageInfo = &display_info;
+		vkUpdateDescriptorSets(device, 2, writes, 0, nullptr);
+
+		return descriptorSet;
+	}
+
+	void TonemapPass::Record(VkCommandBuffer commandBuffer, VkDescriptorSet descriptorSet, VkImage displayImage, uint32_t width, uint32_t height, const ImageDisplaySpecification& specification)
+	{
+		// The previous contents may still be sampled by earlier frames on the queue
+		VkImageMemoryBarrier write_barrier = {};
+		write_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		write_barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		write_barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		write_barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+		write_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		write_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		write_barrier.image = displayImage;
+		write_barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		write_barrier.subresourceRange.levelCount = 1;
+		write_barrier.subresourceRange.layerCount = 1;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL, 0, NULL, 1, &write_barrier);
+
+		TonemapPushConstants pushConstants;
+		pushConstants.Exposure = std::exp2(specification.Exposure);
+		pushConstants.Reinhard = specification.Operator == TonemapOperator::Reinhard ? 1.0f : 0.0f;
+		pushConstants.ACES = specification.Operator == TonemapOperator::ACES ? 1.0f : 0.0f;
+		pushConstants.SRGB = specification.SRGB ? 1.0f : 0.0f;
+		pushConstants.Width = width;
+		pushConstants.Height = height;
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, s_TonemapPipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, s_TonemapPipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+		vkCmdPushConstants(commandBuffer, s_TonemapPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+		vkCmdDispatch(commandBuffer, (width + c_TonemapGroupSize - 1) / c_TonemapGroupSize, (height + c_TonemapGroupSize - 1) / c_TonemapGroupSize, 1);
+
+		VkImageMemoryBarrier use_barrier = {};
+		use_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		use_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		use_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		use_barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+		use_barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		use_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		use_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		use_barrier.image = displayImage;
+		use_barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		use_barrier.subresourceRange.levelCount = 1;
+		use_barrier.subresourceRange.layerCount = 1;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, NULL, 0, NULL, 1, &use_barrier);
+	}
+
+	void TonemapPass::Shutdown()
+	{
+		std::scoped_lock<std::mutex> lock(s_TonemapPassMutex);
+
+		VkDevice device = Application::GetDevice();
+		vkDestroyPipeline(device, s_TonemapPipeline, Application::GetAllocator());
+		vkDestroyPipelineLayout(device, s_TonemapPipelineLayout, Application::GetAllocator());
+		vkDestroyDescriptorSetLayout(device, s_TonemapDescriptorSetLayout, Application::GetAllocator());
+
+		s_TonemapPipeline = VK_NULL_HANDLE;
+		s_TonemapPipelineLayout = VK_NULL_HANDLE;
+		s_TonemapDescriptorSetLayout = VK_NULL_HANDLE;
+	}
+
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "vulkan/vulkan.h"
+
+namespace Walnut {
+
+	enum class TonemapOperator : uint8_t
+	{
+		Linear = 0,
+		Reinhard,
+		ACES
+	};
+
+	// How an RGBA32F Image is shown through its descriptor set
+	struct ImageDisplaySpecification
+	{
+		// Off samples the raw linear values. On, a compute pass writes an 8-bit display image
+		// with the settings below applied, after every SetData and whenever they change.
+		bool Tonemap = false;
+
+		float Exposure = 0.0f; // In stops
+		TonemapOperator Operator = TonemapOperator::ACES;
+		bool SRGB = true;      // Encode for an UNORM swapchain, as used by Walnut
+	};
+
+	// Compute pipeline shared by every tonemapped Image
+	class TonemapPass
+	{
+	public:
+		// Binding 0 is the float source (shader read only), binding 1 the RGBA8 display image (general).
+		// Allocated from Application::GetDescriptorPool()
+		static VkDescriptorSet AllocateDescriptorSet(VkSampler sampler, VkImageView sourceView, VkImageView displayView);
+
+		// The display image ends up in SHADER_READ_ONLY_OPTIMAL, its previous contents are discarded
+		static void Record(VkCommandBuffer commandBuffer, VkDescriptorSet descriptorSet, VkImage displayImage, uint32_t width, uint32_t height, const ImageDisplaySpecification& specification);
+
+		// Called by Application once the device is idle
+		static void Shutdown();
+	};
+
+}
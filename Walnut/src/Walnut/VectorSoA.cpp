@@ -0,0 +1,382 @@
+#include "VectorSoA.h"
+
+#include "PixelConversion.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+	#define WL_VECTOR_SOA_X86
+	#include <immintrin.h>
+#endif
+
+namespace Walnut {
+
+	namespace Utils {
+
+		enum class SoABinaryOp : uint8_t
+		{
+			Add = 0,
+			Subtract,
+			Multiply,
+			Min,
+			Max
+		};
+
+		namespace SoAScalar {
+
+			struct Float
+			{
+				static constexpr size_t Width = 1;
+
+				float V;
+
+				static Float Load(const float* source) { return { *source }; }
+				static Float Broadcast(float value) { return { value }; }
+				void Store(float* destination) const { *destination = V; }
+
+				Float operator+(Float other) const { return { V + other.V }; }
+				Float operator-(Float other) const { return { V - other.V }; }
+				Float operator*(Float other) const { return { V * other.V }; }
+				Float operator/(Float other) const { return { V / other.V }; }
+			};
+
+			// Same operand order as minps/maxps, which return the second operand for NaNs
+			static Float Min(Float a, Float b) { return { a.V < b.V ? a.V : b.V }; }
+			static Float Max(Float a, Float b) { return { a.V > b.V ? a.V : b.V }; }
+			static Float Sqrt(Float a) { return { std::sqrt(a.V) }; }
+			static Float SelectIfPositive(Float condition, Float value) { return { condition.V > 0.0f ? value.V : 0.0f }; }
+
+			#include "VectorSoAKernels.inl"
+
+		}
+
+	}
+
+#ifdef WL_VECTOR_SOA_X86
+
+	// Everything defined in these regions is compiled for the level, including the kernels instantiated later.
+	// MSVC needs no target to use the intrinsics
+#if defined(__clang__)
+	#pragma clang attribute push(__attribute__((target("sse4.1"))), apply_to = function)
+#elif defined(__GNUC__)
+	#pragma GCC push_options
+	#pragma GCC target("sse4.1")
+#endif
+
+	namespace Utils {
+
+		namespace SoASSE41 {
+
+			struct Float
+			{
+				static constexpr size_t Width = 4;
+
+				__m128 V;
+
+				static Float Load(const float* source) { return { _mm_loadu_ps(source) }; }
+				static Float Broadcast(float value) { return { _mm_set1_ps(value) }; }
+				void Store(float* destination) const { _mm_storeu_ps(destination, V); }
+
+				Float operator+(Float other) const { return { _mm_add_ps(V, other.V) }; }
+				Float operator-(Float other) const { return { _mm_sub_ps(V, other.V) }; }
+				Float operator*(Float other) const { return { _mm_mul_ps(V, other.V) }; }
+				Float operator/(Float other) const { return { _mm_div_ps(V, other.V) }; }
+			};
+
+			static Float Min(Float a, Float b) { return { _mm_min_ps(a.V, b.V) }; }
+			static Float Max(Float a, Float b) { return { _mm_max_ps(a.V, b.V) }; }
+			static Float Sqrt(Float a) { return { _mm_sqrt_ps(a.V) }; }
+			static Float SelectIfPositive(Float condition, Float value) { return { _mm_and_ps(_mm_cmpgt_ps(condition.V, _mm_setzero_ps()), value.V) }; }
+
+			#include "VectorSoAKernels.inl"
+
+		}
+
+	}
+
+#if defined(__clang__)
+	#pragma clang attribute pop
+	#pragma clang attribute push(__attribute__((target("avx2"))), apply_to = function)
+#elif defined(__GNUC__)
+	#pragma GCC pop_options
+	#pragma GCC push_options
+	#pragma GCC target("avx2")
+#endif
+
+	namespace Utils {
+
+		// No FMA instructions: AVX2 doesn't imply them, and their rounding would differ from the other levels
+		namespace SoAAVX2 {
+
+			struct Float
+			{
+				static constexpr size_t Width = 8;
+
+				__m256 V;
+
+				static Float Load(const float* source) { return { _mm256_loadu_ps(source) }; }
+				static Float Broadcast(float value) { return { _mm256_set1_ps(value) }; }
+				void Store(float* destination) const { _mm256_storeu_ps(destination, V); }
+
+				Float operator+(Float other) const { return { _mm256_add_ps(V, other.V) }; }
+				Float operator-(Float other) const { return { _mm256_sub_ps(V, other.V) }; }
+				Float operator*(Float other) const { return { _mm256_mul_ps(V, other.V) }; }
+				Float operator/(Float other) const { return { _mm256_div_ps(V, other.V) }; }
+			};
+
+			static Float Min(Float a, Float b) { return { _mm256_min_ps(a.V, b.V) }; }
+			static Float Max(Float a, Float b) { return { _mm256_max_ps(a.V, b.V) }; }
+			static Float Sqrt(Float a) { return { _mm256_sqrt_ps(a.V) }; }
+			static Float SelectIfPositive(Float condition, Float value) { return { _mm256_and_ps(_mm256_cmp_ps(condition.V, _mm256_setzero_ps(), _CMP_GT_OQ), value.V) }; }
+
+			#include "VectorSoAKernels.inl"
+
+		}
+
+	}
+
+#if defined(__clang__)
+	#pragma clang attribute pop
+#elif defined(__GNUC__)
+	#pragma GCC pop_options
+#endif
+
+#endif
+
+	namespace Utils {
+
+		// Runs kernel(kernels, begin, end) on the widest level for as many elements as it takes, then the scalar
+		// kernels for the remainder
+		template<typename Function>
+		static void RunSoAKernel(size_t count, Function&& kernel)
+		{
+			size_t done = 0;
+			switch (PixelConversion::GetSIMDLevel())
+			{
+#ifdef WL_VECTOR_SOA_X86
+				case SIMDLevel::AVX2:  done = kernel(SoAAVX2::Kernels(), (size_t)0, count); break;
+				case SIMDLevel::SSE41: done = kernel(SoASSE41::Kernels(), (size_t)0, count); break;
+#endif
+				default: break;
+			}
+			if (done < count)
+				kernel(SoAScalar::Kernels(), done, count);
+		}
+
+		static std::array<const float*, 3> SoAComponents(const Vec3SoA& v) { return { v.GetX(), v.GetY(), v.GetZ() }; }
+		static std::array<const float*, 4> SoAComponents(const Vec4SoA& v) { return { v.GetX(), v.GetY(), v.GetZ(), v.GetW() }; }
+		static std::array<float*, 3> SoAComponents(Vec3SoA& v) { return { v.GetX(), v.GetY(), v.GetZ() }; }
+		static std::array<float*, 4> SoAComponents(Vec4SoA& v) { return { v.GetX(), v.GetY(), v.GetZ(), v.GetW() }; }
+
+		// A result that is also an input only shrinks, which keeps its data in place
+		template<SoABinaryOp Op, typename SoA>
+		static void RunSoABinary(const SoA& a, const SoA& b, SoA& result)
+		{
+			size_t count = std::min(a.GetSize(), b.GetSize());
+			result.Resize(count);
+
+			auto pa = SoAComponents(a);
+			auto pb = SoAComponents(b);
+			auto pr = SoAComponents(result);
+			RunSoAKernel(count, [&](auto kernels, size_t begin, size_t end)
+			{
+				return kernels.template Binary<SoA::ComponentCount, Op>(pa.data(), pb.data(), pr.data(), begin, end);
+			});
+		}
+
+		template<typename SoA>
+		static void RunSoAScale(const SoA& a, float scale, SoA& result)
+		{
+			size_t count = a.GetSize();
+			result.Resize(count);
+
+			auto pa = SoAComponents(a);
+			auto pr = SoAComponents(result);
+			RunSoAKernel(count, [&](auto kernels, size_t begin, size_t end)
+			{
+				return kernels.template Scale<SoA::ComponentCount>(pa.data(), scale, pr.data(), begin, end);
+			});
+		}
+
+		template<typename SoA>
+		static void RunSoAFMA(const SoA& a, const SoA& b, const SoA& c, SoA& result)
+		{
+			size_t count = std::min({ a.GetSize(), b.GetSize(), c.GetSize() });
+			result.Resize(count);
+
+			auto pa = SoAComponents(a);
+			auto pb = SoAComponents(b);
+			auto pc = SoAComponents(c);
+			auto pr = SoAComponents(result);
+			RunSoAKernel(count, [&](auto kernels, size_t begin, size_t end)
+			{
+				return kernels.template FMA<SoA::ComponentCount>(pa.data(), pb.data(), pc.data(), pr.data(), begin, end);
+			});
+		}
+
+		template<typename SoA>
+		static void RunSoAFMA(const SoA& a, float b, const SoA& c, SoA& result)
+		{
+			size_t count = std::min(a.GetSize(), c.GetSize());
+			result.Resize(count);
+
+			auto pa = SoAComponents(a);
+			auto pc = SoAComponents(c);
+			auto pr = SoAComponents(result);
+			RunSoAKernel(count, [&](auto kernels, size_t begin, size_t end)
+			{
+				return kernels.template FMA<SoA::ComponentCount>(pa.data(), b, pc.data(), pr.data(), begin, end);
+			});
+		}
+
+		template<typename SoA>
+		static void RunSoADot(const SoA& a, const SoA& b, float* result)
+		{
+			size_t count = std::min(a.GetSize(), b.GetSize());
+
+			auto pa = SoAComponents(a);
+			auto pb = SoAComponents(b);
+			RunSoAKernel(count, [&](auto kernels, size_t begin, size_t end)
+			{
+				return kernels.template Dot<SoA::ComponentCount>(pa.data(), pb.data(), result, begin, end);
+			});
+		}
+
+		template<typename SoA>
+		static void RunSoALength(const SoA& a, float* result)
+		{
+			auto pa = SoAComponents(a);
+			RunSoAKernel(a.GetSize(), [&](auto kernels, size_t begin, size_t end)
+			{
+				return kernels.template Length<SoA::ComponentCount>(pa.data(), result, begin, end);
+			});
+		}
+
+		template<typename SoA>
+		static void RunSoANormalize(const SoA& a, SoA& result)
+		{
+			size_t count = a.GetSize();
+			result.Resize(count);
+
+			auto pa = SoAComponents(a);
+			auto pr = SoAComponents(result);
+			RunSoAKernel(count, [&](auto kernels, size_t begin, size_t end)
+			{
+				return kernels.template Normalize<SoA::ComponentCount>(pa.data(), pr.data(), begin, end);
+			});
+		}
+
+		template<uint32_t W, typename Input, typename Output>
+		static void RunSoATransform(const glm::mat4& transform, const Input& a, Output& result)
+		{
+			size_t count = a.GetSize();
+			result.Resize(count);
+
+			auto pa = SoAComponents(a);
+			auto pr = SoAComponents(result);
+			const float* matrix = &transform[0][0];
+			RunSoAKernel(count, [&](auto kernels, size_t begin, size_t end)
+			{
+				return kernels.template Transform<Input::ComponentCount, Output::ComponentCount, W>(matrix, pa.data(), pr.data(), begin, end);
+			});
+		}
+
+	}
+
+	void Vec3SoA::Load(const glm::vec3* source, size_t count)
+	{
+		Resize(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			m_X[i] = source[i].x;
+			m_Y[i] = source[i].y;
+			m_Z[i] = source[i].z;
+		}
+	}
+
+	void Vec3SoA::Store(glm::vec3* destination) const
+	{
+		for (size_t i = 0; i < m_X.size(); i++)
+			destination[i] = { m_X[i], m_Y[i], m_Z[i] };
+	}
+
+	std::vector<glm::vec3> Vec3SoA::ToVector() const
+	{
+		std::vector<glm::vec3> result(GetSize());
+		Store(result.data());
+		return result;
+	}
+
+	void Vec4SoA::Load(const glm::vec4* source, size_t count)
+	{
+		Resize(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			m_X[i] = source[i].x;
+			m_Y[i] = source[i].y;
+			m_Z[i] = source[i].z;
+			m_W[i] = source[i].w;
+		}
+	}
+
+	void Vec4SoA::Store(glm::vec4* destination) const
+	{
+		for (size_t i = 0; i < m_X.size(); i++)
+			destination[i] = { m_X[i], m_Y[i], m_Z[i], m_W[i] };
+	}
+
+	std::vector<glm::vec4> Vec4SoA::ToVector() const
+	{
+		std::vector<glm::vec4> result(GetSize());
+		Store(result.data());
+		return result;
+	}
+
+	void VectorSoA::Add(const Vec3SoA& a, const Vec3SoA& b, Vec3SoA& result) { Utils::RunSoABinary<Utils::SoABinaryOp::Add>(a, b, result); }
+	void VectorSoA::Add(const Vec4SoA& a, const Vec4SoA& b, Vec4SoA& result) { Utils::RunSoABinary<Utils::SoABinaryOp::Add>(a, b, result); }
+	void VectorSoA::Subtract(const Vec3SoA& a, const Vec3SoA& b, Vec3SoA& result) { Utils::RunSoABinary<Utils::SoABinaryOp::Subtract>(a, b, result); }
+	void VectorSoA::Subtract(const Vec4SoA& a, const Vec4SoA& b, Vec4SoA& result) { Utils::RunSoABinary<Utils::SoABinaryOp::Subtract>(a, b, result); }
+	void VectorSoA::Multiply(const Vec3SoA& a, const Vec3SoA& b, Vec3SoA& result) { Utils::RunSoABinary<Utils::SoABinaryOp::Multiply>(a, b, result); }
+	void VectorSoA::Multiply(const Vec4SoA& a, const Vec4SoA& b, Vec4SoA& result) { Utils::RunSoABinary<Utils::SoABinaryOp::Multiply>(a, b, result); }
+	void VectorSoA::Scale(const Vec3SoA& a, float scale, Vec3SoA& result) { Utils::RunSoAScale(a, scale, result); }
+	void VectorSoA::Scale(const Vec4SoA& a, float scale, Vec4SoA& result) { Utils::RunSoAScale(a, scale, result); }
+
+	void VectorSoA::FMA(const Vec3SoA& a, const Vec3SoA& b, const Vec3SoA& c, Vec3SoA& result) { Utils::RunSoAFMA(a, b, c, result); }
+	void VectorSoA::FMA(const Vec4SoA& a, const Vec4SoA& b, const Vec4SoA& c, Vec4SoA& result) { Utils::RunSoAFMA(a, b, c, result); }
+	void VectorSoA::FMA(const Vec3SoA& a, float b, const Vec3SoA& c, Vec3SoA& result) { Utils::RunSoAFMA(a, b, c, result); }
+	void VectorSoA::FMA(const Vec4SoA& a, float b, const Vec4SoA& c, Vec4SoA& result) { Utils::RunSoAFMA(a, b, c, result); }
+
+	void VectorSoA::Min(const Vec3SoA& a, const Vec3SoA& b, Vec3SoA& result) { Utils::RunSoABinary<Utils::SoABinaryOp::Min>(a, b, result); }
+	void VectorSoA::Min(const Vec4SoA& a, const Vec4SoA& b, Vec4SoA& result) { Utils::RunSoABinary<Utils::SoABinaryOp::Min>(a, b, result); }
+	void VectorSoA::Max(const Vec3SoA& a, const Vec3SoA& b, Vec3SoA& result) { Utils::RunSoABinary<Utils::SoABinaryOp::Max>(a, b, result); }
+	void VectorSoA::Max(const Vec4SoA& a, const Vec4SoA& b, Vec4SoA& result) { Utils::RunSoABinary<Utils::SoABinaryOp::Max>(a, b, result); }
+
+	void VectorSoA::Dot(const Vec3SoA& a, const Vec3SoA& b, float* result) { Utils::RunSoADot(a, b, result); }
+	void VectorSoA::Dot(const Vec4SoA& a, const Vec4SoA& b, float* result) { Utils::RunSoADot(a, b, result); }
+	void VectorSoA::Length(const Vec3SoA& a, float* result) { Utils::RunSoALength(a, result); }
+	void VectorSoA::Length(const Vec4SoA& a, float* result) { Utils::RunSoALength(a, result); }
+
+	void VectorSoA::Normalize(const Vec3SoA& a, Vec3SoA& result) { Utils::RunSoANormalize(a, result); }
+	void VectorSoA::Normalize(const Vec4SoA& a, Vec4SoA& result) { Utils::RunSoANormalize(a, result); }
+
+	void VectorSoA::Cross(const Vec3SoA& a, const Vec3SoA& b, Vec3SoA& result)
+	{
+		size_t count = std::min(a.GetSize(), b.GetSize());
+		result.Resize(count);
+
+		auto pa = Utils::SoAComponents(a);
+		auto pb = Utils::SoAComponents(b);
+		auto pr = Utils::SoAComponents(result);
+		Utils::RunSoAKernel(count, [&](auto kernels, size_t begin, size_t end)
+		{
+			return kernels.Cross(pa.data(), pb.data(), pr.data(), begin, end);
+		});
+	}
+
+	void VectorSoA::TransformPoint(const glm::mat4& transform, const Vec3SoA& a, Vec3SoA& result) { Utils::RunSoATransform<1>(transform, a, result); }
+	void VectorSoA::TransformDirection(const glm::mat4& transform, const Vec3SoA& a, Vec3SoA& result) { Utils::RunSoATransform<0>(transform, a, result); }
+	void VectorSoA::Transform(const glm::mat4& transform, const Vec4SoA& a, Vec4SoA& result) { Utils::RunSoATransform<0>(transform, a, result); }
+
+}
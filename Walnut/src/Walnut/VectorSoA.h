@@ -0,0 +1,153 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <new>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace Walnut {
+
+	// Storage aligned to a cache line, which covers every SIMD width
+	template<typename T>
+	struct SIMDAllocator
+	{
+		static constexpr size_t Alignment = 64;
+
+		using value_type = T;
+
+		SIMDAllocator() = default;
+
+		template<typename U>
+		SIMDAllocator(const SIMDAllocator<U>&) {}
+
+		T* allocate(size_t count) { return (T*)::operator new(sizeof(T) * count, std::align_val_t(Alignment)); }
+		void deallocate(T* pointer, size_t) { ::operator delete(pointer, std::align_val_t(Alignment)); }
+
+		template<typename U>
+		bool operator==(const SIMDAllocator<U>&) const { return true; }
+		template<typename U>
+		bool operator!=(const SIMDAllocator<U>&) const { return false; }
+	};
+
+	using SIMDFloatArray = std::vector<float, SIMDAllocator<float>>;
+
+	// Vectors stored one array per component (structure of arrays), so VectorSoA processes 4 or 8 of them per
+	// instruction. Convert from and to glm::vec3 arrays with the constructor and Store
+	class Vec3SoA
+	{
+	public:
+		static constexpr uint32_t ComponentCount = 3;
+
+		Vec3SoA() = default;
+		explicit Vec3SoA(size_t size) { Resize(size); }
+		Vec3SoA(const glm::vec3* source, size_t count) { Load(source, count); }
+		Vec3SoA(const std::vector<glm::vec3>& source) { Load(source.data(), source.size()); }
+
+		size_t GetSize() const { return m_X.size(); }
+		void Resize(size_t size) { m_X.resize(size); m_Y.resize(size); m_Z.resize(size); }
+		void Reserve(size_t capacity) { m_X.reserve(capacity); m_Y.reserve(capacity); m_Z.reserve(capacity); }
+		void Clear() { Resize(0); }
+
+		float* GetX() { return m_X.data(); }
+		float* GetY() { return m_Y.data(); }
+		float* GetZ() { return m_Z.data(); }
+		const float* GetX() const { return m_X.data(); }
+		const float* GetY() const { return m_Y.data(); }
+		const float* GetZ() const { return m_Z.data(); }
+
+		glm::vec3 Get(size_t index) const { return { m_X[index], m_Y[index], m_Z[index] }; }
+		void Set(size_t index, const glm::vec3& value) { m_X[index] = value.x; m_Y[index] = value.y; m_Z[index] = value.z; }
+		void PushBack(const glm::vec3& value) { m_X.push_back(value.x); m_Y.push_back(value.y); m_Z.push_back(value.z); }
+
+		// Replaces the contents with count vectors
+		void Load(const glm::vec3* source, size_t count);
+		// GetSize() vectors
+		void Store(glm::vec3* destination) const;
+		std::vector<glm::vec3> ToVector() const;
+	private:
+		SIMDFloatArray m_X, m_Y, m_Z;
+	};
+
+	class Vec4SoA
+	{
+	public:
+		static constexpr uint32_t ComponentCount = 4;
+
+		Vec4SoA() = default;
+		explicit Vec4SoA(size_t size) { Resize(size); }
+		Vec4SoA(const glm::vec4* source, size_t count) { Load(source, count); }
+		Vec4SoA(const std::vector<glm::vec4>& source) { Load(source.data(), source.size()); }
+
+		size_t GetSize() const { return m_X.size(); }
+		void Resize(size_t size) { m_X.resize(size); m_Y.resize(size); m_Z.resize(size); m_W.resize(size); }
+		void Reserve(size_t capacity) { m_X.reserve(capacity); m_Y.reserve(capacity); m_Z.reserve(capacity); m_W.reserve(capacity); }
+		void Clear() { Resize(0); }
+
+		float* GetX() { return m_X.data(); }
+		float* GetY() { return m_Y.data(); }
+		float* GetZ() { return m_Z.data(); }
+		float* GetW() { return m_W.data(); }
+		const float* GetX() const { return m_X.data(); }
+		const float* GetY() const { return m_Y.data(); }
+		const float* GetZ() const { return m_Z.data(); }
+		const float* GetW() const { return m_W.data(); }
+
+		glm::vec4 Get(size_t index) const { return { m_X[index], m_Y[index], m_Z[index], m_W[index] }; }
+		void Set(size_t index, const glm::vec4& value) { m_X[index] = value.x; m_Y[index] = value.y; m_Z[index] = value.z; m_W[index] = value.w; }
+		void PushBack(const glm::vec4& value) { m_X.push_back(value.x); m_Y.push_back(value.y); m_Z.push_back(value.z); m_W.push_back(value.w); }
+
+		void Load(const glm::vec4* source, size_t count);
+		void Store(glm::vec4* destination) const;
+		std::vector<glm::vec4> ToVector() const;
+	private:
+		SIMDFloatArray m_X, m_Y, m_Z, m_W;
+	};
+
+	// Element-wise math on Vec3SoA/Vec4SoA. Kernels are written once against a width-agnostic SIMD wrapper and
+	// picked at runtime like PixelConversion's (PixelConversion::SetSIMDLevel caps them too); every level produces
+	// the same output. Operations run over the shortest input and resize the result to it, which may be one of the
+	// inputs. Float results (Dot, Length) need room for that many floats.
+	class VectorSoA
+	{
+	public:
+		static void Add(const Vec3SoA& a, const Vec3SoA& b, Vec3SoA& result);
+		static void Add(const Vec4SoA& a, const Vec4SoA& b, Vec4SoA& result);
+		static void Subtract(const Vec3SoA& a, const Vec3SoA& b, Vec3SoA& result);
+		static void Subtract(const Vec4SoA& a, const Vec4SoA& b, Vec4SoA& result);
+		static void Multiply(const Vec3SoA& a, const Vec3SoA& b, Vec3SoA& result);
+		static void Multiply(const Vec4SoA& a, const Vec4SoA& b, Vec4SoA& result);
+		static void Scale(const Vec3SoA& a, float scale, Vec3SoA& result);
+		static void Scale(const Vec4SoA& a, float scale, Vec4SoA& result);
+
+		// a * b + c, rounded after the multiply as well, eg. FMA(velocities, timeStep, positions, positions)
+		static void FMA(const Vec3SoA& a, const Vec3SoA& b, const Vec3SoA& c, Vec3SoA& result);
+		static void FMA(const Vec4SoA& a, const Vec4SoA& b, const Vec4SoA& c, Vec4SoA& result);
+		static void FMA(const Vec3SoA& a, float b, const Vec3SoA& c, Vec3SoA& result);
+		static void FMA(const Vec4SoA& a, float b, const Vec4SoA& c, Vec4SoA& result);
+
+		static void Min(const Vec3SoA& a, const Vec3SoA& b, Vec3SoA& result);
+		static void Min(const Vec4SoA& a, const Vec4SoA& b, Vec4SoA& result);
+		static void Max(const Vec3SoA& a, const Vec3SoA& b, Vec3SoA& result);
+		static void Max(const Vec4SoA& a, const Vec4SoA& b, Vec4SoA& result);
+
+		static void Dot(const Vec3SoA& a, const Vec3SoA& b, float* result);
+		static void Dot(const Vec4SoA& a, const Vec4SoA& b, float* result);
+		static void Length(const Vec3SoA& a, float* result);
+		static void Length(const Vec4SoA& a, float* result);
+
+		// Zero vectors stay zero instead of turning into NaNs like glm::normalize
+		static void Normalize(const Vec3SoA& a, Vec3SoA& result);
+		static void Normalize(const Vec4SoA& a, Vec4SoA& result);
+
+		static void Cross(const Vec3SoA& a, const Vec3SoA& b, Vec3SoA& result);
+
+		// transform * vec4(a, 1), without the perspective divide
+		static void TransformPoint(const glm::mat4& transform, const Vec3SoA& a, Vec3SoA& result);
+		// transform * vec4(a, 0)
+		static void TransformDirection(const glm::mat4& transform, const Vec3SoA& a, Vec3SoA& result);
+		static void Transform(const glm::mat4& transform, const Vec4SoA& a, Vec4SoA& result);
+	};
+
+}
@@ -0,0 +1,165 @@
+// VectorSoA's kernels, written once against the SIMD wrapper `Float` of the namespace this is included in.
+// VectorSoA.cpp includes it once per SIMD level, inside that level's target region, so there is no include guard.
+//
+// Every kernel processes whole vectors of Float::Width elements from begin and returns where it stopped,
+// the scalar level finishes the rest. Inputs are read before the result is written, so they may alias.
+
+struct Kernels
+{
+	template<SoABinaryOp Op>
+	static Float Apply(Float a, Float b)
+	{
+		if constexpr (Op == SoABinaryOp::Add)
+			return a + b;
+		else if constexpr (Op == SoABinaryOp::Subtract)
+			return a - b;
+		else if constexpr (Op == SoABinaryOp::Multiply)
+			return a * b;
+		else if constexpr (Op == SoABinaryOp::Min)
+			return Min(a, b);
+		else
+			return Max(a, b);
+	}
+
+	template<uint32_t N, SoABinaryOp Op>
+	static size_t Binary(const float* const* a, const float* const* b, float* const* result, size_t begin, size_t end)
+	{
+		size_t i = begin;
+		for (; i + Float::Width <= end; i += Float::Width)
+		{
+			for (uint32_t c = 0; c < N; c++)
+				Apply<Op>(Float::Load(a[c] + i), Float::Load(b[c] + i)).Store(result[c] + i);
+		}
+		return i;
+	}
+
+	template<uint32_t N>
+	static size_t Scale(const float* const* a, float scale, float* const* result, size_t begin, size_t end)
+	{
+		Float s = Float::Broadcast(scale);
+
+		size_t i = begin;
+		for (; i + Float::Width <= end; i += Float::Width)
+		{
+			for (uint32_t c = 0; c < N; c++)
+				(Float::Load(a[c] + i) * s).Store(result[c] + i);
+		}
+		return i;
+	}
+
+	template<uint32_t N>
+	static size_t FMA(const float* const* a, const float* const* b, const float* const* c, float* const* result, size_t begin, size_t end)
+	{
+		size_t i = begin;
+		for (; i + Float::Width <= end; i += Float::Width)
+		{
+			for (uint32_t k = 0; k < N; k++)
+				(Float::Load(a[k] + i) * Float::Load(b[k] + i) + Float::Load(c[k] + i)).Store(result[k] + i);
+		}
+		return i;
+	}
+
+	template<uint32_t N>
+	static size_t FMA(const float* const* a, float b, const float* const* c, float* const* result, size_t begin, size_t end)
+	{
+		Float s = Float::Broadcast(b);
+
+		size_t i = begin;
+		for (; i + Float::Width <= end; i += Float::Width)
+		{
+			for (uint32_t k = 0; k < N; k++)
+				(Float::Load(a[k] + i) * s + Float::Load(c[k] + i)).Store(result[k] + i);
+		}
+		return i;
+	}
+
+	template<uint32_t N>
+	static Float Dot(const float* const* a, const float* const* b, size_t i)
+	{
+		Float sum = Float::Load(a[0] + i) * Float::Load(b[0] + i);
+		for (uint32_t c = 1; c < N; c++)
+			sum = sum + Float::Load(a[c] + i) * Float::Load(b[c] + i);
+		return sum;
+	}
+
+	template<uint32_t N>
+	static size_t Dot(const float* const* a, const float* const* b, float* result, size_t begin, size_t end)
+	{
+		size_t i = begin;
+		for (; i + Float::Width <= end; i += Float::Width)
+			Dot<N>(a, b, i).Store(result + i);
+		return i;
+	}
+
+	template<uint32_t N>
+	static size_t Length(const float* const* a, float* result, size_t begin, size_t end)
+	{
+		size_t i = begin;
+		for (; i + Float::Width <= end; i += Float::Width)
+			Sqrt(Dot<N>(a, a, i)).Store(result + i);
+		return i;
+	}
+
+	template<uint32_t N>
+	static size_t Normalize(const float* const* a, float* const* result, size_t begin, size_t end)
+	{
+		Float one = Float::Broadcast(1.0f);
+
+		size_t i = begin;
+		for (; i + Float::Width <= end; i += Float::Width)
+		{
+			Float length = Sqrt(Dot<N>(a, a, i));
+			Float inverseLength = SelectIfPositive(length, one / length);
+
+			Float components[N];
+			for (uint32_t c = 0; c < N; c++)
+				components[c] = Float::Load(a[c] + i) * inverseLength;
+			for (uint32_t c = 0; c < N; c++)
+				components[c].Store(result[c] + i);
+		}
+		return i;
+	}
+
+	static size_t Cross(const float* const* a, const float* const* b, float* const* result, size_t begin, size_t end)
+	{
+		size_t i = begin;
+		for (; i + Float::Width <= end; i += Float::Width)
+		{
+			Float ax = Float::Load(a[0] + i), ay = Float::Load(a[1] + i), az = Float::Load(a[2] + i);
+			Float bx = Float::Load(b[0] + i), by = Float::Load(b[1] + i), bz = Float::Load(b[2] + i);
+			(ay * bz - az * by).Store(result[0] + i);
+			(az * bx - ax * bz).Store(result[1] + i);
+			(ax * by - ay * bx).Store(result[2] + i);
+		}
+		return i;
+	}
+
+	// Column-major like glm: matrix[column * 4 + row]. InputN 3 uses w = W, 4 reads w from the input
+	template<uint32_t InputN, uint32_t OutputN, uint32_t W>
+	static size_t Transform(const float* matrix, const float* const* a, float* const* result, size_t begin, size_t end)
+	{
+		Float m[16];
+		for (uint32_t k = 0; k < 16; k++)
+			m[k] = Float::Broadcast(matrix[k]);
+
+		size_t i = begin;
+		for (; i + Float::Width <= end; i += Float::Width)
+		{
+			Float x = Float::Load(a[0] + i), y = Float::Load(a[1] + i), z = Float::Load(a[2] + i);
+
+			Float components[OutputN];
+			for (uint32_t row = 0; row < OutputN; row++)
+			{
+				Float sum = m[row] * x + m[4 + row] * y + m[8 + row] * z;
+				if constexpr (InputN == 4)
+					sum = sum + m[12 + row] * Float::Load(a[3] + i);
+				else if constexpr (W == 1)
+					sum = sum + m[12 + row];
+				components[row] = sum;
+			}
+			for (uint32_t row = 0; row < OutputN; row++)
+				components[row].Store(result[row] + i);
+		}
+		return i;
+	}
+};
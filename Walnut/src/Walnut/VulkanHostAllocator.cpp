@@ -0,0 +1,184 @@
+#include "VulkanHostAllocator.h"
+
+#include "PoolAllocator.h"
+
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+
+namespace Walnut {
+
+	// Right before every pointer handed to Vulkan
+	struct HostAllocationHeader
+	{
+		uint64_t Size;
+		uint32_t Offset; // From the start of the PoolAllocator block
+		uint8_t Scope;
+		uint8_t Reserved[3];
+	};
+
+	static_assert(sizeof(HostAllocationHeader) == 16);
+
+	struct HostScopeCounters
+	{
+		std::atomic<uint64_t> AllocationCount;
+		std::atomic<uint64_t> ReallocationCount;
+		std::atomic<uint64_t> FreeCount;
+		std::atomic<uint64_t> AllocatedBytes;
+		std::atomic<uint64_t> CurrentBytes;
+		std::atomic<uint64_t> PeakBytes;
+		std::atomic<uint64_t> InternalBytes;
+	};
+
+	static bool s_HostAllocatorEnabled = false;
+	static VkAllocationCallbacks s_HostAllocationCallbacks = {};
+	static HostScopeCounters s_HostScopeCounters[VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE + 1];
+
+	namespace Utils {
+
+		static void AddHostBytes(HostScopeCounters& counters, uint64_t bytes)
+		{
+			counters.AllocatedBytes += bytes;
+			uint64_t current = counters.CurrentBytes += bytes;
+			uint64_t peak = counters.PeakBytes.load(std::memory_order_relaxed);
+			while (current > peak && !counters.PeakBytes.compare_exchange_weak(peak, current, std::memory_order_relaxed));
+		}
+
+	}
+
+	static void VKAPI_PTR HostFree(void* userData, void* memory)
+	{
+		if (!memory)
+			return;
+
+		HostAllocationHeader* header = (HostAllocationHeader*)memory - 1;
+		HostScopeCounters& counters = s_HostScopeCounters[header->Scope];
+		counters.FreeCount++;
+		counters.CurrentBytes -= header->Size;
+
+		PoolAllocator::Free((uint8_t*)memory - header->Offset);
+	}
+
+	static void* VKAPI_PTR HostAllocation(void* userData, size_t size, size_t alignment, VkSystemAllocationScope scope)
+	{
+		if (size == 0)
+			return nullptr;
+
+		// PoolAllocator blocks are 16 byte aligned, so the header and alignment padding together never need more than this
+		alignment = std::max(alignment, sizeof(HostAllocationHeader));
+		uint8_t* block = (uint8_t*)PoolAllocator::Allocate(size + alignment);
+		if (!block)
+			return nullptr;
+
+		uintptr_t memory = ((uintptr_t)block + sizeof(HostAllocationHeader) + alignment - 1) & ~(uintptr_t)(alignment - 1);
+		HostAllocationHeader* header = (HostAllocationHeader*)memory - 1;
+		header->Size = size;
+		header->Offset = (uint32_t)(memory - (uintptr_t)block);
+		header->Scope = (uint8_t)scope;
+
+		HostScopeCounters& counters = s_HostScopeCounters[scope];
+		counters.AllocationCount++;
+		Utils::AddHostBytes(counters, size);
+		return (void*)memory;
+	}
+
+	static void* VKAPI_PTR HostReallocation(void* userData, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope)
+	{
+		if (!original)
+			return HostAllocation(userData, size, alignment, scope);
+
+		if (size == 0)
+		{
+			HostFree(userData, original);
+			return nullptr;
+		}
+
+		// Resized in place while the block has room
+		HostAllocationHeader* header = (HostAllocationHeader*)original - 1;
+		HostScopeCounters& counters = s_HostScopeCounters[header->Scope];
+		if (header->Offset + size <= PoolAllocator::GetUsableSize((uint8_t*)original - header->Offset))
+		{
+			counters.ReallocationCount++;
+			if (size > header->Size)
+				Utils::AddHostBytes(counters, size - header->Size);
+			else
+				counters.CurrentBytes -= header->Size - size;
+			header->Size = size;
+			return original;
+		}
+
+		// On failure the original stays valid, as Vulkan requires
+		void* memory = HostAllocation(userData, size, alignment, scope);
+		if (!memory)
+			return nullptr;
+
+		memcpy(memory, original, std::min<size_t>(size, header->Size));
+		HostFree(userData, original);
+		s_HostScopeCounters[scope].ReallocationCount++;
+		return memory;
+	}
+
+	static void VKAPI_PTR HostInternalAllocation(void* userData, size_t size, VkInternalAllocationType allocationType, VkSystemAllocationScope scope)
+	{
+		s_HostScopeCounters[scope].InternalBytes += size;
+	}
+
+	static void VKAPI_PTR HostInternalFree(void* userData, size_t size, VkInternalAllocationType allocationType, VkSystemAllocationScope scope)
+	{
+		s_HostScopeCounters[scope].InternalBytes -= size;
+	}
+
+	void VulkanHostAllocator::Enable()
+	{
+		s_HostAllocationCallbacks.pfnAllocation = HostAllocation;
+		s_HostAllocationCallbacks.pfnReallocation = HostReallocation;
+		s_HostAllocationCallbacks.pfnFree = HostFree;
+		s_HostAllocationCallbacks.pfnInternalAllocation = HostInternalAllocation;
+		s_HostAllocationCallbacks.pfnInternalFree = HostInternalFree;
+		s_HostAllocatorEnabled = true;
+	}
+
+	bool VulkanHostAllocator::IsEnabled()
+	{
+		return s_HostAllocatorEnabled;
+	}
+
+	const VkAllocationCallbacks* VulkanHostAllocator::GetCallbacks()
+	{
+		return s_HostAllocatorEnabled ? &s_HostAllocationCallbacks : nullptr;
+	}
+
+	VulkanHostAllocationStatistics VulkanHostAllocator::GetStatistics()
+	{
+		VulkanHostAllocationStatistics statistics;
+		statistics.Enabled = s_HostAllocatorEnabled;
+		for (uint32_t i = 0; i <= VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE; i++)
+		{
+			const HostScopeCounters& counters = s_HostScopeCounters[i];
+			VulkanHostScopeStatistics& scope = statistics.Scopes[i];
+			scope.AllocationCount = counters.AllocationCount;
+			scope.ReallocationCount = counters.ReallocationCount;
+			scope.FreeCount = counters.FreeCount;
+			scope.AllocatedBytes = counters.AllocatedBytes;
+			scope.CurrentBytes = counters.CurrentBytes;
+			scope.PeakBytes = counters.PeakBytes;
+			scope.InternalBytes = counters.InternalBytes;
+		}
+		return statistics;
+	}
+
+	const char* VulkanHostAllocator::GetScopeName(VkSystemAllocationScope scope)
+	{
+		switch (scope)
+		{
+			case VK_SYSTEM_ALLOCATION_SCOPE_COMMAND:  return "Command";
+			case VK_SYSTEM_ALLOCATION_SCOPE_OBJECT:   return "Object";
+			case VK_SYSTEM_ALLOCATION_SCOPE_CACHE:    return "Cache";
+			case VK_SYSTEM_ALLOCATION_SCOPE_DEVICE:   return "Device";
+			case VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE: return "Instance";
+			default: break;
+		}
+		return "Unknown";
+	}
+
+}
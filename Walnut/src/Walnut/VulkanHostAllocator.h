@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "vulkan/vulkan.h"
+
+namespace Walnut {
+
+	struct VulkanHostScopeStatistics
+	{
+		// Reallocations that move the block also count as an allocation and a free
+		uint64_t AllocationCount = 0;
+		uint64_t ReallocationCount = 0;
+		uint64_t FreeCount = 0;
+
+		uint64_t AllocatedBytes = 0; // Total requested since startup
+		uint64_t CurrentBytes = 0;
+		uint64_t PeakBytes = 0;
+
+		// Allocated by the driver itself and only reported through pfnInternalAllocation
+		uint64_t InternalBytes = 0;
+	};
+
+	struct VulkanHostAllocationStatistics
+	{
+		bool Enabled = false;
+
+		// Indexed by VkSystemAllocationScope
+		VulkanHostScopeStatistics Scopes[VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE + 1];
+	};
+
+	// VkAllocationCallbacks used for every Vulkan object Walnut creates (see Application::GetAllocator).
+	// Blocks come from PoolAllocator, whose size-class free lists keep their memory once allocated,
+	// so bursts of object creation stop going to the system heap, and every call is counted per scope.
+	class VulkanHostAllocator
+	{
+	public:
+		// Only before the Vulkan instance is created: objects have to be destroyed with the callbacks that created them
+		static void Enable();
+		static bool IsEnabled();
+
+		// nullptr (the driver's allocator) unless enabled
+		static const VkAllocationCallbacks* GetCallbacks();
+
+		static VulkanHostAllocationStatistics GetStatistics();
+		static const char* GetScopeName(VkSystemAllocationScope scope);
+	};
+
+}
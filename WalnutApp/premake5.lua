@@ -30,6 +30,12 @@ project "WalnutApp"
       systemversion "latest"
       defines { "WL_PLATFORM_WINDOWS" }
 
+   -- Static libraries do not carry their own dependencies on Linux
+   filter "system:linux"
+      defines { "WL_PLATFORM_LINUX" }
+      libdirs { "%{LibraryDir.VulkanSDK}" }
+      links { "ImGui", "GLFW", "%{Library.Vulkan}", "X11", "dl", "pthread" }
+
    filter "configurations:Debug"
       defines { "WL_DEBUG" }
       runtime "Debug"
@@ -46,4 +52,6 @@ project "WalnutApp"
       defines { "WL_DIST" }
       runtime "Release"
       optimize "On"
-      symbols "Off"
\ No newline at end of file
+      symbols "Off"
+
+   WalnutProfileConfiguration()
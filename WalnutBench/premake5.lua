@@ -0,0 +1,57 @@
+project "WalnutBench"
+   kind "ConsoleApp"
+   language "C++"
+   cppdialect "C++17"
+   targetdir "bin/%{cfg.buildcfg}"
+   staticruntime "off"
+
+   files { "src/**.h", "src/**.cpp" }
+
+   includedirs
+   {
+      "../vendor/imgui",
+      "../vendor/glfw/include",
+
+      "../Walnut/src",
+
+      "%{IncludeDir.VulkanSDK}",
+      "%{IncludeDir.glm}",
+   }
+
+    links
+    {
+        "Walnut"
+    }
+
+   targetdir ("../bin/" .. outputdir .. "/%{prj.name}")
+   objdir ("../bin-int/" .. outputdir .. "/%{prj.name}")
+
+   filter "system:windows"
+      systemversion "latest"
+      defines { "WL_PLATFORM_WINDOWS" }
+
+   -- Static libraries do not carry their own dependencies on Linux
+   filter "system:linux"
+      defines { "WL_PLATFORM_LINUX" }
+      libdirs { "%{LibraryDir.VulkanSDK}" }
+      links { "ImGui", "GLFW", "%{Library.Vulkan}", "X11", "dl", "pthread" }
+
+   filter "configurations:Debug"
+      defines { "WL_DEBUG" }
+      runtime "Debug"
+      symbols "On"
+
+   filter "configurations:Release"
+      defines { "WL_RELEASE" }
+      runtime "Release"
+      optimize "On"
+      symbols "On"
+
+   -- Stays a console app, the results are printed to stdout
+   filter "configurations:Dist"
+      defines { "WL_DIST" }
+      runtime "Release"
+      optimize "On"
+      symbols "Off"
+
+   WalnutProfileConfiguration()
@@ -0,0 +1,89 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+
+namespace WalnutBench {
+
+	double Percentile(std::vector<double>& samples, double percentile)
+	{
+		if (samples.empty())
+			return 0.0;
+
+		std::sort(samples.begin(), samples.end());
+		size_t rank = (size_t)std::ceil(percentile / 100.0 * (double)samples.size());
+		return samples[std::clamp<size_t>(rank, 1, samples.size()) - 1];
+	}
+
+	const BenchmarkResult& BenchmarkRecorder::AddResult(const std::string& name, uint64_t operationsPerSample, double bytesPerOperation, std::vector<double>& sampleNs)
+	{
+		BenchmarkResult& result = m_Results.emplace_back();
+		result.Name = name;
+		result.Samples = (uint32_t)sampleNs.size();
+		result.OperationsPerSample = operationsPerSample;
+		result.BytesPerOperation = bytesPerOperation;
+
+		if (!sampleNs.empty())
+		{
+			result.MeanNs = std::accumulate(sampleNs.begin(), sampleNs.end(), 0.0) / (double)sampleNs.size();
+			result.MedianNs = Percentile(sampleNs, 50.0);
+			result.MinNs = sampleNs.front();
+			result.MaxNs = sampleNs.back();
+		}
+
+		std::cout << "[BENCH] " << result.Name << " - " << result.MedianNs << "ns (median of " << result.Samples << ")\n";
+		return result;
+	}
+
+	bool BenchmarkRecorder::WriteJSON(const std::string& filepath, const std::string& deviceName) const
+	{
+		std::ofstream stream(filepath);
+		if (!stream)
+		{
+			std::cerr << "Could not write benchmark results to " << filepath << "\n";
+			return false;
+		}
+
+		stream << "{\n";
+		stream << "  \"version\": 1,\n";
+		stream << "  \"device\": \"" << deviceName << "\",\n";
+
+		stream << "  \"benchmarks\": [\n";
+		for (size_t i = 0; i < m_Results.size(); i++)
+		{
+			const BenchmarkResult& result = m_Results[i];
+			double throughput = result.BytesPerOperation > 0.0 && result.MedianNs > 0.0 ? result.BytesPerOperation / result.MedianNs * 1e9 / (1024.0 * 1024.0) : 0.0;
+
+			stream << "    { ";
+			stream << "\"name\": \"" << result.Name << "\", ";
+			stream << "\"samples\": " << result.Samples << ", ";
+			stream << "\"operations_per_sample\": " << result.OperationsPerSample << ", ";
+			stream << "\"mean_ns\": " << result.MeanNs << ", ";
+			stream << "\"median_ns\": " << result.MedianNs << ", ";
+			stream << "\"min_ns\": " << result.MinNs << ", ";
+			stream << "\"max_ns\": " << result.MaxNs << ", ";
+			stream << "\"throughput_mib_s\": " << throughput;
+			stream << " }" << (i + 1 < m_Results.size() ? "," : "") << "\n";
+		}
+		stream << "  ],\n";
+
+		stream << "  \"frame_loop\": {\n";
+		stream << "    \"frames\": " << m_FrameLoop.Frames << ",\n";
+		stream << "    \"layers\": " << m_FrameLoop.Layers << ",\n";
+		stream << "    \"images\": " << m_FrameLoop.Images << ",\n";
+		stream << "    \"image_size\": " << m_FrameLoop.ImageSize << ",\n";
+		stream << "    \"mean_ms\": " << m_FrameLoop.MeanMs << ",\n";
+		stream << "    \"median_ms\": " << m_FrameLoop.MedianMs << ",\n";
+		stream << "    \"p95_ms\": " << m_FrameLoop.P95Ms << ",\n";
+		stream << "    \"p99_ms\": " << m_FrameLoop.P99Ms << ",\n";
+		stream << "    \"max_ms\": " << m_FrameLoop.MaxMs << "\n";
+		stream << "  }\n";
+		stream << "}\n";
+
+		return true;
+	}
+
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <stdint.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace WalnutBench {
+
+	// Timings are per operation, in nanoseconds
+	struct BenchmarkResult
+	{
+		std::string Name;
+		uint32_t Samples = 0;
+		uint64_t OperationsPerSample = 1;
+		double BytesPerOperation = 0.0;
+
+		double MeanNs = 0.0;
+		double MedianNs = 0.0;
+		double MinNs = 0.0;
+		double MaxNs = 0.0;
+	};
+
+	struct FrameLoopResult
+	{
+		uint32_t Frames = 0;
+		uint32_t Layers = 0;
+		uint32_t Images = 0;
+		uint32_t ImageSize = 0;
+
+		double MeanMs = 0.0;
+		double MedianMs = 0.0;
+		double P95Ms = 0.0;
+		double P99Ms = 0.0;
+		double MaxMs = 0.0;
+	};
+
+	// Keeps the compiler from optimizing away a benchmarked result
+	template<typename T>
+	inline void DoNotOptimize(const T& value)
+	{
+#if defined(__GNUC__) || defined(__clang__)
+		asm volatile("" : : "r,m"(value) : "memory");
+#else
+		static const void* volatile s_Sink;
+		s_Sink = &value;
+#endif
+	}
+
+	class BenchmarkRecorder
+	{
+	public:
+		// Calls func `samples` times and records each call as `operationsPerSample` operations
+		template<typename Func>
+		const BenchmarkResult& Measure(const std::string& name, uint32_t samples, uint64_t operationsPerSample, double bytesPerOperation, Func&& func)
+		{
+			std::vector<double> sampleNs;
+			sampleNs.reserve(samples);
+			for (uint32_t i = 0; i < samples; i++)
+			{
+				auto start = std::chrono::steady_clock::now();
+				func();
+				auto end = std::chrono::steady_clock::now();
+				sampleNs.push_back(std::chrono::duration<double, std::nano>(end - start).count() / (double)operationsPerSample);
+			}
+
+			return AddResult(name, operationsPerSample, bytesPerOperation, sampleNs);
+		}
+
+		void SetFrameLoopResult(const FrameLoopResult& result) { m_FrameLoop = result; }
+
+		bool WriteJSON(const std::string& filepath, const std::string& deviceName) const;
+	private:
+		const BenchmarkResult& AddResult(const std::string& name, uint64_t operationsPerSample, double bytesPerOperation, std::vector<double>& sampleNs);
+	private:
+		std::vector<BenchmarkResult> m_Results;
+		FrameLoopResult m_FrameLoop;
+	};
+
+	// Nearest-rank percentile, sorts the samples in place
+	double Percentile(std::vector<double>& samples, double percentile);
+
+}
@@ -0,0 +1,454 @@
+#include "Walnut/Application.h"
+#include "Walnut/EntryPoint.h"
+
+#include "Walnut/Image.h"
+#include "Walnut/PixelConversion.h"
+#include "Walnut/Random.h"
+#include "Walnut/Sampling.h"
+#include "Walnut/Timer.h"
+#include "Walnut/VectorSoA.h"
+
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <numeric>
+
+//
+// WalnutBench runs the microbenchmarks one per frame (so resources freed by
+// Walnut's per-frame queues are actually released between them), then renders
+// a fixed number of frames with the frame-loop layers active and writes all
+// results to a JSON file before closing.
+//
+// Usage: WalnutBench [--frames N] [--layers N] [--images N] [--image-size N]
+//                    [--samples N] [--output results.json]
+//
+// To run against a software Vulkan driver such as lavapipe, point the loader at its ICD:
+//   VK_ICD_FILENAMES=/usr/share/vulkan/icd.d/lvp_icd.x86_64.json ./WalnutBench
+//
+
+struct BenchSettings
+{
+	uint32_t Frames = 1000;
+	uint32_t Layers = 4;
+	uint32_t Images = 16;
+	uint32_t ImageSize = 256;
+	uint32_t Samples = 32;
+	std::string OutputPath = "WalnutBench.json";
+};
+
+static const char* ImageFormatName(Walnut::ImageFormat format)
+{
+	switch (format)
+	{
+		case Walnut::ImageFormat::RGBA:    return "RGBA";
+		case Walnut::ImageFormat::RGBA32F: return "RGBA32F";
+	}
+	return "None";
+}
+
+static uint32_t ImageFormatBytesPerPixel(Walnut::ImageFormat format)
+{
+	switch (format)
+	{
+		case Walnut::ImageFormat::RGBA:    return 4;
+		case Walnut::ImageFormat::RGBA32F: return 16;
+	}
+	return 0;
+}
+
+// Updates and draws a share of the images every frame while the frame loop is being measured
+class FrameLoopLayer : public Walnut::Layer
+{
+public:
+	FrameLoopLayer(uint32_t index, uint32_t imageCount, uint32_t imageSize, const bool& active)
+		: m_Index(index), m_ImageCount(imageCount), m_ImageSize(imageSize), m_Active(active) {}
+
+	virtual void OnAttach() override
+	{
+		m_Pixels.resize((size_t)m_ImageSize * m_ImageSize);
+		for (uint32_t i = 0; i < m_ImageCount; i++)
+			m_Images.push_back(std::make_shared<Walnut::Image>(m_ImageSize, m_ImageSize, Walnut::ImageFormat::RGBA, m_Pixels.data()));
+	}
+
+	virtual void OnDetach() override
+	{
+		m_Images.clear();
+	}
+
+	virtual void OnUpdate(float ts) override
+	{
+		if (!m_Active || m_Images.empty())
+			return;
+
+		for (uint32_t y = 0; y < m_ImageSize; y++)
+		{
+			for (uint32_t x = 0; x < m_ImageSize; x++)
+				m_Pixels[(size_t)y * m_ImageSize + x] = 0xff000000 | ((x ^ y) + m_FrameIndex) * 0x010101;
+		}
+
+		m_Images[m_FrameIndex % m_Images.size()]->SetData(m_Pixels.data());
+		m_FrameIndex++;
+	}
+
+	virtual void OnUIRender() override
+	{
+		if (!m_Active)
+			return;
+
+		std::string name = "Frame Loop Layer " + std::to_string(m_Index);
+		ImGui::Begin(name.c_str());
+		for (auto& image : m_Images)
+		{
+			ImGui::Image(image->GetDescriptorSet(), ImVec2(64.0f, 64.0f));
+			ImGui::SameLine();
+		}
+		ImGui::End();
+	}
+private:
+	uint32_t m_Index;
+	uint32_t m_ImageCount;
+	uint32_t m_ImageSize;
+	const bool& m_Active;
+
+	uint32_t m_FrameIndex = 0;
+	std::vector<uint32_t> m_Pixels;
+	std::vector<std::shared_ptr<Walnut::Image>> m_Images;
+};
+
+class BenchmarkLayer : public Walnut::Layer
+{
+public:
+	BenchmarkLayer(const BenchSettings& settings, bool& frameLoopActive)
+		: m_Settings(settings), m_FrameLoopActive(frameLoopActive) {}
+
+	virtual void OnAttach() override
+	{
+		QueueImageBenchmarks();
+		QueueRandomBenchmarks();
+		QueueTimerBenchmarks();
+		QueuePixelConversionBenchmarks();
+		QueueVectorSoABenchmarks();
+	}
+
+	virtual void OnUpdate(float ts) override
+	{
+		if (!m_Steps.empty())
+		{
+			m_Steps.front()();
+			m_Steps.pop_front();
+			return;
+		}
+
+		if (!m_FrameLoopActive)
+		{
+			m_FrameLoopActive = true;
+			m_FrameTimes.reserve(m_Settings.Frames);
+			m_FrameTimer.Reset();
+			return;
+		}
+
+		m_FrameTimes.push_back((float)m_FrameTimer.ElapsedMillis());
+		m_FrameTimer.Reset();
+
+		if (m_FrameTimes.size() == m_Settings.Frames)
+			Finish();
+	}
+private:
+	void QueueImageBenchmarks()
+	{
+		const Walnut::ImageFormat formats[] = { Walnut::ImageFormat::RGBA, Walnut::ImageFormat::RGBA32F };
+		const uint32_t sizes[] = { 64, 256, 1024, 4096 };
+
+		// Keeps the images alive within a step bounded, they are only freed a few frames later
+		const uint64_t maxBytesPerStep = 512ull * 1024 * 1024;
+
+		for (Walnut::ImageFormat format : formats)
+		{
+			for (uint32_t size : sizes)
+			{
+				uint64_t imageBytes = (uint64_t)size * size * ImageFormatBytesPerPixel(format);
+				uint32_t samples = (uint32_t)std::clamp<uint64_t>(maxBytesPerStep / imageBytes, 1, m_Settings.Samples);
+				std::string suffix = std::string(ImageFormatName(format)) + "/" + std::to_string(size) + "x" + std::to_string(size);
+
+				m_Steps.push_back([this, format, size, samples, suffix]()
+				{
+					std::vector<std::unique_ptr<Walnut::Image>> images;
+					images.reserve(samples);
+					m_Recorder.Measure("Image/Create/" + suffix, samples, 1, 0.0, [&]()
+					{
+						images.push_back(std::make_unique<Walnut::Image>(size, size, format));
+					});
+				});
+
+				m_Steps.push_back([this, format, size, samples, imageBytes, suffix]()
+				{
+					std::vector<uint8_t> data(imageBytes, 0x7f);
+					Walnut::Image image(size, size, format, data.data());
+					m_Recorder.Measure("Image/SetData/" + suffix, samples, 1, (double)imageBytes, [&]()
+					{
+						image.SetData(data.data());
+					});
+				});
+
+				m_Steps.push_back([this, format, size, samples, suffix]()
+				{
+					Walnut::Image image(size, size, format);
+					uint32_t resizeIndex = 0;
+					m_Recorder.Measure("Image/Resize/" + suffix, samples, 1, 0.0, [&]()
+					{
+						uint32_t newSize = (resizeIndex++ % 2 == 0) ? size / 2 : size;
+						image.Resize(newSize, newSize);
+					});
+				});
+			}
+		}
+	}
+
+	void QueueRandomBenchmarks()
+	{
+		const uint64_t operations = 1'000'000;
+		const uint32_t samples = 16;
+
+		m_Steps.push_back([this, operations, samples]()
+		{
+			Walnut::Random::Init();
+
+			m_Recorder.Measure("Random/UInt", samples, operations, sizeof(uint32_t), [&]()
+			{
+				for (uint64_t i = 0; i < operations; i++)
+					WalnutBench::DoNotOptimize(Walnut::Random::UInt());
+			});
+			m_Recorder.Measure("Random/Float", samples, operations, sizeof(float), [&]()
+			{
+				for (uint64_t i = 0; i < operations; i++)
+					WalnutBench::DoNotOptimize(Walnut::Random::Float());
+			});
+			m_Recorder.Measure("Random/Vec3", samples, operations, sizeof(glm::vec3), [&]()
+			{
+				for (uint64_t i = 0; i < operations; i++)
+					WalnutBench::DoNotOptimize(Walnut::Random::Vec3());
+			});
+			m_Recorder.Measure("Random/InUnitSphere", samples, operations, sizeof(glm::vec3), [&]()
+			{
+				for (uint64_t i = 0; i < operations; i++)
+					WalnutBench::DoNotOptimize(Walnut::Random::InUnitSphere());
+			});
+
+			m_Recorder.Measure("Sampling/Sobol2D", samples, operations, sizeof(glm::vec2), [&]()
+			{
+				for (uint64_t i = 0; i < operations; i++)
+					WalnutBench::DoNotOptimize(Walnut::Sampling::Sobol2D((uint32_t)i, 1234));
+			});
+			m_Recorder.Measure("Sampling/R2", samples, operations, sizeof(glm::vec2), [&]()
+			{
+				for (uint64_t i = 0; i < operations; i++)
+					WalnutBench::DoNotOptimize(Walnut::Sampling::R2((uint32_t)i, 1234));
+			});
+			m_Recorder.Measure("Sampling/CosineHemisphere", samples, operations, sizeof(glm::vec3), [&]()
+			{
+				for (uint64_t i = 0; i < operations; i++)
+					WalnutBench::DoNotOptimize(Walnut::Sampling::SquareToCosineHemisphere(Walnut::Sampling::R2((uint32_t)i)));
+			});
+		});
+	}
+
+	void QueueTimerBenchmarks()
+	{
+		const uint64_t operations = 1'000'000;
+		const uint32_t samples = 16;
+
+		m_Steps.push_back([this, operations, samples]()
+		{
+			m_Recorder.Measure("Timer/Construct", samples, operations, 0.0, [&]()
+			{
+				for (uint64_t i = 0; i < operations; i++)
+				{
+					Walnut::Timer timer;
+					WalnutBench::DoNotOptimize(timer);
+				}
+			});
+
+			Walnut::Timer timer;
+			m_Recorder.Measure("Timer/Elapsed", samples, operations, 0.0, [&]()
+			{
+				for (uint64_t i = 0; i < operations; i++)
+					WalnutBench::DoNotOptimize(timer.Elapsed());
+			});
+
+			Walnut::Application& app = Walnut::Application::Get();
+			m_Recorder.Measure("Application/GetTime", samples, operations, 0.0, [&]()
+			{
+				for (uint64_t i = 0; i < operations; i++)
+					WalnutBench::DoNotOptimize(app.GetTime());
+			});
+		});
+	}
+
+	void QueuePixelConversionBenchmarks()
+	{
+		const size_t pixelCount = 1920 * 1080;
+		const uint32_t samples = 16;
+		const char* levelNames[] = { "Scalar", "SSE41", "AVX2" };
+
+		for (uint32_t level = 0; level <= (uint32_t)Walnut::PixelConversion::GetSupportedSIMDLevel(); level++)
+		{
+			m_Steps.push_back([this, pixelCount, samples, level, levelName = std::string(levelNames[level])]()
+			{
+				Walnut::PixelConversion::SetSIMDLevel((Walnut::SIMDLevel)level);
+
+				std::vector<glm::vec4> accumulation(pixelCount);
+				for (glm::vec4& color : accumulation)
+					color = glm::vec4(Walnut::Random::Vec3(0.0f, 64.0f), 64.0f);
+				std::vector<uint32_t> pixels(pixelCount);
+				std::vector<uint16_t> halves(pixelCount * 4);
+
+				m_Recorder.Measure("PixelConversion/AccumulationToRGBA8/SRGB/" + levelName, samples, pixelCount, sizeof(glm::vec4), [&]()
+				{
+					Walnut::PixelConversion::AccumulationToRGBA8(accumulation.data(), pixels.data(), pixelCount, 64, Walnut::ColorEncoding::SRGB);
+				});
+				m_Recorder.Measure("PixelConversion/SwizzleRGBA8BGRA8/" + levelName, samples, pixelCount, sizeof(uint32_t), [&]()
+				{
+					Walnut::PixelConversion::SwizzleRGBA8BGRA8(pixels.data(), pixels.data(), pixelCount);
+				});
+				m_Recorder.Measure("PixelConversion/FloatToHalf/" + levelName, samples, pixelCount, sizeof(glm::vec4), [&]()
+				{
+					Walnut::PixelConversion::FloatToHalf(&accumulation[0].x, halves.data(), pixelCount * 4);
+				});
+
+				Walnut::PixelConversion::SetSIMDLevel(Walnut::SIMDLevel::AVX2);
+			});
+		}
+	}
+
+	void QueueVectorSoABenchmarks()
+	{
+		const size_t vectorCount = 1 << 20;
+		const uint32_t samples = 16;
+		const char* levelNames[] = { "Scalar", "SSE41", "AVX2" };
+
+		for (uint32_t level = 0; level <= (uint32_t)Walnut::PixelConversion::GetSupportedSIMDLevel(); level++)
+		{
+			m_Steps.push_back([this, vectorCount, samples, level, levelName = std::string(levelNames[level])]()
+			{
+				Walnut::PixelConversion::SetSIMDLevel((Walnut::SIMDLevel)level);
+
+				Walnut::Vec3SoA positions(vectorCount), velocities(vectorCount);
+				for (size_t i = 0; i < vectorCount; i++)
+				{
+					positions.Set(i, Walnut::Random::Vec3(-1.0f, 1.0f));
+					velocities.Set(i, Walnut::Random::Vec3(-1.0f, 1.0f));
+				}
+				std::vector<float> lengths(vectorCount);
+				glm::mat4 transform(1.0f);
+				transform[3] = glm::vec4(1.0f, 2.0f, 3.0f, 1.0f);
+
+				m_Recorder.Measure("VectorSoA/FMA/" + levelName, samples, vectorCount, sizeof(glm::vec3) * 2, [&]()
+				{
+					Walnut::VectorSoA::FMA(velocities, 0.016f, positions, positions);
+				});
+				m_Recorder.Measure("VectorSoA/Length/" + levelName, samples, vectorCount, sizeof(glm::vec3), [&]()
+				{
+					Walnut::VectorSoA::Length(positions, lengths.data());
+				});
+				m_Recorder.Measure("VectorSoA/Normalize/" + levelName, samples, vectorCount, sizeof(glm::vec3), [&]()
+				{
+					Walnut::VectorSoA::Normalize(velocities, velocities);
+				});
+				m_Recorder.Measure("VectorSoA/TransformPoint/" + levelName, samples, vectorCount, sizeof(glm::vec3), [&]()
+				{
+					Walnut::VectorSoA::TransformPoint(transform, positions, positions);
+				});
+
+				Walnut::PixelConversion::SetSIMDLevel(Walnut::SIMDLevel::AVX2);
+			});
+		}
+	}
+
+	void Finish()
+	{
+		WalnutBench::FrameLoopResult result;
+		result.Frames = m_Settings.Frames;
+		result.Layers = m_Settings.Layers;
+		result.Images = m_Settings.Images;
+		result.ImageSize = m_Settings.ImageSize;
+
+		std::vector<double> frameTimes(m_FrameTimes.begin(), m_FrameTimes.end());
+		result.MeanMs = std::accumulate(frameTimes.begin(), frameTimes.end(), 0.0) / (double)frameTimes.size();
+		result.MedianMs = WalnutBench::Percentile(frameTimes, 50.0);
+		result.P95Ms = WalnutBench::Percentile(frameTimes, 95.0);
+		result.P99Ms = WalnutBench::Percentile(frameTimes, 99.0);
+		result.MaxMs = frameTimes.back();
+		m_Recorder.SetFrameLoopResult(result);
+
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(Walnut::Application::GetPhysicalDevice(), &properties);
+
+		if (m_Recorder.WriteJSON(m_Settings.OutputPath, properties.deviceName))
+			std::cout << "[BENCH] Results written to " << m_Settings.OutputPath << "\n";
+
+		Walnut::Application::Get().Close();
+	}
+private:
+	const BenchSettings& m_Settings;
+	bool& m_FrameLoopActive;
+
+	std::deque<std::function<void()>> m_Steps;
+	WalnutBench::BenchmarkRecorder m_Recorder;
+
+	Walnut::Timer m_FrameTimer;
+	std::vector<float> m_FrameTimes;
+};
+
+static BenchSettings ParseSettings(int argc, char** argv)
+{
+	BenchSettings settings;
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		std::string option = argv[i];
+		std::string value = argv[i + 1];
+
+		if (option == "--frames")
+			settings.Frames = std::max(1, std::stoi(value));
+		else if (option == "--layers")
+			settings.Layers = std::max(1, std::stoi(value));
+		else if (option == "--images")
+			settings.Images = std::max(0, std::stoi(value));
+		else if (option == "--image-size")
+			settings.ImageSize = std::max(1, std::stoi(value));
+		else if (option == "--samples")
+			settings.Samples = std::max(1, std::stoi(value));
+		else if (option == "--output")
+			settings.OutputPath = value;
+		else
+			std::cerr << "Unknown option " << option << "\n";
+	}
+	return settings;
+}
+
+static BenchSettings s_Settings;
+static bool s_FrameLoopActive = false;
+
+Walnut::Application* Walnut::CreateApplication(int argc, char** argv)
+{
+	s_Settings = ParseSettings(argc, argv);
+	s_FrameLoopActive = false;
+
+	Walnut::ApplicationSpecification spec;
+	spec.Name = "Walnut Bench";
+	spec.VSync = false;
+
+	Walnut::Application* app = new Walnut::Application(spec);
+	app->PushLayer(std::make_shared<BenchmarkLayer>(s_Settings, s_FrameLoopActive));
+
+	// Spread the images over the layers, the first layers take the remainder
+	for (uint32_t i = 0; i < s_Settings.Layers; i++)
+	{
+		uint32_t imageCount = s_Settings.Images / s_Settings.Layers + (i < s_Settings.Images % s_Settings.Layers ? 1 : 0);
+		app->PushLayer(std::make_shared<FrameLoopLayer>(i, imageCount, s_Settings.ImageSize, s_FrameLoopActive));
+	}
+
+	return app;
+}
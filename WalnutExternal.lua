@@ -3,20 +3,112 @@
 VULKAN_SDK = os.getenv("VULKAN_SDK")
 
 IncludeDir = {}
-IncludeDir["VulkanSDK"] = "%{VULKAN_SDK}/Include"
 IncludeDir["glm"] = "../vendor/glm"
 
 LibraryDir = {}
-LibraryDir["VulkanSDK"] = "%{VULKAN_SDK}/Lib"
 
 Library = {}
-Library["Vulkan"] = "%{LibraryDir.VulkanSDK}/vulkan-1.lib"
+
+if os.target() == "windows" then
+   IncludeDir["VulkanSDK"] = "%{VULKAN_SDK}/Include"
+   LibraryDir["VulkanSDK"] = "%{VULKAN_SDK}/Lib"
+   Library["Vulkan"] = "%{LibraryDir.VulkanSDK}/vulkan-1.lib"
+else
+   -- Prefer the LunarG SDK when it has been set up, otherwise use the distribution's Vulkan headers and loader
+   IncludeDir["VulkanSDK"] = VULKAN_SDK and "%{VULKAN_SDK}/include" or "/usr/include"
+   LibraryDir["VulkanSDK"] = VULKAN_SDK and "%{VULKAN_SDK}/lib" or "/usr/lib"
+   Library["Vulkan"] = "vulkan"
+end
+
+-- Shader compiler and validator for --compile-shaders, from the SDK when it has been set up, otherwise from PATH
+-- (eg. the distribution's glslc and spirv-tools packages)
+Tool = {}
+if os.target() == "windows" then
+   Tool["glslc"] = '"%{VULKAN_SDK}/Bin/glslc.exe"'
+   Tool["spirv_val"] = '"%{VULKAN_SDK}/Bin/spirv-val.exe"'
+else
+   Tool["glslc"] = VULKAN_SDK and "%{VULKAN_SDK}/bin/glslc" or "glslc"
+   Tool["spirv_val"] = VULKAN_SDK and "%{VULKAN_SDK}/bin/spirv-val" or "spirv-val"
+end
+
+newoption
+{
+   trigger = "pgo",
+   value = "STAGE",
+   description = "Profile-guided optimization stage for the Profile configuration",
+   allowed =
+   {
+      { "instrument", "Build binaries that record an execution profile" },
+      { "use", "Optimize using the profile recorded by an instrumented run" },
+   }
+}
+
+newoption
+{
+   trigger = "compile-shaders",
+   description = "Recompile and validate the committed SPIR-V of Walnut's shaders before building (needs glslc and spirv-val)"
+}
+
+newoption
+{
+   trigger = "unity",
+   description = "Compile the Walnut library as a single unity translation unit"
+}
+
+-- Profile data for every project goes to one place so the Walnut library objects
+-- pick up the profile recorded by whichever executable exercised them
+PGODir = "%{wks.location}/bin-int/pgo"
+
+-- Optimized, symbol-carrying configuration with link-time optimization across
+-- the Walnut static library and the application. Called from each project.
+function WalnutProfileConfiguration()
+   filter "configurations:Profile"
+      defines { "WL_PROFILE" }
+      runtime "Release"
+      optimize "Speed"
+      symbols "On"
+      flags { "LinkTimeOptimization" }
+
+   -- Fat LTO objects keep the static library usable with plain ar
+   filter { "configurations:Profile", "system:linux" }
+      buildoptions { "-ffat-lto-objects" }
+
+   if _OPTIONS["pgo"] == "instrument" then
+      filter { "configurations:Profile", "system:linux" }
+         buildoptions { "-fprofile-generate=" .. PGODir, "-fprofile-update=atomic" }
+         linkoptions { "-fprofile-generate=" .. PGODir }
+
+      filter { "configurations:Profile", "system:windows" }
+         linkoptions { "/GENPROFILE:PGD=%{cfg.targetdir}/%{prj.name}.pgd" }
+   elseif _OPTIONS["pgo"] == "use" then
+      filter { "configurations:Profile", "system:linux" }
+         buildoptions { "-fprofile-use=" .. PGODir, "-fprofile-correction", "-Wno-missing-profile" }
+         linkoptions { "-fprofile-use=" .. PGODir }
+
+      filter { "configurations:Profile", "system:windows" }
+         linkoptions { "/USEPROFILE:PGD=%{cfg.targetdir}/%{prj.name}.pgd" }
+   end
+
+   filter {}
+end
 
 group "Dependencies"
    include "vendor/imgui"
    include "vendor/glfw"
 group ""
 
+-- The vendored projects only configure Debug, Release and Dist, so build them like Release under Profile
+-- instead of with premake's unoptimized defaults (and a mismatched MSVC runtime)
+for _, vendorProject in ipairs({ "ImGui", "GLFW" }) do
+   project(vendorProject)
+      filter "configurations:Profile"
+         runtime "Release"
+         optimize "Speed"
+         symbols "On"
+
+      filter {}
+end
+
 group "Core"
 include "Walnut"
-group ""
\ No newline at end of file
+group ""
@@ -1,10 +1,11 @@
 -- premake5.lua
 workspace "WalnutApp"
    architecture "x64"
-   configurations { "Debug", "Release", "Dist" }
+   configurations { "Debug", "Release", "Profile", "Dist" }
    startproject "WalnutApp"
 
 outputdir = "%{cfg.buildcfg}-%{cfg.system}-%{cfg.architecture}"
 
 include "WalnutExternal.lua"
-include "WalnutApp"
\ No newline at end of file
+include "WalnutApp"
+include "WalnutBench"
\ No newline at end of file
@@ -0,0 +1,20 @@
+#!/bin/sh
+# Builds the Profile configuration with profile-guided optimization:
+#   1. instrumented build, 2. WalnutBench run to record the profile, 3. optimized rebuild
+# Extra arguments are passed to WalnutBench, eg. --frames 2000
+set -e
+
+cd "$(dirname "$0")/.."
+
+JOBS=$(nproc)
+
+rm -rf bin-int/pgo
+scripts/Setup.sh --pgo=instrument
+make config=profile clean
+make config=profile -j"$JOBS"
+
+(cd WalnutBench && ../bin/Profile-linux-x86_64/WalnutBench/WalnutBench --output ../bin-int/pgo/WalnutBench.json "$@")
+
+scripts/Setup.sh --pgo=use
+make config=profile clean
+make config=profile -j"$JOBS"
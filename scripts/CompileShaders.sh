@@ -0,0 +1,15 @@
+#!/bin/sh
+# Recompiles Walnut's shaders to the committed SPIR-V words (*.comp.inc) and validates them.
+# Uses glslc and spirv-val from $VULKAN_SDK when set, otherwise from PATH
+set -e
+
+cd "$(dirname "$0")/../Walnut/src/Walnut/Shaders"
+
+GLSLC=${VULKAN_SDK:+$VULKAN_SDK/bin/}glslc
+SPIRV_VAL=${VULKAN_SDK:+$VULKAN_SDK/bin/}spirv-val
+
+for shader in *.comp; do
+	"$GLSLC" --target-env=vulkan1.0 -O "$shader" -o "$shader.spv"
+	"$SPIRV_VAL" --target-env vulkan1.0 "$shader.spv"
+	"$GLSLC" --target-env=vulkan1.0 -O -mfmt=num "$shader" -o "$shader.inc"
+done
@@ -0,0 +1,11 @@
+#!/bin/sh
+# Generates GNU makefiles, pass extra premake options such as --unity or --pgo=use through
+
+cd "$(dirname "$0")/.."
+
+PREMAKE=premake5
+if [ -x vendor/bin/premake5 ]; then
+	PREMAKE=vendor/bin/premake5
+fi
+
+$PREMAKE gmake2 "$@"